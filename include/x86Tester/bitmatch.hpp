@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace x86Tester::BitMatch
+{
+    // Five ZMM sized roots and the flags, padded to whole 256 bit lanes.
+    inline constexpr std::size_t kMaxImageSize = 352;
+    inline constexpr std::size_t kLaneSize = 32;
+    static_assert(kMaxImageSize % kLaneSize == 0);
+
+    // Packed copy of the register bytes the test matrix refers to.
+    struct alignas(kLaneSize) Image
+    {
+        std::array<std::uint8_t, kMaxImageSize> bytes{};
+
+        bool test(std::size_t bitIndex) const
+        {
+            return (bytes[bitIndex / 8] & (1U << (bitIndex % 8))) != 0;
+        }
+
+        void set(std::size_t bitIndex)
+        {
+            bytes[bitIndex / 8] |= static_cast<std::uint8_t>(1U << (bitIndex % 8));
+        }
+    };
+
+    // Bits that still have to be observed with a specific value.
+    class Targets
+    {
+        Image _expect0;
+        Image _expect1;
+        // Bits that only count if the input had the opposite value, for registers that are written
+        // without being read an unchanged bit says nothing.
+        Image _requireChange;
+        std::size_t _size{};
+        std::size_t _count{};
+
+    public:
+        // Size of the image in bytes, at most kMaxImageSize.
+        explicit Targets(std::size_t size);
+
+        void add(std::size_t bitIndex, std::uint8_t expectedValue);
+
+        void requireChange(std::size_t bitIndex);
+
+        // Removes the matched bits, returns how many targets were removed.
+        std::size_t remove(const Image& matched0, const Image& matched1);
+
+        std::size_t getCount() const
+        {
+            return _count;
+        }
+
+        bool empty() const
+        {
+            return _count == 0;
+        }
+
+        // Writes the targets the output satisfies given the input, returns false if there are none.
+        bool match(const Image& input, const Image& output, Image& matched0, Image& matched1) const;
+
+        // Implementations behind match, exposed for testing.
+        bool matchScalar(const Image& input, const Image& output, Image& matched0, Image& matched1) const;
+        bool matchAvx2(const Image& input, const Image& output, Image& matched0, Image& matched1) const;
+
+        // Same as matchScalar for a size known at compile time, the loop unrolls into a few mask compares.
+        template<std::size_t TSize>
+        bool matchFixed(const Image& input, const Image& output, Image& matched0, Image& matched1) const
+        {
+            static_assert(TSize <= kMaxImageSize);
+            assert(_size == TSize);
+
+            std::uint64_t any = 0;
+            for (std::size_t offset = 0; offset < TSize; offset += sizeof(std::uint64_t))
+            {
+                any |= matchWord(input, output, matched0, matched1, offset);
+            }
+            return any != 0;
+        }
+
+    private:
+        static std::uint64_t loadWord(const Image& image, std::size_t offset)
+        {
+            std::uint64_t value;
+            std::memcpy(&value, image.bytes.data() + offset, sizeof(value));
+            return value;
+        }
+
+        static void storeWord(Image& image, std::size_t offset, std::uint64_t value)
+        {
+            std::memcpy(image.bytes.data() + offset, &value, sizeof(value));
+        }
+
+        // Returns the matched bits of the word at offset.
+        std::uint64_t matchWord(
+            const Image& input, const Image& output, Image& matched0, Image& matched1, std::size_t offset) const
+        {
+            const auto in = loadWord(input, offset);
+            const auto out = loadWord(output, offset);
+            const auto requireChange = loadWord(_requireChange, offset);
+
+            // Observed 0, unless the bit already was 0 and had to change.
+            const auto m0 = ~out & loadWord(_expect0, offset) & ~(~in & requireChange);
+            // Observed 1, unless the bit already was 1 and had to change.
+            const auto m1 = out & loadWord(_expect1, offset) & ~(in & requireChange);
+
+            storeWord(matched0, offset, m0);
+            storeWord(matched1, offset, m1);
+            return m0 | m1;
+        }
+    };
+
+    // Bit values seen in the outputs so far, feedback for the input search.
+    class Coverage
+    {
+        Image _seen0;
+        Image _seen1;
+        std::size_t _size{};
+
+    public:
+        explicit Coverage(std::size_t size);
+
+        // Returns true if the output has a bit value that wasn't seen before.
+        bool update(const Image& output);
+    };
+
+    bool isAvx2Supported();
+
+} // namespace x86Tester::BitMatch
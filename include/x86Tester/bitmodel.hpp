@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Zydis/Zydis.h>
+#include <cstddef>
+#include <cstdint>
+#include <x86Tester/inputconstructor.hpp>
+
+namespace x86Tester::Generator
+{
+    // Bits of a value that are the same for every input, a bit in neither mask depends on the inputs.
+    struct KnownBits
+    {
+        std::uint64_t zero{};
+        std::uint64_t one{};
+
+        bool canBe(std::size_t bitIndex, bool value) const
+        {
+            const auto bit = std::uint64_t{ 1 } << bitIndex;
+            return ((value ? zero : one) & bit) == 0;
+        }
+    };
+
+    // Static model of the destination register and the flags of an instruction, derived from the operand
+    // constraints (immediates, identical registers, operand widths) without executing it. Entries of the
+    // test matrix it proves impossible can be dropped before the search, everything it can't decide is
+    // reported as possible.
+    class BitModel
+    {
+        ZydisRegister _destReg{};
+        std::size_t _destWidth{};
+        KnownBits _dest;
+        // Uses the ZYDIS_CPUFLAG_* masks.
+        KnownBits _flags;
+
+    public:
+        explicit BitModel(const ZydisDisassembledInstruction& instr);
+
+        // False if no input can produce the target. Exceptions and registers other than the destination
+        // are always possible.
+        bool isPossible(const InputTarget& target) const;
+
+        ZydisRegister getDestReg() const
+        {
+            return _destReg;
+        }
+
+        const KnownBits& getDestBits() const
+        {
+            return _dest;
+        }
+
+        const KnownBits& getFlags() const
+        {
+            return _flags;
+        }
+    };
+
+} // namespace x86Tester::Generator
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace x86Tester::Threading
+{
+    // Blocking multi producer/consumer queue with a fixed capacity, push waits while the queue is full
+    // so a fast stage can't run arbitrarily far ahead of a slow one.
+    template<typename T> class BoundedQueue
+    {
+        std::mutex _mutex;
+        std::condition_variable _notFullCv;
+        std::condition_variable _notEmptyCv;
+        std::deque<T> _items;
+        std::size_t _capacity;
+        bool _closed{};
+
+    public:
+        explicit BoundedQueue(std::size_t capacity)
+            : _capacity(capacity > 0 ? capacity : 1)
+        {
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // Returns false if the queue was closed, the value is dropped in that case.
+        bool push(T value)
+        {
+            {
+                std::unique_lock lock(_mutex);
+                _notFullCv.wait(lock, [&]() { return _closed || _items.size() < _capacity; });
+                if (_closed)
+                    return false;
+                _items.push_back(std::move(value));
+            }
+            _notEmptyCv.notify_one();
+            return true;
+        }
+
+        // Returns false once the queue is closed and drained.
+        bool pop(T& value)
+        {
+            {
+                std::unique_lock lock(_mutex);
+                _notEmptyCv.wait(lock, [&]() { return _closed || !_items.empty(); });
+                if (_items.empty())
+                    return false;
+                value = std::move(_items.front());
+                _items.pop_front();
+            }
+            _notFullCv.notify_one();
+            return true;
+        }
+
+        // Wakes up all waiters, the remaining items can still be popped.
+        void close()
+        {
+            {
+                std::lock_guard lock(_mutex);
+                _closed = true;
+            }
+            _notFullCv.notify_all();
+            _notEmptyCv.notify_all();
+        }
+    };
+
+} // namespace x86Tester::Threading
@@ -2,7 +2,10 @@
 
 #include <Zydis/Defines.h>
 #include <Zydis/Register.h>
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <span>
 
 namespace x86Tester::Execution
@@ -16,31 +19,164 @@ namespace x86Tester::Execution
         ExceptionIntDivideError,
         ExceptionIntOverflow,
         IllegalInstruction,
+        // Memory outside of the data window or a page the code may not access.
+        ExceptionAccessViolation,
     };
 
-    Context* prepare(ZydisMachineMode mode, std::span<const std::uint8_t> code);
+    enum class Backend
+    {
+        // In-process when the code allows it, otherwise the debugger.
+        Auto,
+        // Runs the code in a separate sandbox process, under a debugger on Windows and in a forked child
+        // that catches its own signals on Linux.
+        Debugger,
+        // Runs the code inside this process on a dedicated page, faults are caught with a vectored exception
+        // handler or a signal handler. The code must not access memory, the stack or the instruction pointer,
+        // there is no data window.
+        InProcess,
+    };
+
+    // Matches the legacy region of FXSAVE/XSAVE.
+    struct alignas(16) FxSaveArea
+    {
+        std::uint16_t controlWord;
+        std::uint16_t statusWord;
+        std::uint8_t tagWord;
+        std::uint8_t reserved1;
+        std::uint16_t errorOpcode;
+        std::uint32_t errorOffset;
+        std::uint16_t errorSelector;
+        std::uint16_t reserved2;
+        std::uint32_t dataOffset;
+        std::uint16_t dataSelector;
+        std::uint16_t reserved3;
+        std::uint32_t mxcsr;
+        std::uint32_t mxcsrMask;
+        std::uint8_t st[8][16];
+        std::uint8_t xmm[16][16];
+        std::uint8_t reserved4[96];
+    };
+    static_assert(sizeof(FxSaveArea) == 512);
+
+    // Bytes of scratch memory at the data address that are loaded before and stored after running the code,
+    // large enough for a ZMM operand.
+    inline constexpr std::size_t kDataWindowSize = 64;
+
+    // Register state that is loaded before and stored after running the code, this is what
+    // setRegBytes/getRegBytes operate on regardless of the backend.
+    struct alignas(64) RegisterFile
+    {
+        // Encoding order: RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8-R15.
+        std::uint64_t gpr[16];
+        std::uint64_t rip;
+        std::uint32_t eflags;
+        std::uint32_t reserved;
+        // x87 and MXCSR state, the XMM registers are taken from zmm.
+        FxSaveArea fx;
+        // ZMM0-31, XMM and YMM registers are the low bytes so each register is contiguous, the backends
+        // only transfer the parts the code uses.
+        alignas(64) std::uint8_t zmm[32][64];
+        // K0-K7.
+        std::uint64_t opmask[8];
+        // Contents of the data window, memory operands pointed at getDataAddress() see these bytes.
+        alignas(64) std::uint8_t data[kDataWindowSize];
+    };
+
+    using InputState = RegisterFile;
+
+    struct OutputState
+    {
+        RegisterFile regs;
+        ExecutionStatus status;
+        // Bytes of the data window that differ from the input, begin equals end if nothing changed.
+        std::uint16_t dataDirtyBegin;
+        std::uint16_t dataDirtyEnd;
+    };
+
+    bool setRegBytes(RegisterFile& regs, ZydisRegister reg, std::span<const std::uint8_t> data);
+
+    std::span<const uint8_t> getRegBytes(const RegisterFile& regs, ZydisRegister reg);
+
+    template<typename T> bool setRegValue(RegisterFile& regs, ZydisRegister reg, T data)
+    {
+        return setRegBytes(regs, reg, std::span(reinterpret_cast<const std::uint8_t*>(&data), sizeof(T)));
+    }
+
+    template<typename T> T getRegValue(const RegisterFile& regs, ZydisRegister reg)
+    {
+        T val{};
+        const auto data = getRegBytes(regs, reg);
+        std::memcpy(&val, data.data(), std::min(data.size(), sizeof(T)));
+        return val;
+    }
+
+    // A context can hold several codes, each in a slot of its own that starts with a breakpoint and is padded
+    // with breakpoints. Slots are cache line aligned, the code is at offset 1 of its slot.
+    inline constexpr std::size_t kCodeSlotSize = 64;
+    inline constexpr std::size_t kMaxCodeSlots = 256;
+
+    Context* prepare(ZydisMachineMode mode, std::span<const std::uint8_t> code, Backend backend = Backend::Auto);
+
+    // Packs all codes into a single sandbox, switching between them is a register write instead of a new
+    // context. The backend applies to all of them, Auto only picks in-process if every code supports it.
+    Context* prepare(
+        ZydisMachineMode mode, std::span<const std::span<const std::uint8_t>> codes, Backend backend = Backend::Auto);
 
     std::uint64_t getBaseAddress(Context* ctx);
 
+    // Address of the selected slot.
     std::uint64_t getCodeAddress(Context* ctx);
 
+    std::uint64_t getCodeAddress(Context* ctx, std::size_t slot);
+
+    std::size_t getSlotCount(Context* ctx);
+
+    // Address of the data window, the window is followed by a guard page so accesses past it fault. Zero if
+    // the backend has none.
+    std::uint64_t getDataAddress(Context* ctx);
+
+    // Makes the slot the code that runs from now on and points RIP of the context at it, slot 0 is
+    // selected after prepare.
+    bool selectSlot(Context* ctx, std::size_t slot);
+
     bool setRegBytes(Context* ctx, ZydisRegister reg, std::span<const std::uint8_t> data);
 
     std::span<const uint8_t> getRegBytes(Context* ctx, ZydisRegister reg);
 
+    // Registers of the context, initially the state of a fresh thread with all GPRs cleared.
+    const RegisterFile& getRegisterFile(Context* ctx);
+
     bool execute(Context* ctx);
 
+    // Runs the code once per input, the registers of the context are not modified. A fault only sets the
+    // status of its own entry, returns false if the backend itself failed.
+    bool executeBatch(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs);
+
+    // Selects the slot and runs it.
+    bool execute(Context* ctx, std::size_t slot);
+
+    bool executeBatch(
+        Context* ctx, std::size_t slot, std::span<const InputState> inputs, std::span<OutputState> outputs);
+
     void cleanup(Context* ctx);
 
     ExecutionStatus getExecutionStatus(Context* ctx);
 
+    Backend getBackend(Context* ctx);
+
     class ScopedContext
     {
         Context* ctx;
 
     public:
-        ScopedContext(ZydisMachineMode mode, std::span<const std::uint8_t> code)
-            : ctx(prepare(mode, code))
+        ScopedContext(ZydisMachineMode mode, std::span<const std::uint8_t> code, Backend backend = Backend::Auto)
+            : ctx(prepare(mode, code, backend))
+        {
+        }
+
+        ScopedContext(
+            ZydisMachineMode mode, std::span<const std::span<const std::uint8_t>> codes, Backend backend = Backend::Auto)
+            : ctx(prepare(mode, codes, backend))
         {
         }
 
@@ -64,6 +200,36 @@ namespace x86Tester::Execution
             return x86Tester::Execution::execute(ctx);
         }
 
+        bool executeBatch(std::span<const InputState> inputs, std::span<OutputState> outputs)
+        {
+            return x86Tester::Execution::executeBatch(ctx, inputs, outputs);
+        }
+
+        bool execute(std::size_t slot)
+        {
+            return x86Tester::Execution::execute(ctx, slot);
+        }
+
+        bool executeBatch(std::size_t slot, std::span<const InputState> inputs, std::span<OutputState> outputs)
+        {
+            return x86Tester::Execution::executeBatch(ctx, slot, inputs, outputs);
+        }
+
+        bool selectSlot(std::size_t slot)
+        {
+            return x86Tester::Execution::selectSlot(ctx, slot);
+        }
+
+        std::size_t getSlotCount() const
+        {
+            return x86Tester::Execution::getSlotCount(ctx);
+        }
+
+        const RegisterFile& getRegisterFile() const
+        {
+            return x86Tester::Execution::getRegisterFile(ctx);
+        }
+
         uint64_t getBaseAddress() const
         {
             return x86Tester::Execution::getBaseAddress(ctx);
@@ -74,6 +240,16 @@ namespace x86Tester::Execution
             return x86Tester::Execution::getCodeAddress(ctx);
         }
 
+        uint64_t getCodeAddress(std::size_t slot) const
+        {
+            return x86Tester::Execution::getCodeAddress(ctx, slot);
+        }
+
+        uint64_t getDataAddress() const
+        {
+            return x86Tester::Execution::getDataAddress(ctx);
+        }
+
         bool setRegBytes(ZydisRegister reg, std::span<const std::uint8_t> data)
         {
             return x86Tester::Execution::setRegBytes(ctx, reg, data);
@@ -102,6 +278,11 @@ namespace x86Tester::Execution
         {
             return x86Tester::Execution::getExecutionStatus(ctx);
         }
+
+        Backend getBackend() const
+        {
+            return x86Tester::Execution::getBackend(ctx);
+        }
     };
 
 } // namespace x86Tester::Execution
\ No newline at end of file
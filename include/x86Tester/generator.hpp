@@ -2,6 +2,7 @@
 
 #include <Zydis/Zydis.h>
 #include <bitset>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <vector>
@@ -23,7 +24,19 @@ namespace x86Tester::Generator
         }
     };
 
+    struct BuildStats
+    {
+        // Operand combinations that were enumerated.
+        std::size_t numCombinations{};
+        // Combinations without an encoding, including the ones rejected by the validity cache.
+        std::size_t numInvalid{};
+        // Combinations rejected by the validity cache without calling the encoder.
+        std::size_t numCacheHits{};
+        std::size_t numCacheMisses{};
+    };
+
     InstructionEntries buildInstructions(
-        ZydisMachineMode mode, const Filter& filter, bool buildInParallel, ProgressReportFn reporter = {});
+        ZydisMachineMode mode, const Filter& filter, bool buildInParallel, ProgressReportFn reporter = {},
+        BuildStats* stats = nullptr);
 
 } // namespace x86Tester::Generator
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Zydis/Zydis.h>
+#include <cstdint>
+#include <span>
+#include <x86Tester/random.hpp>
+#include <x86Tester/testdata.hpp>
+
+namespace x86Tester::Generator
+{
+    // Register input of the instruction, the data covers the bytes of the register itself.
+    struct InputField
+    {
+        ZydisRegister reg{};
+        std::span<std::uint8_t> data;
+    };
+
+    // Single entry of the test matrix, flags use ZYDIS_REGISTER_FLAGS with the flag index as bitPos.
+    struct InputTarget
+    {
+        TestData::ExceptionType exceptionType{};
+        ZydisRegister reg{};
+        std::uint16_t bitPos{};
+        std::uint8_t expectedBitValue{};
+    };
+
+    // Assigns inputs that should produce the target, the fields already hold generated values which
+    // are kept where the target doesn't constrain them. Returns false if the target is not handled,
+    // the input search then falls back to the generated values.
+    using InputConstructorFn = bool (*)(
+        const ZydisDisassembledInstruction& instr, const InputTarget& target, std::span<const InputField> fields,
+        std::uint32_t& flags, Random::Prng& prng);
+
+    // Returns nullptr for mnemonics without a constructor.
+    InputConstructorFn getInputConstructor(ZydisMnemonic mnemonic);
+
+} // namespace x86Tester::Generator
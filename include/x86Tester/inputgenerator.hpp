@@ -1,20 +1,51 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cstdint>
-#include <random>
-#include <sfl/small_vector.hpp>
+#include <sfl/static_vector.hpp>
 #include <span>
-#include <xmmintrin.h>
+#include <vector>
+#include <x86Tester/random.hpp>
 
 namespace x86Tester::Generator
 {
+    // Part of the result cache key, bump whenever the generated inputs change.
+    inline constexpr std::uint32_t kInputGeneratorVersion = 6;
+
+    // Widest register an input is generated for, ZMM.
+    inline constexpr std::size_t kMaxInputBytes = 64;
+
     namespace Detail
     {
-        template<typename T> static std::vector<std::vector<std::uint8_t>> generateIntegers()
+        // Fixed capacity list, the pools are built in constant expressions so exceeding the capacity
+        // fails to compile.
+        template<typename T, std::size_t TCapacity> struct FixedList
         {
-            std::vector<T> numbers;
+            std::array<T, TCapacity> values{};
+            std::size_t count{};
+
+            constexpr void push_back(const T& value)
+            {
+                values[count++] = value;
+            }
+
+            constexpr T* begin()
+            {
+                return values.data();
+            }
+
+            constexpr T* end()
+            {
+                return values.data() + count;
+            }
+        };
+
+        template<typename T> constexpr auto generateIntegers()
+        {
+            FixedList<T, 1024> numbers;
 
             // Add first 64 numbers, important for shifts and rotates.
             for (T i = 1; i < 64; i++)
@@ -70,7 +101,9 @@ namespace x86Tester::Generator
                 for (std::size_t i = 0; i < sizeof(T) * 8; i += 3)
                 {
                     value |= T{ 1 } << i;
-                    value |= T{ 1 } << (i + 1);
+                    // The last pair doesn't fit into 64 bits.
+                    if (i + 1 < sizeof(T) * 8)
+                        value |= T{ 1 } << (i + 1);
                 }
                 numbers.push_back(value);
             }
@@ -135,14 +168,13 @@ namespace x86Tester::Generator
 
             if constexpr (sizeof(T) >= 8)
             {
-                std::mt19937_64 prng{ 1 };
+                Random::SplitMix64 prng{ 1 };
 
                 // Generate random floating point numbers.
                 {
-                    std::uniform_real_distribution<double> dist(0.0f, 1.0f);
                     for (size_t i = 0; i < 64; i++)
                     {
-                        double value = dist(prng);
+                        double value = prng.nextUnit();
                         numbers.push_back(std::bit_cast<std::int64_t>(value));
                     }
                 }
@@ -154,9 +186,9 @@ namespace x86Tester::Generator
                 numbers.push_back(-i);
             }
 
-            for (size_t i = 0, maxNum = numbers.size(); i < maxNum; i++)
+            for (size_t i = 0, maxNum = numbers.count; i < maxNum; i++)
             {
-                auto num = numbers[i];
+                auto num = numbers.values[i];
                 if (num == 0)
                     continue;
                 if (num == -1)
@@ -171,111 +203,62 @@ namespace x86Tester::Generator
 
             // Make unique.
             std::sort(numbers.begin(), numbers.end());
-            numbers.erase(std::unique(numbers.begin(), numbers.end()), numbers.end());
+            numbers.count = static_cast<std::size_t>(std::unique(numbers.begin(), numbers.end()) - numbers.begin());
+
+            return numbers;
+        }
 
-            // Convert.
-            auto res = std::vector<std::vector<std::uint8_t>>{};
-            res.reserve(numbers.size());
+        using XmmValue = std::array<std::uint8_t, 16>;
 
-            for (auto num : numbers)
+        constexpr XmmValue makeXmmBits(std::size_t first, std::size_t last, std::size_t step = 1)
+        {
+            XmmValue bytes{};
+            for (std::size_t i = first; i < last; i += step)
             {
-                std::vector<std::uint8_t> bytes(sizeof(T));
-                std::memcpy(bytes.data(), &num, sizeof(T));
-                res.push_back(std::move(bytes));
+                bytes[i / 8] |= static_cast<std::uint8_t>(1 << (i % 8));
             }
-
-            return res;
+            return bytes;
         }
 
-        static std::vector<std::vector<std::uint8_t>> generateXmmNumbers()
+        constexpr auto generateXmmNumbers()
         {
-            std::vector<std::vector<std::uint8_t>> res;
+            FixedList<XmmValue, 512> res;
 
             // All bits set.
-            {
-                std::vector<std::uint8_t> bytes(16, 0xFF);
-                res.push_back(std::move(bytes));
-            }
+            res.push_back(makeXmmBits(0, 128));
 
             // 0-31 set.
-            {
-                std::vector<std::uint8_t> bytes(16, 0);
-                for (std::size_t i = 0; i < 32; i++)
-                {
-                    bytes[i / 8] |= 1 << (i % 8);
-                }
-                res.push_back(std::move(bytes));
-            }
+            res.push_back(makeXmmBits(0, 32));
 
             // 32-63 set.
-            {
-                std::vector<std::uint8_t> bytes(16, 0);
-                for (std::size_t i = 32; i < 64; i++)
-                {
-                    bytes[i / 8] |= 1 << (i % 8);
-                }
-                res.push_back(std::move(bytes));
-            }
+            res.push_back(makeXmmBits(32, 64));
 
             // 64-95 set.
-            {
-                std::vector<std::uint8_t> bytes(16, 0);
-                for (std::size_t i = 64; i < 96; i++)
-                {
-                    bytes[i / 8] |= 1 << (i % 8);
-                }
-                res.push_back(std::move(bytes));
-            }
+            res.push_back(makeXmmBits(64, 96));
 
             // 96-127 set.
-            {
-                std::vector<std::uint8_t> bytes(16, 0);
-                for (std::size_t i = 96; i < 128; i++)
-                {
-                    bytes[i / 8] |= 1 << (i % 8);
-                }
-                res.push_back(std::move(bytes));
-            }
+            res.push_back(makeXmmBits(96, 128));
 
             // Every second bit set.
-            {
-                std::vector<std::uint8_t> bytes(16, 0);
-                for (std::size_t i = 0; i < 128; i += 2)
-                {
-                    bytes[i / 8] |= 1 << (i % 8);
-                }
-                res.push_back(std::move(bytes));
-            }
+            res.push_back(makeXmmBits(0, 128, 2));
 
             // Special values.
-            {
-                std::vector<std::uint8_t> bytes(16, 0);
-
-                __m128 val{};
-                val.m128_u64[0] = 0xFFFFFFFFFF8000FF;
-
-                std::memcpy(bytes.data(), &val, sizeof(val));
-
-                res.push_back(bytes);
-            }
+            res.push_back(std::bit_cast<XmmValue>(std::array<std::uint64_t, 2>{ 0xFFFFFFFFFF8000FF, 0 }));
 
             // Random floats.
             {
-                std::mt19937_64 prng{ 1 };
-                std::uniform_real_distribution<float> dist(-99999.0f, 99999.0f);
+                Random::SplitMix64 prng{ 1 };
+                const auto nextFloat = [&]() {
+                    return static_cast<float>(-99999.0 + prng.nextUnit() * (99999.0 * 2));
+                };
+
                 for (size_t i = 0; i < 64; i++)
                 {
-                    std::vector<std::uint8_t> bytes(16);
-
-                    __m128 val{};
-                    val.m128_f32[0] = dist(prng);
-                    val.m128_f32[1] = dist(prng);
-                    val.m128_f32[2] = dist(prng);
-                    val.m128_f32[3] = dist(prng);
-
-                    std::memcpy(bytes.data(), &val, sizeof(val));
-
-                    res.push_back(std::move(bytes));
+                    const auto x = nextFloat();
+                    const auto y = nextFloat();
+                    const auto z = nextFloat();
+                    const auto w = nextFloat();
+                    res.push_back(std::bit_cast<XmmValue>(std::array<float, 4>{ x, y, z, w }));
                 }
             }
 
@@ -287,17 +270,8 @@ namespace x86Tester::Generator
                     {
                         for (std::uint32_t d0 = 0; d0 < 4; d0++)
                         {
-                            std::vector<std::uint8_t> bytes(16);
-
-                            __m128 val{};
-                            val.m128_u32[0] = a0 * 9;
-                            val.m128_u32[1] = b0 * 2147483647;
-                            val.m128_u32[2] = c0 * 3;
-                            val.m128_u32[3] = d0 * 9;
-
-                            std::memcpy(bytes.data(), &val, sizeof(val));
-
-                            res.push_back(std::move(bytes));
+                            const std::array<std::uint32_t, 4> val{ a0 * 9, b0 * 2147483647, c0 * 3, d0 * 9 };
+                            res.push_back(std::bit_cast<XmmValue>(val));
                         }
                     }
                 }
@@ -305,55 +279,94 @@ namespace x86Tester::Generator
 
             // Remove duplicates.
             std::sort(res.begin(), res.end());
-            res.erase(std::unique(res.begin(), res.end()), res.end());
+            res.count = static_cast<std::size_t>(std::unique(res.begin(), res.end()) - res.begin());
 
             return res;
         }
 
-        template<std::size_t TBitSize> std::vector<std::vector<std::uint8_t>> generateNumbers()
+        // Values stored back to back, TSize bytes each, shared read only by every generator.
+        template<std::size_t TSize, std::size_t TCount> struct MagicPool
         {
-            if constexpr (TBitSize == 8)
-            {
-                return generateIntegers<std::int8_t>();
-            }
-            else if constexpr (TBitSize == 16)
-            {
-                return generateIntegers<std::int16_t>();
-            }
-            else if constexpr (TBitSize == 32)
+            std::array<std::uint8_t, TSize * TCount> bytes{};
+
+            static constexpr std::size_t size()
             {
-                return generateIntegers<std::int32_t>();
+                return TCount;
             }
-            else if constexpr (TBitSize == 64)
+
+            constexpr const std::uint8_t* operator[](std::size_t index) const
             {
-                return generateIntegers<std::int64_t>();
+                return bytes.data() + index * TSize;
             }
-            else if constexpr (TBitSize == 128)
+        };
+
+        template<typename T> constexpr auto buildIntegerPool()
+        {
+            constexpr auto numbers = generateIntegers<T>();
+
+            MagicPool<sizeof(T), numbers.count> pool;
+            for (std::size_t i = 0; i < numbers.count; ++i)
             {
-                return generateXmmNumbers();
+                const auto bytes = std::bit_cast<std::array<std::uint8_t, sizeof(T)>>(numbers.values[i]);
+                std::copy(bytes.begin(), bytes.end(), pool.bytes.begin() + i * sizeof(T));
             }
-            else
+            return pool;
+        }
+
+        constexpr auto buildXmmPool()
+        {
+            constexpr auto numbers = generateXmmNumbers();
+
+            MagicPool<sizeof(XmmValue), numbers.count> pool;
+            for (std::size_t i = 0; i < numbers.count; ++i)
             {
-                static_assert(TBitSize == 0, "Unsupported bit size");
+                const auto& bytes = numbers.values[i];
+                std::copy(bytes.begin(), bytes.end(), pool.bytes.begin() + i * sizeof(XmmValue));
             }
+            return pool;
         }
 
-        static const auto kMagicNumbers8b = generateIntegers<std::int8_t>();
+        inline constexpr auto kMagicNumbers8b = buildIntegerPool<std::int8_t>();
+
+        inline constexpr auto kMagicNumbers16b = buildIntegerPool<std::int16_t>();
+
+        inline constexpr auto kMagicNumbers32b = buildIntegerPool<std::int32_t>();
+
+        inline constexpr auto kMagicNumbers64b = buildIntegerPool<std::int64_t>();
 
-        static const auto kMagicNumbers16b = generateIntegers<std::int16_t>();
+        inline constexpr auto kMagicNumbers128b = buildXmmPool();
 
-        static const auto kMagicNumbers32b = generateIntegers<std::int32_t>();
+        // YMM and ZMM values, every 128 bit value repeated in each lane.
+        template<std::size_t TLanes> constexpr auto buildLanePool()
+        {
+            constexpr auto& xmm = kMagicNumbers128b;
+
+            MagicPool<sizeof(XmmValue) * TLanes, xmm.size()> pool;
+            for (std::size_t i = 0; i < xmm.size(); ++i)
+            {
+                for (std::size_t lane = 0; lane < TLanes; ++lane)
+                {
+                    std::copy(
+                        xmm[i], xmm[i] + sizeof(XmmValue),
+                        pool.bytes.begin() + (i * TLanes + lane) * sizeof(XmmValue));
+                }
+            }
+            return pool;
+        }
 
-        static const auto kMagicNumbers64b = generateIntegers<std::int64_t>();
+        inline constexpr auto kMagicNumbers256b = buildLanePool<2>();
 
-        static const auto kMagicNumbers128b = generateXmmNumbers();
+        inline constexpr auto kMagicNumbers512b = buildLanePool<4>();
 
     } // namespace Detail
 
     class InputGenerator
     {
-        sfl::small_vector<uint8_t, 8> _data{};
-        std::mt19937_64& _prng;
+        // Inline so generators can be recreated inside the input search without allocating.
+        sfl::static_vector<uint8_t, kMaxInputBytes> _data{};
+        // Entry of a magic number pool while that strategy is active, the value is not copied.
+        const std::uint8_t* _pooled{};
+        Random::Prng& _prng;
 
         enum class Strategy
         {
@@ -374,10 +387,11 @@ namespace x86Tester::Generator
         size_t _counter{};
 
     public:
-        InputGenerator(size_t maxBits, std::mt19937_64& prng)
+        InputGenerator(size_t maxBits, Random::Prng& prng)
             : _prng(prng)
             , _maxBits(maxBits)
         {
+            assert(maxBits <= kMaxInputBytes * 8);
             _data.resize((maxBits + 7) / 8);
             // Make sure we have an initial value.
             advanceStrategy();
@@ -389,12 +403,13 @@ namespace x86Tester::Generator
             _strategy = Strategy::reset;
             _bitIndex = 0;
             _counter = 0;
+            _pooled = nullptr;
             std::fill(_data.begin(), _data.end(), 0);
         }
 
         std::span<const uint8_t> current() const
         {
-            return _data;
+            return { _pooled != nullptr ? _pooled : _data.data(), _data.size() };
         }
 
         bool advance()
@@ -461,9 +476,7 @@ namespace x86Tester::Generator
 
         bool advanceRandomFlip()
         {
-            std::uniform_int_distribution<size_t> dist(0, _maxBits - 1);
-
-            const auto bitIndex = dist(_prng);
+            const auto bitIndex = _prng.nextBelow(_maxBits);
             const auto byteIndex = bitIndex / 8;
             const auto bitMask = 1 << (bitIndex % 8);
 
@@ -484,6 +497,12 @@ namespace x86Tester::Generator
             return advanceStrategy();
         }
 
+        template<typename TPool> bool advancePool(const TPool& pool)
+        {
+            _pooled = pool[_counter % pool.size()];
+            return ++_counter >= pool.size();
+        }
+
         bool advanceMagicNumbers()
         {
             bool nextStrat = false;
@@ -498,47 +517,36 @@ namespace x86Tester::Generator
             }
             else if (_maxBits == 8)
             {
-                const auto valueBytes = Detail::kMagicNumbers8b[_counter % std::size(Detail::kMagicNumbers8b)];
-                if (++_counter >= std::size(Detail::kMagicNumbers8b))
-                    nextStrat = true;
-
-                std::copy(valueBytes.begin(), valueBytes.end(), _data.begin());
+                nextStrat = advancePool(Detail::kMagicNumbers8b);
             }
             else if (_maxBits == 16)
             {
-                const auto valueBytes = Detail::kMagicNumbers16b[_counter % std::size(Detail::kMagicNumbers16b)];
-                if (++_counter >= std::size(Detail::kMagicNumbers16b))
-                    nextStrat = true;
-
-                std::copy(valueBytes.begin(), valueBytes.end(), _data.begin());
+                nextStrat = advancePool(Detail::kMagicNumbers16b);
             }
             else if (_maxBits == 32)
             {
-                const auto valueBytes = Detail::kMagicNumbers32b[_counter % std::size(Detail::kMagicNumbers32b)];
-                if (++_counter >= std::size(Detail::kMagicNumbers32b))
-                    nextStrat = true;
-
-                std::copy(valueBytes.begin(), valueBytes.end(), _data.begin());
+                nextStrat = advancePool(Detail::kMagicNumbers32b);
             }
             else if (_maxBits == 64)
             {
-                const auto valueBytes = Detail::kMagicNumbers64b[_counter % std::size(Detail::kMagicNumbers64b)];
-                if (++_counter >= std::size(Detail::kMagicNumbers64b))
-                    nextStrat = true;
-
-                std::copy(valueBytes.begin(), valueBytes.end(), _data.begin());
+                nextStrat = advancePool(Detail::kMagicNumbers64b);
             }
             else if (_maxBits == 128)
             {
-                const auto valueBytes = Detail::kMagicNumbers128b[_counter % std::size(Detail::kMagicNumbers128b)];
-                if (++_counter >= std::size(Detail::kMagicNumbers128b))
-                    nextStrat = true;
-
-                std::copy(valueBytes.begin(), valueBytes.end(), _data.begin());
+                nextStrat = advancePool(Detail::kMagicNumbers128b);
+            }
+            else if (_maxBits == 256)
+            {
+                nextStrat = advancePool(Detail::kMagicNumbers256b);
+            }
+            else if (_maxBits == 512)
+            {
+                nextStrat = advancePool(Detail::kMagicNumbers512b);
             }
             else
             {
-                assert(false);
+                // No pool for this width, move on instead of repeating the current value.
+                nextStrat = true;
             }
 
             if (nextStrat)
@@ -564,4 +572,168 @@ namespace x86Tester::Generator
         }
     };
 
+    // Inputs that reached new output states, the feedback driven strategy mutates these instead of
+    // starting from scratch. An entry holds the inputs of all registers back to back.
+    class InputCorpus
+    {
+    public:
+        static constexpr std::size_t kMaxFields = 8;
+        static constexpr std::size_t kMaxEntrySize = kMaxInputBytes * kMaxFields;
+        static constexpr std::size_t kMaxEntries = 64;
+
+    private:
+        enum class Mutation
+        {
+            flipBit,
+            flipTopBit,
+            addDelta,
+            negate,
+            fill,
+            randomByte,
+            splice,
+            end,
+        };
+
+        Random::Prng& _prng;
+        sfl::static_vector<std::size_t, kMaxFields> _fieldOffsets;
+        sfl::static_vector<std::size_t, kMaxFields> _fieldSizes;
+        std::size_t _entrySize{};
+        std::vector<std::uint8_t> _entries;
+        std::size_t _numEntries{};
+        std::size_t _nextReplaced{};
+
+    public:
+        // The storage is allocated up front, add and mutate don't allocate.
+        InputCorpus(std::span<const std::size_t> fieldSizes, Random::Prng& prng)
+            : _prng(prng)
+        {
+            assert(fieldSizes.size() <= kMaxFields);
+            for (const auto size : fieldSizes)
+            {
+                assert(size > 0 && size <= kMaxInputBytes);
+                _fieldOffsets.push_back(_entrySize);
+                _fieldSizes.push_back(size);
+                _entrySize += size;
+            }
+            _entries.resize(_entrySize * kMaxEntries);
+        }
+
+        std::size_t getEntrySize() const
+        {
+            return _entrySize;
+        }
+
+        std::size_t size() const
+        {
+            return _numEntries;
+        }
+
+        bool empty() const
+        {
+            return _numEntries == 0;
+        }
+
+        // Once full the oldest entry is replaced.
+        void add(std::span<const std::uint8_t> input)
+        {
+            assert(input.size() == _entrySize);
+
+            std::size_t index = _numEntries;
+            if (_numEntries < kMaxEntries)
+            {
+                _numEntries++;
+            }
+            else
+            {
+                index = _nextReplaced;
+                _nextReplaced = (_nextReplaced + 1) % kMaxEntries;
+            }
+
+            std::copy(input.begin(), input.end(), _entries.begin() + index * _entrySize);
+        }
+
+        // Writes a mutated copy of a random entry, must not be called while empty.
+        void mutate(std::span<std::uint8_t> out)
+        {
+            assert(!empty() && out.size() == _entrySize);
+
+            const auto entry = getEntry(_prng.nextBelow(_numEntries));
+            std::copy(entry.begin(), entry.end(), out.begin());
+
+            const auto numMutations = 1 + _prng.nextBelow(3);
+            for (std::size_t i = 0; i < numMutations; ++i)
+            {
+                const auto fieldIndex = _prng.nextBelow(_fieldSizes.size());
+                auto field = out.subspan(_fieldOffsets[fieldIndex], _fieldSizes[fieldIndex]);
+
+                mutateField(field, fieldIndex);
+            }
+        }
+
+    private:
+        std::span<const std::uint8_t> getEntry(std::size_t index) const
+        {
+            return { _entries.data() + index * _entrySize, _entrySize };
+        }
+
+        void mutateField(std::span<std::uint8_t> field, std::size_t fieldIndex)
+        {
+            const auto mutation = static_cast<Mutation>(_prng.nextBelow(static_cast<std::size_t>(Mutation::end)));
+            switch (mutation)
+            {
+                case Mutation::flipBit:
+                {
+                    const auto bitIndex = _prng.nextBelow(field.size() * 8);
+                    field[bitIndex / 8] ^= static_cast<std::uint8_t>(1U << (bitIndex % 8));
+                    break;
+                }
+                case Mutation::flipTopBit:
+                    // Sign and overflow flags depend on it.
+                    field.back() ^= 0x80;
+                    break;
+                case Mutation::addDelta:
+                {
+                    // Small steps towards carries and borrows, the values are little endian.
+                    auto value = static_cast<std::int64_t>(_prng.nextBelow(32)) - 16;
+                    const auto delta = static_cast<std::uint64_t>(value >= 0 ? value + 1 : value);
+                    std::uint64_t carry = 0;
+                    for (std::size_t i = 0; i < field.size(); ++i)
+                    {
+                        const auto deltaByte = i < sizeof(delta) ? (delta >> (i * 8)) & 0xFF : (delta >> 63) * 0xFF;
+                        const auto sum = field[i] + deltaByte + carry;
+                        field[i] = static_cast<std::uint8_t>(sum);
+                        carry = sum >> 8;
+                    }
+                    break;
+                }
+                case Mutation::negate:
+                {
+                    std::uint64_t carry = 1;
+                    for (auto& byte : field)
+                    {
+                        const auto sum = static_cast<std::uint8_t>(~byte) + carry;
+                        byte = static_cast<std::uint8_t>(sum);
+                        carry = sum >> 8;
+                    }
+                    break;
+                }
+                case Mutation::fill:
+                    std::fill(field.begin(), field.end(), _prng.nextBool() ? 0xFF : 0x00);
+                    break;
+                case Mutation::randomByte:
+                    field[_prng.nextBelow(field.size())] = static_cast<std::uint8_t>(_prng());
+                    break;
+                case Mutation::splice:
+                {
+                    const auto other = getEntry(_prng.nextBelow(_numEntries));
+                    const auto otherField = other.subspan(_fieldOffsets[fieldIndex], field.size());
+                    std::copy(otherField.begin(), otherField.end(), field.begin());
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    };
+
 } // namespace x86Tester::Generator
\ No newline at end of file
@@ -16,7 +16,18 @@ namespace x86Tester::Logging
         Detail::startProgress(msg);
     }
 
+    // A background thread renders the progress, the functions below only update counters and are cheap
+    // enough to call from every worker for every item.
+
+    void setProgressTotal(size_t max);
+
+    // Adds to a counter of the calling thread.
+    void addProgress(size_t count = 1);
+
+    // Absolute progress, for callers that already track it themselves. Values below the current one are
+    // ignored so it can be called from several threads.
     void updateProgress(size_t val, size_t max);
+
     void endProgress();
 
     template<typename... TArgs> void println(const std::format_string<TArgs...> _Fmt, TArgs&&... args)
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+namespace x86Tester::Profiling
+{
+    enum class Counter : std::uint8_t
+    {
+        // Execution.
+        Prepares,
+        PrepareCycles,
+        ExecuteCalls,
+        Executions,
+        ExecuteCycles,
+        DivideErrors,
+        IntOverflows,
+        IllegalInstructions,
+        AccessViolations,
+        // Input search.
+        InstructionsTested,
+        InstructionCycles,
+        MatrixBits,
+        BitsSatisfied,
+        IterationsToSatisfy,
+        BitsAborted,
+        BitsPruned,
+        ExecutionsSaved,
+        InputCycles,
+        MatchCycles,
+        Count,
+    };
+
+    inline constexpr std::size_t kNumCounters = static_cast<std::size_t>(Counter::Count);
+
+    using Totals = std::array<std::uint64_t, kNumCounters>;
+
+    std::string_view getCounterName(Counter counter);
+
+    inline std::uint64_t readTsc()
+    {
+#ifdef _MSC_VER
+        return __rdtsc();
+#else
+        return __builtin_ia32_rdtsc();
+#endif
+    }
+
+    // Measured once against the steady clock.
+    double getTscFrequency();
+
+    double cyclesToMilliseconds(std::uint64_t cycles);
+
+    // One instance per thread that used it, instances outlive their threads so they can be collected at the
+    // end. There is a single registry per type, the instance of a thread is cached in a thread local.
+    template<typename T> class ThreadRegistry
+    {
+        mutable std::mutex _mutex;
+        std::vector<std::unique_ptr<T>> _instances;
+
+    public:
+        T& local()
+        {
+            thread_local T* instance = nullptr;
+            if (instance == nullptr)
+            {
+                std::lock_guard lock(_mutex);
+                instance = _instances.emplace_back(std::make_unique<T>()).get();
+            }
+            return *instance;
+        }
+
+        template<typename TFn> void forEach(TFn&& fn) const
+        {
+            std::lock_guard lock(_mutex);
+            for (const auto& instance : _instances)
+            {
+                fn(*instance);
+            }
+        }
+    };
+
+    // Only written by the owning thread, reading the totals doesn't have to wait for the work to finish. Aligned so
+    // the counters of different threads don't share a cache line.
+    struct alignas(64) ThreadCounters
+    {
+        std::array<std::atomic<std::uint64_t>, kNumCounters> values{};
+    };
+
+    ThreadCounters& getThreadCounters();
+
+    inline void add(Counter counter, std::uint64_t value = 1)
+    {
+        // No other thread writes it, a plain load and store avoids the locked read-modify-write.
+        auto& slot = getThreadCounters().values[static_cast<std::size_t>(counter)];
+        slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    // Sum over all threads.
+    Totals getTotals();
+
+    // Adds the elapsed cycles to the counter when going out of scope.
+    class ScopedTimer
+    {
+        Counter _counter;
+        std::uint64_t _start;
+
+    public:
+        explicit ScopedTimer(Counter counter)
+            : _counter(counter)
+            , _start(readTsc())
+        {
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        ~ScopedTimer()
+        {
+            add(_counter, readTsc() - _start);
+        }
+    };
+
+} // namespace x86Tester::Profiling
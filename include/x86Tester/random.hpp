@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+
+namespace x86Tester::Random
+{
+    // Finalizer of SplitMix64, a bijection that spreads every input bit over the whole value.
+    constexpr std::uint64_t mix(std::uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+
+    // Usable in constant expressions, also used to expand seeds into generator state.
+    struct SplitMix64
+    {
+        std::uint64_t state{};
+
+        constexpr std::uint64_t operator()()
+        {
+            return mix(state += 0x9E3779B97F4A7C15ULL);
+        }
+
+        // Uniform in [0, 1).
+        constexpr double nextUnit()
+        {
+            return static_cast<double>((*this)() >> 11) * 0x1.0p-53;
+        }
+    };
+
+    // xoshiro256**, 32 bytes of state and a few instructions per draw. Satisfies
+    // UniformRandomBitGenerator so it can be used with the standard distributions.
+    class Xoshiro256
+    {
+        std::array<std::uint64_t, 4> _state{};
+
+    public:
+        using result_type = std::uint64_t;
+
+        constexpr explicit Xoshiro256(std::uint64_t seed)
+        {
+            SplitMix64 seeder{ seed };
+            for (auto& value : _state)
+            {
+                value = seeder();
+            }
+        }
+
+        static constexpr result_type min()
+        {
+            return 0;
+        }
+
+        static constexpr result_type max()
+        {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        constexpr result_type operator()()
+        {
+            const auto result = std::rotl(_state[1] * 5, 7) * 9;
+            const auto t = _state[1] << 17;
+
+            _state[2] ^= _state[0];
+            _state[3] ^= _state[1];
+            _state[1] ^= _state[2];
+            _state[0] ^= _state[3];
+            _state[2] ^= t;
+            _state[3] = std::rotl(_state[3], 45);
+
+            return result;
+        }
+
+        // Advances the state by 2^128 draws, the skipped ranges serve as non-overlapping streams.
+        constexpr void jump()
+        {
+            constexpr std::uint64_t kJump[] = {
+                0x180EC6D33CFD0ABAULL,
+                0xD5A61266F0C9392CULL,
+                0xA9582618E03FC9AAULL,
+                0x39ABDC4529B1661CULL,
+            };
+
+            std::array<std::uint64_t, 4> state{};
+            for (const auto word : kJump)
+            {
+                for (std::size_t bit = 0; bit < 64; ++bit)
+                {
+                    if ((word & (std::uint64_t{ 1 } << bit)) != 0)
+                    {
+                        for (std::size_t i = 0; i < state.size(); ++i)
+                        {
+                            state[i] ^= _state[i];
+                        }
+                    }
+                    (*this)();
+                }
+            }
+            _state = state;
+        }
+
+        // Uniform in [0, bound), multiply and shift instead of a division. The bias is bound / 2^32
+        // which is irrelevant for register sizes and list indices.
+        constexpr std::uint64_t nextBelow(std::uint64_t bound)
+        {
+            assert(bound != 0 && bound <= std::numeric_limits<std::uint32_t>::max());
+            return (((*this)() >> 32) * bound) >> 32;
+        }
+
+        // Random values for all bits of the mask from a single draw, the other bits are zero.
+        constexpr std::uint64_t nextBits(std::uint64_t mask)
+        {
+            return (*this)() & mask;
+        }
+
+        constexpr bool nextBool()
+        {
+            return ((*this)() >> 63) != 0;
+        }
+
+        constexpr bool operator==(const Xoshiro256&) const = default;
+    };
+
+    // Generator used by the input search, a replacement only has to provide the same members.
+    using Prng = Xoshiro256;
+
+    // Seeds a stream per worker or per instruction, the streams don't depend on the order in which
+    // they are created so the results don't depend on the thread schedule.
+    constexpr Prng makeStream(std::uint64_t seed, std::uint64_t streamIndex)
+    {
+        return Prng(mix(seed) ^ mix(streamIndex + 0x9E3779B97F4A7C15ULL));
+    }
+
+} // namespace x86Tester::Random
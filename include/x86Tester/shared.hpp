@@ -2,6 +2,7 @@
 
 #include <Zydis/SharedTypes.h>
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <execution>
 #include <span>
@@ -17,6 +18,18 @@ namespace x86Tester
         // Offsets to the beginning of an entry.
         std::vector<uint32_t> entryOffsets;
 
+        std::size_t size() const
+        {
+            return entryOffsets.size();
+        }
+
+        std::span<const uint8_t> getEntry(std::size_t index) const
+        {
+            const auto entryOffset = entryOffsets[index];
+            const auto length = instrData[entryOffset];
+            return std::span<const uint8_t>(instrData.data() + entryOffset + 1, length);
+        }
+
         template<typename T> void forEach(T&& fn) const
         {
             for (size_t i = 0; i < entryOffsets.size(); ++i)
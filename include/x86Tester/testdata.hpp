@@ -0,0 +1,730 @@
+#pragma once
+
+#include <Zydis/Mnemonic.h>
+#include <Zydis/Register.h>
+#include <Zydis/SharedTypes.h>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <vector>
+
+#ifdef _WIN32
+#    ifndef WIN32_LEAN_AND_MEAN
+#        define WIN32_LEAN_AND_MEAN
+#    endif
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+// Binary test data, one file per mnemonic. All values are little endian.
+//
+//   FileHeader
+//   InstrRecord[instrCount]             at instrTableOffset, before or after the entries
+//   per instruction, entryCount times:  at InstrRecord::entriesOffset, aligned to kEntryAlignment
+//     EntryHeader
+//     RegRecord[numInputs + numOutputs]
+//     register payloads                 each aligned to its size, up to kEntryAlignment
+//
+// Every offset is relative to the start of the file except RegRecord::offset which is relative to
+// its entry, so an entry can be inspected without knowing where it came from.
+//
+// Version 2 added records for the explicit memory operand.
+namespace x86Tester::TestData
+{
+    inline constexpr std::uint8_t kMagic[4] = { 'X', '8', '6', 'T' };
+    inline constexpr std::uint16_t kVersion = 2;
+    inline constexpr std::size_t kEntryAlignment = 16;
+
+    // Register of the records that hold the explicit memory operand, the data is the memory at the address
+    // formed by the input registers. An output record can extend past the operand if the instruction wrote
+    // more than it.
+    inline constexpr auto kMemoryOperand = static_cast<ZydisRegister>(ZYDIS_REGISTER_MAX_VALUE + 1);
+
+    inline const char* getRegisterName(ZydisRegister reg)
+    {
+        return reg == kMemoryOperand ? "mem" : ZydisRegisterGetString(reg);
+    }
+
+    enum class ExceptionType : std::uint8_t
+    {
+        None,
+        // #DE
+        DivideError,
+        IntegerOverflow,
+    };
+
+    struct FileHeader
+    {
+        std::uint8_t magic[4];
+        std::uint16_t version;
+        std::uint16_t machineMode;
+        std::uint32_t mnemonic;
+        std::uint32_t instrCount;
+        std::uint64_t instrTableOffset;
+        std::uint64_t fileSize;
+    };
+    static_assert(sizeof(FileHeader) == 32);
+
+    struct InstrRecord
+    {
+        std::uint64_t address;
+        std::uint64_t entriesOffset;
+        std::uint32_t entryCount;
+        std::uint8_t length;
+        std::uint8_t bytes[15];
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(InstrRecord) == 40);
+
+    enum EntryFlags : std::uint8_t
+    {
+        kEntryHasInputFlags = 1U << 0,
+        kEntryHasOutputFlags = 1U << 1,
+        kEntryHasException = 1U << 2,
+    };
+
+    struct EntryHeader
+    {
+        // Including the register table and payloads, the next entry starts right after.
+        std::uint32_t size;
+        std::uint8_t flags;
+        std::uint8_t exceptionType;
+        std::uint8_t numInputs;
+        std::uint8_t numOutputs;
+        std::uint32_t inputFlags;
+        std::uint32_t outputFlags;
+    };
+    static_assert(sizeof(EntryHeader) == 16);
+
+    struct RegRecord
+    {
+        std::uint16_t reg;
+        std::uint16_t size;
+        std::uint32_t offset;
+    };
+    static_assert(sizeof(RegRecord) == 8);
+
+    struct RegValue
+    {
+        ZydisRegister reg;
+        std::span<const std::uint8_t> data;
+    };
+
+    namespace Detail
+    {
+        inline std::size_t alignUp(std::size_t value, std::size_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        inline std::size_t getPayloadAlignment(std::size_t size)
+        {
+            return std::min(std::bit_ceil(std::max<std::size_t>(size, 1)), kEntryAlignment);
+        }
+
+        template<typename T> const T* getAt(std::span<const std::uint8_t> data, std::uint64_t offset)
+        {
+            if (offset > data.size() || data.size() - offset < sizeof(T) || offset % alignof(T) != 0)
+                return nullptr;
+            return reinterpret_cast<const T*>(data.data() + offset);
+        }
+
+        inline FileHeader makeHeader(ZydisMachineMode mode, ZydisMnemonic mnemonic)
+        {
+            FileHeader header{};
+            std::memcpy(header.magic, kMagic, sizeof(kMagic));
+            header.version = kVersion;
+            header.machineMode = static_cast<std::uint16_t>(mode);
+            header.mnemonic = static_cast<std::uint32_t>(mnemonic);
+            return header;
+        }
+
+        inline bool makeInstrRecord(std::uint64_t address, std::span<const std::uint8_t> bytes, InstrRecord& rec)
+        {
+            rec = {};
+            if (bytes.size() > sizeof(rec.bytes))
+                return false;
+
+            rec.address = address;
+            rec.length = static_cast<std::uint8_t>(bytes.size());
+            std::copy(bytes.begin(), bytes.end(), rec.bytes);
+            return true;
+        }
+
+        // Appends a complete entry to out, its size is a multiple of kEntryAlignment.
+        inline bool appendEntry(
+            std::vector<std::uint8_t>& out, std::span<const RegValue> inputs, std::optional<std::uint32_t> inputFlags,
+            std::span<const RegValue> outputs, std::optional<std::uint32_t> outputFlags,
+            std::optional<ExceptionType> exceptionType)
+        {
+            if (inputs.size() > 0xFF || outputs.size() > 0xFF)
+                return false;
+
+            const auto entryOffset = out.size();
+
+            EntryHeader header{};
+            header.numInputs = static_cast<std::uint8_t>(inputs.size());
+            header.numOutputs = static_cast<std::uint8_t>(outputs.size());
+            if (inputFlags)
+            {
+                header.flags |= kEntryHasInputFlags;
+                header.inputFlags = *inputFlags;
+            }
+            if (outputFlags)
+            {
+                header.flags |= kEntryHasOutputFlags;
+                header.outputFlags = *outputFlags;
+            }
+            if (exceptionType)
+            {
+                header.flags |= kEntryHasException;
+                header.exceptionType = static_cast<std::uint8_t>(*exceptionType);
+            }
+
+            const auto numRegs = inputs.size() + outputs.size();
+            const auto getRegValue = [&](std::size_t index) -> const RegValue& {
+                return index < inputs.size() ? inputs[index] : outputs[index - inputs.size()];
+            };
+
+            // Lay out the payloads behind the register table.
+            std::vector<RegRecord> regs(numRegs);
+            std::size_t size = sizeof(EntryHeader) + numRegs * sizeof(RegRecord);
+            for (std::size_t i = 0; i < numRegs; ++i)
+            {
+                const auto& value = getRegValue(i);
+                if (value.data.size() > 0xFFFF)
+                    return false;
+
+                size = alignUp(size, getPayloadAlignment(value.data.size()));
+                regs[i].reg = static_cast<std::uint16_t>(value.reg);
+                regs[i].size = static_cast<std::uint16_t>(value.data.size());
+                regs[i].offset = static_cast<std::uint32_t>(size);
+                size += value.data.size();
+            }
+            size = alignUp(size, kEntryAlignment);
+            header.size = static_cast<std::uint32_t>(size);
+
+            out.resize(entryOffset + size);
+            auto* dst = out.data() + entryOffset;
+            std::memcpy(dst, &header, sizeof(header));
+            if (numRegs != 0)
+                std::memcpy(dst + sizeof(header), regs.data(), numRegs * sizeof(RegRecord));
+            for (std::size_t i = 0; i < numRegs; ++i)
+            {
+                const auto& value = getRegValue(i);
+                if (!value.data.empty())
+                    std::memcpy(dst + regs[i].offset, value.data.data(), value.data.size());
+            }
+
+            return true;
+        }
+    } // namespace Detail
+
+    // View of a single test case, the register data points into the file.
+    class EntryView
+    {
+        const std::uint8_t* _data{};
+
+    public:
+        EntryView() = default;
+        explicit EntryView(const std::uint8_t* data)
+            : _data(data)
+        {
+        }
+
+        const EntryHeader& getHeader() const
+        {
+            return *reinterpret_cast<const EntryHeader*>(_data);
+        }
+
+        std::size_t getInputCount() const
+        {
+            return getHeader().numInputs;
+        }
+
+        std::size_t getOutputCount() const
+        {
+            return getHeader().numOutputs;
+        }
+
+        RegValue getInput(std::size_t index) const
+        {
+            return getReg(index);
+        }
+
+        RegValue getOutput(std::size_t index) const
+        {
+            return getReg(getHeader().numInputs + index);
+        }
+
+        std::optional<std::uint32_t> getInputFlags() const
+        {
+            const auto& header = getHeader();
+            if ((header.flags & kEntryHasInputFlags) == 0)
+                return std::nullopt;
+            return header.inputFlags;
+        }
+
+        std::optional<std::uint32_t> getOutputFlags() const
+        {
+            const auto& header = getHeader();
+            if ((header.flags & kEntryHasOutputFlags) == 0)
+                return std::nullopt;
+            return header.outputFlags;
+        }
+
+        std::optional<ExceptionType> getException() const
+        {
+            const auto& header = getHeader();
+            if ((header.flags & kEntryHasException) == 0)
+                return std::nullopt;
+            return static_cast<ExceptionType>(header.exceptionType);
+        }
+
+    private:
+        RegValue getReg(std::size_t index) const
+        {
+            const auto* regs = reinterpret_cast<const RegRecord*>(_data + sizeof(EntryHeader));
+            const auto& rec = regs[index];
+            return { static_cast<ZydisRegister>(rec.reg), std::span(_data + rec.offset, rec.size) };
+        }
+    };
+
+    class EntryIterator
+    {
+        const std::uint8_t* _data{};
+        std::size_t _index{};
+
+    public:
+        using value_type = EntryView;
+        using difference_type = std::ptrdiff_t;
+
+        EntryIterator() = default;
+        EntryIterator(const std::uint8_t* data, std::size_t index)
+            : _data(data)
+            , _index(index)
+        {
+        }
+
+        EntryView operator*() const
+        {
+            return EntryView(_data);
+        }
+
+        EntryIterator& operator++()
+        {
+            _data += reinterpret_cast<const EntryHeader*>(_data)->size;
+            _index++;
+            return *this;
+        }
+
+        EntryIterator operator++(int)
+        {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        bool operator==(const EntryIterator& other) const
+        {
+            return _index == other._index;
+        }
+    };
+
+    class InstrView
+    {
+        const std::uint8_t* _file{};
+        const InstrRecord* _record{};
+
+    public:
+        InstrView(const std::uint8_t* file, const InstrRecord* record)
+            : _file(file)
+            , _record(record)
+        {
+        }
+
+        std::uint64_t getAddress() const
+        {
+            return _record->address;
+        }
+
+        std::span<const std::uint8_t> getBytes() const
+        {
+            return std::span(_record->bytes, _record->length);
+        }
+
+        std::size_t getEntryCount() const
+        {
+            return _record->entryCount;
+        }
+
+        EntryIterator begin() const
+        {
+            return EntryIterator(_file + _record->entriesOffset, 0);
+        }
+
+        EntryIterator end() const
+        {
+            return EntryIterator(nullptr, _record->entryCount);
+        }
+    };
+
+    // Zero copy view over the contents of a file, the data must outlive the view.
+    class FileView
+    {
+        std::span<const std::uint8_t> _data;
+
+    public:
+        FileView() = default;
+
+        // Validates the layout once so iterating afterwards doesn't need any checks.
+        bool open(std::span<const std::uint8_t> data)
+        {
+            _data = {};
+
+            const auto* header = Detail::getAt<FileHeader>(data, 0);
+            if (header == nullptr || std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0
+                || header->version != kVersion || header->fileSize != data.size())
+                return false;
+
+            for (std::size_t i = 0; i < header->instrCount; ++i)
+            {
+                const auto* instr = Detail::getAt<InstrRecord>(data, header->instrTableOffset + i * sizeof(InstrRecord));
+                if (instr == nullptr || instr->length > sizeof(instr->bytes))
+                    return false;
+
+                auto entryOffset = instr->entriesOffset;
+                for (std::size_t j = 0; j < instr->entryCount; ++j)
+                {
+                    const auto* entry = Detail::getAt<EntryHeader>(data, entryOffset);
+                    if (entry == nullptr || entry->size > data.size() - entryOffset)
+                        return false;
+
+                    const auto numRegs = std::size_t{ entry->numInputs } + entry->numOutputs;
+                    if (sizeof(EntryHeader) + numRegs * sizeof(RegRecord) > entry->size)
+                        return false;
+
+                    const auto* regs = reinterpret_cast<const RegRecord*>(data.data() + entryOffset + sizeof(EntryHeader));
+                    for (std::size_t k = 0; k < numRegs; ++k)
+                    {
+                        if (regs[k].offset > entry->size || regs[k].size > entry->size - regs[k].offset)
+                            return false;
+                    }
+
+                    if (entry->size % kEntryAlignment != 0)
+                        return false;
+                    entryOffset += entry->size;
+                }
+            }
+
+            _data = data;
+            return true;
+        }
+
+        explicit operator bool() const
+        {
+            return !_data.empty();
+        }
+
+        const FileHeader& getHeader() const
+        {
+            return *reinterpret_cast<const FileHeader*>(_data.data());
+        }
+
+        ZydisMachineMode getMachineMode() const
+        {
+            return static_cast<ZydisMachineMode>(getHeader().machineMode);
+        }
+
+        ZydisMnemonic getMnemonic() const
+        {
+            return static_cast<ZydisMnemonic>(getHeader().mnemonic);
+        }
+
+        std::size_t getInstructionCount() const
+        {
+            return getHeader().instrCount;
+        }
+
+        InstrView getInstruction(std::size_t index) const
+        {
+            const auto* table = reinterpret_cast<const InstrRecord*>(_data.data() + getHeader().instrTableOffset);
+            return InstrView(_data.data(), table + index);
+        }
+    };
+
+    // Read only memory mapping of a whole file.
+    class MappedFile
+    {
+        const std::uint8_t* _data{};
+        std::size_t _size{};
+#ifdef _WIN32
+        HANDLE _file = INVALID_HANDLE_VALUE;
+        HANDLE _mapping{};
+#else
+        int _fd = -1;
+#endif
+
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile()
+        {
+            close();
+        }
+
+        bool open(const std::filesystem::path& path)
+        {
+            close();
+
+#ifdef _WIN32
+            _file = CreateFileW(
+                path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (_file == INVALID_HANDLE_VALUE)
+                return false;
+
+            LARGE_INTEGER size{};
+            if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+            {
+                close();
+                return false;
+            }
+
+            _mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (_mapping == nullptr)
+            {
+                close();
+                return false;
+            }
+
+            _data = static_cast<const std::uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+            _size = static_cast<std::size_t>(size.QuadPart);
+#else
+            _fd = ::open(path.c_str(), O_RDONLY);
+            if (_fd < 0)
+                return false;
+
+            struct stat st{};
+            if (fstat(_fd, &st) != 0 || st.st_size == 0)
+            {
+                close();
+                return false;
+            }
+
+            auto* mem = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, _fd, 0);
+            _data = mem != MAP_FAILED ? static_cast<const std::uint8_t*>(mem) : nullptr;
+            _size = static_cast<std::size_t>(st.st_size);
+#endif
+            if (_data == nullptr)
+            {
+                close();
+                return false;
+            }
+
+            return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (_data != nullptr)
+                UnmapViewOfFile(_data);
+            if (_mapping != nullptr)
+                CloseHandle(_mapping);
+            if (_file != INVALID_HANDLE_VALUE)
+                CloseHandle(_file);
+            _mapping = nullptr;
+            _file = INVALID_HANDLE_VALUE;
+#else
+            if (_data != nullptr)
+                munmap(const_cast<std::uint8_t*>(_data), _size);
+            if (_fd >= 0)
+                ::close(_fd);
+            _fd = -1;
+#endif
+            _data = nullptr;
+            _size = 0;
+        }
+
+        std::span<const std::uint8_t> getData() const
+        {
+            return std::span(_data, _size);
+        }
+    };
+
+    // Builds a file in memory, instructions are added one after the other with their entries.
+    class Writer
+    {
+        FileHeader _header{};
+        std::vector<InstrRecord> _instrs;
+        std::vector<std::uint8_t> _entries;
+
+    public:
+        Writer(ZydisMachineMode mode, ZydisMnemonic mnemonic)
+            : _header(Detail::makeHeader(mode, mnemonic))
+        {
+        }
+
+        bool beginInstruction(std::uint64_t address, std::span<const std::uint8_t> bytes)
+        {
+            InstrRecord rec{};
+            if (!Detail::makeInstrRecord(address, bytes, rec))
+                return false;
+
+            rec.entriesOffset = _entries.size();
+            _instrs.push_back(rec);
+
+            return true;
+        }
+
+        bool addEntry(
+            std::span<const RegValue> inputs, std::optional<std::uint32_t> inputFlags, std::span<const RegValue> outputs,
+            std::optional<std::uint32_t> outputFlags, std::optional<ExceptionType> exceptionType)
+        {
+            if (_instrs.empty() || !Detail::appendEntry(_entries, inputs, inputFlags, outputs, outputFlags, exceptionType))
+                return false;
+
+            _instrs.back().entryCount++;
+            return true;
+        }
+
+        std::vector<std::uint8_t> finish() const
+        {
+            auto header = _header;
+            header.instrCount = static_cast<std::uint32_t>(_instrs.size());
+            header.instrTableOffset = sizeof(FileHeader);
+
+            const auto entriesBase = Detail::alignUp(sizeof(FileHeader) + _instrs.size() * sizeof(InstrRecord), kEntryAlignment);
+            header.fileSize = entriesBase + _entries.size();
+
+            std::vector<std::uint8_t> res(header.fileSize);
+            std::memcpy(res.data(), &header, sizeof(header));
+            for (std::size_t i = 0; i < _instrs.size(); ++i)
+            {
+                auto rec = _instrs[i];
+                rec.entriesOffset += entriesBase;
+                std::memcpy(res.data() + sizeof(FileHeader) + i * sizeof(InstrRecord), &rec, sizeof(rec));
+            }
+            if (!_entries.empty())
+                std::memcpy(res.data() + entriesBase, _entries.data(), _entries.size());
+
+            return res;
+        }
+
+        bool writeToFile(const std::filesystem::path& path) const
+        {
+            const auto data = finish();
+
+            std::ofstream file(path, std::ios::binary);
+            if (!file)
+                return false;
+
+            file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            return static_cast<bool>(file);
+        }
+    };
+
+    // Writes a file while it is produced, only the instruction table and the entries of the current
+    // instruction are kept in memory. The entries go straight behind the header and the table is appended
+    // once the writer is closed, the header is patched last.
+    class StreamWriter
+    {
+        FileHeader _header{};
+        std::vector<InstrRecord> _instrs;
+        std::vector<std::uint8_t> _entries;
+        std::ofstream _file;
+        std::uint64_t _offset{};
+
+    public:
+        StreamWriter(ZydisMachineMode mode, ZydisMnemonic mnemonic)
+            : _header(Detail::makeHeader(mode, mnemonic))
+        {
+        }
+
+        bool open(const std::filesystem::path& path)
+        {
+            _file.open(path, std::ios::binary | std::ios::trunc);
+            if (!_file)
+                return false;
+
+            // Placeholder until the table offset is known, the header size keeps the entries aligned.
+            static_assert(sizeof(FileHeader) % kEntryAlignment == 0);
+            _file.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+            _offset = sizeof(FileHeader);
+
+            return static_cast<bool>(_file);
+        }
+
+        bool beginInstruction(std::uint64_t address, std::span<const std::uint8_t> bytes)
+        {
+            InstrRecord rec{};
+            if (!flushEntries() || !Detail::makeInstrRecord(address, bytes, rec))
+                return false;
+
+            rec.entriesOffset = _offset;
+            _instrs.push_back(rec);
+
+            return true;
+        }
+
+        bool addEntry(
+            std::span<const RegValue> inputs, std::optional<std::uint32_t> inputFlags, std::span<const RegValue> outputs,
+            std::optional<std::uint32_t> outputFlags, std::optional<ExceptionType> exceptionType)
+        {
+            if (_instrs.empty() || !Detail::appendEntry(_entries, inputs, inputFlags, outputs, outputFlags, exceptionType))
+                return false;
+
+            _instrs.back().entryCount++;
+            return true;
+        }
+
+        bool close()
+        {
+            if (!flushEntries())
+                return false;
+
+            auto header = _header;
+            header.instrCount = static_cast<std::uint32_t>(_instrs.size());
+            header.instrTableOffset = _offset;
+            header.fileSize = _offset + _instrs.size() * sizeof(InstrRecord);
+
+            _file.write(
+                reinterpret_cast<const char*>(_instrs.data()),
+                static_cast<std::streamsize>(_instrs.size() * sizeof(InstrRecord)));
+            _file.seekp(0);
+            _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            _file.close();
+
+            return static_cast<bool>(_file);
+        }
+
+    private:
+        bool flushEntries()
+        {
+            if (!_file.is_open())
+                return false;
+
+            _file.write(reinterpret_cast<const char*>(_entries.data()), static_cast<std::streamsize>(_entries.size()));
+            _offset += _entries.size();
+            _entries.clear();
+
+            return static_cast<bool>(_file);
+        }
+    };
+
+} // namespace x86Tester::TestData
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace x86Tester::Threading
+{
+    struct WorkerStats
+    {
+        std::size_t tasksExecuted{};
+        std::size_t tasksStolen{};
+        // Time spent inside tasks.
+        std::chrono::nanoseconds busyTime{};
+        // Time in which the pool had pending tasks, busy or not.
+        std::chrono::nanoseconds totalTime{};
+
+        double getUtilization() const
+        {
+            if (totalTime.count() == 0)
+                return 0.0;
+            return static_cast<double>(busyTime.count()) / static_cast<double>(totalTime.count());
+        }
+    };
+
+    // Fixed set of worker threads with one task deque each. The threads live as long as the pool so
+    // per-thread state such as execution sandboxes is kept across tasks and runs.
+    class ThreadPool
+    {
+    public:
+        // Receives the index of the worker running the task.
+        using Task = std::function<void(std::size_t)>;
+
+    private:
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            WorkerStats stats;
+        };
+
+        std::vector<std::unique_ptr<Worker>> _workers;
+        std::vector<std::thread> _threads;
+
+        std::mutex _mutex;
+        std::condition_variable _startCv;
+        std::condition_variable _doneCv;
+        std::atomic<std::size_t> _numQueued{};
+        std::size_t _numPending{};
+        std::size_t _nextWorker{};
+        std::chrono::steady_clock::time_point _activeSince{};
+        std::chrono::nanoseconds _activeTime{};
+        bool _stopping{};
+
+    public:
+        explicit ThreadPool(std::size_t numWorkers = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        std::size_t getWorkerCount() const
+        {
+            return _workers.size();
+        }
+
+        // Deals the tasks round robin to the workers and returns immediately. Every worker takes its
+        // tasks in the given order and idle workers steal from the back of the others, so the tasks
+        // should be ordered by descending cost. Tasks may submit further tasks.
+        void submit(std::vector<Task> tasks);
+
+        // Blocks until every submitted task ran.
+        void wait();
+
+        void run(std::vector<Task> tasks)
+        {
+            submit(std::move(tasks));
+            wait();
+        }
+
+        // Accumulated since construction, must not be called while tasks are pending. The total time
+        // only counts the time in which the pool had pending tasks.
+        std::vector<WorkerStats> getStats() const;
+
+    private:
+        void workerMain(std::size_t workerIndex);
+        bool popTask(std::size_t workerIndex, Task& task, bool& stolen);
+    };
+
+} // namespace x86Tester::Threading
@@ -0,0 +1,152 @@
+#include "instructions.hpp"
+
+#include <benchmark/benchmark.h>
+#include <span>
+#include <vector>
+#include <x86Tester/execution.hpp>
+
+namespace x86Tester::bench
+{
+    static constexpr std::size_t kBatchSize = 256;
+
+    static constexpr ZydisRegister kInputRegs[] = {
+        ZYDIS_REGISTER_RAX, ZYDIS_REGISTER_RBX, ZYDIS_REGISTER_RCX, ZYDIS_REGISTER_RDX, ZYDIS_REGISTER_XMM0,
+    };
+
+    static void execute(benchmark::State& state, std::span<const std::uint8_t> code, Execution::Backend backend)
+    {
+        auto ctx = Execution::ScopedContext(kMode, code, backend);
+        if (!ctx)
+        {
+            state.SkipWithError("Backend not available");
+            return;
+        }
+
+        auto regs = Execution::getRegisterFile(ctx.get());
+        setupInputs(regs, ctx.getDataAddress());
+        for (const auto reg : kInputRegs)
+        {
+            ctx.setRegBytes(reg, Execution::getRegBytes(regs, reg));
+        }
+
+        // The outputs become the next inputs, the remainder stays below the divisor so DIV never faults.
+        for (auto _ : state)
+        {
+            if (!ctx.execute())
+            {
+                state.SkipWithError("Execution failed");
+                break;
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    static void executeBatch(benchmark::State& state, std::span<const std::uint8_t> code, Execution::Backend backend)
+    {
+        auto ctx = Execution::ScopedContext(kMode, code, backend);
+        if (!ctx)
+        {
+            state.SkipWithError("Backend not available");
+            return;
+        }
+
+        std::vector<Execution::InputState> inputs(kBatchSize, Execution::getRegisterFile(ctx.get()));
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            setupInputs(inputs[i], ctx.getDataAddress());
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RAX, i);
+        }
+        std::vector<Execution::OutputState> outputs(inputs.size());
+
+        for (auto _ : state)
+        {
+            if (!ctx.executeBatch(inputs, outputs))
+            {
+                state.SkipWithError("Execution failed");
+                break;
+            }
+            benchmark::DoNotOptimize(outputs.data());
+        }
+
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(inputs.size()));
+    }
+
+    static constexpr std::span<const std::uint8_t> kSwitchCodes[] = { kAddR64R64, kDivR64, kCvtdq2pd, kLeaMem };
+
+    // A new context per instruction, what testing one encoding per context costs.
+    static void switchPrepare(benchmark::State& state, Execution::Backend backend)
+    {
+        std::size_t index = 0;
+        for (auto _ : state)
+        {
+            auto ctx = Execution::ScopedContext(kMode, kSwitchCodes[index], backend);
+            if (!ctx || !ctx.execute())
+            {
+                state.SkipWithError("Execution failed");
+                break;
+            }
+            index = (index + 1) % std::size(kSwitchCodes);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // All instructions in the slots of one context.
+    static void switchSlot(benchmark::State& state, Execution::Backend backend)
+    {
+        auto ctx = Execution::ScopedContext(kMode, kSwitchCodes, backend);
+        if (!ctx)
+        {
+            state.SkipWithError("Backend not available");
+            return;
+        }
+
+        auto regs = Execution::getRegisterFile(ctx.get());
+        setupInputs(regs, ctx.getDataAddress());
+
+        std::size_t index = 0;
+        for (auto _ : state)
+        {
+            for (const auto reg : kInputRegs)
+            {
+                ctx.setRegBytes(reg, Execution::getRegBytes(regs, reg));
+            }
+            if (!ctx.execute(index))
+            {
+                state.SkipWithError("Execution failed");
+                break;
+            }
+            index = (index + 1) % std::size(kSwitchCodes);
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK_CAPTURE(execute, add_r64_r64/inprocess, kAddR64R64, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(execute, add_r64_r64/debugger, kAddR64R64, Execution::Backend::Debugger);
+    BENCHMARK_CAPTURE(execute, div_r64/inprocess, kDivR64, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(execute, div_r64/debugger, kDivR64, Execution::Backend::Debugger);
+    BENCHMARK_CAPTURE(execute, cvtdq2pd/inprocess, kCvtdq2pd, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(execute, cvtdq2pd/debugger, kCvtdq2pd, Execution::Backend::Debugger);
+    BENCHMARK_CAPTURE(execute, lea_mem/inprocess, kLeaMem, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(execute, lea_mem/debugger, kLeaMem, Execution::Backend::Debugger);
+    // Only the debugger has a data window.
+    BENCHMARK_CAPTURE(execute, add_mem/debugger, kAddMem, Execution::Backend::Debugger);
+
+    BENCHMARK_CAPTURE(executeBatch, add_r64_r64/inprocess, kAddR64R64, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(executeBatch, add_r64_r64/debugger, kAddR64R64, Execution::Backend::Debugger);
+    BENCHMARK_CAPTURE(executeBatch, div_r64/inprocess, kDivR64, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(executeBatch, div_r64/debugger, kDivR64, Execution::Backend::Debugger);
+    BENCHMARK_CAPTURE(executeBatch, cvtdq2pd/inprocess, kCvtdq2pd, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(executeBatch, cvtdq2pd/debugger, kCvtdq2pd, Execution::Backend::Debugger);
+    BENCHMARK_CAPTURE(executeBatch, lea_mem/inprocess, kLeaMem, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(executeBatch, lea_mem/debugger, kLeaMem, Execution::Backend::Debugger);
+    BENCHMARK_CAPTURE(executeBatch, add_mem/debugger, kAddMem, Execution::Backend::Debugger);
+
+    BENCHMARK_CAPTURE(switchPrepare, inprocess, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(switchPrepare, debugger, Execution::Backend::Debugger);
+    BENCHMARK_CAPTURE(switchSlot, inprocess, Execution::Backend::InProcess);
+    BENCHMARK_CAPTURE(switchSlot, debugger, Execution::Backend::Debugger);
+
+} // namespace x86Tester::bench
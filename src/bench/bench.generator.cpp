@@ -0,0 +1,58 @@
+#include "instructions.hpp"
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <x86Tester/generator.hpp>
+#include <x86Tester/inputgenerator.hpp>
+#include <x86Tester/random.hpp>
+
+namespace x86Tester::bench
+{
+    static void buildInstructions(benchmark::State& state, ZydisMnemonic mnemonic, bool buildInParallel)
+    {
+        const auto filter = Generator::Filter{}.addMnemonics(mnemonic);
+
+        std::size_t numCombinations = 0;
+        std::size_t numInstrs = 0;
+        for (auto _ : state)
+        {
+            Generator::BuildStats stats{};
+            const auto instrs = Generator::buildInstructions(kMode, filter, buildInParallel, {}, &stats);
+            numCombinations += stats.numCombinations;
+            numInstrs += instrs.size();
+        }
+
+        state.counters["combinations"] = benchmark::Counter(
+            static_cast<double>(numCombinations), benchmark::Counter::kIsRate);
+        state.counters["instructions"] = benchmark::Counter(static_cast<double>(numInstrs), benchmark::Counter::kIsRate);
+    }
+
+    BENCHMARK_CAPTURE(buildInstructions, add/sequential, ZYDIS_MNEMONIC_ADD, false)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(buildInstructions, add/parallel, ZYDIS_MNEMONIC_ADD, true)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(buildInstructions, div/sequential, ZYDIS_MNEMONIC_DIV, false)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(buildInstructions, div/parallel, ZYDIS_MNEMONIC_DIV, true)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(buildInstructions, cvtdq2pd/sequential, ZYDIS_MNEMONIC_CVTDQ2PD, false)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(buildInstructions, cvtdq2pd/parallel, ZYDIS_MNEMONIC_CVTDQ2PD, true)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(buildInstructions, lea/sequential, ZYDIS_MNEMONIC_LEA, false)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(buildInstructions, lea/parallel, ZYDIS_MNEMONIC_LEA, true)->Unit(benchmark::kMillisecond);
+
+    // Values per second of a single generator, the argument is the operand width in bits.
+    static void advanceInputGenerator(benchmark::State& state)
+    {
+        auto prng = Random::makeStream(1, 0);
+        Generator::InputGenerator generator(static_cast<std::size_t>(state.range(0)), prng);
+
+        for (auto _ : state)
+        {
+            if (!generator.advance())
+                generator.reset();
+            benchmark::DoNotOptimize(generator.current().data());
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(advanceInputGenerator)->Arg(8)->Arg(32)->Arg(64)->Arg(128)->Arg(512);
+
+} // namespace x86Tester::bench
@@ -0,0 +1,86 @@
+#include "instructions.hpp"
+
+#include <array>
+#include <benchmark/benchmark.h>
+#include <vector>
+#include <x86Tester/testdata.hpp>
+
+namespace x86Tester::bench
+{
+    // Roughly the shape of a DIV r64 file, GPR inputs and outputs with flags.
+    static constexpr std::size_t kNumInstrs = 16;
+    static constexpr std::size_t kEntriesPerInstr = 512;
+
+    static std::vector<std::uint8_t> writeFile()
+    {
+        std::array<std::uint8_t, 8> rax{};
+        std::array<std::uint8_t, 8> rdx{};
+        const auto rcx = std::to_array<std::uint8_t>({ 3, 0, 0, 0, 0, 0, 0, 0 });
+
+        TestData::Writer writer(kMode, ZYDIS_MNEMONIC_DIV);
+        for (std::size_t i = 0; i < kNumInstrs; ++i)
+        {
+            writer.beginInstruction(0x4000001, kDivR64);
+            for (std::size_t j = 0; j < kEntriesPerInstr; ++j)
+            {
+                rax[0] = static_cast<std::uint8_t>(j);
+                rdx[0] = static_cast<std::uint8_t>(j % 3);
+
+                const TestData::RegValue inputs[] = {
+                    { ZYDIS_REGISTER_RAX, rax }, { ZYDIS_REGISTER_RCX, rcx }, { ZYDIS_REGISTER_RDX, rdx } };
+                const TestData::RegValue outputs[] = { { ZYDIS_REGISTER_RAX, rdx }, { ZYDIS_REGISTER_RDX, rax } };
+                writer.addEntry(inputs, 0x202, outputs, 0x206, std::nullopt);
+            }
+        }
+
+        return writer.finish();
+    }
+
+    // Same path as the binary serialization of the CLI, without the file system.
+    static void serializeBinary(benchmark::State& state)
+    {
+        std::size_t numBytes = 0;
+        for (auto _ : state)
+        {
+            const auto data = writeFile();
+            numBytes += data.size();
+            benchmark::DoNotOptimize(data.data());
+        }
+
+        state.SetBytesProcessed(static_cast<std::int64_t>(numBytes));
+        state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(kNumInstrs * kEntriesPerInstr));
+    }
+
+    BENCHMARK(serializeBinary);
+
+    static void readBinary(benchmark::State& state)
+    {
+        const auto data = writeFile();
+
+        for (auto _ : state)
+        {
+            TestData::FileView file;
+            if (!file.open(data))
+            {
+                state.SkipWithError("Invalid file");
+                break;
+            }
+
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < file.getInstructionCount(); ++i)
+            {
+                for (const auto entry : file.getInstruction(i))
+                {
+                    for (std::size_t j = 0; j < entry.getInputCount(); ++j)
+                        sum += entry.getInput(j).data[0];
+                }
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+
+        state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(data.size()));
+    }
+
+    BENCHMARK(readBinary);
+
+} // namespace x86Tester::bench
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Zydis/Zydis.h>
+#include <array>
+#include <cstdint>
+#include <x86Tester/execution.hpp>
+
+namespace x86Tester::bench
+{
+    inline constexpr auto kMode = ZYDIS_MACHINE_MODE_LONG_64;
+
+    // Fixed set of representative instructions so results stay comparable between runs and backends.
+
+    // add rax, rbx
+    inline constexpr auto kAddR64R64 = std::to_array<std::uint8_t>({ 0x48, 0x01, 0xD8 });
+    // div rcx
+    inline constexpr auto kDivR64 = std::to_array<std::uint8_t>({ 0x48, 0xF7, 0xF1 });
+    // cvtdq2pd xmm3, xmm0
+    inline constexpr auto kCvtdq2pd = std::to_array<std::uint8_t>({ 0xF3, 0x0F, 0xE6, 0xD8 });
+    // lea rax, [rbx+rcx*4+0x10], address generation only, the memory isn't accessed.
+    inline constexpr auto kLeaMem = std::to_array<std::uint8_t>({ 0x48, 0x8D, 0x44, 0x8B, 0x10 });
+    // add qword ptr [rbx], rax, reads and writes the data window.
+    inline constexpr auto kAddMem = std::to_array<std::uint8_t>({ 0x48, 0x01, 0x03 });
+
+    // Inputs every instruction of the set can run with, the divisor keeps DIV from faulting and RBX points
+    // at the data window.
+    inline void setupInputs(Execution::RegisterFile& regs, std::uint64_t dataAddress)
+    {
+        Execution::setRegValue<std::uint64_t>(regs, ZYDIS_REGISTER_RAX, 0x123456789);
+        Execution::setRegValue<std::uint64_t>(regs, ZYDIS_REGISTER_RBX, dataAddress);
+        Execution::setRegValue<std::uint64_t>(regs, ZYDIS_REGISTER_RCX, 3);
+        Execution::setRegValue<std::uint64_t>(regs, ZYDIS_REGISTER_RDX, 0);
+        Execution::setRegValue<std::uint32_t>(regs, ZYDIS_REGISTER_XMM0, 0x80000001);
+    }
+
+} // namespace x86Tester::bench
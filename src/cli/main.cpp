@@ -1,33 +1,87 @@
 #include "utils.hpp"
 
 #include <Zydis/Disassembler.h>
+#include <cassert>
+#include <charconv>
+#include <execution>
 #include <filesystem>
 #include <fstream>
 #include <map>
-#include <random>
+#include <numeric>
 #include <ranges>
+#include <semaphore>
 #include <set>
 #include <sfl/small_flat_map.hpp>
 #include <sfl/small_flat_set.hpp>
 #include <sfl/small_vector.hpp>
 #include <sfl/static_vector.hpp>
 #include <sfl/vector.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <x86Tester/bitmatch.hpp>
+#include <x86Tester/bitmodel.hpp>
+#include <x86Tester/boundedqueue.hpp>
 #include <x86Tester/execution.hpp>
 #include <x86Tester/generator.hpp>
+#include <x86Tester/inputconstructor.hpp>
 #include <x86Tester/inputgenerator.hpp>
 #include <x86Tester/logging.hpp>
+#include <x86Tester/profiling.hpp>
+#include <x86Tester/random.hpp>
+#include <x86Tester/testdata.hpp>
+#include <x86Tester/threadpool.hpp>
 
 using namespace x86Tester;
 
 static constexpr auto kAbortTestCaseThreshold = 100'000;
-static constexpr auto kReportInputsThreshold = kAbortTestCaseThreshold * 80 / 100;
+static constexpr auto kReportSlowBitThreshold = kAbortTestCaseThreshold / 10;
+// Iterations without progress before the search gives up on the remaining bits, the window grows with the iteration
+// of the last progress up to kAbortTestCaseThreshold. Bits that were found late hint that the rest needs long too.
+static constexpr std::size_t kMinAbortWindow = 8'192;
+static constexpr std::size_t kAbortWindowFactor = 4;
+static constexpr std::size_t kMaxExecutionBatchSize = 256;
+// Constructed inputs per matrix entry before the entry is left to the input generators.
+static constexpr std::uint8_t kMaxConstructAttempts = 4;
 
-enum class ExceptionType
+// Registers read by an instruction plus its memory operand, CMPXCHG16B with a base and an index reads seven.
+static constexpr std::size_t kMaxInputs = Generator::InputCorpus::kMaxFields;
+
+// The index of a memory operand only takes small values, the base makes up for it so the address stays the same.
+static constexpr std::uint64_t kMaxMemIndex = 8;
+
+// Part of the result cache key, bump whenever the search behaves differently in a way no hashed constant covers.
+static constexpr std::uint32_t kResultCacheVersion = 1;
+
+using ExceptionType = TestData::ExceptionType;
+
+enum class OutputFormat
+{
+    // Compact binary files read through x86Tester/testdata.hpp.
+    Binary,
+    // Human readable hex dump, mostly for inspection.
+    Text,
+};
+
+// Where and in which format the test data is written.
+struct OutputTarget
+{
+    std::filesystem::path directory = "testdata";
+    OutputFormat format = OutputFormat::Binary;
+};
+
+// Part of the instructions generated on one machine, a generation split into shards is merged afterwards.
+struct Shard
 {
-    None,
-    // #DE
-    DivideError,
-    IntegerOverflow,
+    std::uint32_t index{};
+    std::uint32_t count{ 1 };
+
+    // Decided by the position in the sorted instruction list, every node builds the same list. The mnemonic offsets
+    // the start so mnemonics with few instructions don't all end up in the first shard.
+    bool contains(ZydisMnemonic mnemonic, std::size_t instrIndex) const
+    {
+        return (Random::mix(static_cast<std::uint64_t>(mnemonic)) + instrIndex) % count == index;
+    }
 };
 
 struct TestBitInfo
@@ -67,8 +121,58 @@ struct InstrTestGroup
     std::span<const uint8_t> instrData;
     std::vector<TestCaseEntry> entries;
     bool illegalInstruction{};
+    // The backend failed, the results are incomplete.
+    bool failed{};
+    // Decoded once, sorting, grouping and serialization would otherwise disassemble it over and over.
+    ZydisMnemonic mnemonic{};
+    std::uint16_t operandWidth{};
+    std::string text;
+};
+
+// Settings of the input search, shared by all workers. The statistics are kept in the profiling counters.
+struct SearchContext
+{
+    // Mutate inputs that reached new output states in addition to cycling the input generators.
+    bool useFeedback = true;
+    // Keep the cost of every instruction and the slowest bits for the profile report.
+    bool collectProfile = false;
 };
 
+// Number of entries in the lists of the profile report.
+static constexpr std::size_t kProfileReportSize = 50;
+
+struct InstrCost
+{
+    std::string text;
+    std::uint64_t cycles{};
+    std::size_t iterations{};
+    std::size_t numBits{};
+    std::size_t numAborted{};
+};
+
+struct BitCost
+{
+    std::string instrText;
+    std::string bitInfo;
+    std::size_t iterations{};
+    bool aborted{};
+};
+
+// Written by a single worker only.
+struct WorkerProfile
+{
+    std::vector<InstrCost> instrs;
+    // Heap with the cheapest of the kept bits on top, bounded by kProfileReportSize.
+    std::vector<BitCost> slowestBits;
+};
+
+static Profiling::ThreadRegistry<WorkerProfile> workerProfiles;
+
+static bool isCheaperBit(const BitCost& a, const BitCost& b)
+{
+    return a.iterations > b.iterations;
+}
+
 static bool isRegFiltered(ZydisRegister reg)
 {
     switch (reg)
@@ -100,18 +204,18 @@ static sfl::small_vector<ExceptionType, 5> getExceptions(const ZydisDisassembled
     return res;
 }
 
-static sfl::static_vector<ZydisRegister, 5> sortRegs(const sfl::small_flat_set<ZydisRegister, 5>& regs)
+static sfl::static_vector<ZydisRegister, kMaxInputs> sortRegs(const sfl::small_flat_set<ZydisRegister, kMaxInputs>& regs)
 {
-    sfl::static_vector<ZydisRegister, 5> res(regs.begin(), regs.end());
+    sfl::static_vector<ZydisRegister, kMaxInputs> res(regs.begin(), regs.end());
     std::sort(res.begin(), res.end(), [](auto a, auto b) {
         return ZydisRegisterGetWidth(ZYDIS_MACHINE_MODE_LONG_64, a) > ZydisRegisterGetWidth(ZYDIS_MACHINE_MODE_LONG_64, b);
     });
     return res;
 }
 
-static sfl::static_vector<ZydisRegister, 5> getRegsModified(const ZydisDisassembledInstruction& instr)
+static sfl::static_vector<ZydisRegister, kMaxInputs> getRegsModified(const ZydisDisassembledInstruction& instr)
 {
-    sfl::small_flat_set<ZydisRegister, 5> regs;
+    sfl::small_flat_set<ZydisRegister, kMaxInputs> regs;
     for (std::size_t i = 0; i < instr.info.operand_count; ++i)
     {
         const auto& op = instr.operands[i];
@@ -126,6 +230,9 @@ static sfl::static_vector<ZydisRegister, 5> getRegsModified(const ZydisDisassemb
 
 static ZydisRegister getRootReg(ZydisMachineMode mode, ZydisRegister reg)
 {
+    if (reg == TestData::kMemoryOperand)
+        return reg;
+
     const auto regCls = ZydisRegisterGetClass(reg);
     switch (regCls)
     {
@@ -140,9 +247,9 @@ static ZydisRegister getRootReg(ZydisMachineMode mode, ZydisRegister reg)
     return reg;
 }
 
-static sfl::static_vector<ZydisRegister, 5> getRegsRead(const ZydisDisassembledInstruction& instr)
+static sfl::static_vector<ZydisRegister, kMaxInputs> getRegsRead(const ZydisDisassembledInstruction& instr)
 {
-    sfl::small_flat_set<ZydisRegister, 5> regs;
+    sfl::small_flat_set<ZydisRegister, kMaxInputs> regs;
     for (std::size_t i = 0; i < instr.info.operand_count; ++i)
     {
         const auto& op = instr.operands[i];
@@ -213,9 +320,9 @@ static sfl::static_vector<ZydisRegister, 5> getRegsRead(const ZydisDisassembledI
     return sortRegs(regs);
 }
 
-static sfl::static_vector<ZydisRegister, 5> getRegsUsed(const ZydisDisassembledInstruction& instr)
+static sfl::static_vector<ZydisRegister, kMaxInputs> getRegsUsed(const ZydisDisassembledInstruction& instr)
 {
-    sfl::small_flat_set<ZydisRegister, 5> regs;
+    sfl::small_flat_set<ZydisRegister, kMaxInputs> regs;
     for (std::size_t i = 0; i < instr.info.operand_count; ++i)
     {
         const auto& op = instr.operands[i];
@@ -235,6 +342,32 @@ static sfl::static_vector<ZydisRegister, 5> getRegsUsed(const ZydisDisassembledI
     return sortRegs(regs);
 }
 
+// The explicit memory operand if the data window can back it, the address has to come from 64 bit registers so the
+// base can be chosen to point at the window. Other forms are tested without their memory as before.
+static const ZydisDecodedOperand* getDataMemOperand(const ZydisDisassembledInstruction& instr)
+{
+    const auto isAddressReg = [](ZydisRegister reg) { return ZydisRegisterGetClass(reg) == ZYDIS_REGCLASS_GPR64; };
+
+    for (std::size_t i = 0; i < instr.info.operand_count_visible; ++i)
+    {
+        const auto& op = instr.operands[i];
+        if (op.type != ZYDIS_OPERAND_TYPE_MEMORY || op.mem.type != ZYDIS_MEMOP_TYPE_MEM)
+            continue;
+
+        if (op.size == 0 || op.size % 8 != 0 || op.size / 8 > Execution::kDataWindowSize)
+            return nullptr;
+        if (op.mem.segment == ZYDIS_REGISTER_FS || op.mem.segment == ZYDIS_REGISTER_GS)
+            return nullptr;
+        if (!isAddressReg(op.mem.base) || op.mem.base == op.mem.index)
+            return nullptr;
+        if (op.mem.index != ZYDIS_REGISTER_NONE && !isAddressReg(op.mem.index))
+            return nullptr;
+
+        return &op;
+    }
+    return nullptr;
+}
+
 static std::uint32_t getFlagsModified(const ZydisDisassembledInstruction& instr)
 {
     std::uint32_t flags = 0;
@@ -263,213 +396,73 @@ static std::uint32_t getFlagsRead(const ZydisDisassembledInstruction& instr)
     return flags;
 }
 
-static std::vector<TestBitInfo> generateTestMatrix(const ZydisDisassembledInstruction& instr)
+// Every bit of the modified registers and flags with both values, minus the entries the bit model proves
+// impossible. Those would otherwise keep the search running until it gives up.
+static std::vector<TestBitInfo> generateTestMatrix(const ZydisDisassembledInstruction& instr, std::size_t& numPruned)
 {
-    const auto regsRead = getRegsRead(instr);
     const auto regsModified = getRegsModified(instr);
     const auto flagsModified = getFlagsModified(instr);
     const auto flagsSet1 = getFlagsSet1(instr);
     const auto flagsSet0 = getFlagsSet0(instr);
 
-    std::vector<TestBitInfo> matrix;
-
-    bool regDestAndSrcSame = false;
-    const auto& ops = instr.operands;
-    if (ops[0].type == ZYDIS_OPERAND_TYPE_REGISTER && ops[1].type == ZYDIS_OPERAND_TYPE_REGISTER)
-    {
-        if (ops[0].reg.value == ops[1].reg.value)
-            regDestAndSrcSame = true;
-    }
+    const Generator::BitModel model(instr);
 
-    bool testRegZero = true;
-    bool testRegOne = true;
-    bool rightInputZero = false;
-    bool resultAlwaysZero = false;
-    bool firstBitAlwaysZero = false;
-    bool inputIsImmediate = false;
-    size_t numBitsZero = 0;
+    std::vector<TestBitInfo> matrix;
+    numPruned = 0;
 
-    if (ops[1].type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
-    {
-        inputIsImmediate = true;
-        if (ops[1].imm.value.s == 0)
+    const auto addEntry = [&](ExceptionType exceptionType, ZydisRegister reg, std::uint16_t bitPos, std::uint8_t value) {
+        if (!model.isPossible({ exceptionType, reg, bitPos, value }))
         {
-            rightInputZero = true;
+            numPruned++;
+            return;
         }
-    }
-
-    // Enhanced semantic checks for specific instructions
-    switch (instr.info.mnemonic)
-    {
-        case ZYDIS_MNEMONIC_SUB:
-        case ZYDIS_MNEMONIC_CMP:
-        case ZYDIS_MNEMONIC_XOR:
-            resultAlwaysZero = regDestAndSrcSame;
-            break;
-        case ZYDIS_MNEMONIC_AND:
-        case ZYDIS_MNEMONIC_TEST:
-            resultAlwaysZero = rightInputZero;
-            break;
-        case ZYDIS_MNEMONIC_ADD:
-        case ZYDIS_MNEMONIC_FADD:
-            firstBitAlwaysZero = regDestAndSrcSame;
-            break;
-        case ZYDIS_MNEMONIC_MOV:
-            resultAlwaysZero = rightInputZero;
-            break;
-        case ZYDIS_MNEMONIC_LEA:
-            // If mem is [rax+rax*1] then the first bit is always zero.
-            firstBitAlwaysZero = ops[1].mem.base != ZYDIS_REGISTER_NONE && ops[1].mem.index == ops[1].mem.base
-                && ops[1].mem.disp.value == 0;
-            if (ops[1].mem.base == ZYDIS_REGISTER_NONE && ops[1].mem.index != ZYDIS_REGISTER_NONE && ops[1].mem.scale > 1
-                && ops[1].mem.disp.value == 0)
-            {
-                // The first bits are always zero based on scale.
-                // Turn multiply into shift
-                const auto shift = static_cast<std::uint8_t>(std::log2(ops[1].mem.scale));
-                numBitsZero = shift;
-            }
-            break;
-    }
+        matrix.push_back({ exceptionType, reg, bitPos, value });
+    };
 
     // Generate test matrix for registers
     for (auto& regModified : regsModified)
     {
         const auto regSize = ZydisRegisterGetWidth(instr.info.machine_mode, regModified);
-
-        auto maxBits = regSize;
-        switch (instr.info.mnemonic)
+        for (std::uint16_t bitPos = 0; bitPos < regSize; ++bitPos)
         {
-            case ZYDIS_MNEMONIC_SETB:
-            case ZYDIS_MNEMONIC_SETBE:
-            case ZYDIS_MNEMONIC_SETL:
-            case ZYDIS_MNEMONIC_SETLE:
-            case ZYDIS_MNEMONIC_SETNB:
-            case ZYDIS_MNEMONIC_SETNBE:
-            case ZYDIS_MNEMONIC_SETNL:
-            case ZYDIS_MNEMONIC_SETNLE:
-            case ZYDIS_MNEMONIC_SETNO:
-            case ZYDIS_MNEMONIC_SETNP:
-            case ZYDIS_MNEMONIC_SETNS:
-            case ZYDIS_MNEMONIC_SETNZ:
-            case ZYDIS_MNEMONIC_SETO:
-            case ZYDIS_MNEMONIC_SETP:
-            case ZYDIS_MNEMONIC_SETS:
-            case ZYDIS_MNEMONIC_SETZ:
-                maxBits = 1;
-                break;
-            case ZYDIS_MNEMONIC_LEA:
-                maxBits = instr.info.address_width;
-                break;
-            case ZYDIS_MNEMONIC_BSWAP:
-                resultAlwaysZero = regSize <= 16;
-                break;
+            addEntry(ExceptionType::None, regModified, bitPos, 0);
+            addEntry(ExceptionType::None, regModified, bitPos, 1);
         }
+    }
 
-        for (std::uint16_t bitPos = 0; bitPos < regSize; ++bitPos)
+    // The written memory is tested like a register.
+    const auto* memOp = getDataMemOperand(instr);
+    if (memOp != nullptr && (memOp->actions & ZYDIS_OPERAND_ACTION_MASK_WRITE) != 0)
+    {
+        for (std::uint16_t bitPos = 0; bitPos < memOp->size; ++bitPos)
         {
-            bool testZero = testRegZero;
-            bool testOne = bitPos >= numBitsZero && !resultAlwaysZero && bitPos < maxBits;
-
-            if (instr.info.mnemonic == ZYDIS_MNEMONIC_MOV && inputIsImmediate)
-            {
-                // We know the input value so we will expect those bits.
-                testZero = (ops[1].imm.value.u & (1ULL << bitPos)) == 0;
-                testOne = (ops[1].imm.value.u & (1ULL << bitPos)) != 0;
-            }
-            else if (instr.info.mnemonic == ZYDIS_MNEMONIC_OR && inputIsImmediate)
-            {
-                // If the input bit is not zero then the output bit will never be zero.
-                testZero = (ops[1].imm.value.u & (1ULL << bitPos)) == 0;
-            }
-            else if (instr.info.mnemonic == ZYDIS_MNEMONIC_AND && inputIsImmediate)
-            {
-                // If the input bit is zero then the output bit will never be one.
-                testOne = (ops[1].imm.value.u & (1ULL << bitPos)) != 0;
-            }
-            else if (instr.info.mnemonic == ZYDIS_MNEMONIC_BTR && inputIsImmediate)
-            {
-                // BTR is just reg[bit] = 0
-                testOne = ((ops[1].imm.value.u % instr.info.operand_width) != bitPos);
-            }
-
-            // Expect 0 if possible.
-            if (testZero)
-            {
-                matrix.push_back({ ExceptionType::None, regModified, bitPos, 0 });
-            }
-
-            if (bitPos == 0 && firstBitAlwaysZero)
-                testOne = false;
-
-            // Expect 1 if possible.
-            if (testOne)
-            {
-                matrix.push_back({ ExceptionType::None, regModified, bitPos, 1 });
-            }
+            addEntry(ExceptionType::None, TestData::kMemoryOperand, bitPos, 0);
+            addEntry(ExceptionType::None, TestData::kMemoryOperand, bitPos, 1);
         }
     }
 
-    // Generate test matrix for flags
+    // Generate test matrix for flags, the flags of instructions with an immediate operand are mostly fixed and
+    // only the ones Zydis reports as constant are tested.
+    const auto inputIsImmediate = instr.operands[1].type == ZYDIS_OPERAND_TYPE_IMMEDIATE;
     for (std::size_t i = 0; i < 32; ++i)
     {
         const auto flag = 1U << i;
+        const auto bitPos = static_cast<std::uint16_t>(i);
 
-        if (!inputIsImmediate)
+        if (!inputIsImmediate && (flagsModified & flag) != 0)
         {
-            if ((flagsModified & flag) != 0)
-            {
-                bool testFlagZero = true;
-                bool testFlagOne = true;
-
-                // Additional checks for specific flags based on instruction type.
-                if (flag == ZYDIS_CPUFLAG_ZF)
-                {
-                    testFlagZero = !resultAlwaysZero;
-                }
-                if (flag == ZYDIS_CPUFLAG_CF)
-                {
-                    testFlagOne = !resultAlwaysZero && !rightInputZero;
-                }
-                if (flag == ZYDIS_CPUFLAG_OF)
-                {
-                    testFlagOne = !regDestAndSrcSame && !rightInputZero;
-                }
-                if (flag == ZYDIS_CPUFLAG_PF)
-                {
-                    testFlagZero = !resultAlwaysZero;
-                }
-                if (flag == ZYDIS_CPUFLAG_AF)
-                {
-                    testFlagOne = !resultAlwaysZero && !rightInputZero;
-                }
-                if (flag == ZYDIS_CPUFLAG_SF)
-                {
-                    testFlagOne = !resultAlwaysZero;
-                }
-
-                // Expect 0 if possible.
-                if (testFlagZero)
-                {
-                    matrix.push_back({ ExceptionType::None, ZYDIS_REGISTER_FLAGS, static_cast<std::uint16_t>(i), 0 });
-                }
-
-                // Expect 1 if possible.
-                if (testFlagOne)
-                {
-                    matrix.push_back({ ExceptionType::None, ZYDIS_REGISTER_FLAGS, static_cast<std::uint16_t>(i), 1 });
-                }
-            }
+            addEntry(ExceptionType::None, ZYDIS_REGISTER_FLAGS, bitPos, 0);
+            addEntry(ExceptionType::None, ZYDIS_REGISTER_FLAGS, bitPos, 1);
         }
 
         if ((flagsSet0 & flag) != 0)
         {
-            matrix.push_back({ ExceptionType::None, ZYDIS_REGISTER_FLAGS, static_cast<std::uint16_t>(i), 0 });
+            addEntry(ExceptionType::None, ZYDIS_REGISTER_FLAGS, bitPos, 0);
         }
 
         if ((flagsSet1 & flag) != 0)
         {
-            matrix.push_back({ ExceptionType::None, ZYDIS_REGISTER_FLAGS, static_cast<std::uint16_t>(i), 1 });
+            addEntry(ExceptionType::None, ZYDIS_REGISTER_FLAGS, bitPos, 1);
         }
     }
 
@@ -477,12 +470,18 @@ static std::vector<TestBitInfo> generateTestMatrix(const ZydisDisassembledInstru
     const auto exceptions = getExceptions(instr);
     for (const auto& exception : exceptions)
     {
-        matrix.push_back({ exception, ZYDIS_REGISTER_NONE, 0, 0 });
+        addEntry(exception, ZYDIS_REGISTER_NONE, 0, 0);
     }
 
     return matrix;
 }
 
+static std::vector<TestBitInfo> generateTestMatrix(const ZydisDisassembledInstruction& instr)
+{
+    std::size_t numPruned{};
+    return generateTestMatrix(instr, numPruned);
+}
+
 static std::size_t getRegOffset(ZydisRegister reg)
 {
     switch (reg)
@@ -496,77 +495,473 @@ static std::size_t getRegOffset(ZydisRegister reg)
     return 0;
 }
 
-static void advanceInputs(
-    Execution::ScopedContext& ctx, std::mt19937_64& prng, std::vector<Generator::InputGenerator>& inputGens,
-    const ZydisDisassembledInstruction& instr, TestCaseEntry& testEntry, std::size_t iteration)
+// Location of a register inside Execution::RegisterFile, resolved once so the hot loop only copies bytes.
+struct RegSlot
+{
+    ZydisRegister reg{};
+    ZydisRegister rootReg{};
+    // Byte offset of the root register within the register file.
+    std::uint32_t rootOffset{};
+    std::uint16_t rootSize{};
+    // Bytes of the register itself within the root register, AH starts at 1.
+    std::uint16_t offset{};
+    std::uint16_t size{};
+    // Offset within the bit image, only used for modified registers.
+    std::uint16_t imageOffset{};
+};
+
+// Everything the per-iteration functions need from an instruction, built once per instruction so
+// the loop doesn't call into Zydis.
+struct InstrProfile
+{
+    // Same order as the input generators.
+    sfl::static_vector<RegSlot, kMaxInputs> regsRead;
+    // Root registers of the read registers, cleared before the inputs are assigned.
+    sfl::static_vector<RegSlot, kMaxInputs> rootRegsRead;
+    // Root registers captured as output.
+    sfl::static_vector<RegSlot, kMaxInputs> rootRegsModified;
+    // Modified root registers that are not read, their bits only count if they changed.
+    sfl::static_vector<RegSlot, kMaxInputs> rootRegsWriteOnly;
+    std::uint32_t flagsRead{};
+    std::uint32_t flagsModified{};
+    // Flags reported by Zydis, the others are removed from the output.
+    std::uint32_t outputFlagsMask{};
+    // The bit image holds the modified root registers followed by the flags.
+    std::uint16_t flagsImageOffset{};
+    std::uint16_t imageSize{};
+    // The memory operand is at the start of the data window, the size is zero without one. It shows up in the
+    // slots as TestData::kMemoryOperand.
+    std::uint16_t memSize{};
+    ZydisRegister memBase{};
+    ZydisRegister memIndex{};
+    std::uint8_t memScale{};
+    std::int64_t memDisp{};
+};
+
+static RegSlot getRegSlot(ZydisMachineMode mode, ZydisRegister reg)
+{
+    static const Execution::RegisterFile probe{};
+
+    const auto rootReg = getRootReg(mode, reg);
+    const auto rootData = Execution::getRegBytes(probe, rootReg);
+    const auto rootWidth = static_cast<std::size_t>(ZydisRegisterGetWidth(mode, rootReg) / 8);
+
+    RegSlot slot{};
+    slot.reg = reg;
+    slot.rootReg = rootReg;
+    slot.rootOffset = static_cast<std::uint32_t>(rootData.data() - reinterpret_cast<const std::uint8_t*>(&probe));
+    slot.rootSize = static_cast<std::uint16_t>(std::min(rootData.size(), rootWidth));
+    slot.offset = static_cast<std::uint16_t>(getRegOffset(reg));
+    slot.size = static_cast<std::uint16_t>(ZydisRegisterGetWidth(mode, reg) / 8);
+    return slot;
+}
+
+static RegSlot getMemSlot(std::uint16_t size)
+{
+    RegSlot slot{};
+    slot.reg = TestData::kMemoryOperand;
+    slot.rootReg = TestData::kMemoryOperand;
+    slot.rootOffset = static_cast<std::uint32_t>(offsetof(Execution::RegisterFile, data));
+    slot.rootSize = size;
+    slot.size = size;
+    return slot;
+}
+
+static std::uint8_t* getSlotData(Execution::RegisterFile& regs, const RegSlot& slot)
+{
+    return reinterpret_cast<std::uint8_t*>(&regs) + slot.rootOffset;
+}
+
+static const std::uint8_t* getSlotData(const Execution::RegisterFile& regs, const RegSlot& slot)
+{
+    return reinterpret_cast<const std::uint8_t*>(&regs) + slot.rootOffset;
+}
+
+static InstrProfile buildInstrProfile(const ZydisDisassembledInstruction& instr)
 {
-    const auto regsRead = getRegsRead(instr);
-    const auto flagsRead = getFlagsRead(instr);
+    const auto mode = instr.info.machine_mode;
+    const auto containsRoot = [](const auto& slots, ZydisRegister rootReg) {
+        return std::ranges::any_of(slots, [&](const auto& slot) { return slot.rootReg == rootReg; });
+    };
+
+    InstrProfile profile{};
 
-    sfl::small_flat_set<ZydisRegister, 5> regsReadBig;
-    for (const auto& reg : regsRead)
+    for (const auto& reg : getRegsRead(instr))
     {
-        const auto bigReg = getRootReg(instr.info.machine_mode, reg);
-        regsReadBig.insert(bigReg);
+        const auto rootReg = getRootReg(mode, reg);
+        if (!isRegFiltered(rootReg) && !containsRoot(profile.rootRegsRead, rootReg))
+            profile.rootRegsRead.push_back(getRegSlot(mode, rootReg));
+
+        if (!isRegFiltered(reg))
+            profile.regsRead.push_back(getRegSlot(mode, reg));
+    }
+
+    const auto* memOp = getDataMemOperand(instr);
+    if (memOp != nullptr)
+    {
+        profile.memSize = static_cast<std::uint16_t>(memOp->size / 8);
+        profile.memBase = memOp->mem.base;
+        profile.memIndex = memOp->mem.index;
+        profile.memScale = memOp->mem.scale;
+        profile.memDisp = memOp->mem.disp.value;
+
+        if ((memOp->actions & ZYDIS_OPERAND_ACTION_MASK_READ) != 0)
+        {
+            profile.regsRead.push_back(getMemSlot(profile.memSize));
+            profile.rootRegsRead.push_back(getMemSlot(profile.memSize));
+        }
     }
 
-    // Cleanse the registers.
-    for (const auto& reg : regsReadBig)
+    std::uint16_t imageOffset = 0;
+    for (const auto& reg : getRegsModified(instr))
     {
-        if (isRegFiltered(reg))
+        const auto rootReg = getRootReg(mode, reg);
+        if (containsRoot(profile.rootRegsModified, rootReg))
             continue;
 
-        const auto bigRegSize = static_cast<size_t>(ZydisRegisterGetWidth(instr.info.machine_mode, reg) / 8);
-        constexpr uint8_t ccBytes[] = {
-            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
-            0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC,
-        };
-        ctx.setRegBytes(reg, std::span<const std::uint8_t>{ ccBytes, bigRegSize });
+        auto slot = getRegSlot(mode, rootReg);
+        slot.imageOffset = imageOffset;
+        imageOffset += slot.rootSize;
+
+        profile.rootRegsModified.push_back(slot);
+        if (!containsRoot(profile.rootRegsRead, rootReg))
+            profile.rootRegsWriteOnly.push_back(slot);
     }
 
-#ifdef _DEBUG
-    sfl::static_vector<std::pair<ZydisRegister, std::vector<std::uint8_t>>, 5> regData;
-#endif
+    if (memOp != nullptr && (memOp->actions & ZYDIS_OPERAND_ACTION_MASK_WRITE) != 0)
+    {
+        auto slot = getMemSlot(profile.memSize);
+        slot.imageOffset = imageOffset;
+        imageOffset += slot.rootSize;
+
+        profile.rootRegsModified.push_back(slot);
+        if (!containsRoot(profile.rootRegsRead, TestData::kMemoryOperand))
+            profile.rootRegsWriteOnly.push_back(slot);
+    }
 
-    // Randomize read registers.
-    size_t regIndex = 0;
-    for (const auto& reg : regsRead)
+    profile.flagsImageOffset = imageOffset;
+    profile.imageSize = static_cast<std::uint16_t>(imageOffset + sizeof(Execution::RegisterFile::eflags));
+    assert(profile.imageSize <= BitMatch::kMaxImageSize);
+
+    profile.flagsRead = getFlagsRead(instr);
+    profile.flagsModified = getFlagsModified(instr);
+
+    const auto* cpuFlags = instr.info.cpu_flags;
+    profile.outputFlagsMask = cpuFlags->modified | cpuFlags->set_0 | cpuFlags->set_1 | cpuFlags->undefined;
+
+    return profile;
+}
+
+// Bit of the image the test matrix entry refers to.
+static std::size_t getImageBit(ZydisMachineMode mode, const InstrProfile& profile, const TestBitInfo& testBitInfo)
+{
+    if (testBitInfo.reg == ZYDIS_REGISTER_FLAGS)
+        return profile.flagsImageOffset * 8 + testBitInfo.bitPos;
+
+    const auto rootReg = getRootReg(mode, testBitInfo.reg);
+    const auto it = std::ranges::find_if(
+        profile.rootRegsModified, [&](const auto& slot) { return slot.rootReg == rootReg; });
+    assert(it != profile.rootRegsModified.end());
+
+    return (it->imageOffset + getRegOffset(testBitInfo.reg)) * 8 + testBitInfo.bitPos;
+}
+
+// Registers that are only written start out with all bits set or cleared, the output can only be
+// observed with the opposite value.
+static void fillOutputs(Execution::InputState& regs, const InstrProfile& profile, std::uint8_t value)
+{
+    for (const auto& slot : profile.rootRegsWriteOnly)
     {
-        if (isRegFiltered(reg))
-            continue;
+        std::memset(getSlotData(regs, slot), value, slot.rootSize);
+    }
+}
 
-        std::uint8_t regBuf[256]{};
-        const std::size_t usedRegBitSize = ZydisRegisterGetWidth(instr.info.machine_mode, reg);
-        const std::size_t usedRegByteSize = usedRegBitSize / 8;
-        const auto bigReg = getRootReg(instr.info.machine_mode, reg);
-        const std::size_t bigRegBitSize = ZydisRegisterGetWidth(instr.info.machine_mode, bigReg);
-        const std::size_t bigRegByteSize = bigRegBitSize / 8;
+static void captureImage(const Execution::RegisterFile& regs, const InstrProfile& profile, BitMatch::Image& image)
+{
+    for (const auto& slot : profile.rootRegsModified)
+    {
+        std::memcpy(image.bytes.data() + slot.imageOffset, getSlotData(regs, slot), slot.rootSize);
+    }
+    std::memcpy(image.bytes.data() + profile.flagsImageOffset, &regs.eflags, sizeof(regs.eflags));
+}
 
-        // In case inputs are ah, al we need to re-use the existing data in the root register.
-        auto currentBytes = ctx.getRegBytes(bigReg);
-        std::memcpy(regBuf, currentBytes.data(), currentBytes.size());
-        const auto regOffset = getRegOffset(reg);
+// Cleanse the read registers, done once for the base state of the attempts.
+static void clearInputs(Execution::InputState& regs, const InstrProfile& profile)
+{
+    for (const auto& slot : profile.rootRegsRead)
+    {
+        std::memset(getSlotData(regs, slot), 0xCC, slot.rootSize);
+    }
+}
 
-        auto& inputGen = inputGens[regIndex];
+// Points the memory operand at the data window, the index cycles through small values so the address registers
+// are not the same for every attempt. It steps every fourth attempt, the low bits of the attempt already pick the
+// input source and the output prefill. Done after the inputs are assigned, the captured inputs hold the final values.
+static void constrainAddress(
+    Execution::InputState& regs, const InstrProfile& profile, std::uint64_t dataAddr, std::size_t attempt)
+{
+    if (profile.memSize == 0)
+        return;
 
-        const auto inputData = inputGen.current();
-        std::memcpy(regBuf + regOffset, inputData.data(), usedRegByteSize);
+    std::uint64_t index = 0;
+    if (profile.memIndex != ZYDIS_REGISTER_NONE)
+    {
+        index = (attempt / 4) % kMaxMemIndex;
+        Execution::setRegValue<std::uint64_t>(regs, profile.memIndex, index);
+    }
 
-        ctx.setRegBytes(bigReg, std::span<const std::uint8_t>{ regBuf, bigRegByteSize });
+    const auto base = dataAddr - index * profile.memScale - static_cast<std::uint64_t>(profile.memDisp);
+    Execution::setRegValue<std::uint64_t>(regs, profile.memBase, base);
+}
 
-        testEntry.inputRegs[bigReg] = RegTestData{ regBuf, regBuf + bigRegByteSize };
+static std::uint32_t randomizeFlags(Execution::InputState& regs, Random::Prng& prng, const InstrProfile& profile)
+{
+    // Randomize read flags, all of them come from a single draw.
+    const auto flags = static_cast<std::uint32_t>(prng.nextBits(profile.flagsRead));
 
-        regIndex++;
+    // Ensure we never have TF set.
+    regs.eflags = flags & ~ZYDIS_CPUFLAG_TF;
 
-#ifdef _DEBUG
-        if (iteration >= kReportInputsThreshold)
+    return flags;
+}
+
+// Randomize read registers, in case inputs are ah, al the existing data of the root register is kept.
+static void assignInputs(
+    Execution::InputState& regs, std::span<Generator::InputGenerator> inputGens, const InstrProfile& profile)
+{
+    for (std::size_t regIndex = 0; regIndex < profile.regsRead.size(); ++regIndex)
+    {
+        const auto& slot = profile.regsRead[regIndex];
+
+        const auto inputData = inputGens[regIndex].current();
+        std::memcpy(getSlotData(regs, slot) + slot.offset, inputData.data(), slot.size);
+    }
+}
+
+// Reads the inputs back from a corpus entry, the slots are packed in order.
+static void loadInputs(Execution::InputState& regs, std::span<const std::uint8_t> buffer, const InstrProfile& profile)
+{
+    std::size_t offset = 0;
+    for (const auto& slot : profile.regsRead)
+    {
+        std::memcpy(getSlotData(regs, slot) + slot.offset, buffer.data() + offset, slot.size);
+        offset += slot.size;
+    }
+}
+
+static bool matchTargets(
+    const BitMatch::Targets& targets, const BitMatch::Image& input, const BitMatch::Image& output,
+    BitMatch::Image& matched0, BitMatch::Image& matched1)
+{
+    return targets.match(input, output, matched0, matched1);
+}
+
+// The per execution steps of the search. The generic kernel walks the slots of the profile, the fixed ones are
+// instantiated for common register signatures and have every width and image offset as a constant.
+struct SearchKernel
+{
+    void (*assignInputs)(Execution::InputState&, std::span<Generator::InputGenerator>, const InstrProfile&);
+    void (*loadInputs)(Execution::InputState&, std::span<const std::uint8_t>, const InstrProfile&);
+    void (*captureImage)(const Execution::RegisterFile&, const InstrProfile&, BitMatch::Image&);
+    bool (*match)(
+        const BitMatch::Targets&, const BitMatch::Image&, const BitMatch::Image&, BitMatch::Image&, BitMatch::Image&);
+};
+
+static constexpr SearchKernel kGenericKernel{ assignInputs, loadInputs, captureImage, matchTargets };
+
+// Bytes of a register within its root register, only the position in the register file is left to the profile.
+template<std::uint16_t TSize, std::uint16_t TOffset = 0> struct SlotLayout
+{
+    static constexpr std::uint16_t kSize = TSize;
+    static constexpr std::uint16_t kOffset = TOffset;
+};
+
+using Gp8 = SlotLayout<1>;
+using Gp8Hi = SlotLayout<1, 1>;
+using Gp16 = SlotLayout<2>;
+using Gp32 = SlotLayout<4>;
+using Gp64 = SlotLayout<8>;
+using St = SlotLayout<10>;
+using Xmm = SlotLayout<16>;
+
+template<typename... TSlots> struct SlotList
+{
+    static constexpr std::size_t kCount = sizeof...(TSlots);
+    static constexpr std::array<std::uint16_t, kCount> kSizes{ TSlots::kSize... };
+    static constexpr std::array<std::uint16_t, kCount> kOffsets{ TSlots::kOffset... };
+    static constexpr std::size_t kTotalSize = (std::size_t{} + ... + TSlots::kSize);
+
+    // Position of every slot when they are packed back to back, as in the corpus entries and the bit image.
+    static constexpr auto kPacked = []() {
+        std::array<std::uint16_t, kCount> res{};
+        std::uint16_t offset = 0;
+        for (std::size_t i = 0; i < kCount; ++i)
         {
-            regData.emplace_back(reg, std::vector<std::uint8_t>{ regBuf + regOffset, regBuf + regOffset + usedRegByteSize });
+            res[i] = offset;
+            offset += kSizes[i];
         }
-#endif
+        return res;
+    }();
+};
+
+template<typename... TSlots> using Inputs = SlotList<TSlots...>;
+template<typename... TSlots> using Outputs = SlotList<TSlots...>;
+
+// Kernel for the register signature, the inputs are the read registers and the outputs the modified root
+// registers in profile order. The flags always follow the outputs in the image.
+template<typename TInputs, typename TOutputs> struct FixedKernel
+{
+    static constexpr std::size_t kFlagsImageOffset = TOutputs::kTotalSize;
+    static constexpr std::size_t kImageSize = kFlagsImageOffset + sizeof(Execution::RegisterFile::eflags);
+    static_assert(kImageSize <= BitMatch::kMaxImageSize);
+
+    static bool matches(const InstrProfile& profile)
+    {
+        if (profile.regsRead.size() != TInputs::kCount || profile.rootRegsModified.size() != TOutputs::kCount)
+            return false;
+
+        for (std::size_t i = 0; i < TInputs::kCount; ++i)
+        {
+            const auto& slot = profile.regsRead[i];
+            if (slot.size != TInputs::kSizes[i] || slot.offset != TInputs::kOffsets[i])
+                return false;
+        }
+
+        // The image offsets follow from the sizes, buildInstrProfile packs them the same way.
+        for (std::size_t i = 0; i < TOutputs::kCount; ++i)
+        {
+            if (profile.rootRegsModified[i].rootSize != TOutputs::kSizes[i])
+                return false;
+        }
+
+        return profile.imageSize == kImageSize;
+    }
+
+    static void assignInputs(
+        Execution::InputState& regs, std::span<Generator::InputGenerator> inputGens, const InstrProfile& profile)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (std::memcpy(
+                 getSlotData(regs, profile.regsRead[I]) + TInputs::kOffsets[I], inputGens[I].current().data(),
+                 TInputs::kSizes[I]),
+             ...);
+        }(std::make_index_sequence<TInputs::kCount>{});
+    }
+
+    static void loadInputs(
+        Execution::InputState& regs, std::span<const std::uint8_t> buffer, const InstrProfile& profile)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (std::memcpy(
+                 getSlotData(regs, profile.regsRead[I]) + TInputs::kOffsets[I], buffer.data() + TInputs::kPacked[I],
+                 TInputs::kSizes[I]),
+             ...);
+        }(std::make_index_sequence<TInputs::kCount>{});
+    }
+
+    static void captureImage(const Execution::RegisterFile& regs, const InstrProfile& profile, BitMatch::Image& image)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (std::memcpy(
+                 image.bytes.data() + TOutputs::kPacked[I], getSlotData(regs, profile.rootRegsModified[I]),
+                 TOutputs::kSizes[I]),
+             ...);
+        }(std::make_index_sequence<TOutputs::kCount>{});
+        std::memcpy(image.bytes.data() + kFlagsImageOffset, &regs.eflags, sizeof(regs.eflags));
     }
 
-    for (size_t inputIdx = 0; inputIdx < regIndex; ++inputIdx)
+    static bool match(
+        const BitMatch::Targets& targets, const BitMatch::Image& input, const BitMatch::Image& output,
+        BitMatch::Image& matched0, BitMatch::Image& matched1)
+    {
+        return targets.matchFixed<kImageSize>(input, output, matched0, matched1);
+    }
+};
+
+struct SearchKernelEntry
+{
+    bool (*matches)(const InstrProfile&);
+    SearchKernel kernel;
+};
+
+template<typename TInputs, typename TOutputs> constexpr SearchKernelEntry makeKernelEntry()
+{
+    using Kernel = FixedKernel<TInputs, TOutputs>;
+    return { Kernel::matches, { Kernel::assignInputs, Kernel::loadInputs, Kernel::captureImage, Kernel::match } };
+}
+
+// Signatures of the common instruction shapes. The read registers are ordered by width, a GPR output is its
+// 64 bit root and a memory operand counts as a slot of its size, so [rbx] with 8 bytes looks like a Gp64.
+template<typename TGp> constexpr auto makeGpKernelEntries()
+{
+    return std::array{
+        // INC/NEG/NOT, MOV, ALU with an immediate.
+        makeKernelEntry<Inputs<TGp>, Outputs<Gp64>>(),
+        // ALU reg, reg and CMOVcc.
+        makeKernelEntry<Inputs<TGp, TGp>, Outputs<Gp64>>(),
+        // CMP/TEST.
+        makeKernelEntry<Inputs<TGp>, Outputs<>>(),
+        makeKernelEntry<Inputs<TGp, TGp>, Outputs<>>(),
+        // Shifts and rotates by CL.
+        makeKernelEntry<Inputs<TGp, Gp8>, Outputs<Gp64>>(),
+        // MUL/IMUL with the implicit accumulator, XCHG/XADD.
+        makeKernelEntry<Inputs<TGp, TGp>, Outputs<Gp64, Gp64>>(),
+        // DIV/IDIV.
+        makeKernelEntry<Inputs<TGp, TGp, TGp>, Outputs<Gp64, Gp64>>(),
+        // ALU reg, [base], the base sorts first as the widest register.
+        makeKernelEntry<Inputs<Gp64, TGp, TGp>, Outputs<Gp64>>(),
+    };
+}
+
+static constexpr auto kGp8KernelEntries = makeGpKernelEntries<Gp8>();
+static constexpr auto kGp16KernelEntries = makeGpKernelEntries<Gp16>();
+static constexpr auto kGp32KernelEntries = makeGpKernelEntries<Gp32>();
+static constexpr auto kGp64KernelEntries = makeGpKernelEntries<Gp64>();
+
+static constexpr SearchKernelEntry kOtherKernelEntries[] = {
+    // High byte registers.
+    makeKernelEntry<Inputs<Gp8Hi>, Outputs<Gp64>>(),
+    makeKernelEntry<Inputs<Gp8, Gp8Hi>, Outputs<Gp64>>(),
+    // 8 bit DIV/IDIV and MUL/IMUL read AX and write it.
+    makeKernelEntry<Inputs<Gp16, Gp8>, Outputs<Gp64>>(),
+    // SSE arithmetic, conversions and COMISS/COMISD.
+    makeKernelEntry<Inputs<Xmm>, Outputs<Xmm>>(),
+    makeKernelEntry<Inputs<Xmm, Xmm>, Outputs<Xmm>>(),
+    makeKernelEntry<Inputs<Xmm, Xmm>, Outputs<>>(),
+    makeKernelEntry<Inputs<Xmm>, Outputs<Gp64>>(),
+    makeKernelEntry<Inputs<Xmm, Gp64>, Outputs<Xmm>>(),
+    // x87 on the stack top.
+    makeKernelEntry<Inputs<St>, Outputs<St>>(),
+    makeKernelEntry<Inputs<St, St>, Outputs<St>>(),
+};
+
+// Picked once per instruction, the first signature that matches wins.
+static SearchKernel selectSearchKernel(const InstrProfile& profile)
+{
+    for (const auto& entries : { std::span<const SearchKernelEntry>(kGp8KernelEntries),
+                                 std::span<const SearchKernelEntry>(kGp16KernelEntries),
+                                 std::span<const SearchKernelEntry>(kGp32KernelEntries),
+                                 std::span<const SearchKernelEntry>(kGp64KernelEntries),
+                                 std::span<const SearchKernelEntry>(kOtherKernelEntries) })
+    {
+        for (const auto& entry : entries)
+        {
+            if (entry.matches(profile))
+                return entry.kernel;
+        }
+    }
+    return kGenericKernel;
+}
+
+// Returns the input flags before TF is removed, the inputs are captured from the register file once an
+// attempt is kept so the search itself doesn't allocate.
+static std::uint32_t advanceInputs(
+    Execution::InputState& regs, Random::Prng& prng, std::span<Generator::InputGenerator> inputGens,
+    const InstrProfile& profile, const SearchKernel& kernel, std::size_t iteration)
+{
+    kernel.assignInputs(regs, inputGens, profile);
+
+    for (size_t inputIdx = 0; inputIdx < profile.regsRead.size(); ++inputIdx)
     {
         if (inputGens[inputIdx].advance())
         {
@@ -575,488 +970,1865 @@ static void advanceInputs(
         }
     }
 
-    // Randomize read flags.
-    std::uint32_t flags = 0;
-    if (flagsRead != 0)
-    {
-        for (std::size_t i = 0; i < 32; ++i)
+    return randomizeFlags(regs, prng, profile);
+}
+
+// Same as advanceInputs but the register inputs come from a mutated corpus entry.
+static std::uint32_t mutateInputs(
+    Execution::InputState& regs, Random::Prng& prng, Generator::InputCorpus& corpus, const InstrProfile& profile,
+    const SearchKernel& kernel, std::span<std::uint8_t> buffer)
+{
+    corpus.mutate(buffer);
+    kernel.loadInputs(regs, buffer, profile);
+
+    return randomizeFlags(regs, prng, profile);
+}
+
+static void addToCorpus(
+    Generator::InputCorpus& corpus, const Execution::InputState& regs, const InstrProfile& profile,
+    std::span<std::uint8_t> buffer)
+{
+    std::size_t offset = 0;
+    for (const auto& slot : profile.regsRead)
+    {
+        std::memcpy(buffer.data() + offset, getSlotData(regs, slot) + slot.offset, slot.size);
+        offset += slot.size;
+    }
+
+    corpus.add(buffer);
+}
+
+// Replaces the assigned inputs with ones built for the matrix entry, returns false if the constructor
+// doesn't handle the entry.
+static bool constructInputs(
+    Execution::InputState& regs, std::uint32_t& flags, Random::Prng& prng, const ZydisDisassembledInstruction& instr,
+    const InstrProfile& profile, Generator::InputConstructorFn constructor, const TestBitInfo& testBitInfo)
+{
+    sfl::static_vector<Generator::InputField, kMaxInputs> fields;
+    for (const auto& slot : profile.regsRead)
+    {
+        fields.push_back({ slot.reg, std::span(getSlotData(regs, slot) + slot.offset, slot.size) });
+    }
+
+    const Generator::InputTarget target{
+        testBitInfo.exceptionType, testBitInfo.reg, testBitInfo.bitPos, testBitInfo.expectedBitValue
+    };
+    if (!constructor(instr, target, std::span<const Generator::InputField>(fields.data(), fields.size()), flags, prng))
+        return false;
+
+    // Ensure we never have TF set.
+    regs.eflags = flags & ~ZYDIS_CPUFLAG_TF;
+    return true;
+}
+
+static void captureInputs(
+    const Execution::InputState& regs, std::uint32_t inputFlags, const InstrProfile& profile, TestCaseEntry& testEntry)
+{
+    for (const auto& slot : profile.regsRead)
+    {
+        const auto* rootData = getSlotData(regs, slot);
+        testEntry.inputRegs[slot.rootReg] = RegTestData{ rootData, rootData + slot.rootSize };
+    }
+
+    if (profile.flagsRead != 0)
+    {
+        testEntry.inputFlags = inputFlags;
+    }
+}
+
+// The recorded memory also covers bytes past the operand the instruction wrote.
+static void captureOutputs(const Execution::OutputState& output, const InstrProfile& profile, TestCaseEntry& testEntry)
+{
+    const auto& regs = output.regs;
+    for (const auto& slot : profile.rootRegsModified)
+    {
+        const auto* rootData = getSlotData(regs, slot);
+        auto size = static_cast<std::size_t>(slot.rootSize);
+        if (slot.rootReg == TestData::kMemoryOperand)
+            size = std::max<std::size_t>(size, output.dataDirtyEnd);
+
+        testEntry.outputRegs[slot.rootReg] = RegTestData{ rootData, rootData + size };
+    }
+
+    if (profile.flagsModified != 0)
+    {
+        // Remove all flags that are not reported by Zydis.
+        testEntry.outputFlags = regs.eflags & profile.outputFlagsMask;
+    }
+}
+
+static std::string getTestInfo(const TestBitInfo& info)
+{
+    std::string res;
+    res = std::format("{}[{}] = 0b{}", TestData::getRegisterName(info.reg), info.bitPos, info.expectedBitValue);
+    return res;
+}
+
+// Reuses the storage of the vector, the generators keep their data inline.
+static void setupInputGenerators(
+    Random::Prng& prng, const InstrProfile& profile, std::vector<Generator::InputGenerator>& generators)
+{
+    generators.clear();
+
+    // Generate input generators for registers.
+    for (const auto& slot : profile.regsRead)
+    {
+        generators.emplace_back(slot.size * 8, prng);
+    }
+}
+
+static bool isInputFromImmediate(const ZydisDisassembledInstruction& instr)
+{
+    for (std::size_t i = 0; i < instr.info.operand_count; ++i)
+    {
+        const auto& op = instr.operands[i];
+        if (op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
+            return true;
+    }
+    return false;
+}
+
+static std::size_t getAbortWindow(std::size_t lastProgress, std::size_t maxAttempts)
+{
+    return std::clamp(lastProgress * kAbortWindowFactor, kMinAbortWindow, maxAttempts);
+}
+
+// Encodings of the same mnemonic get their own streams, the mnemonic alone would give every register and
+// operand size combination the same inputs.
+static std::uint64_t getInstrSeed(const ZydisDisassembledInstruction& instr, std::span<const std::uint8_t> instrData)
+{
+    auto seed = Random::mix(static_cast<std::uint64_t>(instr.info.mnemonic));
+    for (const auto value : instrData)
+    {
+        seed = Random::mix(seed ^ value);
+    }
+    return seed;
+}
+
+static void testInstruction(ZydisMachineMode mode, InstrTestGroup& testCase, SearchContext& search)
+{
+    auto& instrData = testCase.instrData;
+
+    ZydisDisassembledInstruction instr{};
+    ZydisDisassembleIntel(mode, 0, instrData.data(), instrData.size(), &instr);
+
+    const auto isInputImmediate = isInputFromImmediate(instr);
+    const std::size_t maxAttempts = isInputImmediate ? kAbortTestCaseThreshold / 3 : kAbortTestCaseThreshold;
+
+    const auto profile = buildInstrProfile(instr);
+    const auto kernel = selectSearchKernel(profile);
+
+    std::size_t numPruned{};
+    const auto testMatrix = generateTestMatrix(instr, numPruned);
+
+    const auto timeStart = Profiling::readTsc();
+    Profiling::add(Profiling::Counter::InstructionsTested);
+    Profiling::add(Profiling::Counter::MatrixBits, testMatrix.size());
+    Profiling::add(Profiling::Counter::BitsPruned, numPruned);
+
+    auto ctx = Execution::ScopedContext(mode, instrData);
+    if (!ctx)
+    {
+        Logging::println("Failed to prepare context");
+        testCase.failed = true;
+        return;
+    }
+
+    testCase.address = ctx.getCodeAddress();
+
+    const auto dataAddr = ctx.getDataAddress();
+    if (profile.memSize != 0 && dataAddr == 0)
+    {
+        Logging::println("No data window for the memory operand: {}", instr.text);
+        testCase.failed = true;
+        return;
+    }
+
+    // Streams are derived from the mnemonic and the encoded bytes, the results are the same for every thread
+    // schedule.
+    const auto seed = getInstrSeed(instr, instrData);
+    auto prng = Random::makeStream(seed, 0);
+
+    std::vector<Execution::InputState> batchInputs(kMaxExecutionBatchSize);
+    std::vector<Execution::OutputState> batchOutputs(kMaxExecutionBatchSize);
+    std::vector<std::uint32_t> batchFlags(kMaxExecutionBatchSize);
+
+    std::vector<Generator::InputGenerator> inputGenerators;
+    inputGenerators.reserve(profile.regsRead.size());
+    setupInputGenerators(prng, profile, inputGenerators);
+
+    // Every execution is checked against all register and flag bits of the matrix that were not
+    // observed yet, a single execution usually satisfies many of them.
+    BitMatch::Targets targets(profile.imageSize);
+    std::vector<std::size_t> matrixBits(testMatrix.size());
+    std::size_t numRemainingExceptions = 0;
+    for (std::size_t i = 0; i < testMatrix.size(); ++i)
+    {
+        const auto& testBitInfo = testMatrix[i];
+        if (testBitInfo.exceptionType != ExceptionType::None)
+        {
+            numRemainingExceptions++;
+            continue;
+        }
+
+        matrixBits[i] = getImageBit(mode, profile, testBitInfo);
+        targets.add(matrixBits[i], testBitInfo.expectedBitValue);
+    }
+
+    for (const auto& slot : profile.rootRegsWriteOnly)
+    {
+        for (std::size_t i = 0; i < slot.rootSize * 8u; ++i)
+        {
+            targets.requireChange(slot.imageOffset * 8 + i);
+        }
+    }
+
+    // Iteration in which each matrix entry was satisfied, zero while it is not.
+    std::vector<std::size_t> satisfiedAt(testMatrix.size());
+
+    const auto markSatisfied = [&](std::size_t index, std::size_t iteration) {
+        satisfiedAt[index] = iteration;
+        Profiling::add(Profiling::Counter::BitsSatisfied);
+        Profiling::add(Profiling::Counter::IterationsToSatisfy, iteration);
+
+        if (iteration >= kReportSlowBitThreshold)
+        {
+            Logging::println(
+                "Slow test: {} ; {} took {} iterations", instr.text, getTestInfo(testMatrix[index]), iteration);
+        }
+    };
+
+    // Everything but the inputs is the same for every attempt, pairs of attempts alternate between the two
+    // so either value of the write only registers can be observed with generated and mutated inputs alike.
+    std::array<Execution::InputState, 2> baseRegs{ ctx.getRegisterFile(), ctx.getRegisterFile() };
+    for (std::size_t i = 0; i < baseRegs.size(); ++i)
+    {
+        fillOutputs(baseRegs[i], profile, i == 0 ? 0xFF : 0x00);
+        clearInputs(baseRegs[i], profile);
+    }
+
+    BitMatch::Image inputImage;
+    BitMatch::Image outputImage;
+    BitMatch::Image matched0;
+    BitMatch::Image matched1;
+
+    // Inputs that reached new output states, every other attempt mutates one of them.
+    const auto useFeedback = search.useFeedback && !profile.regsRead.empty();
+    sfl::static_vector<std::size_t, kMaxInputs> inputSizes;
+    for (const auto& slot : profile.regsRead)
+    {
+        inputSizes.push_back(slot.size);
+    }
+    Generator::InputCorpus corpus(std::span<const std::size_t>(inputSizes.data(), inputSizes.size()), prng);
+    BitMatch::Coverage coverage(profile.imageSize);
+    std::uint32_t seenStatuses = 0;
+
+    std::array<std::uint8_t, Generator::InputCorpus::kMaxEntrySize> corpusBuffer{};
+    const auto corpusInput = std::span(corpusBuffer).first(corpus.getEntrySize());
+
+    // Captured entries are only added once per target at most.
+    testCase.entries.reserve(testMatrix.size());
+
+    bool illegalInstr = false;
+    bool aborted = false;
+
+    const auto isDone = [&]() { return targets.empty() && numRemainingExceptions == 0; };
+
+    // Known instruction families get inputs built for the open matrix entries first, the entries are
+    // visited round robin until each was satisfied or ran out of attempts.
+    const auto inputConstructor = Generator::getInputConstructor(instr.info.mnemonic);
+    std::vector<std::uint8_t> numConstructed(testMatrix.size());
+    std::size_t constructCursor = 0;
+    bool constructing = inputConstructor != nullptr;
+
+    // Each matrix entry constructs from its own stream, 2^128 draws apart, so its inputs don't depend on
+    // how many draws the generators or the other entries took.
+    std::vector<Random::Prng> constructStreams;
+    if (constructing)
+    {
+        auto stream = Random::makeStream(seed, 1);
+        constructStreams.reserve(testMatrix.size());
+        for (std::size_t i = 0; i < testMatrix.size(); ++i)
+        {
+            constructStreams.push_back(stream);
+            stream.jump();
+        }
+    }
+
+    const auto constructNext = [&](Execution::InputState& regs, std::uint32_t& flags) {
+        for (std::size_t n = 0; n < testMatrix.size(); ++n)
+        {
+            const auto index = (constructCursor + n) % testMatrix.size();
+            if (satisfiedAt[index] != 0 || numConstructed[index] >= kMaxConstructAttempts)
+                continue;
+
+            constructCursor = index + 1;
+            if (constructInputs(
+                    regs, flags, constructStreams[index], instr, profile, inputConstructor, testMatrix[index]))
+            {
+                numConstructed[index]++;
+                return;
+            }
+
+            // Not handled, don't ask again.
+            numConstructed[index] = kMaxConstructAttempts;
+        }
+        constructing = false;
+    };
+
+    // The first inputs satisfy most of the bits, grow the batch for the ones that are left.
+    std::size_t batchSize = 1;
+
+    std::size_t iteration = 0;
+    std::size_t lastProgress = 0;
+    while (!isDone() && !illegalInstr && !aborted)
+    {
+        const auto inputStart = Profiling::readTsc();
+        for (std::size_t i = 0; i < batchSize; ++i)
+        {
+            const auto attempt = iteration + i;
+
+            auto& regs = batchInputs[i];
+            // Mutation picks the odd attempts, the prefill changes every second attempt so it isn't tied to it.
+            regs = baseRegs[(attempt / 2) % baseRegs.size()];
+
+            // Assign inputs.
+            if (useFeedback && !corpus.empty() && attempt % 2 == 1)
+                batchFlags[i] = mutateInputs(regs, prng, corpus, profile, kernel, corpusInput);
+            else
+                batchFlags[i] = advanceInputs(regs, prng, inputGenerators, profile, kernel, attempt);
+
+            if (constructing)
+                constructNext(regs, batchFlags[i]);
+
+            constrainAddress(regs, profile, dataAddr, attempt);
+        }
+
+        Profiling::add(Profiling::Counter::InputCycles, Profiling::readTsc() - inputStart);
+
+        const auto inputs = std::span<const Execution::InputState>(batchInputs.data(), batchSize);
+        if (!ctx.executeBatch(inputs, std::span(batchOutputs.data(), batchSize)))
+        {
+            Logging::println("Failed to execute instruction");
+            testCase.failed = true;
+            return;
+        }
+
+        Profiling::ScopedTimer matchTimer(Profiling::Counter::MatchCycles);
+
+        for (std::size_t i = 0; i < batchSize && !isDone() && !illegalInstr; ++i)
+        {
+            const auto& input = batchInputs[i];
+            const auto& output = batchOutputs[i];
+
+            iteration++;
+
+            bool isNew = false;
+            if (output.status == Execution::ExecutionStatus::Success)
+            {
+                kernel.captureImage(input, profile, inputImage);
+                kernel.captureImage(output.regs, profile, outputImage);
+
+                isNew = coverage.update(outputImage);
+
+                if (kernel.match(targets, inputImage, outputImage, matched0, matched1))
+                {
+                    targets.remove(matched0, matched1);
+
+                    for (std::size_t j = 0; j < testMatrix.size(); ++j)
+                    {
+                        const auto& testBitInfo = testMatrix[j];
+                        if (satisfiedAt[j] != 0 || testBitInfo.exceptionType != ExceptionType::None)
+                            continue;
+
+                        const auto& matched = testBitInfo.expectedBitValue == 0 ? matched0 : matched1;
+                        if (matched.test(matrixBits[j]))
+                            markSatisfied(j, iteration);
+                    }
+
+                    auto& testEntry = testCase.entries.emplace_back();
+                    captureInputs(input, batchFlags[i], profile, testEntry);
+                    captureOutputs(output, profile, testEntry);
+
+                    lastProgress = iteration;
+                }
+            }
+            else
+            {
+                const auto statusMask = 1U << static_cast<std::uint32_t>(output.status);
+                isNew = (seenStatuses & statusMask) == 0;
+                seenStatuses |= statusMask;
+
+                ExceptionType exceptionType = ExceptionType::None;
+                switch (output.status)
+                {
+                    case Execution::ExecutionStatus::ExceptionIntDivideError:
+                        exceptionType = ExceptionType::DivideError;
+                        break;
+                    case Execution::ExecutionStatus::ExceptionIntOverflow:
+                        exceptionType = ExceptionType::IntegerOverflow;
+                        break;
+                    case Execution::ExecutionStatus::IllegalInstruction:
+                        illegalInstr = true;
+                        break;
+                }
+
+                // Unexpected exceptions are ignored.
+                for (std::size_t j = 0; j < testMatrix.size(); ++j)
+                {
+                    if (satisfiedAt[j] != 0 || testMatrix[j].exceptionType != exceptionType
+                        || exceptionType == ExceptionType::None)
+                        continue;
+
+                    markSatisfied(j, iteration);
+                    numRemainingExceptions--;
+
+                    auto& testEntry = testCase.entries.emplace_back();
+                    captureInputs(input, batchFlags[i], profile, testEntry);
+                    testEntry.exceptionType = exceptionType;
+
+                    lastProgress = iteration;
+                    break;
+                }
+            }
+
+            if (useFeedback && isNew)
+                addToCorpus(corpus, input, profile, corpusInput);
+
+            if (iteration - lastProgress > getAbortWindow(lastProgress, maxAttempts))
+            {
+                aborted = true;
+                break;
+            }
+        }
+
+        batchSize = std::min(batchSize * 2, kMaxExecutionBatchSize);
+    }
+
+    if (illegalInstr)
+    {
+        Logging::println("Illegal instruction: {}", instr.text);
+        testCase.illegalInstruction = true;
+    }
+    else if (aborted)
+    {
+        // Probably impossible.
+        for (std::size_t i = 0; i < testMatrix.size(); ++i)
+        {
+            if (satisfiedAt[i] != 0)
+                continue;
+
+            Logging::println("Test probably impossible: {} ; {}", instr.text, getTestInfo(testMatrix[i]));
+            Profiling::add(Profiling::Counter::BitsAborted);
+        }
+    }
+
+    // Without the pruning and the adaptive window any entry left open keeps the search running until maxAttempts
+    // iterations after the last progress.
+    if (!illegalInstr && (numPruned != 0 || aborted))
+    {
+        const auto fixedEnd = lastProgress + maxAttempts + 1;
+        if (fixedEnd > iteration)
+            Profiling::add(Profiling::Counter::ExecutionsSaved, fixedEnd - iteration);
+    }
+
+    const auto cycles = Profiling::readTsc() - timeStart;
+    Profiling::add(Profiling::Counter::InstructionCycles, cycles);
+
+    if (search.collectProfile)
+    {
+        auto& workerProfile = workerProfiles.local();
+
+        auto& instrCost = workerProfile.instrs.emplace_back();
+        instrCost.text = instr.text;
+        instrCost.cycles = cycles;
+        instrCost.iterations = iteration;
+        instrCost.numBits = testMatrix.size();
+
+        // Bits that were never satisfied ran for all iterations, an illegal instruction has no meaningful bits.
+        auto& slowestBits = workerProfile.slowestBits;
+        for (std::size_t i = 0; i < testMatrix.size() && !illegalInstr; ++i)
+        {
+            const auto bitAborted = satisfiedAt[i] == 0;
+            const auto bitIterations = bitAborted ? iteration : satisfiedAt[i];
+            instrCost.numAborted += bitAborted ? 1 : 0;
+
+            if (slowestBits.size() >= kProfileReportSize && bitIterations <= slowestBits.front().iterations)
+                continue;
+
+            slowestBits.push_back({ instr.text, getTestInfo(testMatrix[i]), bitIterations, bitAborted });
+            std::push_heap(slowestBits.begin(), slowestBits.end(), isCheaperBit);
+            if (slowestBits.size() > kProfileReportSize)
+            {
+                std::pop_heap(slowestBits.begin(), slowestBits.end(), isCheaperBit);
+                slowestBits.pop_back();
+            }
+        }
+    }
+}
+
+// Rough relative cost of testing an instruction, only used to order the work.
+static std::size_t estimateTestCost(const ZydisDisassembledInstruction& instr)
+{
+    // Every matrix entry is a separate search for inputs.
+    std::size_t cost = generateTestMatrix(instr).size();
+
+    // Bits that depend on an immediate are frequently impossible and run into the abort threshold.
+    if (isInputFromImmediate(instr))
+        cost *= 4;
+
+    // Exceptions need very specific inputs, DIV/IDIV are the worst offenders.
+    if (!getExceptions(instr).empty())
+        cost *= 16;
+
+    // Wider operands have more bits that require specific carries/borrows.
+    cost *= 1 + instr.info.operand_width / 32;
+
+    return cost;
+}
+
+// Also puts the entries into their serialized order.
+static void removeDuplicateEntries(InstrTestGroup& testGroup)
+{
+    std::sort(testGroup.entries.begin(), testGroup.entries.end());
+
+    auto last = std::unique(testGroup.entries.begin(), testGroup.entries.end());
+    testGroup.entries.erase(last, testGroup.entries.end());
+}
+
+static InstrTestGroup generateInstructionTestData(
+    ZydisMachineMode mode, const std::span<const uint8_t> instrData, SearchContext& search)
+{
+    InstrTestGroup testCase{};
+    testCase.instrData = instrData;
+
+    testInstruction(mode, testCase, search);
+    removeDuplicateEntries(testCase);
+
+    return testCase;
+}
+
+static ZydisDisassembledInstruction disassembleInstruction(
+    ZydisMachineMode mode, const std::span<const std::uint8_t> instrData, std::uint64_t address)
+{
+    ZydisDisassembledInstruction instr{};
+    ZydisDisassembleIntel(mode, address, instrData.data(), instrData.size(), &instr);
+    return instr;
+}
+
+static std::filesystem::path getPathForMnemonic(const OutputTarget& output, ZydisMnemonic mnemonic)
+{
+    const auto& outputPath = output.directory;
+
+    if (!std::filesystem::exists(outputPath))
+    {
+        // Another pipeline stage may have created it in the meantime.
+        std::error_code ec;
+        if (!std::filesystem::create_directories(outputPath, ec) && !std::filesystem::exists(outputPath))
+        {
+            std::print("Failed to create output directory\n");
+            std::abort();
+        }
+    }
+
+    const auto* extension = output.format == OutputFormat::Text ? ".txt" : ".bin";
+    const auto filePath = outputPath / (ZydisMnemonicGetString(mnemonic) + std::string(extension));
+    return filePath;
+}
+
+// Upper bound for most groups so the buffer is allocated once.
+static std::size_t estimateTextSize(std::span<const InstrTestGroup> entries)
+{
+    const auto getRegsSize = [](const auto& regs) {
+        std::size_t size = 0;
+        for (const auto& [reg, data] : regs)
+        {
+            size += 16 + data.size() * 2;
+        }
+        return size;
+    };
+
+    std::size_t size = 0;
+    for (const auto& entry : entries)
+    {
+        size += 48 + entry.instrData.size() * 2 + entry.text.size();
+        for (const auto& testEntry : entry.entries)
+        {
+            size += 64 + getRegsSize(testEntry.inputRegs) + getRegsSize(testEntry.outputRegs);
+        }
+    }
+    return size;
+}
+
+static std::string_view getExceptionString(ExceptionType exception)
+{
+    switch (exception)
+    {
+        case ExceptionType::None:
+            return "NONE";
+        case ExceptionType::DivideError:
+            return "INT_DIVIDE_ERROR";
+        case ExceptionType::IntegerOverflow:
+            return "INT_OVERFLOW";
+    }
+    return "<ERROR>";
+}
+
+static void formatTestGroupText(std::string& buffer, const InstrTestGroup& testGroup)
+{
+    auto out = std::back_inserter(buffer);
+
+    const auto formatRegs = [&](const auto& regs, std::optional<std::uint32_t> flags) {
+        auto num = 0;
+        for (const auto& [reg, data] : regs)
+        {
+            std::format_to(out, "{}{}:#", num > 0 ? "," : "", TestData::getRegisterName(reg));
+            Utils::hexEncodeTo(buffer, { data.data(), data.size() });
+            num++;
+        }
+
+        if (flags)
+        {
+            std::array<std::uint8_t, 4> flagsHex{};
+            std::memcpy(flagsHex.data(), &flags.value(), 4);
+            std::format_to(out, "{}flags:#", num > 0 ? "," : "");
+            Utils::hexEncodeTo(buffer, flagsHex);
+        }
+
+        return num;
+    };
+
+    std::format_to(out, "instr:0x{:X};#", testGroup.address);
+    Utils::hexEncodeTo(buffer, testGroup.instrData);
+    std::format_to(out, ";{};{}\n", testGroup.text, testGroup.entries.size());
+
+    for (const auto& entry : testGroup.entries)
+    {
+        buffer += " in:";
+        const auto numIn = formatRegs(entry.inputRegs, entry.inputFlags);
+
+        buffer += numIn > 0 ? "|out:" : "out:";
+        formatRegs(entry.outputRegs, entry.outputFlags);
+
+        if (entry.exceptionType)
+        {
+            std::format_to(out, "|exception:{}", getExceptionString(*entry.exceptionType));
+        }
+
+        buffer += '\n';
+    }
+}
+
+static bool serializeTestEntriesText(
+    const OutputTarget& output, ZydisMnemonic mnemonic, std::span<const InstrTestGroup> entries)
+{
+    const auto filePath = getPathForMnemonic(output, mnemonic);
+
+    std::string buffer;
+    buffer.reserve(estimateTextSize(entries));
+
+    for (const auto& entry : entries)
+    {
+        formatTestGroupText(buffer, entry);
+    }
+
+    std::ofstream file(filePath);
+    if (!file)
+    {
+        std::print("Failed to open file for writing\n");
+        return false;
+    }
+
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return static_cast<bool>(file);
+}
+
+template<typename TWriter> static bool addTestGroup(TWriter& writer, const InstrTestGroup& testGroup)
+{
+    const auto toRegValues = [](const auto& regs) {
+        sfl::small_vector<TestData::RegValue, 4> res;
+        for (const auto& [reg, data] : regs)
+        {
+            res.push_back({ reg, { data.data(), data.size() } });
+        }
+        return res;
+    };
+
+    if (!writer.beginInstruction(testGroup.address, testGroup.instrData))
+        return false;
+
+    for (const auto& entry : testGroup.entries)
+    {
+        const auto inputs = toRegValues(entry.inputRegs);
+        const auto outputs = toRegValues(entry.outputRegs);
+        if (!writer.addEntry(
+                { inputs.data(), inputs.size() }, entry.inputFlags, { outputs.data(), outputs.size() },
+                entry.outputFlags, entry.exceptionType))
+            return false;
+    }
+
+    return true;
+}
+
+static bool serializeTestEntriesBinary(
+    const OutputTarget& output, ZydisMachineMode mode, ZydisMnemonic mnemonic, std::span<const InstrTestGroup> entries)
+{
+    const auto filePath = getPathForMnemonic(output, mnemonic);
+
+    TestData::Writer writer(mode, mnemonic);
+    for (const auto& entry : entries)
+    {
+        if (!addTestGroup(writer, entry))
+            return false;
+    }
+
+    if (!writer.writeToFile(filePath))
+    {
+        std::print("Failed to open file for writing\n");
+        return false;
+    }
+
+    return true;
+}
+
+static bool serializeTestEntries(
+    const OutputTarget& output, ZydisMachineMode mode, ZydisMnemonic mnemonic, std::span<const InstrTestGroup> entries)
+{
+    if (output.format == OutputFormat::Text)
+        return serializeTestEntriesText(output, mnemonic, entries);
+    return serializeTestEntriesBinary(output, mode, mnemonic, entries);
+}
+
+// The instruction data points into the view.
+static InstrTestGroup readTestGroup(const TestData::InstrView& instr)
+{
+    InstrTestGroup testGroup{};
+    testGroup.address = instr.getAddress();
+    testGroup.instrData = instr.getBytes();
+
+    const auto toRegTestData = [](const TestData::RegValue& value) {
+        return RegTestData(value.data.begin(), value.data.end());
+    };
+
+    for (const auto entryView : instr)
+    {
+        auto& entry = testGroup.entries.emplace_back();
+        for (std::size_t i = 0; i < entryView.getInputCount(); ++i)
+        {
+            const auto value = entryView.getInput(i);
+            entry.inputRegs.insert({ value.reg, toRegTestData(value) });
+        }
+        for (std::size_t i = 0; i < entryView.getOutputCount(); ++i)
+        {
+            const auto value = entryView.getOutput(i);
+            entry.outputRegs.insert({ value.reg, toRegTestData(value) });
+        }
+        entry.inputFlags = entryView.getInputFlags();
+        entry.outputFlags = entryView.getOutputFlags();
+        entry.exceptionType = entryView.getException();
+    }
+
+    return testGroup;
+}
+
+// Every output directory has its own cache, shards running on the same machine don't drop each other's records.
+static std::filesystem::path getCachePathForMnemonic(const std::filesystem::path& outputPath, ZydisMnemonic mnemonic)
+{
+    const auto cachePath = outputPath / "cache";
+
+    if (!std::filesystem::exists(cachePath))
+    {
+        std::error_code ec;
+        if (!std::filesystem::create_directories(cachePath, ec) && !std::filesystem::exists(cachePath))
+        {
+            std::print("Failed to create cache directory\n");
+            std::abort();
+        }
+    }
+
+    return cachePath / (ZydisMnemonicGetString(mnemonic) + std::string(".journal"));
+}
+
+// FNV-1a
+static std::uint64_t hashBytes(std::uint64_t hash, const void* data, std::size_t size)
+{
+    const auto* bytes = static_cast<const std::uint8_t*>(data);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+template<typename T> static std::uint64_t hashValue(std::uint64_t hash, const T& value)
+{
+    static_assert(std::is_integral_v<T> || std::is_enum_v<T>);
+    return hashBytes(hash, &value, sizeof(T));
+}
+
+// Everything the results of an instruction depend on, a change in any of them invalidates the cached results.
+static std::uint64_t getResultCacheKey(
+    ZydisMachineMode mode, std::span<const std::uint8_t> instrData, const SearchContext& search)
+{
+    const auto instr = disassembleInstruction(mode, instrData, 0);
+
+    std::uint64_t hash = 0xCBF29CE484222325ULL;
+    hash = hashValue(hash, kResultCacheVersion);
+    hash = hashValue(hash, Generator::kInputGeneratorVersion);
+    hash = hashValue(hash, getInstrSeed(instr, instrData));
+    hash = hashValue(hash, mode);
+    hash = hashValue(hash, search.useFeedback);
+    hash = hashValue(hash, kMinAbortWindow);
+    hash = hashValue(hash, kAbortWindowFactor);
+    // The corpus is only updated between batches, the batch schedule decides which inputs are found.
+    hash = hashValue(hash, kMaxExecutionBatchSize);
+    hash = hashValue(hash, kMaxConstructAttempts);
+    // Decide the addresses of memory operands.
+    hash = hashValue(hash, kMaxMemIndex);
+    hash = hashValue(hash, Execution::kDataWindowSize);
+    hash = hashBytes(hash, instrData.data(), instrData.size());
+
+    for (const auto& testBitInfo : generateTestMatrix(instr))
+    {
+        hash = hashValue(hash, testBitInfo.exceptionType);
+        hash = hashValue(hash, testBitInfo.reg);
+        hash = hashValue(hash, testBitInfo.bitPos);
+        hash = hashValue(hash, testBitInfo.expectedBitValue);
+    }
+
+    return hash;
+}
+
+// Journal of finished instructions of a mnemonic, every result is appended as soon as it is done so an
+// interrupted run loses nothing and a rerun only executes instructions whose key changed. Each record
+// is a complete binary test data file for a single instruction.
+class ResultCache
+{
+    struct RecordHeader
+    {
+        std::uint64_t key;
+        std::uint32_t size;
+        std::uint32_t flags;
+    };
+
+    static constexpr std::uint32_t kRecordIllegalInstruction = 1U << 0;
+
+    struct Record
+    {
+        std::uint32_t flags{};
+        std::vector<std::uint8_t> data;
+    };
+
+    ZydisMachineMode _mode{};
+    ZydisMnemonic _mnemonic{};
+    std::filesystem::path _path;
+    std::ofstream _file;
+
+    std::mutex _mutex;
+    std::unordered_map<std::uint64_t, Record> _records;
+    std::unordered_set<std::uint64_t> _usedKeys;
+    std::size_t _numHits{};
+
+public:
+    bool open(ZydisMachineMode mode, ZydisMnemonic mnemonic, const std::filesystem::path& outputPath)
+    {
+        _mode = mode;
+        _mnemonic = mnemonic;
+        _path = getCachePathForMnemonic(outputPath, mnemonic);
+
+        // A crash can leave a partial record at the end, everything before it is still good.
+        const auto complete = load();
+        if (!complete && !rewrite())
+            return false;
+
+        _file.open(_path, std::ios::binary | std::ios::app);
+        return static_cast<bool>(_file);
+    }
+
+    std::optional<InstrTestGroup> find(std::uint64_t key, std::span<const std::uint8_t> instrData)
+    {
+        std::lock_guard lock(_mutex);
+
+        const auto it = _records.find(key);
+        if (it == _records.end())
+            return std::nullopt;
+
+        TestData::FileView file;
+        if (!file.open(it->second.data) || file.getInstructionCount() != 1)
+            return std::nullopt;
+
+        const auto instr = file.getInstruction(0);
+        if (!std::ranges::equal(instr.getBytes(), instrData))
+            return std::nullopt;
+
+        // The record can be rewritten, keep referring to the caller's data.
+        auto testGroup = readTestGroup(instr);
+        testGroup.instrData = instrData;
+        testGroup.illegalInstruction = (it->second.flags & kRecordIllegalInstruction) != 0;
+
+        _usedKeys.insert(key);
+        _numHits++;
+
+        return testGroup;
+    }
+
+    void store(std::uint64_t key, const InstrTestGroup& testGroup)
+    {
+        if (testGroup.failed)
+            return;
+
+        TestData::Writer writer(_mode, _mnemonic);
+        if (!addTestGroup(writer, testGroup))
+            return;
+
+        Record record{};
+        record.flags = testGroup.illegalInstruction ? kRecordIllegalInstruction : 0;
+        record.data = writer.finish();
+
+        std::lock_guard lock(_mutex);
+
+        writeRecord(_file, key, record);
+        _file.flush();
+
+        _records[key] = std::move(record);
+        _usedKeys.insert(key);
+    }
+
+    std::size_t getHitCount() const
+    {
+        return _numHits;
+    }
+
+    // Drops the records of instructions that no longer exist or changed.
+    void close()
+    {
+        _file.close();
+
+        if (_usedKeys.size() == _records.size())
+            return;
+
+        std::erase_if(_records, [&](const auto& it) { return !_usedKeys.contains(it.first); });
+        rewrite();
+    }
+
+private:
+    static void writeRecord(std::ofstream& file, std::uint64_t key, const Record& record)
+    {
+        const RecordHeader header{ key, static_cast<std::uint32_t>(record.data.size()), record.flags };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(record.data.data()), static_cast<std::streamsize>(record.data.size()));
+    }
+
+    // Returns false if the journal ended with an incomplete record.
+    bool load()
+    {
+        std::ifstream file(_path, std::ios::binary);
+        if (!file)
+            return true;
+
+        const std::vector<std::uint8_t> data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+        std::size_t offset = 0;
+        while (offset < data.size())
+        {
+            RecordHeader header{};
+            if (data.size() - offset < sizeof(header))
+                return false;
+            std::memcpy(&header, data.data() + offset, sizeof(header));
+            offset += sizeof(header);
+
+            if (data.size() - offset < header.size)
+                return false;
+
+            Record record{};
+            record.flags = header.flags;
+            record.data.assign(data.begin() + offset, data.begin() + offset + header.size);
+            offset += header.size;
+
+            // Later records replace earlier ones.
+            _records[header.key] = std::move(record);
+        }
+
+        return true;
+    }
+
+    bool rewrite()
+    {
+        auto tempPath = _path;
+        tempPath += ".tmp";
+
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+
+            for (const auto& [key, record] : _records)
+            {
+                writeRecord(file, key, record);
+            }
+
+            if (!file)
+                return false;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tempPath, _path, ec);
+        return !ec;
+    }
+};
+
+// Has to happen once the address is known, relative branches are formatted with their target.
+static void setInstrInfo(ZydisMachineMode mode, InstrTestGroup& testGroup)
+{
+    const auto instr = disassembleInstruction(mode, testGroup.instrData, testGroup.address);
+    testGroup.mnemonic = instr.info.mnemonic;
+    testGroup.operandWidth = instr.info.operand_width;
+    testGroup.text = instr.text;
+}
+
+static InstrTestGroup getInstructionTestData(
+    ZydisMachineMode mode, std::span<const std::uint8_t> instrData, ResultCache& resultCache, SearchContext& search)
+{
+    const auto key = getResultCacheKey(mode, instrData, search);
+    if (auto cached = resultCache.find(key, instrData); cached.has_value())
+    {
+        setInstrInfo(mode, *cached);
+        return std::move(*cached);
+    }
+
+    auto testCase = generateInstructionTestData(mode, instrData, search);
+    resultCache.store(key, testCase);
+    setInstrInfo(mode, testCase);
+
+    return testCase;
+}
+
+static bool hasTestData([[maybe_unused]] const OutputTarget& output, [[maybe_unused]] ZydisMnemonic mnemonic)
+{
+#ifndef _DEBUG
+    if (std::filesystem::exists(getPathForMnemonic(output, mnemonic)))
+    {
+        Logging::println("Skipping \"{}\" as it already exists", ZydisMnemonicGetString(mnemonic));
+        return true;
+    }
+#endif
+    return false;
+}
+
+// Instruction indices with the most expensive ones first so the tail consists of cheap ones.
+static std::vector<std::size_t> getCostOrder(ZydisMachineMode mode, const InstructionEntries& instrs)
+{
+    std::vector<std::pair<std::size_t, std::size_t>> costOrder;
+    costOrder.reserve(instrs.size());
+    for (std::size_t i = 0; i < instrs.size(); ++i)
+    {
+        const auto instr = disassembleInstruction(mode, instrs.getEntry(i), 0);
+        costOrder.emplace_back(estimateTestCost(instr), i);
+    }
+    std::stable_sort(costOrder.begin(), costOrder.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<std::size_t> res;
+    res.reserve(costOrder.size());
+    for (const auto& [cost, index] : costOrder)
+    {
+        res.push_back(index);
+    }
+    return res;
+}
+
+static void writeTestGroups(
+    ZydisMachineMode mode, std::vector<InstrTestGroup>& testGroups, const OutputTarget& output)
+{
+    // Group by mnemonic and sort by operand width within, the bytes make the order independent of the
+    // order in which the workers finished.
+    std::sort(std::execution::par, testGroups.begin(), testGroups.end(), [](const auto& a, const auto& b) {
+        if (a.mnemonic != b.mnemonic)
+            return a.mnemonic < b.mnemonic;
+        if (a.operandWidth != b.operandWidth)
+            return a.operandWidth < b.operandWidth;
+        return std::ranges::lexicographical_compare(a.instrData, b.instrData);
+    });
+
+    std::vector<std::span<const InstrTestGroup>> mnemonicGroups;
+    for (auto it = testGroups.begin(); it != testGroups.end();)
+    {
+        const auto last = std::find_if(it, testGroups.end(), [&](const auto& g) { return g.mnemonic != it->mnemonic; });
+        mnemonicGroups.emplace_back(it, last);
+        it = last;
+    }
+
+    // Report results.
+    const auto totalTestEntries = std::transform_reduce(
+        std::execution::par, testGroups.begin(), testGroups.end(), std::size_t{}, std::plus<>{},
+        [](const auto& testGroup) { return testGroup.entries.size(); });
+    Logging::println("Total test cases: {}", totalTestEntries);
+
+    // Save to file, every mnemonic has its own file.
+    std::for_each(std::execution::par, mnemonicGroups.begin(), mnemonicGroups.end(), [&](const auto& entries) {
+        serializeTestEntries(output, mode, entries.front().mnemonic, entries);
+    });
+}
+
+static void reportBuildStats(const Generator::BuildStats& stats)
+{
+    Logging::println(
+        "Combinations: {}, invalid: {}, validity cache hits: {}, misses: {}", stats.numCombinations, stats.numInvalid,
+        stats.numCacheHits, stats.numCacheMisses);
+}
+
+static void openResultCache(
+    ResultCache& resultCache, ZydisMachineMode mode, ZydisMnemonic mnemonic, const OutputTarget& output)
+{
+    if (!resultCache.open(mode, mnemonic, output.directory))
+    {
+        Logging::println("Failed to open result cache for \"{}\", results are not kept", ZydisMnemonicGetString(mnemonic));
+    }
+}
+
+static void closeResultCache(ResultCache& resultCache, ZydisMnemonic mnemonic, std::size_t numInstrs)
+{
+    if (const auto numHits = resultCache.getHitCount(); numHits != 0)
+    {
+        Logging::println(
+            "Reused {} of {} \"{}\" instructions from the result cache", numHits, numInstrs,
+            ZydisMnemonicGetString(mnemonic));
+    }
+    resultCache.close();
+}
+
+// Keeps the instructions of this shard, the others are generated on other machines.
+static void selectShard(InstructionEntries& instrs, ZydisMnemonic mnemonic, const Shard& shard)
+{
+    if (shard.count <= 1)
+        return;
+
+    std::vector<uint32_t> entryOffsets;
+    for (std::size_t i = 0; i < instrs.entryOffsets.size(); ++i)
+    {
+        if (shard.contains(mnemonic, i))
+            entryOffsets.push_back(instrs.entryOffsets[i]);
+    }
+    instrs.entryOffsets = std::move(entryOffsets);
+}
+
+static void generateInstrTests(
+    Threading::ThreadPool& pool, ZydisMachineMode mode, ZydisMnemonic mnemonic, const OutputTarget& output,
+    const Shard& shard, SearchContext& search)
+{
+    if (hasTestData(output, mnemonic))
+        return;
+
+    const auto filter = Generator::Filter{}.addMnemonics(mnemonic);
+
+    Logging::startProgress("Building \"{}\" instruction combinations", ZydisMnemonicGetString(mnemonic));
+
+    Generator::BuildStats buildStats{};
+    auto instrs = Generator::buildInstructions(
+        mode, filter, true, [](auto curVal, auto maxVal) { Logging::updateProgress(curVal, maxVal); }, &buildStats);
+    selectShard(instrs, mnemonic, shard);
+
+    Logging::endProgress();
+
+    const auto numInstrs = instrs.size();
+    Logging::println("Total instructions: {}", numInstrs);
+    reportBuildStats(buildStats);
+
+    ResultCache resultCache;
+    openResultCache(resultCache, mode, mnemonic, output);
+
+    Logging::startProgress("Generating tests");
+    Logging::setProgressTotal(numInstrs);
+
+    std::vector<InstrTestGroup> testGroups;
+    std::mutex mtx;
+
+    std::vector<Threading::ThreadPool::Task> tasks;
+    tasks.reserve(numInstrs);
+    for (const auto index : getCostOrder(mode, instrs))
+    {
+        tasks.push_back([&, index](std::size_t) {
+            InstrTestGroup testCase = getInstructionTestData(mode, instrs.getEntry(index), resultCache, search);
+            if (!testCase.entries.empty() && !testCase.illegalInstruction)
+            {
+                std::lock_guard lock(mtx);
+                testGroups.push_back(std::move(testCase));
+            }
+            Logging::addProgress();
+        });
+    }
+
+    pool.run(std::move(tasks));
+
+    Logging::endProgress();
+
+    writeTestGroups(mode, testGroups, output);
+    closeResultCache(resultCache, mnemonic, numInstrs);
+}
+
+// Mnemonics that are encoded or being tested at the same time, bounds the memory of the pipeline.
+static constexpr std::size_t kPipelineDepth = 4;
+
+struct MnemonicJob
+{
+    ZydisMnemonic mnemonic{};
+    InstructionEntries instrs;
+    std::mutex mtx;
+    std::vector<InstrTestGroup> testGroups;
+    std::atomic<std::size_t> numRemaining{};
+    ResultCache resultCache;
+};
+
+// Encoding, execution and serialization overlap, while the tail of one mnemonic is still executing the
+// workers already pick up the instructions of the next one and finished mnemonics are written out in the
+// background.
+static void generateInstrTestsPipelined(
+    Threading::ThreadPool& pool, ZydisMachineMode mode, std::span<const ZydisMnemonic> mnemonics,
+    const OutputTarget& output, const Shard& shard, SearchContext& search)
+{
+    using JobPtr = std::shared_ptr<MnemonicJob>;
+
+    Threading::BoundedQueue<JobPtr> encodedJobs(kPipelineDepth);
+    Threading::BoundedQueue<JobPtr> finishedJobs(kPipelineDepth);
+    std::counting_semaphore<kPipelineDepth> jobSlots(kPipelineDepth);
+
+    Logging::startProgress("Generating tests");
+    Logging::setProgressTotal(mnemonics.size());
+
+    Generator::BuildStats totalBuildStats{};
+
+    std::thread encoder([&]() {
+        for (const auto mnemonic : mnemonics)
+        {
+            if (hasTestData(output, mnemonic))
+            {
+                Logging::addProgress();
+                continue;
+            }
+
+            auto job = std::make_shared<MnemonicJob>();
+            job->mnemonic = mnemonic;
+
+            Generator::BuildStats buildStats{};
+            job->instrs = Generator::buildInstructions(
+                mode, Generator::Filter{}.addMnemonics(mnemonic), true, {}, &buildStats);
+            selectShard(job->instrs, mnemonic, shard);
+            openResultCache(job->resultCache, mode, mnemonic, output);
+
+            totalBuildStats.numCombinations += buildStats.numCombinations;
+            totalBuildStats.numInvalid += buildStats.numInvalid;
+            totalBuildStats.numCacheHits += buildStats.numCacheHits;
+            totalBuildStats.numCacheMisses += buildStats.numCacheMisses;
+
+            if (!encodedJobs.push(std::move(job)))
+                break;
+        }
+        encodedJobs.close();
+    });
+
+    std::thread serializer([&]() {
+        JobPtr job;
+        while (finishedJobs.pop(job))
+        {
+            Logging::println(
+                "Completed \"{}\", {} instructions", ZydisMnemonicGetString(job->mnemonic), job->instrs.size());
+            writeTestGroups(mode, job->testGroups, output);
+            closeResultCache(job->resultCache, job->mnemonic, job->instrs.size());
+            job.reset();
+
+            jobSlots.release();
+            Logging::addProgress();
+        }
+    });
+
+    for (;;)
+    {
+        jobSlots.acquire();
+
+        JobPtr job;
+        if (!encodedJobs.pop(job))
+            break;
+
+        const auto numInstrs = job->instrs.size();
+        if (numInstrs == 0)
+        {
+            finishedJobs.push(std::move(job));
+            continue;
+        }
+
+        job->numRemaining = numInstrs;
+
+        std::vector<Threading::ThreadPool::Task> tasks;
+        tasks.reserve(numInstrs);
+        for (const auto index : getCostOrder(mode, job->instrs))
         {
-            if ((flagsRead & (1 << i)) != 0)
-            {
-                flags |= (prng() % 2) << i;
-            }
+            tasks.push_back([&, job, index](std::size_t) {
+                InstrTestGroup testCase = getInstructionTestData(
+                    mode, job->instrs.getEntry(index), job->resultCache, search);
+                if (!testCase.entries.empty() && !testCase.illegalInstruction)
+                {
+                    std::lock_guard lock(job->mtx);
+                    job->testGroups.push_back(std::move(testCase));
+                }
+
+                // The last instruction hands the mnemonic over to serialization.
+                if (--job->numRemaining == 0)
+                    finishedJobs.push(job);
+            });
         }
 
-        testEntry.inputFlags = flags;
+        pool.submit(std::move(tasks));
     }
 
-    // Ensure we never have TF set.
-    flags &= ~ZYDIS_CPUFLAG_TF;
+    encoder.join();
 
-    ctx.setRegValue(ZYDIS_REGISTER_EFLAGS, flags);
+    pool.wait();
+    finishedJobs.close();
+    serializer.join();
 
-#if defined(_DEBU) && 0
-    if (iteration >= kReportInputsThreshold)
-    {
-        std::string inputsStr;
-        for (const auto& [reg, data] : regData)
-        {
-            inputsStr += std::format("{}=#{} ", ZydisRegisterGetString(reg), Utils::hexEncode(data));
-        }
+    Logging::endProgress();
 
-        Logging::println("Test: {} - Inputs: {}", instr.text, inputsStr);
-    }
-#endif
+    reportBuildStats(totalBuildStats);
 }
 
-static void clearOutput(ZydisMachineMode mode, Execution::ScopedContext& ctx, const TestBitInfo& testBitInfo)
-{
-    uint8_t regBuf[256]{};
+// Instructions of a streamed mnemonic that are running or wait for their turn to be written, bounds the results
+// kept in memory independent of the number of instructions.
+static constexpr std::size_t kStreamWindow = 1024;
 
-    if (!isRegFiltered(testBitInfo.reg))
+// Output file of a single mnemonic that is appended to group by group. It is written under a temporary name and
+// only renamed once complete, an interrupted run doesn't leave a file behind that would be skipped next time.
+class TestGroupStream
+{
+    OutputFormat _format{};
+    std::filesystem::path _path;
+    std::filesystem::path _partialPath;
+    std::optional<TestData::StreamWriter> _writer;
+    std::ofstream _textFile;
+    std::string _buffer;
+    std::size_t _numGroups{};
+    std::size_t _numEntries{};
+    bool _ok{};
+
+public:
+    bool open(const OutputTarget& output, ZydisMachineMode mode, ZydisMnemonic mnemonic)
     {
-        const std::size_t regSize = ZydisRegisterGetWidth(mode, testBitInfo.reg) / 8;
-        const auto regOffset = getRegOffset(testBitInfo.reg);
+        _format = output.format;
+        _path = getPathForMnemonic(output, mnemonic);
+        _partialPath = _path;
+        _partialPath += ".partial";
 
-        for (std::size_t i = 0; i < regSize; ++i)
+        if (_format == OutputFormat::Text)
         {
-            if (testBitInfo.expectedBitValue == 0)
-                regBuf[i + regOffset] = 0xFF;
-            else
-                regBuf[i + regOffset] = 0;
+            _textFile.open(_partialPath, std::ios::trunc);
+            _ok = static_cast<bool>(_textFile);
+        }
+        else
+        {
+            _writer.emplace(mode, mnemonic);
+            _ok = _writer->open(_partialPath);
         }
 
-        const auto bigReg = getRootReg(mode, testBitInfo.reg);
-        const std::size_t bigRegSize = ZydisRegisterGetWidth(mode, bigReg) / 8;
-
-        ctx.setRegBytes(bigReg, std::span<const std::uint8_t>{ regBuf, bigRegSize });
+        if (!_ok)
+            std::print("Failed to open file for writing\n");
+        return _ok;
     }
 
-    // Clear flags.
-    std::uint32_t flags = 0;
-    if (testBitInfo.expectedBitValue == 0)
+    void write(const InstrTestGroup& testGroup)
     {
-        flags |= ZYDIS_CPUFLAG_CF | ZYDIS_CPUFLAG_PF | ZYDIS_CPUFLAG_AF | ZYDIS_CPUFLAG_ZF | ZYDIS_CPUFLAG_SF
-            | ZYDIS_CPUFLAG_OF;
-    }
-    else
-    {
-        flags = 0;
-    }
-    ctx.setRegValue(ZYDIS_REGISTER_EFLAGS, flags);
-}
-
-static bool checkOutputs(
-    ZydisMachineMode mode, Execution::ScopedContext& ctx, const ZydisDisassembledInstruction& instr,
-    const TestBitInfo& testBitInfo, TestCaseEntry& testEntry)
-{
-    const auto bigReg = getRootReg(mode, testBitInfo.reg);
+        if (!_ok)
+            return;
 
-    const auto regData = ctx.getRegBytes(bigReg);
-    const auto regOffset = getRegOffset(testBitInfo.reg);
+        if (_format == OutputFormat::Text)
+        {
+            _buffer.clear();
+            formatTestGroupText(_buffer, testGroup);
+            _textFile.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+            _ok = static_cast<bool>(_textFile);
+        }
+        else
+        {
+            _ok = addTestGroup(*_writer, testGroup);
+        }
 
-    // The raw memory of all registers are stored little endian so the first bit is in the last byte.
-    const auto byteOffset = regOffset + ((testBitInfo.bitPos / 8) ^ (sizeof(regData[0]) - 1));
-    const auto bitValue = (regData[byteOffset] >> (testBitInfo.bitPos % 8)) & 0x01;
+        _numGroups++;
+        _numEntries += testGroup.entries.size();
+    }
 
-    if (bitValue != testBitInfo.expectedBitValue)
+    std::size_t getEntryCount() const
     {
-        return false;
+        return _numEntries;
     }
 
-    // Capture output.
-    auto regsModified = getRegsModified(instr);
-    auto flagsModified = getFlagsModified(instr);
-
-    for (auto regModified : regsModified)
+    bool close()
     {
-        const auto bigReg = getRootReg(instr.info.machine_mode, regModified);
-        const auto bigSize = ZydisRegisterGetWidth(instr.info.machine_mode, bigReg);
+        if (_ok)
+        {
+            if (_format == OutputFormat::Text)
+            {
+                _textFile.close();
+                _ok = static_cast<bool>(_textFile);
+            }
+            else
+            {
+                _ok = _writer->close();
+            }
+        }
+
+        // Like writeTestGroups there is no file for a mnemonic without any results.
+        std::error_code ec;
+        if (_ok && _numGroups == 0)
+        {
+            std::filesystem::remove(_partialPath, ec);
+            return true;
+        }
 
-        const auto regData = ctx.getRegBytes(bigReg);
+        if (_ok)
+            std::filesystem::rename(_partialPath, _path, ec);
+        if (!_ok || ec)
+        {
+            std::print("Failed to write \"{}\"\n", _path.string());
+            std::filesystem::remove(_partialPath, ec);
+            return false;
+        }
 
-        testEntry.outputRegs[bigReg] = RegTestData{ regData.begin(), regData.begin() + (bigSize / 8) };
+        return true;
     }
+};
 
-    if (getFlagsModified(instr) != 0)
+// Hands finished groups to the stream in the order they were submitted. A group that finishes ahead of its
+// predecessors waits in its slot, every written group frees its entries and a slot of the window.
+class ReorderBuffer
+{
+    TestGroupStream& _stream;
+    std::counting_semaphore<kStreamWindow>& _windowSlots;
+    std::mutex _mutex;
+    std::vector<std::optional<InstrTestGroup>> _slots;
+    std::size_t _next{};
+
+public:
+    ReorderBuffer(TestGroupStream& stream, std::counting_semaphore<kStreamWindow>& windowSlots)
+        : _stream(stream)
+        , _windowSlots(windowSlots)
+        , _slots(kStreamWindow)
     {
-        testEntry.outputFlags = ctx.getRegValue<uint32_t>(ZYDIS_REGISTER_EFLAGS);
-
-        // Remove all flags that are not reported by Zydis.
-        const auto* cpuFlags = instr.info.cpu_flags;
-        *testEntry.outputFlags &= (cpuFlags->modified | cpuFlags->set_0 | cpuFlags->set_1 | cpuFlags->undefined);
     }
 
-    return true;
-}
-
-static std::string getTestInfo(const TestBitInfo& info)
-{
-    std::string res;
-    res = std::format("{}[{}] = 0b{}", ZydisRegisterGetString(info.reg), info.bitPos, info.expectedBitValue);
-    return res;
-}
+    // The position has to be within the window, which the caller ensures by taking a slot before submitting it.
+    void finish(std::size_t pos, InstrTestGroup testGroup)
+    {
+        std::lock_guard lock(_mutex);
 
-static std::vector<Generator::InputGenerator> setupInputGenerators(
-    std::mt19937_64& prng, const ZydisDisassembledInstruction& instr)
-{
-    std::vector<Generator::InputGenerator> generators;
+        _slots[pos % _slots.size()] = std::move(testGroup);
 
-    const auto regsRead = getRegsRead(instr);
+        // Writing under the lock keeps the order, it is short compared to the input search.
+        for (;;)
+        {
+            auto& slot = _slots[_next % _slots.size()];
+            if (!slot.has_value())
+                break;
 
-    // Generate input generators for registers.
-    for (const auto& reg : regsRead)
-    {
-        if (isRegFiltered(reg))
-            continue;
+            if (!slot->entries.empty() && !slot->illegalInstruction)
+                _stream.write(*slot);
+            slot.reset();
 
-        const auto regSize = ZydisRegisterGetWidth(instr.info.machine_mode, reg);
-        generators.emplace_back(regSize, prng);
+            _next++;
+            _windowSlots.release();
+        }
     }
+};
 
-    return generators;
-}
-
-static bool isInputFromImmediate(const ZydisDisassembledInstruction& instr)
+// Positions in the order of the output file, see writeTestGroups.
+static std::vector<std::size_t> getStreamOrder(ZydisMachineMode mode, const InstructionEntries& instrs)
 {
-    for (std::size_t i = 0; i < instr.info.operand_count; ++i)
+    std::vector<std::uint16_t> operandWidths(instrs.size());
+    for (std::size_t i = 0; i < instrs.size(); ++i)
     {
-        const auto& op = instr.operands[i];
-        if (op.type == ZYDIS_OPERAND_TYPE_IMMEDIATE)
-            return true;
+        operandWidths[i] = disassembleInstruction(mode, instrs.getEntry(i), 0).info.operand_width;
     }
-    return false;
+
+    std::vector<std::size_t> res(instrs.size());
+    std::iota(res.begin(), res.end(), std::size_t{});
+    std::stable_sort(res.begin(), res.end(), [&](auto a, auto b) {
+        if (operandWidths[a] != operandWidths[b])
+            return operandWidths[a] < operandWidths[b];
+        return std::ranges::lexicographical_compare(instrs.getEntry(a), instrs.getEntry(b));
+    });
+    return res;
 }
 
-static void testInstruction(ZydisMachineMode mode, InstrTestGroup& testCase)
+// Bounded memory variant of generateInstrTests for mnemonics with a huge number of instructions. Results are written
+// as soon as all instructions before them are done, at most kStreamWindow groups are kept in memory. The encodings
+// are still built up front, the duplicates are only known once all of them exist and they are small compared to
+// the results.
+static void generateInstrTestsStreamed(
+    Threading::ThreadPool& pool, ZydisMachineMode mode, ZydisMnemonic mnemonic, const OutputTarget& output,
+    const Shard& shard, SearchContext& search)
 {
-    auto& instrData = testCase.instrData;
-
-    ZydisDisassembledInstruction instr{};
-    ZydisDisassembleIntel(mode, 0, instrData.data(), instrData.size(), &instr);
-
-    const auto isInputImmediate = isInputFromImmediate(instr);
-    const auto maxAttempts = isInputImmediate ? kAbortTestCaseThreshold / 3 : kAbortTestCaseThreshold;
-
-    const auto regsRead = getRegsRead(instr);
-    const auto flagsRead = getFlagsRead(instr);
-
-    // TODO: Create a matrix to test all possible bits of registers and flags.
-    const auto testMatrix = generateTestMatrix(instr);
-
-    const auto timeStart = std::chrono::high_resolution_clock::now();
-
-    auto ctx = Execution::ScopedContext(mode, instrData);
-    if (!ctx)
-    {
-        Logging::println("Failed to prepare context");
+    if (hasTestData(output, mnemonic))
         return;
-    }
-
-    testCase.address = ctx.getCodeAddress();
-
-    const auto seed = static_cast<std::size_t>(instr.info.mnemonic);
-    std::mt19937_64 prng(seed);
-
-    for (const TestBitInfo& testBitInfo : testMatrix)
-    {
-        TestCaseEntry testEntry{};
 
-        auto inputGenerators = setupInputGenerators(prng, instr);
+    Logging::startProgress("Building \"{}\" instruction combinations", ZydisMnemonicGetString(mnemonic));
 
-        bool hasExpected = false;
-        bool illegalInstr = false;
+    Generator::BuildStats buildStats{};
+    auto instrs = Generator::buildInstructions(
+        mode, Generator::Filter{}.addMnemonics(mnemonic), true,
+        [](auto curVal, auto maxVal) { Logging::updateProgress(curVal, maxVal); }, &buildStats);
+    selectShard(instrs, mnemonic, shard);
 
-        std::size_t iteration = 0;
-        // Repeat this until expected bit is set.
-        while (!hasExpected && !illegalInstr)
-        {
-            // Ensure the output has the opposite value.
-            clearOutput(mode, ctx, testBitInfo);
-
-            // Assign inputs.
-            advanceInputs(ctx, prng, inputGenerators, instr, testEntry, iteration);
+    Logging::endProgress();
 
-            if (!ctx.execute())
-            {
-                Logging::println("Failed to execute instruction");
-                return;
-            }
+    const auto numInstrs = instrs.size();
+    Logging::println("Total instructions: {}", numInstrs);
+    reportBuildStats(buildStats);
 
-            ExceptionType exceptionType = ExceptionType::None;
-            if (auto status = ctx.getExecutionStatus(); status != Execution::ExecutionStatus::Success)
-            {
-                switch (status)
-                {
-                    case Execution::ExecutionStatus::ExceptionIntDivideError:
-                        exceptionType = ExceptionType::DivideError;
-                        break;
-                    case Execution::ExecutionStatus::ExceptionIntOverflow:
-                        exceptionType = ExceptionType::IntegerOverflow;
-                        break;
-                    case Execution::ExecutionStatus::IllegalInstruction:
-                        illegalInstr = true;
-                        break;
-                }
-                if (exceptionType != testBitInfo.exceptionType)
-                {
-                    // Unexpected exception, ignore.
-                    hasExpected = false;
-                }
-                else
-                {
-                    testEntry.exceptionType = exceptionType;
-                    hasExpected = true;
-                }
-            }
-            else
-            {
-                // If we expect an exception we don't care about the output.
-                if (testBitInfo.exceptionType == ExceptionType::None)
-                {
-                    hasExpected = checkOutputs(mode, ctx, instr, testBitInfo, testEntry);
-                }
-            }
+    TestGroupStream stream;
+    if (!stream.open(output, mode, mnemonic))
+        return;
 
-            iteration++;
+    ResultCache resultCache;
+    openResultCache(resultCache, mode, mnemonic, output);
 
-            if (iteration > maxAttempts)
-            {
-                // Probably impossible.
-                Logging::println("Test probably impossible: {} ; {}", instr.text, getTestInfo(testBitInfo));
-                break;
-            }
-        }
+    Logging::startProgress("Generating tests");
+    Logging::setProgressTotal(numInstrs);
 
-        if (illegalInstr)
-        {
-            Logging::println("Illegal instruction: {}", instr.text);
-            testCase.illegalInstruction = true;
-            break;
-        }
+    std::counting_semaphore<kStreamWindow> windowSlots(kStreamWindow);
+    ReorderBuffer reorderBuffer(stream, windowSlots);
 
-        if (hasExpected)
-        {
-            testCase.entries.push_back(std::move(testEntry));
-        }
+    const auto order = getStreamOrder(mode, instrs);
+    for (std::size_t pos = 0; pos < order.size(); ++pos)
+    {
+        windowSlots.acquire();
+
+        std::vector<Threading::ThreadPool::Task> tasks;
+        tasks.push_back([&, pos, index = order[pos]](std::size_t) {
+            auto testCase = getInstructionTestData(mode, instrs.getEntry(index), resultCache, search);
+            reorderBuffer.finish(pos, std::move(testCase));
+            Logging::addProgress();
+        });
+        pool.submit(std::move(tasks));
     }
 
-    const auto timeEnd = std::chrono::high_resolution_clock::now();
-    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(timeEnd - timeStart).count();
+    pool.wait();
 
-    // std::print("Completed testing of instruction: {}, matrix size: {}, elapsed in: {} ms.\n", instr.text,
-    // testMatrix.size(), elapsed);
+    Logging::endProgress();
+
+    Logging::println("Total test cases: {}", stream.getEntryCount());
+    stream.close();
+    closeResultCache(resultCache, mnemonic, numInstrs);
 }
 
-static InstrTestGroup generateInstructionTestData(ZydisMachineMode mode, const std::span<const uint8_t> instrData)
+// "k/N" on the command line, "k-of-N" as directory name.
+static std::optional<Shard> parseShard(std::string_view text, std::string_view separator)
 {
-    InstrTestGroup testCase{};
-    testCase.instrData = instrData;
-
-    testInstruction(mode, testCase);
-
-    // Remove duplicate entries.
-    std::sort(testCase.entries.begin(), testCase.entries.end());
+    const auto pos = text.find(separator);
+    if (pos == std::string_view::npos)
+        return std::nullopt;
+
+    const auto parseNumber = [](std::string_view str, std::uint32_t& value) {
+        const auto* last = str.data() + str.size();
+        const auto res = std::from_chars(str.data(), last, value);
+        return res.ec == std::errc{} && res.ptr == last;
+    };
 
-    auto last = std::unique(testCase.entries.begin(), testCase.entries.end());
-    testCase.entries.erase(last, testCase.entries.end());
+    Shard shard{};
+    if (!parseNumber(text.substr(0, pos), shard.index) || !parseNumber(text.substr(pos + separator.size()), shard.count)
+        || shard.index >= shard.count)
+        return std::nullopt;
 
-    return testCase;
+    return shard;
 }
 
-static ZydisDisassembledInstruction disassembleInstruction(
-    ZydisMachineMode mode, const std::span<const std::uint8_t> instrData, std::uint64_t address)
+static std::filesystem::path getShardPath(const std::filesystem::path& outputPath, const Shard& shard)
 {
-    ZydisDisassembledInstruction instr{};
-    ZydisDisassembleIntel(mode, address, instrData.data(), instrData.size(), &instr);
-    return instr;
+    return outputPath / "shards" / std::format("{}-of-{}", shard.index, shard.count);
 }
 
-static std::filesystem::path getPathForMnemonic(ZydisMnemonic mnemonic)
+// Combines the partial files of all shards into the final test data, the result is the same as generating
+// everything on one machine.
+static bool mergeShards(ZydisMachineMode mode, const OutputTarget& output)
 {
-    std::filesystem::path outputPath = "testdata";
+    const auto shardsPath = output.directory / "shards";
 
-    if (!std::filesystem::exists(outputPath))
+    std::vector<std::filesystem::path> shardPaths;
+    std::vector<bool> shardsFound;
+    std::error_code ec;
+    for (const auto& dirEntry : std::filesystem::directory_iterator(shardsPath, ec))
     {
-        if (!std::filesystem::create_directory(outputPath))
+        const auto shard = parseShard(dirEntry.path().filename().string(), "-of-");
+        if (!dirEntry.is_directory() || !shard.has_value())
+            continue;
+
+        if (shardsFound.empty())
+            shardsFound.resize(shard->count);
+        if (shard->count != shardsFound.size())
         {
-            std::print("Failed to create output directory\n");
-            std::abort();
+            Logging::println("Shards of different splits in \"{}\"", shardsPath.string());
+            return false;
         }
-    }
-
-    const auto filePath = outputPath / (ZydisMnemonicGetString(mnemonic) + std::string(".txt"));
-    return filePath;
-}
 
-static bool serializeTestEntries(ZydisMachineMode mode, ZydisMnemonic mnemonic, const std::vector<InstrTestGroup>& entries)
-{
-    const auto filePath = getPathForMnemonic(mnemonic);
+        shardsFound[shard->index] = true;
+        shardPaths.push_back(dirEntry.path());
+    }
 
-    std::ofstream file(filePath);
-    if (!file)
+    const auto numFound = static_cast<std::size_t>(std::ranges::count(shardsFound, true));
+    if (shardsFound.empty() || numFound != shardsFound.size())
     {
-        std::print("Failed to open file for writing\n");
+        Logging::println("Missing shards in \"{}\", found {} of {}", shardsPath.string(), numFound, shardsFound.size());
         return false;
     }
 
-    const auto getExceptionString = [](ExceptionType exception) -> std::string {
-        switch (exception)
+    // The partial files of a mnemonic have the same name in every shard, a shard without any results for it has none.
+    std::map<std::string, std::vector<std::filesystem::path>> partialFiles;
+    for (const auto& shardPath : shardPaths)
+    {
+        for (const auto& fileEntry : std::filesystem::directory_iterator(shardPath, ec))
         {
-            case ExceptionType::None:
-                return "NONE";
-            case ExceptionType::DivideError:
-                return "INT_DIVIDE_ERROR";
-            case ExceptionType::IntegerOverflow:
-                return "INT_OVERFLOW";
+            if (fileEntry.is_regular_file() && fileEntry.path().extension() == ".bin")
+                partialFiles[fileEntry.path().filename().string()].push_back(fileEntry.path());
         }
-        return "<ERROR>";
-    };
+    }
 
-    for (const auto& entry : entries)
+    for (const auto& [fileName, paths] : partialFiles)
     {
-        const auto instr = disassembleInstruction(mode, entry.instrData, entry.address);
-
-        std::print(
-            file, "instr:0x{:X};#{};{};{}\n", entry.address, Utils::hexEncode(entry.instrData), instr.text,
-            entry.entries.size());
-        for (const auto& entry : entry.entries)
+        // The groups refer to the instruction bytes in the mapped files.
+        std::vector<std::unique_ptr<TestData::MappedFile>> files;
+        std::vector<InstrTestGroup> testGroups;
+        for (const auto& path : paths)
         {
-            std::print(file, " in:");
-            auto numIn = 0;
-            for (const auto& [reg, data] : entry.inputRegs)
-            {
-                std::print(
-                    file, "{}{}:#{}", numIn > 0 ? "," : "", ZydisRegisterGetString(reg),
-                    Utils::hexEncode({ data.data(), data.size() }));
-                numIn++;
-            }
+            auto& file = files.emplace_back(std::make_unique<TestData::MappedFile>());
 
-            if (entry.inputFlags)
+            TestData::FileView view;
+            if (!file->open(path) || !view.open(file->getData()) || view.getMachineMode() != mode)
             {
-                std::array<std::uint8_t, 4> flagsHex{};
-                std::memcpy(flagsHex.data(), &entry.inputFlags.value(), 4);
-                std::print(file, "{}flags:#{}", numIn > 0 ? "," : "", Utils::hexEncode(flagsHex));
+                Logging::println("Failed to read \"{}\"", path.string());
+                return false;
             }
 
-            std::print(file, "{}out:", numIn > 0 ? "|" : "");
-            auto numOut = 0;
-            for (const auto& [reg, data] : entry.outputRegs)
+            for (std::size_t i = 0; i < view.getInstructionCount(); ++i)
             {
-                std::print(
-                    file, "{}{}:#{}", numOut > 0 ? "," : "", ZydisRegisterGetString(reg),
-                    Utils::hexEncode({ data.data(), data.size() }));
-                numOut++;
+                testGroups.push_back(readTestGroup(view.getInstruction(i)));
             }
+        }
 
-            if (entry.outputFlags)
-            {
-                std::array<std::uint8_t, 4> flagsHex{};
-                std::memcpy(flagsHex.data(), &entry.outputFlags.value(), 4);
-                std::print(file, "{}flags:#{}", numOut > 0 ? "," : "", Utils::hexEncode(flagsHex));
-            }
+        // An instruction is only generated by a single shard, partial files from an earlier run can still have it.
+        std::sort(testGroups.begin(), testGroups.end(), [](const auto& a, const auto& b) {
+            return std::ranges::lexicographical_compare(a.instrData, b.instrData);
+        });
 
-            if (entry.exceptionType)
+        std::vector<InstrTestGroup> mergedGroups;
+        for (auto& testGroup : testGroups)
+        {
+            if (!mergedGroups.empty() && std::ranges::equal(mergedGroups.back().instrData, testGroup.instrData))
             {
-                std::print(file, "|exception:{}", getExceptionString(*entry.exceptionType));
+                auto& entries = mergedGroups.back().entries;
+                entries.insert(
+                    entries.end(), std::make_move_iterator(testGroup.entries.begin()),
+                    std::make_move_iterator(testGroup.entries.end()));
+                continue;
             }
-
-            std::print(file, "\n");
+            mergedGroups.push_back(std::move(testGroup));
         }
+
+        std::for_each(std::execution::par, mergedGroups.begin(), mergedGroups.end(), [&](auto& testGroup) {
+            removeDuplicateEntries(testGroup);
+            setInstrInfo(mode, testGroup);
+        });
+
+        Logging::println(
+            "Merged \"{}\", {} instructions from {} shards", std::filesystem::path(fileName).stem().string(),
+            mergedGroups.size(), paths.size());
+        writeTestGroups(mode, mergedGroups, output);
     }
 
     return true;
 }
 
-static void generateInstrTests(ZydisMachineMode mode, ZydisMnemonic mnemonic)
+static void reportWorkerStats(const Threading::ThreadPool& pool)
 {
-#ifndef _DEBUG
-    const auto filePath = getPathForMnemonic(static_cast<ZydisMnemonic>(mnemonic));
-
-    if (std::filesystem::exists(filePath))
+    const auto stats = pool.getStats();
+    for (std::size_t i = 0; i < stats.size(); ++i)
     {
-        std::print("Skipping \"{}\" as it already exists\n", ZydisMnemonicGetString(static_cast<ZydisMnemonic>(mnemonic)));
-        return;
+        const auto& workerStats = stats[i];
+        Logging::println(
+            "Worker {:2}: {:6} tasks, {:6} stolen, busy {:%T}, utilization {:.1f}%", i, workerStats.tasksExecuted,
+            workerStats.tasksStolen, std::chrono::duration_cast<std::chrono::milliseconds>(workerStats.busyTime),
+            workerStats.getUtilization() * 100.0);
     }
-#endif
+}
 
-    const auto filter = Generator::Filter{}.addMnemonics(mnemonic);
+static double getRatio(double value, double count)
+{
+    return count != 0.0 ? value / count : 0.0;
+}
 
-    Logging::startProgress(
-        "Building \"{}\" instruction combinations", ZydisMnemonicGetString(static_cast<ZydisMnemonic>(mnemonic)));
+static void reportSearchStats(const SearchContext& search, const Profiling::Totals& totals)
+{
+    const auto get = [&](Profiling::Counter counter) { return totals[static_cast<std::size_t>(counter)]; };
+
+    const auto numSatisfied = get(Profiling::Counter::BitsSatisfied);
+    Logging::println(
+        "Search: {} bits satisfied, {:.1f} iterations on average, {} bits aborted, feedback {}", numSatisfied,
+        getRatio(get(Profiling::Counter::IterationsToSatisfy), numSatisfied), get(Profiling::Counter::BitsAborted),
+        search.useFeedback ? "on" : "off");
+    Logging::println(
+        "Pruning: {} bits proven impossible, {} executions saved", get(Profiling::Counter::BitsPruned),
+        get(Profiling::Counter::ExecutionsSaved));
+}
 
-    const auto instrs = Generator::buildInstructions(
-        mode, filter, true, [](auto curVal, auto maxVal) { Logging::updateProgress(curVal, maxVal); });
+static void reportExecutionStats(const Profiling::Totals& totals)
+{
+    const auto get = [&](Profiling::Counter counter) { return totals[static_cast<std::size_t>(counter)]; };
+    const auto toMs = [](std::uint64_t cycles) { return Profiling::cyclesToMilliseconds(cycles); };
+
+    const auto numPrepares = get(Profiling::Counter::Prepares);
+    const auto numExecutions = get(Profiling::Counter::Executions);
+    Logging::println(
+        "Execution: {} prepares, {:.3f} ms each, {} executions in {} calls, {:.0f} ns each", numPrepares,
+        getRatio(toMs(get(Profiling::Counter::PrepareCycles)), numPrepares), numExecutions,
+        get(Profiling::Counter::ExecuteCalls), getRatio(toMs(get(Profiling::Counter::ExecuteCycles)) * 1e6, numExecutions));
+    Logging::println(
+        "Exceptions: {} divide errors, {} integer overflows, {} illegal instructions, {} access violations",
+        get(Profiling::Counter::DivideErrors), get(Profiling::Counter::IntOverflows),
+        get(Profiling::Counter::IllegalInstructions), get(Profiling::Counter::AccessViolations));
+
+    // Where the time of the search itself goes, the remainder is setup and bookkeeping of the matrix.
+    const auto instrCycles = get(Profiling::Counter::InstructionCycles);
+    Logging::println(
+        "Search time: {:.0f} ms for {} instructions, {:.1f}% execution, {:.1f}% inputs, {:.1f}% matching, "
+        "{:.1f}% prepare, {:.1f} iterations per matrix bit",
+        toMs(instrCycles), get(Profiling::Counter::InstructionsTested),
+        getRatio(get(Profiling::Counter::ExecuteCycles), instrCycles) * 100.0,
+        getRatio(get(Profiling::Counter::InputCycles), instrCycles) * 100.0,
+        getRatio(get(Profiling::Counter::MatchCycles), instrCycles) * 100.0,
+        getRatio(get(Profiling::Counter::PrepareCycles), instrCycles) * 100.0,
+        getRatio(numExecutions, get(Profiling::Counter::MatrixBits)));
+}
 
-    Logging::endProgress();
+static std::string escapeJson(std::string_view text)
+{
+    std::string res;
+    res.reserve(text.size());
+    for (const auto c : text)
+    {
+        if (c == '"' || c == '\\')
+            res.push_back('\\');
+        res.push_back(c);
+    }
+    return res;
+}
 
-    const auto numInstrs = instrs.entryOffsets.size();
-    Logging::println("Total instructions: {}", numInstrs);
+static bool writeProfile(
+    const std::filesystem::path& filePath, const Profiling::Totals& totals, std::span<const InstrCost> instrs,
+    std::span<const BitCost> bits)
+{
+    std::string out = std::format("{{\n  \"tscFrequency\": {:.0f},\n  \"counters\": {{", Profiling::getTscFrequency());
+    for (std::size_t i = 0; i < totals.size(); ++i)
+    {
+        const auto name = Profiling::getCounterName(static_cast<Profiling::Counter>(i));
+        out += std::format("{}\n    \"{}\": {}", i != 0 ? "," : "", name, totals[i]);
+    }
 
-    Logging::startProgress("Generating tests");
+    out += "\n  },\n  \"instructions\": [";
+    for (std::size_t i = 0; i < instrs.size(); ++i)
+    {
+        const auto& instr = instrs[i];
+        out += std::format(
+            "{}\n    {{ \"text\": \"{}\", \"cycles\": {}, \"iterations\": {}, \"bits\": {}, \"aborted\": {} }}",
+            i != 0 ? "," : "", escapeJson(instr.text), instr.cycles, instr.iterations, instr.numBits, instr.numAborted);
+    }
 
-    std::vector<InstrTestGroup> testGroups;
-    std::mutex mtx;
-    std::atomic<size_t> curInstr = 0;
+    out += "\n  ],\n  \"slowestBits\": [";
+    for (std::size_t i = 0; i < bits.size(); ++i)
+    {
+        const auto& bit = bits[i];
+        out += std::format(
+            "{}\n    {{ \"instruction\": \"{}\", \"bit\": \"{}\", \"iterations\": {}, \"aborted\": {} }}",
+            i != 0 ? "," : "", escapeJson(bit.instrText), escapeJson(bit.bitInfo), bit.iterations, bit.aborted);
+    }
+    out += "\n  ]\n}\n";
 
-    instrs.forEachParallel([&](auto&& instrData) {
-        //
-        InstrTestGroup testCase = generateInstructionTestData(mode, instrData);
-        if (!testCase.entries.empty() && !testCase.illegalInstruction)
-        {
-            std::lock_guard lock(mtx);
-            testGroups.push_back(std::move(testCase));
-        }
-        Logging::updateProgress(++curInstr, numInstrs);
-    });
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file)
+        return false;
 
-    Logging::endProgress();
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    return static_cast<bool>(file);
+}
 
-    // Sort the groups by instruction operand width.
-    std::sort(testGroups.begin(), testGroups.end(), [mode](const auto& a, const auto& b) {
-        const auto instA = disassembleInstruction(mode, a.instrData, a.address);
-        const auto instB = disassembleInstruction(mode, b.instrData, b.address);
-        return instA.info.operand_width < instB.info.operand_width;
+// The most expensive instructions and bits, everything else goes into the dump next to the test data.
+static void reportProfile(const OutputTarget& output, const Profiling::Totals& totals)
+{
+    std::vector<InstrCost> instrs;
+    std::vector<BitCost> bits;
+    workerProfiles.forEach([&](const WorkerProfile& workerProfile) {
+        instrs.insert(instrs.end(), workerProfile.instrs.begin(), workerProfile.instrs.end());
+        bits.insert(bits.end(), workerProfile.slowestBits.begin(), workerProfile.slowestBits.end());
     });
 
-    // Group the test cases by instruction.
-    std::map<ZydisMnemonic, std::vector<InstrTestGroup>> testGroupsMap;
-    for (auto& testGroup : testGroups)
-    {
-        const auto instr = disassembleInstruction(mode, testGroup.instrData, testGroup.address);
+    std::sort(instrs.begin(), instrs.end(), [](const auto& a, const auto& b) { return a.cycles > b.cycles; });
+    std::sort(bits.begin(), bits.end(), isCheaperBit);
+    bits.resize(std::min(bits.size(), kProfileReportSize));
 
-        auto it = testGroupsMap.find(instr.info.mnemonic);
-        if (it != testGroupsMap.end())
-        {
-            it->second.push_back(std::move(testGroup));
-            continue;
-        }
-        else
-        {
-            testGroupsMap.insert({ instr.info.mnemonic, { std::move(testGroup) } });
-        }
+    Logging::println("Most expensive instructions:");
+    for (const auto& instr : std::span(instrs).first(std::min(instrs.size(), kProfileReportSize)))
+    {
+        Logging::println(
+            "  {:10.1f} ms {:8} iterations {:4} bits {:4} aborted  {}", Profiling::cyclesToMilliseconds(instr.cycles),
+            instr.iterations, instr.numBits, instr.numAborted, instr.text);
     }
 
-    // Report results.
-    size_t totalTestEntries = 0;
-    for (const auto& [mnemonic, testGroups] : testGroupsMap)
+    Logging::println("Most expensive bits:");
+    for (const auto& bit : bits)
     {
-        for (auto& testGroup : testGroups)
-        {
-            totalTestEntries += testGroup.entries.size();
-        }
+        Logging::println(
+            "  {:8} iterations{}  {} ; {}", bit.iterations, bit.aborted ? " (aborted)" : "", bit.instrText, bit.bitInfo);
     }
-    Logging::println("Total test cases: {}", totalTestEntries);
 
-    // Save to file.
-    for (const auto& [mnemonic, testGroups] : testGroupsMap)
+    // Before anything was generated the directory may not exist yet.
+    std::error_code ec;
+    std::filesystem::create_directories(output.directory, ec);
+
+    const auto filePath = output.directory / "profile.json";
+    if (!writeProfile(filePath, totals, instrs, bits))
     {
-        serializeTestEntries(mode, mnemonic, { testGroups });
+        Logging::println("Failed to write \"{}\"", filePath.string());
+        return;
     }
+    Logging::println("Profile written to \"{}\"", filePath.string());
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    OutputTarget output;
+    Shard shard;
+    bool merge = false;
+    bool stream = false;
+    SearchContext search;
+    for (int i = 1; i < argc; ++i)
+    {
+        const auto arg = std::string_view(argv[i]);
+        if (arg == "merge")
+            merge = true;
+        else if (arg == "--text")
+            output.format = OutputFormat::Text;
+        else if (arg == "--no-feedback")
+            search.useFeedback = false;
+        else if (arg == "--profile")
+            search.collectProfile = true;
+        else if (arg == "--stream")
+            stream = true;
+        else if (arg == "--shard" && i + 1 < argc)
+        {
+            const auto parsed = parseShard(argv[++i], "/");
+            if (!parsed.has_value())
+            {
+                Logging::println("Invalid shard \"{}\", expected k/N with k < N", argv[i]);
+                return EXIT_FAILURE;
+            }
+            shard = *parsed;
+        }
+    }
+
     const ZydisMnemonic mnemonics[] = {
         ZYDIS_MNEMONIC_AAA,
         ZYDIS_MNEMONIC_AAD,
@@ -2857,14 +4629,42 @@ int main()
 
     const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
 
+    if (merge)
+        return mergeShards(mode, output) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (shard.count > 1)
+    {
+        // Partial files are read back by the merge, the format only applies to the final output.
+        output.directory = getShardPath(output.directory, shard);
+        output.format = OutputFormat::Binary;
+        Logging::println("Generating shard {} of {} into \"{}\"", shard.index, shard.count, output.directory.string());
+    }
+
 #ifdef _DEBUG
-    generateInstrTests(mode, ZYDIS_MNEMONIC_CVTDQ2PD);
+    Threading::ThreadPool pool(1);
+    generateInstrTests(pool, mode, ZYDIS_MNEMONIC_CVTDQ2PD, output, shard, search);
 #else
-    for (auto mnemonic : mnemonics)
+    Threading::ThreadPool pool;
+    if (stream)
+    {
+        // One mnemonic at a time, only the results in the window of the current one are kept in memory.
+        for (const auto mnemonic : mnemonics)
+        {
+            generateInstrTestsStreamed(pool, mode, mnemonic, output, shard, search);
+        }
+    }
+    else
     {
-        generateInstrTests(mode, mnemonic);
+        generateInstrTestsPipelined(pool, mode, mnemonics, output, shard, search);
     }
 #endif
 
+    const auto totals = Profiling::getTotals();
+    reportWorkerStats(pool);
+    reportSearchStats(search, totals);
+    reportExecutionStats(totals);
+    if (search.collectProfile)
+        reportProfile(output, totals);
+
     return EXIT_SUCCESS;
 }
@@ -2,10 +2,11 @@
 
 #include <chrono>
 #include <cstdio>
-#include <intrin.h>
+#include <immintrin.h>
 #include <iostream>
 #include <print>
 #include <span>
+#include <string>
 
 namespace x86Tester::Utils
 {
@@ -24,18 +25,22 @@ namespace x86Tester::Utils
                   << "\n";
     }
 
-    std::string hexEncode(std::span<const uint8_t> bytes)
+    // Appends to an existing buffer, avoids a temporary string per field when formatting large files.
+    inline void hexEncodeTo(std::string& out, std::span<const uint8_t> bytes)
     {
-        std::string out;
-        out.reserve(bytes.size() * 2);
-
         constexpr const char* hexChars = "0123456789ABCDEF";
         for (const auto byte : bytes)
         {
             out.push_back(hexChars[byte >> 4]);
             out.push_back(hexChars[byte & 0xF]);
         }
+    }
 
+    inline std::string hexEncode(std::span<const uint8_t> bytes)
+    {
+        std::string out;
+        out.reserve(bytes.size() * 2);
+        hexEncodeTo(out, bytes);
         return out;
     }
 
@@ -0,0 +1,155 @@
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <immintrin.h>
+#include <x86Tester/bitmatch.hpp>
+
+#ifdef _MSC_VER
+#    include <intrin.h>
+#    define X86TESTER_TARGET_AVX2
+#else
+#    define X86TESTER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace x86Tester::BitMatch
+{
+    Targets::Targets(std::size_t size)
+        : _size(size)
+    {
+        assert(size <= kMaxImageSize);
+    }
+
+    void Targets::add(std::size_t bitIndex, std::uint8_t expectedValue)
+    {
+        assert(bitIndex < _size * 8);
+
+        auto& image = expectedValue == 0 ? _expect0 : _expect1;
+        if (image.test(bitIndex))
+            return;
+
+        image.set(bitIndex);
+        _count++;
+    }
+
+    void Targets::requireChange(std::size_t bitIndex)
+    {
+        assert(bitIndex < _size * 8);
+        _requireChange.set(bitIndex);
+    }
+
+    std::size_t Targets::remove(const Image& matched0, const Image& matched1)
+    {
+        std::size_t numRemoved = 0;
+        for (std::size_t i = 0; i < _size; ++i)
+        {
+            const auto removed0 = _expect0.bytes[i] & matched0.bytes[i];
+            const auto removed1 = _expect1.bytes[i] & matched1.bytes[i];
+            numRemoved += std::popcount(static_cast<unsigned>(removed0)) + std::popcount(static_cast<unsigned>(removed1));
+
+            _expect0.bytes[i] &= ~matched0.bytes[i];
+            _expect1.bytes[i] &= ~matched1.bytes[i];
+        }
+
+        assert(numRemoved <= _count);
+        _count -= numRemoved;
+        return numRemoved;
+    }
+
+    bool Targets::match(const Image& input, const Image& output, Image& matched0, Image& matched1) const
+    {
+        static const bool useAvx2 = isAvx2Supported();
+        if (useAvx2)
+            return matchAvx2(input, output, matched0, matched1);
+        return matchScalar(input, output, matched0, matched1);
+    }
+
+    bool Targets::matchScalar(const Image& input, const Image& output, Image& matched0, Image& matched1) const
+    {
+        std::uint64_t any = 0;
+        for (std::size_t offset = 0; offset < _size; offset += sizeof(std::uint64_t))
+        {
+            any |= matchWord(input, output, matched0, matched1, offset);
+        }
+
+        return any != 0;
+    }
+
+    static X86TESTER_TARGET_AVX2 __m256i loadLane(const Image& image, std::size_t offset)
+    {
+        return _mm256_load_si256(reinterpret_cast<const __m256i*>(image.bytes.data() + offset));
+    }
+
+    X86TESTER_TARGET_AVX2 bool Targets::matchAvx2(
+        const Image& input, const Image& output, Image& matched0, Image& matched1) const
+    {
+        auto any = _mm256_setzero_si256();
+        for (std::size_t offset = 0; offset < _size; offset += kLaneSize)
+        {
+            const auto in = loadLane(input, offset);
+            const auto out = loadLane(output, offset);
+            const auto requireChange = loadLane(_requireChange, offset);
+
+            const auto m0 = _mm256_andnot_si256(
+                _mm256_andnot_si256(in, requireChange), _mm256_andnot_si256(out, loadLane(_expect0, offset)));
+            const auto m1 = _mm256_andnot_si256(
+                _mm256_and_si256(in, requireChange), _mm256_and_si256(out, loadLane(_expect1, offset)));
+
+            _mm256_store_si256(reinterpret_cast<__m256i*>(matched0.bytes.data() + offset), m0);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(matched1.bytes.data() + offset), m1);
+            any = _mm256_or_si256(any, _mm256_or_si256(m0, m1));
+        }
+
+        return _mm256_testz_si256(any, any) == 0;
+    }
+
+    Coverage::Coverage(std::size_t size)
+        : _size(size)
+    {
+        assert(size <= kMaxImageSize);
+    }
+
+    bool Coverage::update(const Image& output)
+    {
+        std::uint64_t any = 0;
+        for (std::size_t offset = 0; offset < _size; offset += sizeof(std::uint64_t))
+        {
+            std::uint64_t out, seen0, seen1;
+            std::memcpy(&out, output.bytes.data() + offset, sizeof(out));
+            std::memcpy(&seen0, _seen0.bytes.data() + offset, sizeof(seen0));
+            std::memcpy(&seen1, _seen1.bytes.data() + offset, sizeof(seen1));
+
+            // Bytes past the size are left alone so the padding never counts as new.
+            auto mask = ~std::uint64_t{};
+            if (_size - offset < sizeof(std::uint64_t))
+                mask >>= (sizeof(std::uint64_t) - (_size - offset)) * 8;
+
+            any |= ((~out & ~seen0) | (out & ~seen1)) & mask;
+
+            seen0 |= ~out & mask;
+            seen1 |= out & mask;
+            std::memcpy(_seen0.bytes.data() + offset, &seen0, sizeof(seen0));
+            std::memcpy(_seen1.bytes.data() + offset, &seen1, sizeof(seen1));
+        }
+
+        return any != 0;
+    }
+
+    bool isAvx2Supported()
+    {
+#ifdef _MSC_VER
+        int regs[4]{};
+        __cpuid(regs, 1);
+        // OSXSAVE and AVX
+        if ((regs[2] & (1 << 27)) == 0 || (regs[2] & (1 << 28)) == 0)
+            return false;
+        // The OS has to save the YMM state.
+        if ((_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(regs, 7, 0);
+        return (regs[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+} // namespace x86Tester::BitMatch
@@ -1,77 +1,194 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <print>
+#include <thread>
 #include <x86Tester/logging.hpp>
+#include <x86Tester/profiling.hpp>
 
 namespace x86Tester::Logging
 {
-    using clock = std::chrono::high_resolution_clock;
+    using clock = std::chrono::steady_clock;
 
-    static int _lastProgress = -1;
+    static constexpr auto kReportInterval = std::chrono::milliseconds(100);
+
+    // Progress added by one thread, only written by it. Aligned so the shards of different threads don't share
+    // a cache line.
+    struct alignas(64) ProgressShard
+    {
+        std::atomic<std::uint64_t> value{};
+    };
+
+    static Profiling::ThreadRegistry<ProgressShard> _shards;
+
+    // Written by workers without any locking.
+    static std::atomic<std::uint64_t> _reportedValue{};
+    static std::atomic<std::uint64_t> _total{};
+
+    // Everything below is owned by the reporter and guarded by the mutex, workers don't take it unless they
+    // print a message.
+    static std::mutex _mutex;
     static bool _inProgress = false;
     static std::string _progressName;
-    static auto _nextReport = clock::now();
-    static double _progress = 0.0;
     static size_t _progressLineLen = 0;
     static clock::time_point _startTime;
+    static std::uint64_t _shardsBase = 0;
+    static Profiling::Totals _countersBase{};
 
-    static void printProgress(std::string_view name, double percentage, bool forcePrint)
+    static std::uint64_t sumShards()
     {
-        using namespace std::chrono_literals;
+        std::uint64_t sum = 0;
+        _shards.forEach([&](const ProgressShard& shard) { sum += shard.value.load(std::memory_order_relaxed); });
+        return sum;
+    }
 
+    static std::uint64_t getProgressValue()
+    {
+        return sumShards() - _shardsBase + _reportedValue.load(std::memory_order_relaxed);
+    }
+
+    static void printProgress()
+    {
         constexpr const char* PBSTR = "||||||||||||||||||||||||||||||||||||||||||||||||||||||||||||";
         constexpr int PBWIDTH = 40;
 
-        int val = static_cast<int>(percentage * 100);
-        if (val == _lastProgress && !forcePrint)
-            return;
-
-        auto now = clock::now();
-        if (percentage != 1.0 && now < _nextReport && !forcePrint)
-            return;
+        const auto value = getProgressValue();
+        const auto total = _total.load(std::memory_order_relaxed);
+        const auto percentage = total != 0 ? std::min(static_cast<double>(value) / static_cast<double>(total), 1.0) : 0.0;
 
-        _nextReport = now + 50ms;
+        const auto elapsed = std::chrono::duration<double>(clock::now() - _startTime).count();
+        const auto getRate = [&](double count) { return elapsed > 0.0 ? count / elapsed : 0.0; };
 
+        int val = static_cast<int>(percentage * 100);
         int lpad = static_cast<int>(percentage * PBWIDTH);
-        int rpad = PBWIDTH - lpad;
-        _lastProgress = val;
 
-        int namepad = 20 - static_cast<int>(name.size());
+        std::string line = std::format("\r{:25} {:3d}% [{:40}]", _progressName, val, std::string_view(PBSTR, lpad));
+
+        // Throughput of the search since the start of this progress, nothing to show while building instructions.
+        const auto counters = Profiling::getTotals();
+        const auto getCounter = [&](Profiling::Counter counter) {
+            const auto index = static_cast<std::size_t>(counter);
+            return static_cast<double>(counters[index] - _countersBase[index]);
+        };
+        const auto numInstrs = getCounter(Profiling::Counter::InstructionsTested);
+        const auto numExecutions = getCounter(Profiling::Counter::Executions);
+        if (numInstrs != 0.0 || numExecutions != 0.0)
+        {
+            line += std::format(" {:.1f} instr/s, {:.0f} exec/s", getRate(numInstrs), getRate(numExecutions));
+        }
+
+        const auto rate = getRate(static_cast<double>(value));
+        if (rate > 0.0 && value < total)
+        {
+            const auto remaining = std::chrono::seconds(static_cast<std::int64_t>(static_cast<double>(total - value) / rate));
+            line += std::format(", ETA {:%T}", remaining);
+        }
 
-        std::string line;
-        line = std::format("\r{:25} {:3d}% [{:40}]", name, val, std::string_view(PBSTR, lpad));
+        // Clear what is left of a longer previous line.
+        const auto lineLen = line.size();
+        if (lineLen < _progressLineLen)
+            line.append(_progressLineLen - lineLen, ' ');
 
         std::print("{}", line);
         std::fflush(stdout);
 
-        _progressLineLen = line.size();
+        _progressLineLen = lineLen;
+    }
+
+    // Samples the counters at a fixed interval, the workers never format or print the progress themselves.
+    class Reporter
+    {
+        std::thread _thread;
+        std::condition_variable _stopCv;
+        bool _stopping = false;
+
+    public:
+        ~Reporter()
+        {
+            stop();
+        }
+
+        // Called with the mutex held.
+        void start()
+        {
+            _stopping = false;
+            _thread = std::thread([this]() {
+                std::unique_lock lock(_mutex);
+                while (!_stopCv.wait_for(lock, kReportInterval, [this]() { return _stopping; }))
+                {
+                    printProgress();
+                }
+            });
+        }
+
+        // Called without the mutex.
+        void stop()
+        {
+            if (!_thread.joinable())
+                return;
+
+            {
+                std::lock_guard lock(_mutex);
+                _stopping = true;
+            }
+            _stopCv.notify_all();
+            _thread.join();
+        }
+    };
+
+    static Reporter _reporter;
+
+    void setProgressTotal(size_t max)
+    {
+        _total.store(max, std::memory_order_relaxed);
+    }
+
+    void addProgress(size_t count)
+    {
+        // Single writer per shard, no read-modify-write needed.
+        auto& value = _shards.local().value;
+        value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
     }
 
     void updateProgress(size_t val, size_t max)
     {
-        _progress = static_cast<double>(val) / max;
-        printProgress(_progressName, _progress, false);
+        // Concurrent callers can arrive out of order, only ever move forward.
+        auto current = _reportedValue.load(std::memory_order_relaxed);
+        while (current < val && !_reportedValue.compare_exchange_weak(current, val, std::memory_order_relaxed))
+        {
+        }
+
+        _total.store(max, std::memory_order_relaxed);
     }
 
     void endProgress()
     {
+        _reporter.stop();
+
+        std::lock_guard lock(_mutex);
+
         _inProgress = false;
 
         auto endTime = clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::seconds>(endTime - _startTime);
-        std::println(
-            "\r{}, completed in {}.{:{}}", _progressName, duration, "",
-            _progressName.size() < 72 ? 72 - _progressName.size() : 1);
+        const auto message = std::format("\r{}, completed in {}", _progressName, duration);
+        std::println("{:{}}", message, std::max(_progressLineLen, message.size()));
+        _progressLineLen = 0;
     }
 
     namespace Detail
     {
         void println(const std::string_view msg)
         {
+            std::lock_guard lock(_mutex);
+
             if (_inProgress)
             {
                 size_t spaces = msg.size() < _progressLineLen ? _progressLineLen - msg.size() : 0;
                 std::println("\r{}{}", msg, std::string(spaces, ' '));
-                printProgress(_progressName, _progress, true);
+                printProgress();
             }
             else
                 std::println("{}", msg);
@@ -79,14 +196,25 @@ namespace x86Tester::Logging
 
         void startProgress(const std::string_view msg)
         {
+            _reporter.stop();
+
+            std::lock_guard lock(_mutex);
+
             _progressName = std::string{ msg };
             _inProgress = true;
-            _lastProgress = -1;
-            _progress = 0.0;
+            _progressLineLen = 0;
             _startTime = clock::now();
-            printProgress(_progressName, _progress, true);
+
+            // The shards keep counting across progress bars, only the difference is shown.
+            _shardsBase = sumShards();
+            _countersBase = Profiling::getTotals();
+            _reportedValue.store(0, std::memory_order_relaxed);
+            _total.store(0, std::memory_order_relaxed);
+
+            printProgress();
+            _reporter.start();
         }
 
     } // namespace Detail
 
-} // namespace x86Tester::Logging
\ No newline at end of file
+} // namespace x86Tester::Logging
@@ -0,0 +1,75 @@
+#include <chrono>
+#include <thread>
+#include <x86Tester/profiling.hpp>
+
+namespace x86Tester::Profiling
+{
+    static constexpr std::string_view kCounterNames[] = {
+        "prepares",
+        "prepareCycles",
+        "executeCalls",
+        "executions",
+        "executeCycles",
+        "divideErrors",
+        "intOverflows",
+        "illegalInstructions",
+        "accessViolations",
+        "instructionsTested",
+        "instructionCycles",
+        "matrixBits",
+        "bitsSatisfied",
+        "iterationsToSatisfy",
+        "bitsAborted",
+        "bitsPruned",
+        "executionsSaved",
+        "inputCycles",
+        "matchCycles",
+    };
+    static_assert(std::size(kCounterNames) == kNumCounters);
+
+    static ThreadRegistry<ThreadCounters> _counters;
+
+    std::string_view getCounterName(Counter counter)
+    {
+        return kCounterNames[static_cast<std::size_t>(counter)];
+    }
+
+    double getTscFrequency()
+    {
+        static const double frequency = []() {
+            using clock = std::chrono::steady_clock;
+
+            const auto startTime = clock::now();
+            const auto startTsc = readTsc();
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            const auto endTsc = readTsc();
+            const auto elapsed = std::chrono::duration<double>(clock::now() - startTime).count();
+
+            return static_cast<double>(endTsc - startTsc) / elapsed;
+        }();
+        return frequency;
+    }
+
+    double cyclesToMilliseconds(std::uint64_t cycles)
+    {
+        return static_cast<double>(cycles) * 1000.0 / getTscFrequency();
+    }
+
+    ThreadCounters& getThreadCounters()
+    {
+        return _counters.local();
+    }
+
+    Totals getTotals()
+    {
+        Totals totals{};
+        _counters.forEach([&](const ThreadCounters& counters) {
+            for (std::size_t i = 0; i < kNumCounters; ++i)
+            {
+                totals[i] += counters.values[i].load(std::memory_order_relaxed);
+            }
+        });
+        return totals;
+    }
+
+} // namespace x86Tester::Profiling
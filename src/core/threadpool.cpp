@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <x86Tester/threadpool.hpp>
+
+namespace x86Tester::Threading
+{
+    using clock = std::chrono::steady_clock;
+
+    ThreadPool::ThreadPool(std::size_t numWorkers)
+    {
+        numWorkers = std::max<std::size_t>(numWorkers, 1);
+
+        for (std::size_t i = 0; i < numWorkers; ++i)
+        {
+            _workers.push_back(std::make_unique<Worker>());
+        }
+
+        for (std::size_t i = 0; i < numWorkers; ++i)
+        {
+            _threads.emplace_back([this, i]() { workerMain(i); });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(_mutex);
+            _stopping = true;
+        }
+        _startCv.notify_all();
+
+        for (auto& thread : _threads)
+        {
+            thread.join();
+        }
+    }
+
+    bool ThreadPool::popTask(std::size_t workerIndex, Task& task, bool& stolen)
+    {
+        {
+            auto& worker = *_workers[workerIndex];
+            std::lock_guard lock(worker.mutex);
+            if (!worker.tasks.empty())
+            {
+                task = std::move(worker.tasks.front());
+                worker.tasks.pop_front();
+                stolen = false;
+                return true;
+            }
+        }
+
+        // Steal the cheapest task of another worker, starting with the next one so victims are spread out.
+        for (std::size_t i = 1; i < _workers.size(); ++i)
+        {
+            auto& victim = *_workers[(workerIndex + i) % _workers.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                stolen = true;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void ThreadPool::workerMain(std::size_t workerIndex)
+    {
+        auto& stats = _workers[workerIndex]->stats;
+
+        for (;;)
+        {
+            {
+                std::unique_lock lock(_mutex);
+                _startCv.wait(lock, [&]() { return _stopping || _numQueued != 0; });
+                if (_stopping)
+                    return;
+            }
+
+            Task task;
+            bool stolen = false;
+            while (popTask(workerIndex, task, stolen))
+            {
+                _numQueued--;
+
+                const auto start = clock::now();
+                task(workerIndex);
+                stats.busyTime += clock::now() - start;
+
+                stats.tasksExecuted++;
+                if (stolen)
+                    stats.tasksStolen++;
+
+                task = nullptr;
+
+                std::lock_guard lock(_mutex);
+                if (--_numPending == 0)
+                {
+                    _activeTime += clock::now() - _activeSince;
+                    _doneCv.notify_all();
+                }
+            }
+        }
+    }
+
+    void ThreadPool::submit(std::vector<Task> tasks)
+    {
+        if (tasks.empty())
+            return;
+
+        // Continue dealing where the last submission stopped so small submissions are spread out.
+        std::size_t workerIndex;
+        {
+            std::lock_guard lock(_mutex);
+            if (_numPending == 0)
+                _activeSince = clock::now();
+            _numPending += tasks.size();
+            _numQueued += tasks.size();
+
+            workerIndex = _nextWorker;
+            _nextWorker = (_nextWorker + tasks.size()) % _workers.size();
+        }
+
+        for (std::size_t i = 0; i < tasks.size(); ++i)
+        {
+            auto& worker = *_workers[(workerIndex + i) % _workers.size()];
+            std::lock_guard lock(worker.mutex);
+            worker.tasks.push_back(std::move(tasks[i]));
+        }
+
+        _startCv.notify_all();
+    }
+
+    void ThreadPool::wait()
+    {
+        std::unique_lock lock(_mutex);
+        _doneCv.wait(lock, [&]() { return _numPending == 0; });
+    }
+
+    std::vector<WorkerStats> ThreadPool::getStats() const
+    {
+        std::vector<WorkerStats> res;
+        res.reserve(_workers.size());
+        for (const auto& worker : _workers)
+        {
+            auto& stats = res.emplace_back(worker->stats);
+            stats.totalTime = _activeTime;
+        }
+        return res;
+    }
+
+} // namespace x86Tester::Threading
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <x86Tester/execution.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <vector>
+
+#ifdef _WIN32
+#    ifndef WIN32_LEAN_AND_MEAN
+#        define WIN32_LEAN_AND_MEAN
+#    endif
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#elif defined(__linux__)
+#    include <csignal>
+#    include <ucontext.h>
+#endif
+
+namespace x86Tester::Execution
+{
+    // The Windows sandbox has its image base at 0x70000000 so this region is usually free, all backends
+    // report code at this address so results don't depend on the backend that produced them.
+    inline constexpr std::uintptr_t kPreferredCodeBase = 0x04000000;
+
+    // XSAVE state components covered by the register file.
+    inline constexpr std::uint64_t kXStateX87 = 1ULL << 0;
+    inline constexpr std::uint64_t kXStateSse = 1ULL << 1;
+    inline constexpr std::uint64_t kXStateAvx = 1ULL << 2;
+    inline constexpr std::uint64_t kXStateOpmask = 1ULL << 5;
+    inline constexpr std::uint64_t kXStateZmmHi256 = 1ULL << 6;
+    inline constexpr std::uint64_t kXStateHi16Zmm = 1ULL << 7;
+    inline constexpr std::uint64_t kXStateLegacy = kXStateX87 | kXStateSse;
+    inline constexpr std::uint64_t kXStateAvx512 = kXStateOpmask | kXStateZmmHi256 | kXStateHi16Zmm;
+
+    // Follows the legacy region in the standard XSAVE format.
+    struct XSaveHeader
+    {
+        std::uint64_t xstateBv;
+        std::uint64_t xcompBv;
+        std::uint64_t reserved[6];
+    };
+    static_assert(sizeof(XSaveHeader) == 64);
+
+    // Standard format XSAVE area the stubs load from and store to. The offsets of the extended components
+    // are reported by CPUID, components placed elsewhere are not supported.
+    struct alignas(64) XSaveArea
+    {
+        FxSaveArea fx;
+        XSaveHeader header;
+        // Upper halves of YMM0-15.
+        std::uint8_t ymmHi128[16][16];
+        // Unused gap and the MPX state, never requested.
+        std::uint8_t reserved[256];
+        std::uint64_t opmask[8];
+        // Upper halves of ZMM0-15.
+        std::uint8_t zmmHi256[16][32];
+        // ZMM16-31.
+        std::uint8_t hi16Zmm[16][64];
+    };
+    static_assert(offsetof(XSaveArea, ymmHi128) == 576);
+    static_assert(offsetof(XSaveArea, opmask) == 1088);
+    static_assert(offsetof(XSaveArea, zmmHi256) == 1152);
+    static_assert(offsetof(XSaveArea, hi16Zmm) == 1664);
+    static_assert(sizeof(XSaveArea) == 2688);
+
+    inline constexpr ZydisRegister kGprRegs[] = {
+        ZYDIS_REGISTER_RAX, ZYDIS_REGISTER_RCX, ZYDIS_REGISTER_RDX, ZYDIS_REGISTER_RBX,
+        ZYDIS_REGISTER_RSP, ZYDIS_REGISTER_RBP, ZYDIS_REGISTER_RSI, ZYDIS_REGISTER_RDI,
+        ZYDIS_REGISTER_R8,  ZYDIS_REGISTER_R9,  ZYDIS_REGISTER_R10, ZYDIS_REGISTER_R11,
+        ZYDIS_REGISTER_R12, ZYDIS_REGISTER_R13, ZYDIS_REGISTER_R14, ZYDIS_REGISTER_R15,
+    };
+
+#ifdef _WIN32
+    static_assert(sizeof(FxSaveArea) == sizeof(XMM_SAVE_AREA32));
+
+    inline constexpr DWORD64 CONTEXT::*kGprFields[] = {
+        &CONTEXT::Rax, &CONTEXT::Rcx, &CONTEXT::Rdx, &CONTEXT::Rbx, &CONTEXT::Rsp, &CONTEXT::Rbp,
+        &CONTEXT::Rsi, &CONTEXT::Rdi, &CONTEXT::R8,  &CONTEXT::R9,  &CONTEXT::R10, &CONTEXT::R11,
+        &CONTEXT::R12, &CONTEXT::R13, &CONTEXT::R14, &CONTEXT::R15,
+    };
+
+    inline void copyToRegisterFile(const CONTEXT& src, RegisterFile& dst)
+    {
+        for (std::size_t i = 0; i < std::size(kGprFields); ++i)
+        {
+            dst.gpr[i] = src.*kGprFields[i];
+        }
+        dst.rip = src.Rip;
+        dst.eflags = src.EFlags;
+        std::memcpy(&dst.fx, &src.FltSave, sizeof(dst.fx));
+        for (std::size_t i = 0; i < std::size(dst.fx.xmm); ++i)
+        {
+            std::memcpy(dst.zmm[i], dst.fx.xmm[i], sizeof(dst.fx.xmm[i]));
+        }
+    }
+
+    inline void copyFromRegisterFile(const RegisterFile& src, CONTEXT& dst)
+    {
+        for (std::size_t i = 0; i < std::size(kGprFields); ++i)
+        {
+            dst.*kGprFields[i] = src.gpr[i];
+        }
+        dst.Rip = src.rip;
+        dst.EFlags = src.eflags;
+        std::memcpy(&dst.FltSave, &src.fx, sizeof(src.fx));
+        for (std::size_t i = 0; i < std::size(src.fx.xmm); ++i)
+        {
+            std::memcpy(&dst.FltSave.XmmRegisters[i], src.zmm[i], sizeof(src.fx.xmm[i]));
+        }
+        dst.MxCsr = src.fx.mxcsr;
+    }
+#elif defined(__linux__)
+    static_assert(sizeof(FxSaveArea) == sizeof(_libc_fpstate));
+
+    inline constexpr int kGprFields[] = {
+        REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+        REG_R8,  REG_R9,  REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15,
+    };
+
+    // Registers at the faulting instruction as the kernel saved them in the signal frame.
+    inline void copyToRegisterFile(const ucontext_t& src, RegisterFile& dst)
+    {
+        const auto& gregs = src.uc_mcontext.gregs;
+        for (std::size_t i = 0; i < std::size(kGprFields); ++i)
+        {
+            dst.gpr[i] = static_cast<std::uint64_t>(gregs[kGprFields[i]]);
+        }
+        dst.rip = static_cast<std::uint64_t>(gregs[REG_RIP]);
+        dst.eflags = static_cast<std::uint32_t>(gregs[REG_EFL]);
+        if (src.uc_mcontext.fpregs != nullptr)
+        {
+            std::memcpy(&dst.fx, src.uc_mcontext.fpregs, sizeof(dst.fx));
+            for (std::size_t i = 0; i < std::size(dst.fx.xmm); ++i)
+            {
+                std::memcpy(dst.zmm[i], dst.fx.xmm[i], sizeof(dst.fx.xmm[i]));
+            }
+        }
+    }
+#endif
+
+    namespace Debugger
+    {
+        struct Sandbox;
+    }
+
+    struct DebuggerState
+    {
+        // Pooled per thread, owned by the pool.
+        Debugger::Sandbox* sandbox{};
+    };
+
+    struct InProcessState
+    {
+        // Loaded by the entry stub and stored by the exit stub.
+        XSaveArea xsave{};
+        std::byte* page{};
+        std::size_t pageSize{};
+        std::uintptr_t entryAddr{};
+        std::uintptr_t exitAddr{};
+        // Actual address of the code region, Context::codeBase reports the sandbox layout.
+        std::uintptr_t codeBase{};
+        // Qword on the stub page the entry stub jumps through, set to the selected slot.
+        std::uint64_t* codeTarget{};
+        std::uint64_t hostRsp{};
+        bool faulted{};
+    };
+
+    struct CodeSlot
+    {
+        std::uintptr_t codeAddr{};
+        std::size_t codeSize{};
+        std::uint64_t stateMask{};
+    };
+
+    struct Context
+    {
+        Backend backend{};
+        ZydisMachineMode mode{};
+        // Code region holding all slots.
+        std::uintptr_t codeBase{};
+        std::size_t codeSize{};
+        std::vector<CodeSlot> slots;
+        // Selected slot, codeAddr and stateMask are copied from it.
+        std::size_t slot{};
+        std::uintptr_t codeAddr{};
+        // Data window of the sandbox, zero for the in-process backend.
+        std::uintptr_t dataAddr{};
+        // Read by the stubs for xrstor/xsave.
+        std::uint64_t stateMask{};
+        RegisterFile regs{};
+        ExecutionStatus status{};
+        DebuggerState debugger{};
+        InProcessState inProcess{};
+    };
+
+    // Reported as RIP after a successful run, same as stopping on a breakpoint right after the code.
+    inline std::uintptr_t getCodeEnd(const Context* ctx)
+    {
+        return ctx->codeAddr + ctx->slots[ctx->slot].codeSize;
+    }
+
+#ifdef _WIN32
+    std::optional<ExecutionStatus> getExceptionStatus(DWORD exceptionCode);
+#elif defined(__linux__)
+    // Signals that are caught while running code.
+    inline constexpr int kFaultSignals[] = { SIGFPE, SIGILL, SIGSEGV, SIGBUS, SIGTRAP };
+
+    // Linux reports both causes of #DE as FPE_INTDIV, the divisor of the instruction at regs.rip tells them
+    // apart the same way Windows does. The registers must be the ones at the fault.
+    std::optional<ExecutionStatus> getSignalStatus(const siginfo_t& info, const RegisterFile& regs);
+#endif
+
+    // MXCSR bits supported by this CPU, loading anything else with fxrstor/xrstor faults.
+    std::uint32_t getMxcsrMask();
+
+    inline constexpr std::uint32_t kTrapFlag = 1U << 8;
+
+    // True if the OS enabled XSAVE, the stubs fall back to fxsave/fxrstor otherwise.
+    bool isXSaveEnabled();
+
+    // Components enabled by the OS that XSaveArea can hold, only the legacy ones without XSAVE.
+    std::uint64_t getSupportedStateComponents();
+
+    // State components the code touches, xrstor/xsave skip everything else.
+    std::uint64_t getStateComponents(ZydisMachineMode mode, std::span<const std::uint8_t> code);
+
+    // Reserved MXCSR bits would fault in the load stub and TF would trap right after popfq.
+    inline void sanitizeRegisterFile(RegisterFile& regs)
+    {
+        regs.fx.mxcsr &= getMxcsrMask();
+        regs.eflags &= ~kTrapFlag;
+    }
+
+    // Copies the components of the mask into the area, xrstor only loads components marked in the header
+    // and faults on a non-zero XCOMP_BV. The legacy region is always copied for fxrstor.
+    void storeXState(const RegisterFile& regs, std::uint64_t stateMask, XSaveArea& area);
+
+    // Copies the components of the mask back into the register file.
+    void loadXState(const XSaveArea& area, std::uint64_t stateMask, RegisterFile& regs);
+
+    namespace Debugger
+    {
+        // Every slot of the context jumps to the store stub of the sandbox.
+        bool prepare(Context* ctx, std::span<const std::span<const std::uint8_t>> codes);
+
+        bool execute(Context* ctx);
+
+        bool executeBatch(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs);
+
+        void cleanup(Context* ctx);
+
+    } // namespace Debugger
+
+    namespace InProcess
+    {
+        // Returns true if the code can safely run inside this process, it must not touch memory,
+        // the stack or the instruction pointer.
+        bool isSupported(ZydisMachineMode mode, std::span<const std::uint8_t> code);
+
+        bool prepare(Context* ctx, std::span<const std::span<const std::uint8_t>> codes);
+
+        bool execute(Context* ctx);
+
+        void cleanup(Context* ctx);
+
+    } // namespace InProcess
+
+} // namespace x86Tester::Execution
@@ -0,0 +1,718 @@
+#include "context.hpp"
+#include "stubs.hpp"
+
+#include <Zydis/Disassembler.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <print>
+#include <span>
+#include <vector>
+
+namespace x86Tester::Execution::Debugger
+{
+    using namespace Stubs;
+
+    // Layout of the section shared with the sandbox, the code region with all slots is followed by the batch
+    // driver, the control block with the scratch stack above it, the batch entries and the data arena.
+    static constexpr std::size_t kDriverOffset = kMaxCodeSlots * kCodeSlotSize;
+    static constexpr std::size_t kControlOffset = kDriverOffset + 0x1000;
+    static constexpr std::size_t kEntriesOffset = kControlOffset + 0x1000;
+    // Entries carry the register file and the XSAVE area, matches the batches of the input search.
+    static constexpr std::size_t kBatchCapacity = 256;
+
+    struct BatchControl
+    {
+        std::uint64_t index;
+        std::uint64_t count;
+        // Address of the current entry, the load/store stubs read the register file through it.
+        std::uint64_t current;
+        std::uint64_t scratchRax;
+        // Components for xrstor/xsave.
+        std::uint64_t stateMask;
+        // Code of the selected slot, the driver jumps through it.
+        std::uint64_t codeAddr;
+    };
+
+    struct BatchEntry
+    {
+        RegisterFile regs;
+        ExecutionStatus status;
+        // Loaded and stored by the stubs, only the components of the state mask are transferred.
+        XSaveArea xsave;
+    };
+
+    // Memory operands address the data window at the end of the arena page, the pages on either side are
+    // inaccessible so an access that leaves the arena faults instead of overwriting the entries.
+    static constexpr std::size_t kLowerGuardOffset =
+        (kEntriesOffset + kBatchCapacity * sizeof(BatchEntry) + 0xFFF) & ~std::size_t{ 0xFFF };
+    static constexpr std::size_t kArenaOffset = kLowerGuardOffset + 0x1000;
+    static constexpr std::size_t kUpperGuardOffset = kArenaOffset + 0x1000;
+    static constexpr std::size_t kDataOffset = kUpperGuardOffset - kDataWindowSize;
+    static constexpr std::size_t kSectionSize = kUpperGuardOffset + 0x1000;
+
+    static constexpr std::int64_t kEntryDataOffset = offsetof(BatchEntry, regs) + offsetof(RegisterFile, data);
+
+    // Long-lived sandbox process, the thread is always stopped at a debug event when not executing.
+    struct Sandbox
+    {
+        STARTUPINFOW startupInfo{};
+        PROCESS_INFORMATION processInfo{};
+        HANDLE hThread{};
+        CONTEXT threadContext{};
+        DEBUG_EVENT dbgEvent{};
+        // Section shared with the sandbox, holds the code and the batch entries.
+        HANDLE hSection{};
+        std::byte* localView{};
+        std::uintptr_t remoteView{};
+        std::uintptr_t batchLoopAddr{};
+        std::uintptr_t batchDoneAddr{};
+        std::uintptr_t batchStoreAddr{};
+        std::uint64_t scratchStackTop{};
+        // State of the thread at the entry breakpoint with all GPRs cleared.
+        RegisterFile initialRegs{};
+        bool inUse{};
+        // The process exited or ended up in an unknown state, it is not handed out again.
+        bool broken{};
+    };
+
+    // Only exported on Windows 10 1703 and later.
+    using MapViewOfFileNuma2Fn = PVOID(WINAPI*)(HANDLE, HANDLE, ULONG64, PVOID, SIZE_T, ULONG, ULONG, ULONG);
+
+    static MapViewOfFileNuma2Fn getMapViewOfFileNuma2()
+    {
+        static const auto fn = reinterpret_cast<MapViewOfFileNuma2Fn>(
+            GetProcAddress(GetModuleHandleW(L"kernelbase.dll"), "MapViewOfFileNuma2"));
+        return fn;
+    }
+
+    static std::filesystem::path getExecutingPath()
+    {
+        wchar_t path[2048]{};
+        GetModuleFileNameW(nullptr, path, std::size(path));
+
+        auto* lastSlash = std::wcsrchr(path, L'\\');
+        if (!lastSlash)
+        {
+            return path;
+        }
+
+        *lastSlash = L'\0';
+        return path;
+    }
+
+    enum class DebugStatus
+    {
+        Continue,
+        Faulted,
+        Terminated,
+    };
+
+    static void dumpDisassembly(Context* ctx, std::uintptr_t activeAddress)
+    {
+        // Decode the entire code region.
+        for (size_t n = 0; n < ctx->codeSize;)
+        {
+            const std::uintptr_t addr = ctx->codeBase + n;
+
+            std::uint8_t buffer[16]{};
+            SIZE_T read;
+            ReadProcessMemory(
+                ctx->debugger.sandbox->processInfo.hProcess, reinterpret_cast<void*>(addr), buffer, sizeof(buffer),
+                &read);
+
+            ZydisDisassembledInstruction instr;
+            ZydisDisassembleIntel(ZYDIS_MACHINE_MODE_LONG_64, addr, buffer, read, &instr);
+
+            std::print("{}{:016X} ", addr == activeAddress ? ">" : " ", addr);
+
+            n += instr.info.length;
+        }
+    }
+
+    static DebugStatus handleException(Context* ctx, const EXCEPTION_RECORD& record)
+    {
+        const auto exceptionAddress = reinterpret_cast<uintptr_t>(record.ExceptionAddress);
+
+        std::print("Exception code: {:X}\n", record.ExceptionCode);
+        std::print("Exception flags: {:X}\n", record.ExceptionFlags);
+        std::print("Exception address: {:X}\n", exceptionAddress);
+        std::print("Number of parameters: {}\n", record.NumberParameters);
+        for (DWORD i = 0; i < record.NumberParameters; ++i)
+        {
+            std::print("Parameter {}: {}\n", i, record.ExceptionInformation[i]);
+        }
+
+        if (ctx->codeBase >= exceptionAddress && exceptionAddress < ctx->codeBase + ctx->codeSize)
+        {
+            dumpDisassembly(ctx, exceptionAddress);
+        }
+
+        return DebugStatus::Faulted;
+    }
+
+    static DebugStatus handleCommonEvent(const DEBUG_EVENT& dbgEvent)
+    {
+        switch (dbgEvent.dwDebugEventCode)
+        {
+            case CREATE_PROCESS_DEBUG_EVENT:
+                CloseHandle(dbgEvent.u.CreateProcessInfo.hFile);
+                break;
+            case LOAD_DLL_DEBUG_EVENT:
+                CloseHandle(dbgEvent.u.LoadDll.hFile);
+                break;
+            case EXIT_PROCESS_DEBUG_EVENT:
+                return DebugStatus::Terminated;
+            default:
+                break;
+        }
+
+        return DebugStatus::Continue;
+    }
+
+    static DebugStatus handleDbgEvent(Context* ctx, const DEBUG_EVENT& dbgEvent)
+    {
+        if (dbgEvent.dwDebugEventCode == EXCEPTION_DEBUG_EVENT)
+        {
+            return handleException(ctx, dbgEvent.u.Exception.ExceptionRecord);
+        }
+
+        const auto status = handleCommonEvent(dbgEvent);
+        if (status == DebugStatus::Terminated)
+        {
+            ctx->debugger.sandbox->broken = true;
+        }
+
+        return status;
+    }
+
+    // Consumes debug events until the sandbox hits a breakpoint at the given address or the first
+    // breakpoint when the address is 0, the breakpoint event is left pending.
+    static bool waitForBreakpoint(Sandbox& sandbox, std::uintptr_t address)
+    {
+        auto& dbgEvent = sandbox.dbgEvent;
+        while (WaitForDebugEvent(&dbgEvent, INFINITE))
+        {
+            if (dbgEvent.dwDebugEventCode == EXCEPTION_DEBUG_EVENT)
+            {
+                const auto& record = dbgEvent.u.Exception.ExceptionRecord;
+                const auto exceptionAddress = reinterpret_cast<std::uintptr_t>(record.ExceptionAddress);
+                if (record.ExceptionCode == EXCEPTION_BREAKPOINT && (address == 0 || exceptionAddress == address))
+                {
+                    return true;
+                }
+            }
+            else if (handleCommonEvent(dbgEvent) == DebugStatus::Terminated)
+            {
+                std::print("Sandbox terminated unexpectedly\n");
+                return false;
+            }
+
+            ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
+        }
+
+        return false;
+    }
+
+    static bool spawnProcess(Sandbox& sandbox)
+    {
+        sandbox.startupInfo.cb = sizeof(sandbox.startupInfo);
+        sandbox.startupInfo.dwFlags = STARTF_USESHOWWINDOW;
+        sandbox.startupInfo.wShowWindow = SW_HIDE;
+
+        const auto path = getExecutingPath();
+        const auto cmd = path / "x86Tester-sandbox.exe";
+        auto cmdWstr = cmd.wstring();
+
+        if (!CreateProcessW(
+                nullptr, cmdWstr.data(), nullptr, nullptr, FALSE, DEBUG_PROCESS, nullptr, nullptr,
+                &sandbox.startupInfo, &sandbox.processInfo))
+        {
+            return false;
+        }
+
+        // Consume all debug events until the system breakpoint.
+        if (!waitForBreakpoint(sandbox, 0))
+        {
+            return false;
+        }
+
+        auto& dbgEvent = sandbox.dbgEvent;
+        ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
+
+        return true;
+    }
+
+    // Only the view of the sandbox, this process never accesses the arena.
+    static bool protectGuardPages(Sandbox& sandbox)
+    {
+        for (const auto offset : { kLowerGuardOffset, kUpperGuardOffset })
+        {
+            DWORD oldProtect{};
+            if (!VirtualProtectEx(
+                    sandbox.processInfo.hProcess, reinterpret_cast<void*>(sandbox.remoteView + offset), 0x1000,
+                    PAGE_NOACCESS, &oldProtect))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static bool createSection(Sandbox& sandbox)
+    {
+        const auto mapViewOfFileNuma2 = getMapViewOfFileNuma2();
+        if (mapViewOfFileNuma2 == nullptr)
+        {
+            std::print("MapViewOfFileNuma2 is not available\n");
+            return false;
+        }
+
+        sandbox.hSection = CreateFileMappingW(
+            INVALID_HANDLE_VALUE, nullptr, PAGE_EXECUTE_READWRITE | SEC_COMMIT, 0, static_cast<DWORD>(kSectionSize),
+            nullptr);
+        if (sandbox.hSection == nullptr)
+        {
+            return false;
+        }
+
+        sandbox.localView = static_cast<std::byte*>(
+            MapViewOfFile(sandbox.hSection, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, kSectionSize));
+        if (sandbox.localView == nullptr)
+        {
+            return false;
+        }
+
+        // Try to map at a predictable address, the child process has base of 0x70000000.
+        const std::uintptr_t preferredAddresses[] = { kPreferredCodeBase, 0x05000000, 0 };
+        for (const auto preferredAddr : preferredAddresses)
+        {
+            auto* remoteView = mapViewOfFileNuma2(
+                sandbox.hSection, sandbox.processInfo.hProcess, 0, reinterpret_cast<void*>(preferredAddr),
+                kSectionSize, 0, PAGE_EXECUTE_READWRITE, NUMA_NO_PREFERRED_NODE);
+            if (remoteView != nullptr)
+            {
+                sandbox.remoteView = reinterpret_cast<std::uintptr_t>(remoteView);
+                return protectGuardPages(sandbox);
+            }
+        }
+
+        return false;
+    }
+
+    static bool setupBatchDriver(Sandbox& sandbox)
+    {
+        const auto controlAddr = sandbox.remoteView + kControlOffset;
+        const auto entriesAddr = sandbox.remoteView + kEntriesOffset;
+        const auto dataAddr = sandbox.remoteView + kDataOffset;
+
+        sandbox.scratchStackTop = entriesAddr;
+
+        const auto regOptions = RegisterStubOptions{
+            .regsAddress = controlAddr + offsetof(BatchControl, current),
+            .regsIndirect = true,
+            .scratchAddress = controlAddr + offsetof(BatchControl, scratchRax),
+            .includeStackPointer = true,
+            .scratchStackTop = sandbox.scratchStackTop,
+            .stateMaskAddress = isXSaveEnabled() ? controlAddr + offsetof(BatchControl, stateMask) : 0,
+            .stateOffset = offsetof(BatchEntry, xsave),
+        };
+
+        Assembler a(sandbox.remoteView + kDriverOffset);
+
+        // Reached once all entries ran, the thread stays here between batches.
+        const std::uint8_t breakpoint[] = { 0xCC };
+        sandbox.batchDoneAddr = a.address();
+        a.emitBytes(breakpoint);
+
+        // Select the next entry.
+        sandbox.batchLoopAddr = a.address();
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(controlAddr));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, index), 8));
+        a.emit(ZYDIS_MNEMONIC_CMP, reg(ZYDIS_REGISTER_RAX), mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, count), 8));
+        a.branch(ZYDIS_MNEMONIC_JNB, sandbox.batchDoneAddr);
+        a.emit(ZYDIS_MNEMONIC_IMUL, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RAX), imm(sizeof(BatchEntry)));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RDX), imm(entriesAddr));
+        a.emit(ZYDIS_MNEMONIC_ADD, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RDX));
+        a.emit(ZYDIS_MNEMONIC_MOV, mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, current), 8), reg(ZYDIS_REGISTER_RAX));
+
+        // Memory inputs of the entry, the registers are loaded afterwards.
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(dataAddr));
+        emitCopy(a, ZYDIS_REGISTER_RCX, 0, ZYDIS_REGISTER_RAX, kEntryDataOffset, ZYDIS_REGISTER_RDX, kDataWindowSize);
+
+        // Run the code at its regular address so results match execute().
+        emitLoadRegisters(a, regOptions);
+        a.jmpIndirect(controlAddr + offsetof(BatchControl, codeAddr));
+
+        // The code is followed by a jump to here.
+        sandbox.batchStoreAddr = a.address();
+        emitStoreRegisters(a, regOptions);
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(dataAddr));
+        emitCopy(a, ZYDIS_REGISTER_RAX, kEntryDataOffset, ZYDIS_REGISTER_RCX, 0, ZYDIS_REGISTER_RDX, kDataWindowSize);
+        a.emit(
+            ZYDIS_MNEMONIC_MOV, mem(ZYDIS_REGISTER_RAX, offsetof(BatchEntry, status), 4),
+            imm(static_cast<std::uint64_t>(ExecutionStatus::Success)));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(controlAddr));
+        a.emit(ZYDIS_MNEMONIC_ADD, mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, index), 8), imm(1));
+        a.jmp(sandbox.batchLoopAddr);
+
+        if (!a.ok() || kDriverOffset + a.code().size() > kControlOffset)
+        {
+            return false;
+        }
+
+        std::memcpy(sandbox.localView + kDriverOffset, a.code().data(), a.code().size());
+
+        return true;
+    }
+
+    static bool setupThread(Sandbox& sandbox)
+    {
+        // The thread starts on a breakpoint at the start of the code region.
+        std::memset(sandbox.localView, 0xCC, kDriverOffset);
+
+        auto hThread = CreateRemoteThread(
+            sandbox.processInfo.hProcess, nullptr, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(sandbox.remoteView),
+            nullptr, 0, nullptr);
+
+        if (hThread == nullptr)
+        {
+            return false;
+        }
+
+        sandbox.hThread = hThread;
+
+        // Wait for the entry breakpoint.
+        if (!waitForBreakpoint(sandbox, sandbox.remoteView))
+        {
+            return false;
+        }
+
+        auto& threadContext = sandbox.threadContext;
+        threadContext.ContextFlags = CONTEXT_ALL;
+        if (!GetThreadContext(sandbox.hThread, &threadContext))
+        {
+            return false;
+        }
+
+        copyToRegisterFile(threadContext, sandbox.initialRegs);
+
+        // Clear all registers.
+        std::fill(std::begin(sandbox.initialRegs.gpr), std::end(sandbox.initialRegs.gpr), 0);
+
+        return true;
+    }
+
+    static void destroySandbox(Sandbox& sandbox)
+    {
+        if (sandbox.processInfo.hProcess != nullptr)
+        {
+            // Signal Termination
+            TerminateProcess(sandbox.processInfo.hProcess, 0);
+
+            // Continue last event.
+            ContinueDebugEvent(sandbox.dbgEvent.dwProcessId, sandbox.dbgEvent.dwThreadId, DBG_CONTINUE);
+
+            // Poll debug events so the process can exit.
+            for (;;)
+            {
+                DEBUG_EVENT dbgEvent{};
+                if (!WaitForDebugEvent(&dbgEvent, INFINITE))
+                    break;
+
+                if (dbgEvent.dwDebugEventCode == EXIT_PROCESS_DEBUG_EVENT)
+                {
+                    ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
+                    break;
+                }
+
+                ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
+            }
+
+            CloseHandle(sandbox.processInfo.hProcess);
+            CloseHandle(sandbox.processInfo.hThread);
+        }
+
+        if (sandbox.hThread != nullptr)
+        {
+            CloseHandle(sandbox.hThread);
+        }
+        if (sandbox.localView != nullptr)
+        {
+            UnmapViewOfFile(sandbox.localView);
+        }
+        if (sandbox.hSection != nullptr)
+        {
+            CloseHandle(sandbox.hSection);
+        }
+
+        sandbox = {};
+    }
+
+    static bool createSandbox(Sandbox& sandbox)
+    {
+        if (!spawnProcess(sandbox))
+        {
+            return false;
+        }
+
+        if (!createSection(sandbox))
+        {
+            return false;
+        }
+
+        if (!setupBatchDriver(sandbox))
+        {
+            return false;
+        }
+
+        if (!setupThread(sandbox))
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    // Sandboxes are kept per thread, debug events are only delivered to the thread that spawned the
+    // process. A context must therefore be cleaned up on the thread that prepared it.
+    class SandboxPool
+    {
+        std::vector<std::unique_ptr<Sandbox>> _sandboxes;
+
+    public:
+        ~SandboxPool()
+        {
+            for (auto& sandbox : _sandboxes)
+            {
+                destroySandbox(*sandbox);
+            }
+        }
+
+        Sandbox* acquire()
+        {
+            for (auto& sandbox : _sandboxes)
+            {
+                if (!sandbox->inUse)
+                {
+                    sandbox->inUse = true;
+                    return sandbox.get();
+                }
+            }
+
+            auto sandbox = std::make_unique<Sandbox>();
+            if (!createSandbox(*sandbox))
+            {
+                destroySandbox(*sandbox);
+                return nullptr;
+            }
+
+            sandbox->inUse = true;
+            return _sandboxes.emplace_back(std::move(sandbox)).get();
+        }
+
+        void release(Sandbox* sandbox)
+        {
+            sandbox->inUse = false;
+            if (!sandbox->broken)
+                return;
+
+            auto it = std::find_if(
+                _sandboxes.begin(), _sandboxes.end(), [&](const auto& entry) { return entry.get() == sandbox; });
+            if (it != _sandboxes.end())
+            {
+                destroySandbox(**it);
+                _sandboxes.erase(it);
+            }
+        }
+    };
+
+    static thread_local SandboxPool tlsSandboxPool;
+
+    bool prepare(Context* ctx, std::span<const std::span<const std::uint8_t>> codes)
+    {
+        auto* sandbox = tlsSandboxPool.acquire();
+        if (sandbox == nullptr)
+        {
+            return false;
+        }
+
+        ctx->debugger.sandbox = sandbox;
+
+        // The code page and thread are reused, only the code is replaced.
+        if (!writeCodeSlots(
+                std::span(sandbox->localView, kDriverOffset), sandbox->remoteView, codes, sandbox->batchStoreAddr))
+        {
+            Debugger::cleanup(ctx);
+            return false;
+        }
+
+        FlushInstructionCache(
+            sandbox->processInfo.hProcess, reinterpret_cast<void*>(sandbox->remoteView), kDriverOffset);
+
+        ctx->codeBase = sandbox->remoteView;
+        ctx->dataAddr = sandbox->remoteView + kDataOffset;
+        ctx->regs = sandbox->initialRegs;
+
+        return true;
+    }
+
+    static bool setDriverContext(Sandbox& sandbox)
+    {
+        sandbox.threadContext.ContextFlags = CONTEXT_CONTROL;
+        sandbox.threadContext.Rip = sandbox.batchLoopAddr;
+        sandbox.threadContext.Rsp = sandbox.scratchStackTop;
+        sandbox.threadContext.EFlags &= ~kTrapFlag;
+
+        if (SetThreadContext(sandbox.hThread, &sandbox.threadContext) == FALSE)
+        {
+            std::print("SetThreadContext failed: {:X}\n", GetLastError());
+            return false;
+        }
+
+        return true;
+    }
+
+    static bool runBatch(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs)
+    {
+        auto& sandbox = *ctx->debugger.sandbox;
+
+        auto* control = reinterpret_cast<BatchControl*>(sandbox.localView + kControlOffset);
+        auto* entries = reinterpret_cast<BatchEntry*>(sandbox.localView + kEntriesOffset);
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            entries[i].regs = inputs[i];
+            entries[i].status = ExecutionStatus::Idle;
+            sanitizeRegisterFile(entries[i].regs);
+            storeXState(entries[i].regs, ctx->stateMask, entries[i].xsave);
+        }
+
+        control->index = 0;
+        control->count = inputs.size();
+        control->stateMask = ctx->stateMask;
+        control->codeAddr = ctx->codeAddr;
+
+        if (!setDriverContext(sandbox))
+        {
+            return false;
+        }
+
+        auto& dbgEvent = sandbox.dbgEvent;
+        if (!ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE))
+        {
+            std::print("ContinueDebugEvent failed: {:X}\n", GetLastError());
+            sandbox.broken = true;
+            return false;
+        }
+
+        bool res = true;
+        while (WaitForDebugEvent(&dbgEvent, INFINITE))
+        {
+            if (dbgEvent.dwDebugEventCode == EXCEPTION_DEBUG_EVENT)
+            {
+                const auto& record = dbgEvent.u.Exception.ExceptionRecord;
+                const auto exceptionAddress = reinterpret_cast<std::uintptr_t>(record.ExceptionAddress);
+
+                if (exceptionAddress == sandbox.batchDoneAddr)
+                {
+                    // All entries ran, the event stays pending like after execute().
+                    break;
+                }
+
+                if (exceptionAddress >= sandbox.remoteView && exceptionAddress < sandbox.remoteView + kControlOffset
+                    && control->index < control->count)
+                {
+                    // Mark the faulting entry and carry on with the next one.
+                    auto& entry = entries[control->index];
+                    entry.status = getExceptionStatus(record.ExceptionCode).value_or(ExecutionStatus::Idle);
+
+                    sandbox.threadContext.ContextFlags = CONTEXT_ALL;
+                    if (!GetThreadContext(sandbox.hThread, &sandbox.threadContext))
+                    {
+                        res = false;
+                        break;
+                    }
+                    copyToRegisterFile(sandbox.threadContext, entry.regs);
+
+                    control->index++;
+
+                    if (!setDriverContext(sandbox))
+                    {
+                        res = false;
+                        break;
+                    }
+
+                    ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
+                    continue;
+                }
+            }
+
+            const auto status = handleDbgEvent(ctx, dbgEvent);
+            if (status == DebugStatus::Faulted || status == DebugStatus::Terminated)
+            {
+                res = false;
+                break;
+            }
+
+            ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
+        }
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            outputs[i].regs = entries[i].regs;
+            outputs[i].status = entries[i].status;
+
+            // The store stub doesn't record RIP, report it as stopped on the breakpoint after the code. Faulted
+            // entries hold the thread context instead, the other components keep their input values.
+            if (outputs[i].status == ExecutionStatus::Success)
+            {
+                loadXState(entries[i].xsave, ctx->stateMask, outputs[i].regs);
+                outputs[i].regs.rip = getCodeEnd(ctx);
+            }
+        }
+
+        return res;
+    }
+
+    bool executeBatch(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs)
+    {
+        bool res = true;
+        for (std::size_t offset = 0; offset < inputs.size() && res; offset += kBatchCapacity)
+        {
+            const auto count = std::min(kBatchCapacity, inputs.size() - offset);
+            res = runBatch(ctx, inputs.subspan(offset, count), outputs.subspan(offset, count));
+        }
+
+        return res;
+    }
+
+    bool execute(Context* ctx)
+    {
+        // Runs through the driver as well, the registers never go through a CONTEXT.
+        OutputState output{};
+        if (!executeBatch(ctx, std::span<const InputState>(&ctx->regs, 1), std::span(&output, 1)))
+        {
+            return false;
+        }
+
+        ctx->regs = output.regs;
+        ctx->status = output.status;
+
+        return true;
+    }
+
+    void cleanup(Context* ctx)
+    {
+        auto* sandbox = ctx->debugger.sandbox;
+        if (sandbox == nullptr)
+            return;
+
+        tlsSandboxPool.release(sandbox);
+        ctx->debugger.sandbox = nullptr;
+    }
+
+} // namespace x86Tester::Execution::Debugger
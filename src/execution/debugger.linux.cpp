@@ -0,0 +1,598 @@
+#include "context.hpp"
+#include "stubs.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <linux/futex.h>
+#include <memory>
+#include <print>
+#include <span>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// The sandbox is a forked child that runs the batch driver from a region shared with this process, faults are
+// caught by a signal handler in the child. There is no debugger involved, the namespace matches the backend.
+namespace x86Tester::Execution::Debugger
+{
+    using namespace Stubs;
+
+    // Same layout as the section of the Windows sandbox.
+    static constexpr std::size_t kDriverOffset = kMaxCodeSlots * kCodeSlotSize;
+    static constexpr std::size_t kControlOffset = kDriverOffset + 0x1000;
+    static constexpr std::size_t kEntriesOffset = kControlOffset + 0x1000;
+    static constexpr std::size_t kBatchCapacity = 256;
+
+    // The host state is kept in an FXSAVE area on the stack of the sandbox while the driver runs.
+    static constexpr std::uint32_t kHostFrameSize = sizeof(FxSaveArea);
+
+    static constexpr ZydisRegister kNonVolatileRegs[] = {
+        ZYDIS_REGISTER_RBX, ZYDIS_REGISTER_RBP, ZYDIS_REGISTER_R12,
+        ZYDIS_REGISTER_R13, ZYDIS_REGISTER_R14, ZYDIS_REGISTER_R15,
+    };
+
+    // The loaded RSP is arbitrary, signals are delivered on a stack of their own.
+    static constexpr std::size_t kSignalStackSize = 0x10000;
+
+    struct BatchControl
+    {
+        std::uint64_t index;
+        std::uint64_t count;
+        // Address of the current entry, the load/store stubs read the register file through it.
+        std::uint64_t current;
+        std::uint64_t scratchRax;
+        // Components for xrstor/xsave.
+        std::uint64_t stateMask;
+        // Stack pointer of the sandbox loop while the driver runs.
+        std::uint64_t hostRsp;
+        // Code of the selected slot, the driver jumps through it.
+        std::uint64_t codeAddr;
+        // Futex words, a batch is requested by incrementing request and done once completed matches it.
+        std::uint32_t request;
+        std::uint32_t completed;
+    };
+
+    struct BatchEntry
+    {
+        RegisterFile regs;
+        ExecutionStatus status;
+        // Loaded and stored by the stubs, only the components of the state mask are transferred.
+        XSaveArea xsave;
+    };
+
+    // Memory operands address the data window at the end of the arena page, the pages on either side are
+    // inaccessible so an access that leaves the arena faults instead of overwriting the entries.
+    static constexpr std::size_t kLowerGuardOffset =
+        (kEntriesOffset + kBatchCapacity * sizeof(BatchEntry) + 0xFFF) & ~std::size_t{ 0xFFF };
+    static constexpr std::size_t kArenaOffset = kLowerGuardOffset + 0x1000;
+    static constexpr std::size_t kUpperGuardOffset = kArenaOffset + 0x1000;
+    static constexpr std::size_t kDataOffset = kUpperGuardOffset - kDataWindowSize;
+    static constexpr std::size_t kSectionSize = kUpperGuardOffset + 0x1000;
+
+    static constexpr std::int64_t kEntryDataOffset = offsetof(BatchEntry, regs) + offsetof(RegisterFile, data);
+
+    // Long-lived sandbox process, waits on the control block when not executing.
+    struct Sandbox
+    {
+        pid_t pid{};
+        // Shared mapping created before the fork, both processes see it at the same address.
+        std::byte* view{};
+        std::uintptr_t entryAddr{};
+        std::uintptr_t batchLoopAddr{};
+        std::uintptr_t batchStoreAddr{};
+        std::uint64_t scratchStackTop{};
+        // State of a fresh thread with all GPRs cleared.
+        RegisterFile initialRegs{};
+        std::uint32_t lastRequest{};
+        bool inUse{};
+        // The process exited or ended up in an unknown state, it is not handed out again.
+        bool broken{};
+    };
+
+    static BatchControl& getControl(const Sandbox& sandbox)
+    {
+        return *reinterpret_cast<BatchControl*>(sandbox.view + kControlOffset);
+    }
+
+    static BatchEntry* getEntries(const Sandbox& sandbox)
+    {
+        return reinterpret_cast<BatchEntry*>(sandbox.view + kEntriesOffset);
+    }
+
+    // Returns false once the timeout expired.
+    static bool futexWait(std::uint32_t* word, std::uint32_t expected, const timespec* timeout)
+    {
+        const auto res = syscall(SYS_futex, word, FUTEX_WAIT, expected, timeout, nullptr, 0);
+        return res == 0 || errno != ETIMEDOUT;
+    }
+
+    static void futexWake(std::uint32_t* word)
+    {
+        syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    // Only set in the sandbox process.
+    static const Sandbox* activeSandbox = nullptr;
+
+    static void sandboxSignalHandler(int, siginfo_t* info, void* ucontext)
+    {
+        const auto& sandbox = *activeSandbox;
+        auto& control = getControl(sandbox);
+        auto& uc = *static_cast<ucontext_t*>(ucontext);
+        auto& gregs = uc.uc_mcontext.gregs;
+
+        const auto rip = static_cast<std::uintptr_t>(gregs[REG_RIP]);
+        const auto viewAddr = reinterpret_cast<std::uintptr_t>(sandbox.view);
+        if (rip < viewAddr || rip >= viewAddr + kControlOffset || control.index >= control.count)
+        {
+            // Unknown state, the host notices the exit.
+            _exit(EXIT_FAILURE);
+        }
+
+        // Mark the faulting entry and carry on with the next one.
+        auto& entry = getEntries(sandbox)[control.index];
+        copyToRegisterFile(uc, entry.regs);
+        entry.status = getSignalStatus(*info, entry.regs).value_or(ExecutionStatus::Idle);
+
+        control.index++;
+
+        gregs[REG_RIP] = static_cast<greg_t>(sandbox.batchLoopAddr);
+        gregs[REG_RSP] = static_cast<greg_t>(sandbox.scratchStackTop);
+        gregs[REG_EFL] &= ~static_cast<greg_t>(kTrapFlag);
+    }
+
+    static bool installSandboxHandlers()
+    {
+        auto* signalStack = mmap(nullptr, kSignalStackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (signalStack == MAP_FAILED)
+        {
+            return false;
+        }
+
+        stack_t stack{};
+        stack.ss_sp = signalStack;
+        stack.ss_size = kSignalStackSize;
+        if (sigaltstack(&stack, nullptr) != 0)
+        {
+            return false;
+        }
+
+        struct sigaction action{};
+        action.sa_sigaction = sandboxSignalHandler;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+
+        sigset_t unblocked;
+        sigemptyset(&unblocked);
+        for (const auto signal : kFaultSignals)
+        {
+            if (sigaction(signal, &action, nullptr) != 0)
+            {
+                return false;
+            }
+            sigaddset(&unblocked, signal);
+        }
+
+        // The mask is inherited from the thread that forked, a blocked fault would kill the process.
+        return sigprocmask(SIG_UNBLOCK, &unblocked, nullptr) == 0;
+    }
+
+    // Entry of the forked process, only the calling thread was copied so everything from here on has to
+    // be async-signal-safe.
+    [[noreturn]] static void runSandbox(const Sandbox& sandbox, pid_t hostPid)
+    {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != hostPid)
+        {
+            _exit(EXIT_FAILURE);
+        }
+
+        activeSandbox = &sandbox;
+        if (!installSandboxHandlers())
+        {
+            _exit(EXIT_FAILURE);
+        }
+
+        auto& control = getControl(sandbox);
+        std::atomic_ref request(control.request);
+        std::atomic_ref completed(control.completed);
+
+        std::uint32_t handled = 0;
+        for (;;)
+        {
+            std::uint32_t current;
+            while ((current = request.load(std::memory_order_acquire)) == handled)
+            {
+                futexWait(&control.request, handled, nullptr);
+            }
+
+            reinterpret_cast<void (*)()>(sandbox.entryAddr)();
+
+            handled = current;
+            completed.store(current, std::memory_order_release);
+            futexWake(&control.completed);
+        }
+    }
+
+    static bool spawnProcess(Sandbox& sandbox)
+    {
+        const auto hostPid = getpid();
+        const auto pid = fork();
+        if (pid < 0)
+        {
+            return false;
+        }
+
+        if (pid == 0)
+        {
+            runSandbox(sandbox, hostPid);
+        }
+
+        sandbox.pid = pid;
+        return true;
+    }
+
+    static bool createSection(Sandbox& sandbox)
+    {
+        // Try to map at a predictable address, later sandboxes of the same process fall back to the others.
+        const std::uintptr_t preferredAddresses[] = { kPreferredCodeBase, 0x05000000, 0 };
+        for (const auto preferredAddr : preferredAddresses)
+        {
+            const int flags = MAP_SHARED | MAP_ANONYMOUS | (preferredAddr != 0 ? MAP_FIXED_NOREPLACE : 0);
+            auto* view = mmap(
+                reinterpret_cast<void*>(preferredAddr), kSectionSize, PROT_READ | PROT_WRITE | PROT_EXEC, flags, -1,
+                0);
+            if (view == MAP_FAILED)
+            {
+                continue;
+            }
+
+            // Kernels before 4.17 treat the address as a hint.
+            if (preferredAddr != 0 && reinterpret_cast<std::uintptr_t>(view) != preferredAddr)
+            {
+                munmap(view, kSectionSize);
+                continue;
+            }
+
+            sandbox.view = static_cast<std::byte*>(view);
+
+            // Inherited by the sandbox with the mapping.
+            return mprotect(sandbox.view + kLowerGuardOffset, 0x1000, PROT_NONE) == 0
+                && mprotect(sandbox.view + kUpperGuardOffset, 0x1000, PROT_NONE) == 0;
+        }
+
+        return false;
+    }
+
+    static bool setupBatchDriver(Sandbox& sandbox)
+    {
+        const auto remoteView = reinterpret_cast<std::uintptr_t>(sandbox.view);
+        const auto controlAddr = remoteView + kControlOffset;
+        const auto entriesAddr = remoteView + kEntriesOffset;
+        const auto dataAddr = remoteView + kDataOffset;
+
+        sandbox.scratchStackTop = entriesAddr;
+
+        const auto regOptions = RegisterStubOptions{
+            .regsAddress = controlAddr + offsetof(BatchControl, current),
+            .regsIndirect = true,
+            .scratchAddress = controlAddr + offsetof(BatchControl, scratchRax),
+            .includeStackPointer = true,
+            .scratchStackTop = sandbox.scratchStackTop,
+            .stateMaskAddress = isXSaveEnabled() ? controlAddr + offsetof(BatchControl, stateMask) : 0,
+            .stateOffset = offsetof(BatchEntry, xsave),
+        };
+
+        Assembler a(remoteView + kDriverOffset);
+
+        // Reached once all entries ran, returns to the sandbox loop.
+        const auto batchDoneAddr = a.address();
+        if ((getSupportedStateComponents() & kXStateAvx) != 0)
+        {
+            a.emit(ZYDIS_MNEMONIC_VZEROUPPER);
+        }
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(controlAddr));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RSP), mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, hostRsp), 8));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RSP));
+        a.stateOp(StateOp::FxRstor, ZYDIS_REGISTER_RAX, 0);
+        a.emit(ZYDIS_MNEMONIC_ADD, reg(ZYDIS_REGISTER_RSP), imm(kHostFrameSize));
+        a.emit(ZYDIS_MNEMONIC_POPFQ);
+        for (auto it = std::rbegin(kNonVolatileRegs); it != std::rend(kNonVolatileRegs); ++it)
+        {
+            a.emit(ZYDIS_MNEMONIC_POP, reg(*it));
+        }
+        a.emit(ZYDIS_MNEMONIC_RET);
+
+        // Called by the sandbox loop, saves its state and falls through into the driver.
+        sandbox.entryAddr = a.address();
+        for (const auto nonVolatileReg : kNonVolatileRegs)
+        {
+            a.emit(ZYDIS_MNEMONIC_PUSH, reg(nonVolatileReg));
+        }
+        a.emit(ZYDIS_MNEMONIC_PUSHFQ);
+        a.emit(ZYDIS_MNEMONIC_SUB, reg(ZYDIS_REGISTER_RSP), imm(kHostFrameSize));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RSP));
+        a.stateOp(StateOp::FxSave, ZYDIS_REGISTER_RAX, 0);
+        a.storeRaxAbsolute(controlAddr + offsetof(BatchControl, hostRsp));
+
+        // Select the next entry.
+        sandbox.batchLoopAddr = a.address();
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(controlAddr));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, index), 8));
+        a.emit(ZYDIS_MNEMONIC_CMP, reg(ZYDIS_REGISTER_RAX), mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, count), 8));
+        a.branch(ZYDIS_MNEMONIC_JNB, batchDoneAddr);
+        a.emit(ZYDIS_MNEMONIC_IMUL, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RAX), imm(sizeof(BatchEntry)));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RDX), imm(entriesAddr));
+        a.emit(ZYDIS_MNEMONIC_ADD, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RDX));
+        a.emit(ZYDIS_MNEMONIC_MOV, mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, current), 8), reg(ZYDIS_REGISTER_RAX));
+
+        // Memory inputs of the entry, the registers are loaded afterwards.
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(dataAddr));
+        emitCopy(a, ZYDIS_REGISTER_RCX, 0, ZYDIS_REGISTER_RAX, kEntryDataOffset, ZYDIS_REGISTER_RDX, kDataWindowSize);
+
+        // Run the code at its regular address so results match execute().
+        emitLoadRegisters(a, regOptions);
+        a.jmpIndirect(controlAddr + offsetof(BatchControl, codeAddr));
+
+        // The code of every slot is followed by a jump to here.
+        sandbox.batchStoreAddr = a.address();
+        emitStoreRegisters(a, regOptions);
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(dataAddr));
+        emitCopy(a, ZYDIS_REGISTER_RAX, kEntryDataOffset, ZYDIS_REGISTER_RCX, 0, ZYDIS_REGISTER_RDX, kDataWindowSize);
+        a.emit(
+            ZYDIS_MNEMONIC_MOV, mem(ZYDIS_REGISTER_RAX, offsetof(BatchEntry, status), 4),
+            imm(static_cast<std::uint64_t>(ExecutionStatus::Success)));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(controlAddr));
+        a.emit(ZYDIS_MNEMONIC_ADD, mem(ZYDIS_REGISTER_RCX, offsetof(BatchControl, index), 8), imm(1));
+        a.jmp(sandbox.batchLoopAddr);
+
+        if (!a.ok() || kDriverOffset + a.code().size() > kControlOffset)
+        {
+            return false;
+        }
+
+        std::memcpy(sandbox.view + kDriverOffset, a.code().data(), a.code().size());
+
+        return true;
+    }
+
+    static void destroySandbox(Sandbox& sandbox)
+    {
+        if (sandbox.pid > 0)
+        {
+            kill(sandbox.pid, SIGKILL);
+            waitpid(sandbox.pid, nullptr, 0);
+        }
+        if (sandbox.view != nullptr)
+        {
+            munmap(sandbox.view, kSectionSize);
+        }
+
+        sandbox = {};
+    }
+
+    static bool createSandbox(Sandbox& sandbox)
+    {
+        if (!createSection(sandbox))
+        {
+            return false;
+        }
+
+        if (!setupBatchDriver(sandbox))
+        {
+            return false;
+        }
+
+        // Same state as a fresh thread, the sandbox process never exposes its own registers.
+        sandbox.initialRegs.eflags = 0x202;
+        sandbox.initialRegs.fx.controlWord = 0x027F;
+        sandbox.initialRegs.fx.mxcsr = 0x1F80;
+        sandbox.initialRegs.fx.mxcsrMask = getMxcsrMask();
+
+        // Forked last, the process inherits the driver and the fields its signal handler reads.
+        std::memset(sandbox.view, 0xCC, kDriverOffset);
+        return spawnProcess(sandbox);
+    }
+
+    // Sandboxes are kept per thread like on Windows, a context must be cleaned up on the thread that
+    // prepared it. The process is killed when the thread that forked it exits.
+    class SandboxPool
+    {
+        std::vector<std::unique_ptr<Sandbox>> _sandboxes;
+
+    public:
+        ~SandboxPool()
+        {
+            for (auto& sandbox : _sandboxes)
+            {
+                destroySandbox(*sandbox);
+            }
+        }
+
+        Sandbox* acquire()
+        {
+            for (auto& sandbox : _sandboxes)
+            {
+                if (!sandbox->inUse)
+                {
+                    sandbox->inUse = true;
+                    return sandbox.get();
+                }
+            }
+
+            auto sandbox = std::make_unique<Sandbox>();
+            if (!createSandbox(*sandbox))
+            {
+                destroySandbox(*sandbox);
+                return nullptr;
+            }
+
+            sandbox->inUse = true;
+            return _sandboxes.emplace_back(std::move(sandbox)).get();
+        }
+
+        void release(Sandbox* sandbox)
+        {
+            sandbox->inUse = false;
+            if (!sandbox->broken)
+                return;
+
+            auto it = std::find_if(
+                _sandboxes.begin(), _sandboxes.end(), [&](const auto& entry) { return entry.get() == sandbox; });
+            if (it != _sandboxes.end())
+            {
+                destroySandbox(**it);
+                _sandboxes.erase(it);
+            }
+        }
+    };
+
+    static thread_local SandboxPool tlsSandboxPool;
+
+    bool prepare(Context* ctx, std::span<const std::span<const std::uint8_t>> codes)
+    {
+        auto* sandbox = tlsSandboxPool.acquire();
+        if (sandbox == nullptr)
+        {
+            return false;
+        }
+
+        ctx->debugger.sandbox = sandbox;
+
+        // The shared region and process are reused, only the code is replaced.
+        const auto remoteView = reinterpret_cast<std::uintptr_t>(sandbox->view);
+        if (!writeCodeSlots(std::span(sandbox->view, kDriverOffset), remoteView, codes, sandbox->batchStoreAddr))
+        {
+            Debugger::cleanup(ctx);
+            return false;
+        }
+
+        ctx->codeBase = remoteView;
+        ctx->dataAddr = remoteView + kDataOffset;
+        ctx->regs = sandbox->initialRegs;
+
+        return true;
+    }
+
+    static bool isAlive(Sandbox& sandbox)
+    {
+        if (waitpid(sandbox.pid, nullptr, WNOHANG) == 0)
+            return true;
+
+        sandbox.pid = 0;
+        return false;
+    }
+
+    static bool waitForBatch(Sandbox& sandbox, std::uint32_t request)
+    {
+        auto& control = getControl(sandbox);
+        std::atomic_ref completed(control.completed);
+
+        // Wakes up now and then to notice a sandbox that exited.
+        const timespec timeout{ .tv_sec = 0, .tv_nsec = 100'000'000 };
+        for (;;)
+        {
+            const auto current = completed.load(std::memory_order_acquire);
+            if (current == request)
+                return true;
+
+            if (!futexWait(&control.completed, current, &timeout) && !isAlive(sandbox))
+                return false;
+        }
+    }
+
+    static bool runBatch(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs)
+    {
+        auto& sandbox = *ctx->debugger.sandbox;
+
+        auto& control = getControl(sandbox);
+        auto* entries = getEntries(sandbox);
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            entries[i].regs = inputs[i];
+            entries[i].status = ExecutionStatus::Idle;
+            sanitizeRegisterFile(entries[i].regs);
+            storeXState(entries[i].regs, ctx->stateMask, entries[i].xsave);
+        }
+
+        control.index = 0;
+        control.count = inputs.size();
+        control.stateMask = ctx->stateMask;
+        control.codeAddr = ctx->codeAddr;
+
+        const auto request = ++sandbox.lastRequest;
+        std::atomic_ref(control.request).store(request, std::memory_order_release);
+        futexWake(&control.request);
+
+        bool res = true;
+        if (!waitForBatch(sandbox, request))
+        {
+            std::print("Sandbox terminated unexpectedly\n");
+            sandbox.broken = true;
+            res = false;
+        }
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            outputs[i].regs = entries[i].regs;
+            outputs[i].status = entries[i].status;
+
+            // The store stub doesn't record RIP, report it as stopped on the breakpoint after the code. Faulted
+            // entries hold the signal frame instead, the other components keep their input values.
+            if (outputs[i].status == ExecutionStatus::Success)
+            {
+                loadXState(entries[i].xsave, ctx->stateMask, outputs[i].regs);
+                outputs[i].regs.rip = getCodeEnd(ctx);
+            }
+        }
+
+        return res;
+    }
+
+    bool executeBatch(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs)
+    {
+        bool res = true;
+        for (std::size_t offset = 0; offset < inputs.size() && res; offset += kBatchCapacity)
+        {
+            const auto count = std::min(kBatchCapacity, inputs.size() - offset);
+            res = runBatch(ctx, inputs.subspan(offset, count), outputs.subspan(offset, count));
+        }
+
+        return res;
+    }
+
+    bool execute(Context* ctx)
+    {
+        OutputState output{};
+        if (!Debugger::executeBatch(ctx, std::span<const InputState>(&ctx->regs, 1), std::span(&output, 1)))
+        {
+            return false;
+        }
+
+        ctx->regs = output.regs;
+        ctx->status = output.status;
+
+        return true;
+    }
+
+    void cleanup(Context* ctx)
+    {
+        auto* sandbox = ctx->debugger.sandbox;
+        if (sandbox == nullptr)
+            return;
+
+        tlsSandboxPool.release(sandbox);
+        ctx->debugger.sandbox = nullptr;
+    }
+
+} // namespace x86Tester::Execution::Debugger
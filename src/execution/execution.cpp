@@ -1,491 +1,588 @@
-#include "x86tester/execution.hpp"
+#include "context.hpp"
 
 #include <Zydis/Disassembler.h>
-#include <Zydis/Encoder.h>
-#include <array>
-#include <filesystem>
-#include <intrin.h>
-#include <print>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
 #include <span>
-#include <unordered_map>
+#include <x86Tester/profiling.hpp>
 
-#ifndef WIN32_LEAN_AND_MEAN
-#    define WIN32_LEAN_AND_MEAN
+#ifdef _MSC_VER
+#    include <intrin.h>
+#else
+#    include <cpuid.h>
 #endif
-#ifndef NOMINMAX
-#    define NOMINMAX
-#endif
-#include <Windows.h>
 
 namespace x86Tester::Execution
 {
-    struct Context
+    static void cpuid(int regs[4], int leaf, int subLeaf)
     {
-        STARTUPINFOW startupInfo{};
-        PROCESS_INFORMATION processInfo{};
-        HANDLE hThread{};
-        std::uintptr_t codeBase{};
-        std::uintptr_t codeAddr{};
-        std::size_t codeSize{};
-        std::uintptr_t breakAddr{};
-        CONTEXT threadContext{};
-        DEBUG_EVENT dbgEvent{};
-        ExecutionStatus status{};
-    };
+#ifdef _MSC_VER
+        __cpuidex(regs, leaf, subLeaf);
+#else
+        unsigned int eax, ebx, ecx, edx;
+        __cpuid_count(leaf, subLeaf, eax, ebx, ecx, edx);
+        regs[0] = static_cast<int>(eax);
+        regs[1] = static_cast<int>(ebx);
+        regs[2] = static_cast<int>(ecx);
+        regs[3] = static_cast<int>(edx);
+#endif
+    }
 
-    static std::filesystem::path getExecutingPath()
+    // XCR0, only valid when the OS enabled XSAVE.
+    static std::uint64_t getEnabledStateComponents()
     {
-        wchar_t path[2048]{};
-        GetModuleFileNameW(nullptr, path, std::size(path));
-
-        auto* lastSlash = std::wcsrchr(path, L'\\');
-        if (!lastSlash)
-        {
-            return path;
-        }
-
-        *lastSlash = L'\0';
-        return path;
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        std::uint32_t lo, hi;
+        asm volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (std::uint64_t{ hi } << 32) | lo;
+#endif
     }
 
-    enum class DebugStatus
+#ifdef _WIN32
+    std::optional<ExecutionStatus> getExceptionStatus(DWORD exceptionCode)
     {
-        Continue,
-        SystemBreak,
-        Exit,
-        Faulted,
-    };
+        switch (exceptionCode)
+        {
+            case EXCEPTION_INT_DIVIDE_BY_ZERO:
+                return ExecutionStatus::ExceptionIntDivideError;
+            case EXCEPTION_INT_OVERFLOW:
+                return ExecutionStatus::ExceptionIntOverflow;
+            case EXCEPTION_ILLEGAL_INSTRUCTION:
+                return ExecutionStatus::IllegalInstruction;
+            case EXCEPTION_ACCESS_VIOLATION:
+                return ExecutionStatus::ExceptionAccessViolation;
+        }
+        return std::nullopt;
+    }
+#elif defined(__linux__)
+    static std::uint64_t getEffectiveAddress(
+        const ZydisDecodedInstruction& instr, const ZydisDecodedOperandMem& mem, const RegisterFile& regs)
+    {
+        auto address = static_cast<std::uint64_t>(mem.disp.value);
+        if (mem.base == ZYDIS_REGISTER_RIP)
+            address += regs.rip + instr.length;
+        else if (mem.base != ZYDIS_REGISTER_NONE)
+            address += getRegValue<std::uint64_t>(regs, mem.base);
+        if (mem.index != ZYDIS_REGISTER_NONE)
+            address += getRegValue<std::uint64_t>(regs, mem.index) * mem.scale;
+        return instr.address_width == 32 ? address & 0xFFFFFFFF : address;
+    }
 
-    static void dumpDisassembly(Context* ctx, std::uintptr_t activeAddress)
+    static bool isZeroDivisor(const RegisterFile& regs)
     {
-        // Decode the entire code region.
-        for (size_t n = 0; n < ctx->codeSize;)
-        {
-            const std::uintptr_t addr = ctx->codeBase + n;
+        const auto mode = ZYDIS_MACHINE_MODE_LONG_64;
 
-            std::uint8_t buffer[16]{};
-            SIZE_T read;
-            ReadProcessMemory(ctx->processInfo.hProcess, reinterpret_cast<void*>(addr), buffer, sizeof(buffer), &read);
+        ZydisDecoder decoder;
+        ZydisDecoderInit(&decoder, mode, ZYDIS_STACK_WIDTH_64);
 
-            ZydisDisassembledInstruction instr;
-            ZydisDisassembleIntel(ZYDIS_MACHINE_MODE_LONG_64, addr, buffer, read, &instr);
+        ZydisDecodedInstruction instr;
+        ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+        if (ZYAN_FAILED(ZydisDecoderDecodeFull(
+                &decoder, reinterpret_cast<const void*>(regs.rip), ZYDIS_MAX_INSTRUCTION_LENGTH, &instr, operands)))
+            return true;
+
+        // The divisor is the only explicit operand, a memory divisor is read from the process that faulted
+        // which is the one running this handler.
+        const auto& op = operands[0];
+        if (instr.operand_count_visible != 1)
+            return true;
+
+        std::span<const std::uint8_t> divisor;
+        if (op.type == ZYDIS_OPERAND_TYPE_REGISTER)
+        {
+            const auto data = getRegBytes(regs, ZydisRegisterGetLargestEnclosing(mode, op.reg.value));
+            const auto isHigh8 = op.reg.value == ZYDIS_REGISTER_AH || op.reg.value == ZYDIS_REGISTER_CH
+                                 || op.reg.value == ZYDIS_REGISTER_DH || op.reg.value == ZYDIS_REGISTER_BH;
+            divisor = data.subspan(isHigh8 ? 1 : 0, ZydisRegisterGetWidth(mode, op.reg.value) / 8);
+        }
+        else if (op.type == ZYDIS_OPERAND_TYPE_MEMORY && op.mem.type == ZYDIS_MEMOP_TYPE_MEM)
+        {
+            const auto address = getEffectiveAddress(instr, op.mem, regs);
+            divisor = std::span(reinterpret_cast<const std::uint8_t*>(address), op.size / 8);
+        }
+        else
+            return true;
 
-            std::print("{}{:016X} ", addr == activeAddress ? ">" : " ", addr);
+        return std::all_of(divisor.begin(), divisor.end(), [](std::uint8_t value) { return value == 0; });
+    }
 
-            n += instr.info.length;
+    std::optional<ExecutionStatus> getSignalStatus(const siginfo_t& info, const RegisterFile& regs)
+    {
+        switch (info.si_signo)
+        {
+            case SIGFPE:
+                if (info.si_code == FPE_INTDIV)
+                    return isZeroDivisor(regs) ? ExecutionStatus::ExceptionIntDivideError
+                                               : ExecutionStatus::ExceptionIntOverflow;
+                if (info.si_code == FPE_INTOVF)
+                    return ExecutionStatus::ExceptionIntOverflow;
+                break;
+            case SIGILL:
+                return ExecutionStatus::IllegalInstruction;
+            case SIGSEGV:
+                // General protection faults are reported as SI_KERNEL, only page faults are accesses.
+                if (info.si_code == SEGV_MAPERR || info.si_code == SEGV_ACCERR)
+                    return ExecutionStatus::ExceptionAccessViolation;
+                break;
+            case SIGBUS:
+                return ExecutionStatus::ExceptionAccessViolation;
         }
+        return std::nullopt;
     }
+#endif
 
-    static DebugStatus handleException(Context* ctx, const EXCEPTION_RECORD& record)
+    std::uint32_t getMxcsrMask()
     {
-        const auto exceptionAddress = reinterpret_cast<uintptr_t>(record.ExceptionAddress);
+        static const std::uint32_t mask = []() {
+            FxSaveArea fx{};
+#ifdef _MSC_VER
+            _fxsave64(&fx);
+#else
+            asm volatile("fxsave64 %0" : "=m"(fx));
+#endif
+            // Zero means the CPU predates the mask field, use the documented default.
+            return fx.mxcsrMask != 0 ? fx.mxcsrMask : 0xFFBF;
+        }();
+        return mask;
+    }
 
-        if (record.ExceptionCode == EXCEPTION_BREAKPOINT)
-        {
-            if (exceptionAddress == ctx->breakAddr)
-            {
-                // std::print("Successfully executed instruction\n");
-                ctx->status = ExecutionStatus::Success;
-                return DebugStatus::Exit;
-            }
-            else if (exceptionAddress == ctx->codeBase)
+    bool isXSaveEnabled()
+    {
+        static const bool enabled = []() {
+            int regs[4]{};
+            cpuid(regs, 1, 0);
+            // OSXSAVE
+            if ((regs[2] & (1 << 27)) == 0)
+                return false;
+            return (getEnabledStateComponents() & kXStateLegacy) == kXStateLegacy;
+        }();
+        return enabled;
+    }
+
+    std::uint64_t getSupportedStateComponents()
+    {
+        static const std::uint64_t components = []() {
+            if (!isXSaveEnabled())
+                return kXStateLegacy;
+
+            const auto isPlacedAt = [](int component, std::size_t offset, std::size_t size) {
+                int regs[4]{};
+                cpuid(regs, 0xD, component);
+                return static_cast<std::size_t>(regs[0]) == size && static_cast<std::size_t>(regs[1]) == offset;
+            };
+
+            const auto enabled = getEnabledStateComponents();
+            auto res = kXStateLegacy;
+            if ((enabled & kXStateAvx) != 0
+                && isPlacedAt(2, offsetof(XSaveArea, ymmHi128), sizeof(XSaveArea::ymmHi128)))
             {
-                // Entry breakpoint.
-                return DebugStatus::Exit;
+                res |= kXStateAvx;
             }
-            if (ctx->breakAddr == 0)
+            if ((res & kXStateAvx) != 0 && (enabled & kXStateAvx512) == kXStateAvx512
+                && isPlacedAt(5, offsetof(XSaveArea, opmask), sizeof(XSaveArea::opmask))
+                && isPlacedAt(6, offsetof(XSaveArea, zmmHi256), sizeof(XSaveArea::zmmHi256))
+                && isPlacedAt(7, offsetof(XSaveArea, hi16Zmm), sizeof(XSaveArea::hi16Zmm)))
             {
-                // std::print("System breakpoint\n");
-                return DebugStatus::SystemBreak;
+                res |= kXStateAvx512;
             }
-        }
-        else if (record.ExceptionCode == EXCEPTION_INT_DIVIDE_BY_ZERO)
+            return res;
+        }();
+        return components;
+    }
+
+    void storeXState(const RegisterFile& regs, std::uint64_t stateMask, XSaveArea& area)
+    {
+        area.fx = regs.fx;
+        area.header = {};
+        area.header.xstateBv = stateMask;
+
+        if ((stateMask & kXStateSse) != 0)
         {
-            ctx->status = ExecutionStatus::ExceptionIntDivideError;
-            return DebugStatus::Faulted;
+            for (std::size_t i = 0; i < 16; ++i)
+                std::memcpy(area.fx.xmm[i], regs.zmm[i], 16);
         }
-        else if (record.ExceptionCode == EXCEPTION_INT_OVERFLOW)
+        if ((stateMask & kXStateAvx) != 0)
         {
-            ctx->status = ExecutionStatus::ExceptionIntOverflow;
-            return DebugStatus::Faulted;
+            for (std::size_t i = 0; i < 16; ++i)
+                std::memcpy(area.ymmHi128[i], regs.zmm[i] + 16, 16);
         }
-        else if (record.ExceptionCode == EXCEPTION_ILLEGAL_INSTRUCTION)
+        if ((stateMask & kXStateOpmask) != 0)
         {
-            ctx->status = ExecutionStatus::IllegalInstruction;
-            return DebugStatus::Faulted;
+            std::memcpy(area.opmask, regs.opmask, sizeof(area.opmask));
         }
-
-        std::print("Exception code: {:X}\n", record.ExceptionCode);
-        std::print("Exception flags: {:X}\n", record.ExceptionFlags);
-        std::print("Exception address: {:X}\n", exceptionAddress);
-        std::print("Number of parameters: {}\n", record.NumberParameters);
-        for (DWORD i = 0; i < record.NumberParameters; ++i)
+        if ((stateMask & kXStateZmmHi256) != 0)
         {
-            std::print("Parameter {}: {}\n", i, record.ExceptionInformation[i]);
+            for (std::size_t i = 0; i < 16; ++i)
+                std::memcpy(area.zmmHi256[i], regs.zmm[i] + 32, 32);
         }
-
-        if (ctx->codeBase >= exceptionAddress && exceptionAddress < ctx->codeBase + ctx->codeSize)
+        if ((stateMask & kXStateHi16Zmm) != 0)
         {
-            dumpDisassembly(ctx, exceptionAddress);
+            std::memcpy(area.hi16Zmm, regs.zmm[16], sizeof(area.hi16Zmm));
         }
-
-        return DebugStatus::Faulted;
     }
 
-    static DebugStatus handleDbgEvent(Context* ctx, const DEBUG_EVENT& dbgEvent)
+    void loadXState(const XSaveArea& area, std::uint64_t stateMask, RegisterFile& regs)
     {
-        switch (dbgEvent.dwDebugEventCode)
+        regs.fx = area.fx;
+
+        if ((stateMask & kXStateSse) != 0)
         {
-            case EXCEPTION_DEBUG_EVENT:
-                return handleException(ctx, dbgEvent.u.Exception.ExceptionRecord);
-            case CREATE_PROCESS_DEBUG_EVENT:
-                CloseHandle(dbgEvent.u.CreateProcessInfo.hFile);
-                break;
-            case LOAD_DLL_DEBUG_EVENT:
-                CloseHandle(dbgEvent.u.LoadDll.hFile);
-                break;
-            default:
-                break;
+            for (std::size_t i = 0; i < 16; ++i)
+                std::memcpy(regs.zmm[i], area.fx.xmm[i], 16);
+        }
+        if ((stateMask & kXStateAvx) != 0)
+        {
+            for (std::size_t i = 0; i < 16; ++i)
+                std::memcpy(regs.zmm[i] + 16, area.ymmHi128[i], 16);
+        }
+        if ((stateMask & kXStateOpmask) != 0)
+        {
+            std::memcpy(regs.opmask, area.opmask, sizeof(regs.opmask));
+        }
+        if ((stateMask & kXStateZmmHi256) != 0)
+        {
+            for (std::size_t i = 0; i < 16; ++i)
+                std::memcpy(regs.zmm[i] + 32, area.zmmHi256[i], 32);
+        }
+        if ((stateMask & kXStateHi16Zmm) != 0)
+        {
+            std::memcpy(regs.zmm[16], area.hi16Zmm, sizeof(area.hi16Zmm));
         }
-
-        return DebugStatus::Continue;
     }
 
-    static bool spawnProcess(Context* ctx)
+    // Registers 16-31 of a vector class are kept in the Hi16_ZMM component.
+    static std::uint64_t getVectorComponents(ZydisRegister reg, std::uint64_t components)
     {
-        ctx->startupInfo.cb = sizeof(ctx->startupInfo);
-        ctx->startupInfo.dwFlags = STARTF_USESHOWWINDOW;
-        ctx->startupInfo.wShowWindow = SW_HIDE;
+        if (ZydisRegisterGetId(reg) >= 16)
+            components |= kXStateHi16Zmm;
+        return components;
+    }
 
-        const auto path = getExecutingPath();
-        const auto cmd = path / "x86Tester-sandbox.exe";
-        auto cmdWstr = cmd.wstring();
+    std::uint64_t getStateComponents(ZydisMachineMode mode, std::span<const std::uint8_t> code)
+    {
+        ZydisDisassembledInstruction instr{};
+        if (ZYAN_FAILED(ZydisDisassembleIntel(mode, 0, code.data(), code.size(), &instr)))
+            return kXStateLegacy;
 
-        if (!CreateProcessW(
-                nullptr, cmdWstr.data(), nullptr, nullptr, FALSE, DEBUG_PROCESS, nullptr, nullptr, &ctx->startupInfo,
-                &ctx->processInfo))
+        std::uint64_t mask = 0;
+        if ((instr.info.attributes & (ZYDIS_ATTRIB_FPU_STATE_CR | ZYDIS_ATTRIB_FPU_STATE_CW)) != 0)
         {
-            return false;
+            mask |= kXStateX87;
         }
 
-        // Consume all debug events until the first breakpoint.
-        auto& dbgEvent = ctx->dbgEvent;
-        while (WaitForDebugEvent(&dbgEvent, INFINITE))
+        // VEX and EVEX encoded instructions clear the upper bits of their destination.
+        if (instr.info.encoding == ZYDIS_INSTRUCTION_ENCODING_VEX)
         {
-            auto status = handleDbgEvent(ctx, dbgEvent);
-            if (status == DebugStatus::Continue)
-            {
-                // Ignore.
-                ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
-            }
-            else if (status == DebugStatus::SystemBreak)
-            {
-                ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
-                break;
-            }
-            else
-            {
-                std::print("Unexpected event\n");
-                break;
-            }
+            mask |= kXStateSse | kXStateAvx;
+        }
+        else if (instr.info.encoding == ZYDIS_INSTRUCTION_ENCODING_EVEX)
+        {
+            mask |= kXStateSse | kXStateAvx | kXStateZmmHi256;
         }
 
-        return true;
-    }
-
-    static std::vector<ZydisRegister> getUsedGPRegister(const ZydisDisassembledInstruction& instr)
-    {
-        std::vector<ZydisRegister> regs;
-
-        for (size_t i = 0; i < instr.info.operand_count; ++i)
+        for (std::size_t i = 0; i < instr.info.operand_count; ++i)
         {
             const auto& op = instr.operands[i];
+            if (op.type != ZYDIS_OPERAND_TYPE_REGISTER)
+                continue;
 
-            if (op.type == ZYDIS_OPERAND_TYPE_REGISTER)
+            switch (ZydisRegisterGetClass(op.reg.value))
             {
-                auto regId = ZydisRegisterGetLargestEnclosing(instr.info.machine_mode, op.reg.value);
-                auto regCls = ZydisRegisterGetClass(regId);
+                case ZYDIS_REGCLASS_X87:
+                case ZYDIS_REGCLASS_MMX:
+                    mask |= kXStateX87;
+                    break;
+                case ZYDIS_REGCLASS_XMM:
+                    mask |= getVectorComponents(op.reg.value, kXStateSse);
+                    break;
+                case ZYDIS_REGCLASS_YMM:
+                    mask |= getVectorComponents(op.reg.value, kXStateSse | kXStateAvx);
+                    break;
+                case ZYDIS_REGCLASS_ZMM:
+                    mask |= getVectorComponents(op.reg.value, kXStateSse | kXStateAvx | kXStateZmmHi256);
+                    break;
+                case ZYDIS_REGCLASS_MASK:
+                    mask |= kXStateOpmask;
+                    break;
+                default:
+                    break;
+            }
 
-                if (regCls == ZYDIS_REGCLASS_GPR32 || regCls == ZYDIS_REGCLASS_GPR64)
-                {
-                    regs.push_back(regId);
-                }
+            switch (op.reg.value)
+            {
+                case ZYDIS_REGISTER_X87CONTROL:
+                case ZYDIS_REGISTER_X87STATUS:
+                case ZYDIS_REGISTER_X87TAG:
+                    mask |= kXStateX87;
+                    break;
+                case ZYDIS_REGISTER_MXCSR:
+                    mask |= kXStateSse;
+                    break;
             }
         }
 
-        return regs;
+        return mask;
     }
 
-    static std::byte* allocRemoteCode(Context* ctx, std::size_t size)
+    namespace InProcess
     {
-        // Try to allocate at a predictable address, the child process has base of 0x70000000.
-
-        auto* remoteCodeAddr = static_cast<std::byte*>(VirtualAllocEx(
-            ctx->processInfo.hProcess, reinterpret_cast<void*>(0x04000000), size, MEM_COMMIT | MEM_RESERVE,
-            PAGE_EXECUTE_READWRITE));
-        if (remoteCodeAddr != nullptr)
+        static bool isStackOrInstructionPointer(ZydisMachineMode mode, ZydisRegister reg)
         {
-            return remoteCodeAddr;
-        }
+            if (reg == ZYDIS_REGISTER_NONE)
+                return false;
 
-        remoteCodeAddr = static_cast<std::byte*>(VirtualAllocEx(
-            ctx->processInfo.hProcess, reinterpret_cast<void*>(0x05000000), size, MEM_COMMIT | MEM_RESERVE,
-            PAGE_EXECUTE_READWRITE));
-        if (remoteCodeAddr != nullptr)
-        {
-            return remoteCodeAddr;
+            const auto rootReg = ZydisRegisterGetLargestEnclosing(mode, reg);
+            return rootReg == ZYDIS_REGISTER_RSP || rootReg == ZYDIS_REGISTER_RIP;
         }
 
-        return static_cast<std::byte*>(
-            VirtualAllocEx(ctx->processInfo.hProcess, nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
-    }
-
-    static bool setupCode(Context* ctx, std::span<const std::uint8_t> code)
-    {
-        auto* remoteCodeAddr = allocRemoteCode(ctx, code.size());
-        if (remoteCodeAddr == nullptr)
+        bool isSupported(ZydisMachineMode mode, std::span<const std::uint8_t> code)
         {
-            return false;
-        }
+            // The stubs are 64 bit only.
+            if (mode != ZYDIS_MACHINE_MODE_LONG_64)
+                return false;
 
-        const uint8_t breakpoint[] = { 0xCC };
-        SIZE_T written;
+            ZydisDisassembledInstruction instr{};
+            if (ZYAN_FAILED(ZydisDisassembleIntel(mode, kPreferredCodeBase + 1, code.data(), code.size(), &instr)))
+                return false;
 
-        auto* cur = remoteCodeAddr;
+            if (instr.info.length != code.size())
+                return false;
 
-        // Write breakpoint before the code.
-        if (!WriteProcessMemory(ctx->processInfo.hProcess, cur, breakpoint, sizeof(breakpoint), &written))
-        {
-            return false;
-        }
-        cur += 1;
+            switch (instr.info.meta.category)
+            {
+                case ZYDIS_CATEGORY_COND_BR:
+                case ZYDIS_CATEGORY_UNCOND_BR:
+                case ZYDIS_CATEGORY_CALL:
+                case ZYDIS_CATEGORY_RET:
+                case ZYDIS_CATEGORY_SYSCALL:
+                case ZYDIS_CATEGORY_INTERRUPT:
+                case ZYDIS_CATEGORY_SYSTEM:
+                    return false;
+            }
 
-        // Write code to test.
-        const auto codeAddr = reinterpret_cast<std::uintptr_t>(cur);
-        if (!WriteProcessMemory(ctx->processInfo.hProcess, cur, code.data(), code.size(), &written))
-        {
-            return false;
-        }
-        cur += code.size();
+            switch (instr.info.mnemonic)
+            {
+                case ZYDIS_MNEMONIC_WRFSBASE:
+                case ZYDIS_MNEMONIC_WRGSBASE:
+                    // Would break TLS of this process.
+                    return false;
+            }
 
-        // Write breakpoint after the code.
-        const auto breakAddr = reinterpret_cast<std::uintptr_t>(cur);
-        if (!WriteProcessMemory(ctx->processInfo.hProcess, cur, breakpoint, sizeof(breakpoint), &written))
-        {
-            return false;
+            for (std::size_t i = 0; i < instr.info.operand_count; ++i)
+            {
+                const auto& op = instr.operands[i];
+                if (op.type == ZYDIS_OPERAND_TYPE_MEMORY)
+                {
+                    // Anything besides address generation would access memory of this process.
+                    if (op.mem.type != ZYDIS_MEMOP_TYPE_AGEN)
+                        return false;
+                    if (isStackOrInstructionPointer(mode, op.mem.base) || isStackOrInstructionPointer(mode, op.mem.index))
+                        return false;
+                }
+                else if (op.type == ZYDIS_OPERAND_TYPE_REGISTER)
+                {
+                    // The exception dispatcher needs a valid stack, RSP is never loaded.
+                    if (isStackOrInstructionPointer(mode, op.reg.value))
+                        return false;
+                    if (ZydisRegisterGetClass(op.reg.value) == ZYDIS_REGCLASS_SEGMENT
+                        && (op.actions & ZYDIS_OPERAND_ACTION_MASK_WRITE) != 0)
+                        return false;
+                }
+                else if (op.type == ZYDIS_OPERAND_TYPE_POINTER)
+                {
+                    return false;
+                }
+            }
+
+            return true;
         }
-        cur += 1;
 
-        ctx->codeBase = reinterpret_cast<std::uintptr_t>(remoteCodeAddr);
-        ctx->codeAddr = codeAddr;
-        ctx->breakAddr = breakAddr;
-        ctx->codeSize = cur - remoteCodeAddr;
+    } // namespace InProcess
 
-        return true;
-    }
-
-    static bool setupThread(Context* ctx)
+    static Backend selectBackend(
+        ZydisMachineMode mode, std::span<const std::span<const std::uint8_t>> codes, Backend backend)
     {
-        // Spawn thread.
-        auto hThread = CreateRemoteThread(
-            ctx->processInfo.hProcess, nullptr, 0, reinterpret_cast<LPTHREAD_START_ROUTINE>(ctx->codeBase), nullptr, 0,
-            nullptr);
-
-        if (hThread == nullptr)
-        {
-            return false;
-        }
-
-        ctx->hThread = hThread;
+        if (backend != Backend::Auto)
+            return backend;
 
-        // Wait for the entry breakpoint.
-        auto& dbgEvent = ctx->dbgEvent;
-        while (WaitForDebugEvent(&dbgEvent, INFINITE))
-        {
-            auto status = handleDbgEvent(ctx, dbgEvent);
-            if (status == DebugStatus::Exit)
-            {
-                break;
-            }
-            ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
-        }
+        const auto isSupported = [&](std::span<const std::uint8_t> code) { return InProcess::isSupported(mode, code); };
+        if (std::all_of(codes.begin(), codes.end(), isSupported))
+            return Backend::InProcess;
 
-        return true;
+        return Backend::Debugger;
     }
 
-    static bool setupThreadContext(Context* ctx)
+    static void setSlot(Context* ctx, std::size_t slot)
     {
-        ctx->threadContext.ContextFlags = CONTEXT_ALL;
-        if (!GetThreadContext(ctx->hThread, &ctx->threadContext))
-        {
-            return false;
-        }
-
-        // Clear all registers.
-        ctx->threadContext.Rax = 0;
-        ctx->threadContext.Rcx = 0;
-        ctx->threadContext.Rdx = 0;
-        ctx->threadContext.Rbx = 0;
-        ctx->threadContext.Rsp = 0;
-        ctx->threadContext.Rbp = 0;
-        ctx->threadContext.Rsi = 0;
-        ctx->threadContext.Rdi = 0;
-        ctx->threadContext.R8 = 0;
-        ctx->threadContext.R9 = 0;
-        ctx->threadContext.R10 = 0;
-        ctx->threadContext.R11 = 0;
-        ctx->threadContext.R12 = 0;
-        ctx->threadContext.R13 = 0;
-        ctx->threadContext.R14 = 0;
-        ctx->threadContext.R15 = 0;
-        ctx->threadContext.Rip = ctx->codeBase + 1;
+        const auto& codeSlot = ctx->slots[slot];
+        ctx->slot = slot;
+        ctx->codeAddr = codeSlot.codeAddr;
+        ctx->stateMask = codeSlot.stateMask;
+        ctx->regs.rip = codeSlot.codeAddr;
+    }
 
-        return true;
+    Context* prepare(ZydisMachineMode mode, std::span<const std::uint8_t> code, Backend backend)
+    {
+        return prepare(mode, std::span(&code, 1), backend);
     }
 
-    Context* prepare(ZydisMachineMode mode, std::span<const std::uint8_t> code)
+    Context* prepare(ZydisMachineMode mode, std::span<const std::span<const std::uint8_t>> codes, Backend backend)
     {
+        Profiling::add(Profiling::Counter::Prepares);
+        Profiling::ScopedTimer timer(Profiling::Counter::PrepareCycles);
+
+        if (codes.empty() || codes.size() > kMaxCodeSlots)
+            return nullptr;
+
         auto ctx = new Context{};
+        ctx->mode = mode;
+        ctx->backend = selectBackend(mode, codes, backend);
+        ctx->slots.resize(codes.size());
 
-        if (!spawnProcess(ctx))
+        // Components the OS enabled in a layout the register file doesn't cover can't be transferred, the
+        // code would see the registers of this process. Components that are not enabled at all fault.
+        for (std::size_t i = 0; i < codes.size(); ++i)
         {
-            delete ctx;
-            return nullptr;
+            const auto stateMask = getStateComponents(mode, codes[i]);
+            if (isXSaveEnabled() && (stateMask & getEnabledStateComponents() & ~getSupportedStateComponents()) != 0)
+            {
+                delete ctx;
+                return nullptr;
+            }
+
+            ctx->slots[i].codeSize = codes[i].size();
+            ctx->slots[i].stateMask = stateMask & getSupportedStateComponents();
+
+            // The stubs are built once for all slots.
+            ctx->stateMask |= ctx->slots[i].stateMask;
         }
 
-        if (!setupCode(ctx, code))
+        bool prepared = false;
+        switch (ctx->backend)
         {
-            delete ctx;
-            return nullptr;
+            case Backend::Debugger:
+                prepared = Debugger::prepare(ctx, codes);
+                break;
+            case Backend::InProcess:
+                prepared = InProcess::prepare(ctx, codes);
+                break;
         }
 
-        if (!setupThread(ctx))
+        if (!prepared)
         {
             delete ctx;
             return nullptr;
         }
 
-        if (!setupThreadContext(ctx))
+        // Same layout on every backend, only the base differs.
+        ctx->codeSize = codes.size() * kCodeSlotSize;
+        for (std::size_t i = 0; i < codes.size(); ++i)
         {
-            delete ctx;
-            return nullptr;
+            ctx->slots[i].codeAddr = ctx->codeBase + i * kCodeSlotSize + 1;
         }
+        setSlot(ctx, 0);
 
         return ctx;
     }
 
-    std::span<std::uint8_t> getContextReg(Context* ctx, ZydisRegister reg)
+    static std::span<std::uint8_t> getRegisterData(RegisterFile& regs, ZydisRegister reg)
     {
         auto getRegData = [&](auto& dst) {
             //
             return std::span(reinterpret_cast<std::uint8_t*>(&dst), sizeof(dst));
         };
 
+        // Vector registers share the storage of the enclosing ZMM register.
+        const auto getVectorData = [&](ZydisRegister first, std::size_t size) {
+            return std::span(regs.zmm[reg - first], size);
+        };
+
+        if (reg >= ZYDIS_REGISTER_XMM0 && reg <= ZYDIS_REGISTER_XMM31)
+            return getVectorData(ZYDIS_REGISTER_XMM0, 16);
+        if (reg >= ZYDIS_REGISTER_YMM0 && reg <= ZYDIS_REGISTER_YMM31)
+            return getVectorData(ZYDIS_REGISTER_YMM0, 32);
+        if (reg >= ZYDIS_REGISTER_ZMM0 && reg <= ZYDIS_REGISTER_ZMM31)
+            return getVectorData(ZYDIS_REGISTER_ZMM0, 64);
+        if (reg >= ZYDIS_REGISTER_K0 && reg <= ZYDIS_REGISTER_K7)
+            return getRegData(regs.opmask[reg - ZYDIS_REGISTER_K0]);
+
         switch (reg)
         {
             case ZYDIS_REGISTER_RAX:
-                return getRegData(ctx->threadContext.Rax);
+                return getRegData(regs.gpr[0]);
             case ZYDIS_REGISTER_RCX:
-                return getRegData(ctx->threadContext.Rcx);
+                return getRegData(regs.gpr[1]);
             case ZYDIS_REGISTER_RDX:
-                return getRegData(ctx->threadContext.Rdx);
+                return getRegData(regs.gpr[2]);
             case ZYDIS_REGISTER_RBX:
-                return getRegData(ctx->threadContext.Rbx);
+                return getRegData(regs.gpr[3]);
             case ZYDIS_REGISTER_RSP:
-                return getRegData(ctx->threadContext.Rsp);
+                return getRegData(regs.gpr[4]);
             case ZYDIS_REGISTER_RBP:
-                return getRegData(ctx->threadContext.Rbp);
+                return getRegData(regs.gpr[5]);
             case ZYDIS_REGISTER_RSI:
-                return getRegData(ctx->threadContext.Rsi);
+                return getRegData(regs.gpr[6]);
             case ZYDIS_REGISTER_RDI:
-                return getRegData(ctx->threadContext.Rdi);
+                return getRegData(regs.gpr[7]);
             case ZYDIS_REGISTER_R8:
-                return getRegData(ctx->threadContext.R8);
+                return getRegData(regs.gpr[8]);
             case ZYDIS_REGISTER_R9:
-                return getRegData(ctx->threadContext.R9);
+                return getRegData(regs.gpr[9]);
             case ZYDIS_REGISTER_R10:
-                return getRegData(ctx->threadContext.R10);
+                return getRegData(regs.gpr[10]);
             case ZYDIS_REGISTER_R11:
-                return getRegData(ctx->threadContext.R11);
+                return getRegData(regs.gpr[11]);
             case ZYDIS_REGISTER_R12:
-                return getRegData(ctx->threadContext.R12);
+                return getRegData(regs.gpr[12]);
             case ZYDIS_REGISTER_R13:
-                return getRegData(ctx->threadContext.R13);
+                return getRegData(regs.gpr[13]);
             case ZYDIS_REGISTER_R14:
-                return getRegData(ctx->threadContext.R14);
+                return getRegData(regs.gpr[14]);
             case ZYDIS_REGISTER_R15:
-                return getRegData(ctx->threadContext.R15);
+                return getRegData(regs.gpr[15]);
             case ZYDIS_REGISTER_RIP:
-                return getRegData(ctx->threadContext.Rip);
+                return getRegData(regs.rip);
             case ZYDIS_REGISTER_RFLAGS:
                 [[fallthrough]];
             case ZYDIS_REGISTER_EFLAGS:
-                return getRegData(ctx->threadContext.EFlags);
-            case ZYDIS_REGISTER_XMM0:
-                return getRegData(ctx->threadContext.Xmm0);
-            case ZYDIS_REGISTER_XMM1:
-                return getRegData(ctx->threadContext.Xmm1);
-            case ZYDIS_REGISTER_XMM2:
-                return getRegData(ctx->threadContext.Xmm2);
-            case ZYDIS_REGISTER_XMM3:
-                return getRegData(ctx->threadContext.Xmm3);
-            case ZYDIS_REGISTER_XMM4:
-                return getRegData(ctx->threadContext.Xmm4);
-            case ZYDIS_REGISTER_XMM5:
-                return getRegData(ctx->threadContext.Xmm5);
-            case ZYDIS_REGISTER_XMM6:
-                return getRegData(ctx->threadContext.Xmm6);
-            case ZYDIS_REGISTER_XMM7:
-                return getRegData(ctx->threadContext.Xmm7);
-            case ZYDIS_REGISTER_XMM8:
-                return getRegData(ctx->threadContext.Xmm8);
-            case ZYDIS_REGISTER_XMM9:
-                return getRegData(ctx->threadContext.Xmm9);
-            case ZYDIS_REGISTER_XMM10:
-                return getRegData(ctx->threadContext.Xmm10);
-            case ZYDIS_REGISTER_XMM11:
-                return getRegData(ctx->threadContext.Xmm11);
-            case ZYDIS_REGISTER_XMM12:
-                return getRegData(ctx->threadContext.Xmm12);
-            case ZYDIS_REGISTER_XMM13:
-                return getRegData(ctx->threadContext.Xmm13);
-            case ZYDIS_REGISTER_XMM14:
-                return getRegData(ctx->threadContext.Xmm14);
-            case ZYDIS_REGISTER_XMM15:
-                return getRegData(ctx->threadContext.Xmm15);
+                return getRegData(regs.eflags);
             case ZYDIS_REGISTER_ST0:
-                return getRegData(ctx->threadContext.FltSave.FloatRegisters[0]);
+                return getRegData(regs.fx.st[0]);
             case ZYDIS_REGISTER_ST1:
-                return getRegData(ctx->threadContext.FltSave.FloatRegisters[1]);
+                return getRegData(regs.fx.st[1]);
             case ZYDIS_REGISTER_ST2:
-                return getRegData(ctx->threadContext.FltSave.FloatRegisters[2]);
+                return getRegData(regs.fx.st[2]);
             case ZYDIS_REGISTER_ST3:
-                return getRegData(ctx->threadContext.FltSave.FloatRegisters[3]);
+                return getRegData(regs.fx.st[3]);
             case ZYDIS_REGISTER_ST4:
-                return getRegData(ctx->threadContext.FltSave.FloatRegisters[4]);
+                return getRegData(regs.fx.st[4]);
             case ZYDIS_REGISTER_ST5:
-                return getRegData(ctx->threadContext.FltSave.FloatRegisters[5]);
+                return getRegData(regs.fx.st[5]);
             case ZYDIS_REGISTER_ST6:
-                return getRegData(ctx->threadContext.FltSave.FloatRegisters[6]);
+                return getRegData(regs.fx.st[6]);
             case ZYDIS_REGISTER_ST7:
-                return getRegData(ctx->threadContext.FltSave.FloatRegisters[7]);
+                return getRegData(regs.fx.st[7]);
             case ZYDIS_REGISTER_X87STATUS:
-                return getRegData(ctx->threadContext.FltSave.StatusWord);
+                return getRegData(regs.fx.statusWord);
             case ZYDIS_REGISTER_X87CONTROL:
-                return getRegData(ctx->threadContext.FltSave.ControlWord);
+                return getRegData(regs.fx.controlWord);
             case ZYDIS_REGISTER_X87TAG:
-                return getRegData(ctx->threadContext.FltSave.TagWord);
+                return getRegData(regs.fx.tagWord);
             case ZYDIS_REGISTER_MXCSR:
-                return getRegData(ctx->threadContext.FltSave.MxCsr);
+                return getRegData(regs.fx.mxcsr);
         }
 
         assert(false);
         return {};
     }
 
-    bool setRegBytes(Context* ctx, ZydisRegister reg, std::span<const std::uint8_t> data)
+    bool setRegBytes(RegisterFile& regs, ZydisRegister reg, std::span<const std::uint8_t> data)
     {
-        auto regData = getContextReg(ctx, reg);
+        auto regData = getRegisterData(regs, reg);
         if (data.size() > regData.size())
         {
             assert(false);
@@ -497,86 +594,177 @@ namespace x86Tester::Execution
         return true;
     }
 
+    std::span<const std::uint8_t> getRegBytes(const RegisterFile& regs, ZydisRegister reg)
+    {
+        return getRegisterData(const_cast<RegisterFile&>(regs), reg);
+    }
+
+    bool setRegBytes(Context* ctx, ZydisRegister reg, std::span<const std::uint8_t> data)
+    {
+        return setRegBytes(ctx->regs, reg, data);
+    }
+
     std::span<const std::uint8_t> getRegBytes(Context* ctx, ZydisRegister reg)
     {
-        return getContextReg(ctx, reg);
+        return getRegBytes(ctx->regs, reg);
     }
 
-    bool execute(Context* ctx)
+    const RegisterFile& getRegisterFile(Context* ctx)
     {
-        ctx->threadContext.ContextFlags = CONTEXT_ALL;
-        ctx->threadContext.Rip = ctx->codeBase + 1;
+        return ctx->regs;
+    }
 
-        if (SetThreadContext(ctx->hThread, &ctx->threadContext) == FALSE)
+    static void countStatus(ExecutionStatus status)
+    {
+        switch (status)
         {
-            std::print("SetThreadContext failed: {:X}\n", GetLastError());
-            return false;
+            case ExecutionStatus::ExceptionIntDivideError:
+                Profiling::add(Profiling::Counter::DivideErrors);
+                break;
+            case ExecutionStatus::ExceptionIntOverflow:
+                Profiling::add(Profiling::Counter::IntOverflows);
+                break;
+            case ExecutionStatus::IllegalInstruction:
+                Profiling::add(Profiling::Counter::IllegalInstructions);
+                break;
+            case ExecutionStatus::ExceptionAccessViolation:
+                Profiling::add(Profiling::Counter::AccessViolations);
+                break;
         }
+    }
 
-        auto& dbgEvent = ctx->dbgEvent;
-        if (!ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE))
+    static bool executeOnce(Context* ctx)
+    {
+        switch (ctx->backend)
         {
-            std::print("ContinueDebugEvent failed: {:X}\n", GetLastError());
-            return false;
+            case Backend::Debugger:
+                return Debugger::execute(ctx);
+            case Backend::InProcess:
+                return InProcess::execute(ctx);
         }
 
-        // Wait for the breakpoint to appear or an exception to occur.
-        while (WaitForDebugEvent(&dbgEvent, INFINITE))
+        assert(false);
+        return false;
+    }
+
+    bool execute(Context* ctx)
+    {
+        Profiling::add(Profiling::Counter::ExecuteCalls);
+        Profiling::add(Profiling::Counter::Executions);
+        Profiling::ScopedTimer timer(Profiling::Counter::ExecuteCycles);
+
+        const auto res = executeOnce(ctx);
+        countStatus(ctx->status);
+
+        return res;
+    }
+
+    static bool executeEach(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs)
+    {
+        const auto savedRegs = ctx->regs;
+        const auto savedStatus = ctx->status;
+
+        bool res = true;
+        for (std::size_t i = 0; i < inputs.size() && res; ++i)
         {
-            bool breakOut = false;
+            ctx->regs = inputs[i];
+            res = executeOnce(ctx);
 
-            auto status = handleDbgEvent(ctx, dbgEvent);
-            if (status == DebugStatus::Faulted)
-            {
-                break;
-            }
-            else if (status == DebugStatus::Exit)
-            {
-                break;
-            }
+            outputs[i].regs = ctx->regs;
+            outputs[i].status = ctx->status;
+        }
 
-            ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
-            if (breakOut)
-                break;
+        ctx->regs = savedRegs;
+        ctx->status = savedStatus;
+
+        return res;
+    }
+
+    // Compared on this side, the sandbox only copies the window back instead of tracking the writes.
+    static void setDirtyRange(const InputState& input, OutputState& output)
+    {
+        std::size_t begin = 0;
+        std::size_t end = kDataWindowSize;
+        while (begin < end && input.data[begin] == output.regs.data[begin])
+            begin++;
+        while (end > begin && input.data[end - 1] == output.regs.data[end - 1])
+            end--;
+
+        output.dataDirtyBegin = static_cast<std::uint16_t>(begin);
+        output.dataDirtyEnd = static_cast<std::uint16_t>(end);
+    }
+
+    static bool executeBatchOnce(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs)
+    {
+        switch (ctx->backend)
+        {
+            case Backend::Debugger:
+                return Debugger::executeBatch(ctx, inputs, outputs);
+            case Backend::InProcess:
+                // No context switch to amortize.
+                return executeEach(ctx, inputs, outputs);
         }
 
-        ctx->threadContext.ContextFlags = CONTEXT_ALL;
-        if (!GetThreadContext(ctx->hThread, &ctx->threadContext))
+        assert(false);
+        return false;
+    }
+
+    bool executeBatch(Context* ctx, std::span<const InputState> inputs, std::span<OutputState> outputs)
+    {
+        if (outputs.size() < inputs.size())
         {
+            assert(false);
+            return false;
+        }
+
+        Profiling::add(Profiling::Counter::ExecuteCalls);
+        Profiling::add(Profiling::Counter::Executions, inputs.size());
+        Profiling::ScopedTimer timer(Profiling::Counter::ExecuteCycles);
+
+        // Outputs of a failed batch are only partially written, nothing to count.
+        if (!executeBatchOnce(ctx, inputs, outputs))
             return false;
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            countStatus(outputs[i].status);
+            setDirtyRange(inputs[i], outputs[i]);
         }
 
         return true;
     }
 
-    void cleanup(Context* ctx)
+    bool execute(Context* ctx, std::size_t slot)
     {
-        // Signal Termination
-        TerminateProcess(ctx->processInfo.hProcess, 0);
+        if (!selectSlot(ctx, slot))
+            return false;
+
+        return execute(ctx);
+    }
 
-        // Continue last event.
-        ContinueDebugEvent(ctx->dbgEvent.dwProcessId, ctx->dbgEvent.dwThreadId, DBG_CONTINUE);
+    bool executeBatch(Context* ctx, std::size_t slot, std::span<const InputState> inputs, std::span<OutputState> outputs)
+    {
+        if (!selectSlot(ctx, slot))
+            return false;
+
+        return executeBatch(ctx, inputs, outputs);
+    }
 
-        // Poll debug events so the process can exit.
-        for (;;)
+    void cleanup(Context* ctx)
+    {
+        if (ctx == nullptr)
+            return;
+
+        switch (ctx->backend)
         {
-            DEBUG_EVENT dbgEvent{};
-            if (!WaitForDebugEvent(&dbgEvent, INFINITE))
+            case Backend::Debugger:
+                Debugger::cleanup(ctx);
                 break;
-
-            if (dbgEvent.dwDebugEventCode == EXIT_PROCESS_DEBUG_EVENT)
-            {
-                ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
+            case Backend::InProcess:
+                InProcess::cleanup(ctx);
                 break;
-            }
-
-            ContinueDebugEvent(dbgEvent.dwProcessId, dbgEvent.dwThreadId, DBG_CONTINUE);
         }
 
-        CloseHandle(ctx->processInfo.hProcess);
-        CloseHandle(ctx->processInfo.hThread);
-        CloseHandle(ctx->hThread);
-
         delete ctx;
     }
 
@@ -590,9 +778,41 @@ namespace x86Tester::Execution
         return ctx->codeAddr;
     }
 
+    std::uint64_t getCodeAddress(Context* ctx, std::size_t slot)
+    {
+        return ctx->slots[slot].codeAddr;
+    }
+
+    std::size_t getSlotCount(Context* ctx)
+    {
+        return ctx->slots.size();
+    }
+
+    std::uint64_t getDataAddress(Context* ctx)
+    {
+        return ctx->dataAddr;
+    }
+
+    bool selectSlot(Context* ctx, std::size_t slot)
+    {
+        if (slot >= ctx->slots.size())
+        {
+            assert(false);
+            return false;
+        }
+
+        setSlot(ctx, slot);
+        return true;
+    }
+
     ExecutionStatus getExecutionStatus(Context* ctx)
     {
         return ctx->status;
     }
 
-} // namespace x86Tester::Execution
\ No newline at end of file
+    Backend getBackend(Context* ctx)
+    {
+        return ctx->backend;
+    }
+
+} // namespace x86Tester::Execution
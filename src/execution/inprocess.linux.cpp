@@ -0,0 +1,231 @@
+#include "context.hpp"
+#include "stubs.hpp"
+
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <sys/mman.h>
+
+namespace x86Tester::Execution::InProcess
+{
+    using namespace Stubs;
+
+    static constexpr std::size_t kPageSize = 0x1000;
+
+    // Last qword of the stub page, holds the address of the selected slot for the entry stub.
+    static constexpr std::size_t kCodeTargetOffset = kPageSize - sizeof(std::uint64_t);
+
+    // The entry stub keeps the host FPU/SSE state in an FXSAVE area on the stack.
+    static constexpr std::uint32_t kHostFrameSize = sizeof(FxSaveArea);
+
+    // Callee-saved registers of the System V ABI, together with the flags the FXSAVE area stays aligned.
+    static constexpr ZydisRegister kNonVolatileRegs[] = {
+        ZYDIS_REGISTER_RBX, ZYDIS_REGISTER_RBP, ZYDIS_REGISTER_R12,
+        ZYDIS_REGISTER_R13, ZYDIS_REGISTER_R14, ZYDIS_REGISTER_R15,
+    };
+
+    static thread_local Context* tlsActiveContext = nullptr;
+
+    // Handlers that were installed before, signals that don't come from the code page are passed on.
+    static struct sigaction previousActions[std::size(kFaultSignals)];
+
+    static void forwardSignal(int signal, siginfo_t* info, void* ucontext)
+    {
+        for (std::size_t i = 0; i < std::size(kFaultSignals); ++i)
+        {
+            if (kFaultSignals[i] != signal)
+                continue;
+
+            const auto& previous = previousActions[i];
+            if ((previous.sa_flags & SA_SIGINFO) != 0)
+            {
+                previous.sa_sigaction(signal, info, ucontext);
+                return;
+            }
+            if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)
+            {
+                previous.sa_handler(signal);
+                return;
+            }
+        }
+
+        // Returning retries the instruction which raises the signal again with the default action.
+        ::signal(signal, SIG_DFL);
+    }
+
+    static void signalHandler(int signal, siginfo_t* info, void* ucontext)
+    {
+        auto* ctx = tlsActiveContext;
+        auto& uc = *static_cast<ucontext_t*>(ucontext);
+        auto& gregs = uc.uc_mcontext.gregs;
+
+        const auto rip = static_cast<std::uintptr_t>(gregs[REG_RIP]);
+        const auto pageAddr = ctx != nullptr ? reinterpret_cast<std::uintptr_t>(ctx->inProcess.page) : 0;
+        if (ctx == nullptr || rip < pageAddr || rip >= pageAddr + ctx->inProcess.pageSize)
+        {
+            forwardSignal(signal, info, ucontext);
+            return;
+        }
+
+        auto& state = ctx->inProcess;
+        state.faulted = true;
+
+        // Same as the debugger, the registers reflect the state at the faulting instruction.
+        const auto rsp = ctx->regs.gpr[4];
+        copyToRegisterFile(uc, ctx->regs);
+        if (const auto status = getSignalStatus(*info, ctx->regs); status.has_value())
+        {
+            ctx->status = *status;
+        }
+        ctx->regs.gpr[4] = rsp;
+        ctx->regs.rip = rip - state.codeBase + ctx->codeBase;
+
+        // Resume in the exit stub which restores the host state.
+        gregs[REG_RSP] = static_cast<greg_t>(state.hostRsp);
+        gregs[REG_RIP] = static_cast<greg_t>(state.exitAddr);
+    }
+
+    static void registerHandler()
+    {
+        static std::once_flag once;
+        std::call_once(once, []() {
+            struct sigaction action{};
+            action.sa_sigaction = signalHandler;
+            action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+            sigemptyset(&action.sa_mask);
+
+            for (std::size_t i = 0; i < std::size(kFaultSignals); ++i)
+            {
+                sigaction(kFaultSignals[i], &action, &previousActions[i]);
+            }
+        });
+    }
+
+    bool prepare(Context* ctx, std::span<const std::span<const std::uint8_t>> codes)
+    {
+        registerHandler();
+
+        auto& state = ctx->inProcess;
+
+        // First page holds the stubs, the code region after it mirrors the sandbox layout.
+        const auto codeRegionSize = (codes.size() * kCodeSlotSize + kPageSize - 1) & ~(kPageSize - 1);
+        state.pageSize = kPageSize + codeRegionSize;
+        auto* page = mmap(
+            nullptr, state.pageSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (page == MAP_FAILED)
+        {
+            return false;
+        }
+        state.page = static_cast<std::byte*>(page);
+
+        // Start out with the state of a fresh thread.
+        ctx->regs.fx.controlWord = 0x027F;
+        ctx->regs.fx.mxcsr = 0x1F80;
+        ctx->regs.fx.mxcsrMask = getMxcsrMask();
+
+        const auto pageAddr = reinterpret_cast<std::uint64_t>(state.page);
+        const auto codeBase = pageAddr + kPageSize;
+        const auto codeTargetAddr = pageAddr + kCodeTargetOffset;
+
+        const auto regsAddr = reinterpret_cast<std::uint64_t>(&ctx->regs);
+        const auto regOptions = RegisterStubOptions{
+            .regsAddress = regsAddr,
+            .stateMaskAddress = isXSaveEnabled() ? reinterpret_cast<std::uint64_t>(&ctx->stateMask) : 0,
+            .stateOffset = static_cast<std::int32_t>(reinterpret_cast<std::uint64_t>(&state.xsave) - regsAddr),
+        };
+
+        // Entry, save the host state and load the registers.
+        Assembler entry(pageAddr);
+        for (const auto nonVolatileReg : kNonVolatileRegs)
+        {
+            entry.emit(ZYDIS_MNEMONIC_PUSH, reg(nonVolatileReg));
+        }
+        entry.emit(ZYDIS_MNEMONIC_PUSHFQ);
+        entry.emit(ZYDIS_MNEMONIC_SUB, reg(ZYDIS_REGISTER_RSP), imm(kHostFrameSize));
+        entry.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RSP));
+        entry.stateOp(StateOp::FxSave, ZYDIS_REGISTER_RAX, 0);
+        entry.storeRaxAbsolute(reinterpret_cast<std::uint64_t>(&state.hostRsp));
+        emitLoadRegisters(entry, regOptions);
+        entry.jmpIndirect(codeTargetAddr);
+
+        // Every slot jumps here after the code, store the registers and restore the host state.
+        Assembler exit(entry.address());
+        const auto storeAddr = exit.address();
+        emitStoreRegisters(exit, regOptions);
+        const auto exitAddr = exit.address();
+        if ((ctx->stateMask & kXStateAvx) != 0)
+        {
+            // The host only restores the legacy state, avoid transition penalties from dirty upper halves.
+            exit.emit(ZYDIS_MNEMONIC_VZEROUPPER);
+        }
+        exit.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RSP));
+        exit.stateOp(StateOp::FxRstor, ZYDIS_REGISTER_RAX, 0);
+        exit.emit(ZYDIS_MNEMONIC_ADD, reg(ZYDIS_REGISTER_RSP), imm(kHostFrameSize));
+        exit.emit(ZYDIS_MNEMONIC_POPFQ);
+        for (auto it = std::rbegin(kNonVolatileRegs); it != std::rend(kNonVolatileRegs); ++it)
+        {
+            exit.emit(ZYDIS_MNEMONIC_POP, reg(*it));
+        }
+        exit.emit(ZYDIS_MNEMONIC_RET);
+
+        auto* codeRegion = state.page + kPageSize;
+        if (!entry.ok() || !exit.ok() || entry.code().size() + exit.code().size() > kCodeTargetOffset
+            || !writeCodeSlots(std::span(codeRegion, codeRegionSize), codeBase, codes, storeAddr))
+        {
+            InProcess::cleanup(ctx);
+            return false;
+        }
+
+        std::memcpy(state.page, entry.code().data(), entry.code().size());
+        std::memcpy(state.page + entry.code().size(), exit.code().data(), exit.code().size());
+
+        state.entryAddr = pageAddr;
+        state.exitAddr = exitAddr;
+        state.codeBase = codeBase;
+        state.codeTarget = reinterpret_cast<std::uint64_t*>(state.page + kCodeTargetOffset);
+
+        // The code is position independent, report the sandbox layout.
+        ctx->codeBase = kPreferredCodeBase;
+
+        return true;
+    }
+
+    bool execute(Context* ctx)
+    {
+        auto& state = ctx->inProcess;
+
+        sanitizeRegisterFile(ctx->regs);
+        storeXState(ctx->regs, ctx->stateMask, state.xsave);
+
+        ctx->status = ExecutionStatus::Idle;
+        state.faulted = false;
+        *state.codeTarget = ctx->codeAddr - ctx->codeBase + state.codeBase;
+
+        tlsActiveContext = ctx;
+        reinterpret_cast<void (*)()>(state.entryAddr)();
+        tlsActiveContext = nullptr;
+
+        // On a fault the handler already took the legacy state from the signal frame, the other components
+        // keep their input values as the faulting instruction didn't write them.
+        if (!state.faulted)
+        {
+            loadXState(state.xsave, ctx->stateMask, ctx->regs);
+            ctx->status = ExecutionStatus::Success;
+            ctx->regs.rip = getCodeEnd(ctx);
+        }
+
+        return true;
+    }
+
+    void cleanup(Context* ctx)
+    {
+        auto& state = ctx->inProcess;
+
+        if (state.page != nullptr)
+        {
+            munmap(state.page, state.pageSize);
+            state.page = nullptr;
+        }
+    }
+
+} // namespace x86Tester::Execution::InProcess
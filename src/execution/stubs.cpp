@@ -0,0 +1,260 @@
+#include "stubs.hpp"
+
+#include "context.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+namespace x86Tester::Execution::Stubs
+{
+    void Assembler::emit(const ZydisEncoderRequest& req)
+    {
+        std::uint8_t buf[ZYDIS_MAX_INSTRUCTION_LENGTH]{};
+        ZyanUSize len = sizeof(buf);
+
+        if (ZYAN_FAILED(ZydisEncoderEncodeInstruction(&req, buf, &len)))
+        {
+            assert(false);
+            _failed = true;
+            return;
+        }
+
+        _code.insert(_code.end(), buf, buf + len);
+    }
+
+    void Assembler::emitAbsolute(ZydisEncoderRequest req)
+    {
+        std::uint8_t buf[ZYDIS_MAX_INSTRUCTION_LENGTH]{};
+        ZyanUSize len = sizeof(buf);
+
+        if (ZYAN_FAILED(ZydisEncoderEncodeInstructionAbsolute(&req, buf, &len, address())))
+        {
+            assert(false);
+            _failed = true;
+            return;
+        }
+
+        _code.insert(_code.end(), buf, buf + len);
+    }
+
+    void Assembler::emitBytes(std::span<const std::uint8_t> bytes)
+    {
+        _code.insert(_code.end(), bytes.begin(), bytes.end());
+    }
+
+    void Assembler::storeRaxAbsolute(std::uint64_t address)
+    {
+        // REX.W A3 moffs64
+        const std::uint8_t opcode[] = { 0x48, 0xA3 };
+        emitBytes(opcode);
+        emitBytes(std::span(reinterpret_cast<const std::uint8_t*>(&address), sizeof(address)));
+    }
+
+    void Assembler::stateOp(StateOp op, ZydisRegister base, std::int32_t disp)
+    {
+        const auto rm = static_cast<std::uint8_t>(base - ZYDIS_REGISTER_RAX);
+        if (rm >= 8 || rm == 4 || rm == 5)
+        {
+            // RSP needs a SIB byte and RBP a different mod, not needed by any stub.
+            assert(false);
+            _failed = true;
+            return;
+        }
+
+        // REX.W 0F AE /op with mod=10 (disp32).
+        const std::uint8_t modrm = 0x80 | (static_cast<std::uint8_t>(op) << 3) | rm;
+        const std::uint8_t opcode[] = { 0x48, 0x0F, 0xAE, modrm };
+        emitBytes(opcode);
+        emitBytes(std::span(reinterpret_cast<const std::uint8_t*>(&disp), sizeof(disp)));
+    }
+
+    void Assembler::jmp(std::uint64_t target)
+    {
+        const auto rel = static_cast<std::int64_t>(target - (address() + 5));
+        if (rel < INT32_MIN || rel > INT32_MAX)
+        {
+            assert(false);
+            _failed = true;
+            return;
+        }
+
+        const auto rel32 = static_cast<std::int32_t>(rel);
+        const std::uint8_t opcode[] = { 0xE9 };
+        emitBytes(opcode);
+        emitBytes(std::span(reinterpret_cast<const std::uint8_t*>(&rel32), sizeof(rel32)));
+    }
+
+    void Assembler::jmpIndirect(std::uint64_t pointerAddress)
+    {
+        const auto rel = static_cast<std::int64_t>(pointerAddress - (address() + 6));
+        if (rel < INT32_MIN || rel > INT32_MAX)
+        {
+            assert(false);
+            _failed = true;
+            return;
+        }
+
+        // FF /4 with mod=00 rm=101 (RIP-relative).
+        const auto rel32 = static_cast<std::int32_t>(rel);
+        const std::uint8_t opcode[] = { 0xFF, 0x25 };
+        emitBytes(opcode);
+        emitBytes(std::span(reinterpret_cast<const std::uint8_t*>(&rel32), sizeof(rel32)));
+    }
+
+    static constexpr std::int64_t gprOffset(std::size_t index)
+    {
+        return static_cast<std::int64_t>(offsetof(RegisterFile, gpr) + index * sizeof(std::uint64_t));
+    }
+
+    // EDX:EAX = [address], clobbers the flags.
+    static void emitLoadStateMask(Assembler& a, std::uint64_t address)
+    {
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), imm(address));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), mem(ZYDIS_REGISTER_RAX, 0, 8));
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RDX), reg(ZYDIS_REGISTER_RAX));
+        a.emit(ZYDIS_MNEMONIC_SHR, reg(ZYDIS_REGISTER_RDX), imm(32));
+    }
+
+    void emitLoadRegisters(Assembler& a, const RegisterStubOptions& options)
+    {
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(options.regsAddress));
+        if (options.regsIndirect)
+        {
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), mem(ZYDIS_REGISTER_RCX, 0, 8));
+        }
+
+        if (options.stateMaskAddress != 0)
+        {
+            emitLoadStateMask(a, options.stateMaskAddress);
+            a.stateOp(StateOp::XRstor, ZYDIS_REGISTER_RCX, options.stateOffset);
+        }
+        else
+        {
+            a.stateOp(StateOp::FxRstor, ZYDIS_REGISTER_RCX, options.stateOffset);
+        }
+
+        if (options.includeStackPointer)
+        {
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RSP), imm(options.scratchStackTop));
+        }
+
+        a.emit(ZYDIS_MNEMONIC_PUSH, mem(ZYDIS_REGISTER_RCX, offsetof(RegisterFile, eflags), 8));
+        a.emit(ZYDIS_MNEMONIC_POPFQ);
+
+        // Nothing below may modify the flags.
+        for (std::size_t i = 0; i < std::size(kGprRegs); ++i)
+        {
+            const auto gpr = kGprRegs[i];
+            if (gpr == ZYDIS_REGISTER_RCX)
+                continue;
+            if (gpr == ZYDIS_REGISTER_RSP && !options.includeStackPointer)
+                continue;
+
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(gpr), mem(ZYDIS_REGISTER_RCX, gprOffset(i), 8));
+        }
+
+        a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), mem(ZYDIS_REGISTER_RCX, gprOffset(1), 8));
+    }
+
+    void emitStoreRegisters(Assembler& a, const RegisterStubOptions& options)
+    {
+        // Nothing up to pushfq may modify the flags.
+        if (options.regsIndirect)
+        {
+            a.storeRaxAbsolute(options.scratchAddress);
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), imm(options.regsAddress));
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), mem(ZYDIS_REGISTER_RAX, 0, 8));
+        }
+        else
+        {
+            a.storeRaxAbsolute(options.regsAddress + gprOffset(0));
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), imm(options.regsAddress));
+        }
+
+        for (std::size_t i = 0; i < std::size(kGprRegs); ++i)
+        {
+            const auto gpr = kGprRegs[i];
+            if (gpr == ZYDIS_REGISTER_RAX)
+                continue;
+            if (gpr == ZYDIS_REGISTER_RSP && !options.includeStackPointer)
+                continue;
+
+            a.emit(ZYDIS_MNEMONIC_MOV, mem(ZYDIS_REGISTER_RAX, gprOffset(i), 8), reg(gpr));
+        }
+
+        if (options.regsIndirect)
+        {
+            // RCX is already stored, use it to move RAX into place.
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), imm(options.scratchAddress));
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), mem(ZYDIS_REGISTER_RCX, 0, 8));
+            a.emit(ZYDIS_MNEMONIC_MOV, mem(ZYDIS_REGISTER_RAX, gprOffset(0), 8), reg(ZYDIS_REGISTER_RCX));
+        }
+
+        if (options.includeStackPointer)
+        {
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RSP), imm(options.scratchStackTop));
+        }
+
+        a.emit(ZYDIS_MNEMONIC_PUSHFQ);
+        a.emit(ZYDIS_MNEMONIC_POP, mem(ZYDIS_REGISTER_RAX, offsetof(RegisterFile, eflags), 8));
+
+        if (options.stateMaskAddress != 0)
+        {
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RCX), reg(ZYDIS_REGISTER_RAX));
+            emitLoadStateMask(a, options.stateMaskAddress);
+            a.stateOp(StateOp::XSave, ZYDIS_REGISTER_RCX, options.stateOffset);
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(ZYDIS_REGISTER_RAX), reg(ZYDIS_REGISTER_RCX));
+        }
+        else
+        {
+            a.stateOp(StateOp::FxSave, ZYDIS_REGISTER_RAX, options.stateOffset);
+        }
+    }
+
+    void emitCopy(
+        Assembler& a, ZydisRegister dst, std::int64_t dstDisp, ZydisRegister src, std::int64_t srcDisp,
+        ZydisRegister temp, std::size_t size)
+    {
+        assert(size % sizeof(std::uint64_t) == 0);
+        for (std::size_t offset = 0; offset < size; offset += sizeof(std::uint64_t))
+        {
+            const auto disp = static_cast<std::int64_t>(offset);
+            a.emit(ZYDIS_MNEMONIC_MOV, reg(temp), mem(src, srcDisp + disp, 8));
+            a.emit(ZYDIS_MNEMONIC_MOV, mem(dst, dstDisp + disp, 8), reg(temp));
+        }
+    }
+
+    bool writeCodeSlots(
+        std::span<std::byte> region, std::uint64_t regionAddress, std::span<const std::span<const std::uint8_t>> codes,
+        std::uint64_t exitAddress)
+    {
+        if (codes.size() * kCodeSlotSize > region.size())
+            return false;
+
+        // Anything outside the code traps, including the rest of a slot and the unused slots.
+        std::memset(region.data(), 0xCC, region.size());
+
+        for (std::size_t i = 0; i < codes.size(); ++i)
+        {
+            const auto& code = codes[i];
+            auto* slot = region.data() + i * kCodeSlotSize;
+
+            // Breakpoint, code and the jmp rel32.
+            if (1 + code.size() + 5 > kCodeSlotSize)
+                return false;
+
+            std::memcpy(slot + 1, code.data(), code.size());
+
+            Assembler a(regionAddress + i * kCodeSlotSize + 1 + code.size());
+            a.jmp(exitAddress);
+            if (!a.ok())
+                return false;
+
+            std::memcpy(slot + 1 + code.size(), a.code().data(), a.code().size());
+        }
+
+        return true;
+    }
+
+} // namespace x86Tester::Execution::Stubs
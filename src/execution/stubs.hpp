@@ -0,0 +1,159 @@
+#pragma once
+
+#include <Zydis/Encoder.h>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace x86Tester::Execution::Stubs
+{
+    inline ZydisEncoderOperand reg(ZydisRegister value)
+    {
+        ZydisEncoderOperand op{};
+        op.type = ZYDIS_OPERAND_TYPE_REGISTER;
+        op.reg.value = value;
+        return op;
+    }
+
+    inline ZydisEncoderOperand mem(ZydisRegister base, std::int64_t disp, std::uint16_t size)
+    {
+        ZydisEncoderOperand op{};
+        op.type = ZYDIS_OPERAND_TYPE_MEMORY;
+        op.mem.base = base;
+        op.mem.displacement = disp;
+        op.mem.size = size;
+        return op;
+    }
+
+    inline ZydisEncoderOperand imm(std::uint64_t value)
+    {
+        ZydisEncoderOperand op{};
+        op.type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
+        op.imm.u = value;
+        return op;
+    }
+
+    // Extension of the 0F AE opcode group.
+    enum class StateOp : std::uint8_t
+    {
+        FxSave = 0,
+        FxRstor = 1,
+        XSave = 4,
+        XRstor = 5,
+    };
+
+    // Small x64 emitter for the register load/store stubs, regular instructions go through the Zydis
+    // encoder, the few forms an encoder request can't express are emitted as raw bytes.
+    class Assembler
+    {
+        std::uint64_t _baseAddress{};
+        std::vector<std::uint8_t> _code;
+        bool _failed{};
+
+    public:
+        explicit Assembler(std::uint64_t baseAddress)
+            : _baseAddress(baseAddress)
+        {
+        }
+
+        std::uint64_t address() const
+        {
+            return _baseAddress + _code.size();
+        }
+
+        std::span<const std::uint8_t> code() const
+        {
+            return _code;
+        }
+
+        bool ok() const
+        {
+            return !_failed;
+        }
+
+        void emit(const ZydisEncoderRequest& req);
+
+        // Encodes relative to the current address, used for branches to absolute targets.
+        void emitAbsolute(ZydisEncoderRequest req);
+
+        template<typename... TOps> void emit(ZydisMnemonic mnemonic, const TOps&... ops)
+        {
+            ZydisEncoderRequest req{};
+            req.machine_mode = ZYDIS_MACHINE_MODE_LONG_64;
+            req.mnemonic = mnemonic;
+            req.operand_count = static_cast<ZyanU8>(sizeof...(TOps));
+
+            [[maybe_unused]] std::size_t index = 0;
+            ((req.operands[index++] = ops), ...);
+
+            emit(req);
+        }
+
+        // Jcc/JMP to an absolute target.
+        void branch(ZydisMnemonic mnemonic, std::uint64_t target)
+        {
+            ZydisEncoderRequest req{};
+            req.machine_mode = ZYDIS_MACHINE_MODE_LONG_64;
+            req.mnemonic = mnemonic;
+            req.operand_count = 1;
+            req.operands[0] = imm(target);
+
+            emitAbsolute(req);
+        }
+
+        void emitBytes(std::span<const std::uint8_t> bytes);
+
+        // mov [address], rax
+        void storeRaxAbsolute(std::uint64_t address);
+
+        // fxsave64/fxrstor64/xsave64/xrstor64 [base+disp], base must be one of RAX, RCX, RDX, RBX, RSI, RDI.
+        void stateOp(StateOp op, ZydisRegister base, std::int32_t disp);
+
+        // jmp rel32
+        void jmp(std::uint64_t target);
+
+        // jmp qword ptr [rip+rel32], jumps to the address stored at pointerAddress without touching a register.
+        void jmpIndirect(std::uint64_t pointerAddress);
+    };
+
+    struct RegisterStubOptions
+    {
+        // Address of the RegisterFile in the process that runs the stub, with regsIndirect it is the
+        // address of a pointer to the RegisterFile.
+        std::uint64_t regsAddress{};
+        bool regsIndirect{};
+        // Only with regsIndirect, qword that holds RAX while the store stub fetches the pointer.
+        std::uint64_t scratchAddress{};
+
+        // When set RSP is loaded/stored as well and the stub switches to the scratch stack for flags,
+        // otherwise RSP is left untouched and the current stack is used.
+        bool includeStackPointer{};
+        std::uint64_t scratchStackTop{};
+
+        // When set the FPU/SSE state goes through xrstor64/xsave64 with the component mask stored at this
+        // address, otherwise all of it is loaded/stored with fxrstor64/fxsave64.
+        std::uint64_t stateMaskAddress{};
+        // Offset of the XSaveArea from the RegisterFile.
+        std::int32_t stateOffset{};
+    };
+
+    // Loads all registers from the register file, RCX is loaded last as it holds the base address.
+    void emitLoadRegisters(Assembler& a, const RegisterStubOptions& options);
+
+    // Stores all registers into the register file, RAX holds the register file address afterwards.
+    void emitStoreRegisters(Assembler& a, const RegisterStubOptions& options);
+
+    // Copies size bytes from [src+srcDisp] to [dst+dstDisp] a qword at a time through temp, the size must be a
+    // multiple of 8.
+    void emitCopy(
+        Assembler& a, ZydisRegister dst, std::int64_t dstDisp, ZydisRegister src, std::int64_t srcDisp,
+        ZydisRegister temp, std::size_t size);
+
+    // Fills the code region with breakpoints and writes one slot of kCodeSlotSize per code, each code is
+    // followed by a jmp rel32 to exitAddress. The code sees the region at regionAddress.
+    bool writeCodeSlots(
+        std::span<std::byte> region, std::uint64_t regionAddress, std::span<const std::span<const std::uint8_t>> codes,
+        std::uint64_t exitAddress);
+
+} // namespace x86Tester::Execution::Stubs
@@ -0,0 +1,316 @@
+#include <bit>
+#include <x86Tester/bitmodel.hpp>
+
+namespace x86Tester::Generator
+{
+    static std::uint64_t getMask(std::size_t width)
+    {
+        return width >= 64 ? ~std::uint64_t{} : (std::uint64_t{ 1 } << width) - 1;
+    }
+
+    static KnownBits getExact(std::uint64_t value, std::uint64_t mask)
+    {
+        return { ~value & mask, value & mask };
+    }
+
+    static bool isGpr(ZydisRegister reg)
+    {
+        switch (ZydisRegisterGetClass(reg))
+        {
+            case ZYDIS_REGCLASS_GPR8:
+            case ZYDIS_REGCLASS_GPR16:
+            case ZYDIS_REGCLASS_GPR32:
+            case ZYDIS_REGCLASS_GPR64:
+                return true;
+        }
+        return false;
+    }
+
+    static bool isAccumulator(ZydisRegister reg)
+    {
+        switch (reg)
+        {
+            case ZYDIS_REGISTER_AL:
+            case ZYDIS_REGISTER_AX:
+            case ZYDIS_REGISTER_EAX:
+            case ZYDIS_REGISTER_RAX:
+                return true;
+        }
+        return false;
+    }
+
+    static bool isSetcc(ZydisMnemonic mnemonic)
+    {
+        switch (mnemonic)
+        {
+            case ZYDIS_MNEMONIC_SETB:
+            case ZYDIS_MNEMONIC_SETBE:
+            case ZYDIS_MNEMONIC_SETL:
+            case ZYDIS_MNEMONIC_SETLE:
+            case ZYDIS_MNEMONIC_SETNB:
+            case ZYDIS_MNEMONIC_SETNBE:
+            case ZYDIS_MNEMONIC_SETNL:
+            case ZYDIS_MNEMONIC_SETNLE:
+            case ZYDIS_MNEMONIC_SETNO:
+            case ZYDIS_MNEMONIC_SETNP:
+            case ZYDIS_MNEMONIC_SETNS:
+            case ZYDIS_MNEMONIC_SETNZ:
+            case ZYDIS_MNEMONIC_SETO:
+            case ZYDIS_MNEMONIC_SETP:
+            case ZYDIS_MNEMONIC_SETS:
+            case ZYDIS_MNEMONIC_SETZ:
+                return true;
+        }
+        return false;
+    }
+
+    // ZF, SF and PF are taken from the result.
+    static bool hasResultFlags(ZydisMnemonic mnemonic)
+    {
+        switch (mnemonic)
+        {
+            case ZYDIS_MNEMONIC_ADD:
+            case ZYDIS_MNEMONIC_ADC:
+            case ZYDIS_MNEMONIC_SUB:
+            case ZYDIS_MNEMONIC_SBB:
+            case ZYDIS_MNEMONIC_CMP:
+            case ZYDIS_MNEMONIC_AND:
+            case ZYDIS_MNEMONIC_OR:
+            case ZYDIS_MNEMONIC_XOR:
+            case ZYDIS_MNEMONIC_TEST:
+                return true;
+        }
+        return false;
+    }
+
+    // The address is computed like any other value, only the parts without a register are known.
+    static KnownBits getLeaResult(const ZydisDecodedOperandMem& mem, std::size_t addressWidth, std::uint64_t mask)
+    {
+        KnownBits res{};
+        const auto disp = static_cast<std::uint64_t>(mem.disp.value);
+
+        // Bits above the address width are zero extended.
+        res.zero = mask & ~getMask(addressWidth);
+
+        if (mem.base == ZYDIS_REGISTER_RIP || mem.base == ZYDIS_REGISTER_EIP)
+            return res;
+
+        std::uint64_t known = 0;
+        if (mem.base == ZYDIS_REGISTER_NONE && mem.index == ZYDIS_REGISTER_NONE)
+            known = getMask(addressWidth);
+        else if (mem.base == ZYDIS_REGISTER_NONE)
+            known = getMask(std::countr_zero(static_cast<unsigned>(mem.scale)));
+        else if (mem.base == mem.index && mem.scale == 1)
+            known = 1;
+
+        const auto exact = getExact(disp, known & mask);
+        res.zero |= exact.zero;
+        res.one |= exact.one;
+        return res;
+    }
+
+    // Known bits of the result for the operand constraints, the result is also computed for CMP and TEST.
+    static KnownBits getResultBits(const ZydisDisassembledInstruction& instr, std::size_t width)
+    {
+        const auto& ops = instr.operands;
+        const auto mask = getMask(width);
+        const auto isImm = ops[1].type == ZYDIS_OPERAND_TYPE_IMMEDIATE;
+        const auto imm = ops[1].imm.value.u & mask;
+        const auto sameRegs = ops[0].type == ZYDIS_OPERAND_TYPE_REGISTER && ops[1].type == ZYDIS_OPERAND_TYPE_REGISTER
+            && ops[0].reg.value == ops[1].reg.value;
+
+        KnownBits res{};
+        switch (instr.info.mnemonic)
+        {
+            case ZYDIS_MNEMONIC_MOV:
+                if (isImm)
+                    res = getExact(imm, mask);
+                break;
+            case ZYDIS_MNEMONIC_AND:
+            case ZYDIS_MNEMONIC_TEST:
+                if (isImm)
+                    res.zero = ~imm & mask;
+                break;
+            case ZYDIS_MNEMONIC_OR:
+                if (isImm)
+                    res.one = imm;
+                break;
+            case ZYDIS_MNEMONIC_XOR:
+            case ZYDIS_MNEMONIC_SUB:
+            case ZYDIS_MNEMONIC_CMP:
+                if (sameRegs)
+                    res.zero = mask;
+                break;
+            case ZYDIS_MNEMONIC_ADD:
+                // x + x is a shift by one.
+                if (sameRegs)
+                    res.zero = 1;
+                break;
+            case ZYDIS_MNEMONIC_IMUL:
+                if (ops[2].type == ZYDIS_OPERAND_TYPE_IMMEDIATE && instr.info.operand_count_visible == 3)
+                {
+                    // Multiplying by imm shifts in at least as many zeros as imm has trailing zeros.
+                    const auto factor = ops[2].imm.value.u & mask;
+                    res.zero = getMask(factor == 0 ? width : std::countr_zero(factor)) & mask;
+                }
+                else if (sameRegs && instr.info.operand_count_visible == 2 && width >= 2)
+                {
+                    // Squares are 0 or 1 modulo 4.
+                    res.zero = 2;
+                }
+                break;
+            case ZYDIS_MNEMONIC_BTS:
+                if (isImm)
+                    res.one = std::uint64_t{ 1 } << (imm & (width - 1));
+                break;
+            case ZYDIS_MNEMONIC_BTR:
+                if (isImm)
+                    res.zero = std::uint64_t{ 1 } << (imm & (width - 1));
+                break;
+            case ZYDIS_MNEMONIC_SHL:
+            case ZYDIS_MNEMONIC_SAL:
+            case ZYDIS_MNEMONIC_SHR:
+                if (isImm)
+                {
+                    // The count is masked to 5 bits, or 6 bits for 64 bit operands, a zero count leaves the value.
+                    const auto count = static_cast<std::size_t>(imm & (width == 64 ? 63 : 31));
+                    if (count >= width)
+                        res.zero = mask;
+                    else if (instr.info.mnemonic == ZYDIS_MNEMONIC_SHR)
+                        res.zero = mask & ~getMask(width - count);
+                    else
+                        res.zero = getMask(count);
+                }
+                break;
+            case ZYDIS_MNEMONIC_MOVZX:
+                res.zero = mask & ~getMask(ops[1].size);
+                break;
+            case ZYDIS_MNEMONIC_POPCNT:
+            case ZYDIS_MNEMONIC_LZCNT:
+            case ZYDIS_MNEMONIC_TZCNT:
+                // The count is at most the width.
+                res.zero = mask & ~getMask(std::bit_width(width));
+                break;
+            case ZYDIS_MNEMONIC_BSWAP:
+                // Undefined for 16 bit operands, the hardware clears the register.
+                if (width <= 16)
+                    res.zero = mask;
+                break;
+            case ZYDIS_MNEMONIC_LEA:
+                res = getLeaResult(ops[1].mem, instr.info.address_width, mask);
+                break;
+            default:
+                if (isSetcc(instr.info.mnemonic))
+                    res.zero = mask & ~std::uint64_t{ 1 };
+                break;
+        }
+        return res;
+    }
+
+    static KnownBits getFlagBits(const ZydisDisassembledInstruction& instr, const KnownBits& result, std::size_t width)
+    {
+        const auto& ops = instr.operands;
+        const auto mask = getMask(width);
+        const auto sameRegs = ops[0].type == ZYDIS_OPERAND_TYPE_REGISTER && ops[1].type == ZYDIS_OPERAND_TYPE_REGISTER
+            && ops[0].reg.value == ops[1].reg.value;
+
+        KnownBits flags{};
+        const auto setFlag = [&](std::uint32_t flag, bool value) {
+            if (value)
+                flags.one |= flag;
+            else
+                flags.zero |= flag;
+        };
+
+        switch (instr.info.mnemonic)
+        {
+            case ZYDIS_MNEMONIC_SUB:
+            case ZYDIS_MNEMONIC_CMP:
+                // Nothing is borrowed from equal values.
+                if (sameRegs)
+                {
+                    setFlag(ZYDIS_CPUFLAG_CF, false);
+                    setFlag(ZYDIS_CPUFLAG_OF, false);
+                    setFlag(ZYDIS_CPUFLAG_AF, false);
+                }
+                break;
+            case ZYDIS_MNEMONIC_SBB:
+                // The result is 0 or -1, neither overflows and both have even parity.
+                if (sameRegs)
+                {
+                    setFlag(ZYDIS_CPUFLAG_OF, false);
+                    setFlag(ZYDIS_CPUFLAG_PF, true);
+                }
+                break;
+            case ZYDIS_MNEMONIC_CMPXCHG:
+                // Compares the accumulator with itself.
+                if (sameRegs && isAccumulator(ops[0].reg.value))
+                {
+                    setFlag(ZYDIS_CPUFLAG_CF, false);
+                    setFlag(ZYDIS_CPUFLAG_OF, false);
+                    setFlag(ZYDIS_CPUFLAG_AF, false);
+                    setFlag(ZYDIS_CPUFLAG_ZF, true);
+                    setFlag(ZYDIS_CPUFLAG_SF, false);
+                    setFlag(ZYDIS_CPUFLAG_PF, true);
+                }
+                break;
+        }
+
+        if (!hasResultFlags(instr.info.mnemonic))
+            return flags;
+
+        if ((result.zero & mask) == mask)
+            setFlag(ZYDIS_CPUFLAG_ZF, true);
+        else if ((result.one & mask) != 0)
+            setFlag(ZYDIS_CPUFLAG_ZF, false);
+
+        const auto signBit = std::uint64_t{ 1 } << (width - 1);
+        if (((result.zero | result.one) & signBit) != 0)
+            setFlag(ZYDIS_CPUFLAG_SF, (result.one & signBit) != 0);
+
+        if (((result.zero | result.one) & 0xFF) == 0xFF)
+            setFlag(ZYDIS_CPUFLAG_PF, std::popcount(result.one & 0xFF) % 2 == 0);
+
+        return flags;
+    }
+
+    BitModel::BitModel(const ZydisDisassembledInstruction& instr)
+    {
+        const auto& op = instr.operands[0];
+        if (instr.info.operand_count_visible == 0 || op.size == 0 || op.size > 64)
+            return;
+
+        if (op.type != ZYDIS_OPERAND_TYPE_REGISTER && op.type != ZYDIS_OPERAND_TYPE_MEMORY)
+            return;
+
+        if (op.type == ZYDIS_OPERAND_TYPE_REGISTER && !isGpr(op.reg.value))
+            return;
+
+        const auto width = static_cast<std::size_t>(op.size);
+        const auto result = getResultBits(instr, width);
+        _flags = getFlagBits(instr, result, width);
+
+        if (op.type == ZYDIS_OPERAND_TYPE_REGISTER && (op.actions & ZYDIS_OPERAND_ACTION_MASK_WRITE) != 0)
+        {
+            _destReg = op.reg.value;
+            _destWidth = width;
+            _dest = result;
+        }
+    }
+
+    bool BitModel::isPossible(const InputTarget& target) const
+    {
+        if (target.exceptionType != TestData::ExceptionType::None)
+            return true;
+
+        const auto value = target.expectedBitValue != 0;
+        if (target.reg == ZYDIS_REGISTER_FLAGS)
+            return target.bitPos >= 32 || _flags.canBe(target.bitPos, value);
+
+        if (target.reg != _destReg || _destReg == ZYDIS_REGISTER_NONE || target.bitPos >= _destWidth)
+            return true;
+
+        return _dest.canBe(target.bitPos, value);
+    }
+
+} // namespace x86Tester::Generator
@@ -1,7 +1,5 @@
 #include "generator.hpp"
 
-#include "basegenerator.hpp"
-
 #include <Zydis/Encoder.h>
 extern "C" {
 #include <Zydis/Internal/EncoderData.h>
@@ -9,13 +7,17 @@ extern "C" {
 }
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <execution>
 #include <format>
 #include <memory>
 #include <print>
+#include <sfl/static_vector.hpp>
 #include <span>
+#include <unordered_set>
 #include <vector>
 
 namespace x86Tester::Generator
@@ -170,264 +172,308 @@ namespace x86Tester::Generator
                 };
             };
 
-        } // namespace Detail
-
-        class OperandBase
-        {
-        public:
-            virtual ZydisEncoderOperand current() = 0;
-
-            virtual bool advance() = 0;
-        };
-
-        template<typename TClassTable> class RegT : public OperandBase
-        {
-            BaseGenerator<ZydisRegister> _gen{ TClassTable::kTable };
-
-        public:
-            ZydisEncoderOperand current() override
+            struct ImmValues
             {
-                ZydisEncoderOperand op{};
-                op.type = ZYDIS_OPERAND_TYPE_REGISTER;
-                op.reg.value = _gen.current();
-                return op;
-            }
+                static constexpr int64_t kTable[] = {
+                    0, 1, 3, 4, 6, 8, -1, -2, -3, -4, -8, -9, 0x7F, 0x7FFF, 0x7FFFFFFF, 0x7FFFFFFFFFFFFFFF, 0xF, 0xFF,
+                };
+            };
 
-            bool advance() override
+            struct Rel8Values
             {
-                return _gen.advance();
-            }
-        };
-
-        using Gp8 = RegT<Detail::Gp8Regs>;
-        using Gp16 = RegT<Detail::Gp16Regs>;
-        using Gp32 = RegT<Detail::Gp32Regs>;
-        using Gp64 = RegT<Detail::Gp64Regs>;
-        using St = RegT<Detail::StRegs>;
-        using Mmx = RegT<Detail::MmRegs>;
-        using Xmm = RegT<Detail::XmmRegs>;
-        using Ymm = RegT<Detail::YmmRegs>;
-        using Zmm = RegT<Detail::ZmmRegs>;
-        using Tmm = RegT<Detail::TmmRegs>;
-
-        struct RegImplicit : public OperandBase
-        {
-            ZydisRegister reg;
+                static constexpr int64_t kTable[] = {
+                    2, 8, 16, -2, -8, -16,
+                };
+            };
 
-            RegImplicit(ZydisRegister reg)
-                : reg(reg)
+            struct Rel32Values
             {
-            }
+                static constexpr int64_t kTable[] = {
+                    1024, 0x7FFFFFFF, 0x7FFFFFFF, -1024, -0x7FFFFFFF, -0x7FFFFFFF,
+                };
+            };
 
-            ZydisEncoderOperand current() override
+            struct MemDispValues
             {
-                ZydisEncoderOperand op{};
-                op.type = ZYDIS_OPERAND_TYPE_REGISTER;
-                op.reg.value = reg;
-                return op;
-            }
+                static constexpr int64_t kTable[] = {
+                    0,
+                    0x89FFFFF,
+                    -0x89FFFFF,
+                };
+            };
 
-            bool advance() override
+            struct MemScaleValues
             {
-                return false;
-            }
-        };
-
-        class Imm : public OperandBase
-        {
-            static constexpr int64_t kValues[] = {
-                0, 1, 3, 4, 6, 8, -1, -2, -3, -4, -8, -9, 0x7F, 0x7FFF, 0x7FFFFFFF, 0x7FFFFFFFFFFFFFFF, 0xF, 0xFF,
+                static constexpr uint8_t kTable[] = { 1, 4, 8 };
             };
 
-            BaseGenerator<int64_t> _gen{ std::span(kValues) };
-
-        public:
-            ZydisEncoderOperand current() override
+            struct MemForm
             {
-                ZydisEncoderOperand op{};
-                op.type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
-                op.imm.s = _gen.current();
-                return op;
-            }
+                ZydisRegister base{};
+                ZydisRegister index{};
+                uint8_t scale{};
+                int64_t disp{};
+            };
 
-            bool advance() override
+            // Memory that is accessed only differs in the address, a handful of forms covers the encodings
+            // without SIB, with SIB and with both displacement sizes. The executor points the address at
+            // its data window through the registers.
+            struct DataMemForms
             {
-                return _gen.advance();
-            }
-        };
-
-        class Rel8 : public OperandBase
-        {
-            static constexpr int64_t kValues[] = {
-                2, 8, 16, -2, -8, -16,
+                static constexpr MemForm kTable[] = {
+                    { ZYDIS_REGISTER_RBX, ZYDIS_REGISTER_NONE, 0, 0 },
+                    { ZYDIS_REGISTER_R13, ZYDIS_REGISTER_NONE, 0, 0x7F },
+                    { ZYDIS_REGISTER_RBX, ZYDIS_REGISTER_RSI, 8, -0x80 },
+                    { ZYDIS_REGISTER_R13, ZYDIS_REGISTER_R14, 4, 0x12345678 },
+                };
             };
 
-            BaseGenerator<int64_t> _gen{ std::span(kValues) };
+        } // namespace Detail
 
-        public:
-            ZydisEncoderOperand current() override
+        enum class ChoiceKind : uint8_t
+        {
+            FixedReg,
+            Reg,
+            Imm,
+            Mem,
+            DataMem,
+        };
+
+        // One alternative of an operand such as all 64 bit GPRs, the combinations are addressed by index.
+        struct Choice
+        {
+            ChoiceKind kind{};
+            ZydisRegister reg{};
+            // Register class, for memory operands the base and index registers.
+            std::span<const ZydisRegister> regs{};
+            std::span<const int64_t> imms{};
+            std::span<const Detail::MemForm> memForms{};
+            uint16_t memSize{};
+
+            constexpr std::size_t size() const
             {
-                ZydisEncoderOperand op{};
-                op.type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
-                op.imm.s = _gen.current();
-                return op;
+                switch (kind)
+                {
+                    case ChoiceKind::FixedReg:
+                        return 1;
+                    case ChoiceKind::Reg:
+                        return regs.size();
+                    case ChoiceKind::Imm:
+                        return imms.size();
+                    case ChoiceKind::Mem:
+                        return regs.size() * regs.size() * std::size(Detail::MemDispValues::kTable)
+                            * std::size(Detail::MemScaleValues::kTable);
+                    case ChoiceKind::DataMem:
+                        return memForms.size();
+                }
+                return 0;
             }
 
-            bool advance() override
+            ZydisEncoderOperand get(std::size_t index) const
             {
-                return _gen.advance();
+                assert(index < size());
+
+                ZydisEncoderOperand op{};
+                switch (kind)
+                {
+                    case ChoiceKind::FixedReg:
+                        op.type = ZYDIS_OPERAND_TYPE_REGISTER;
+                        op.reg.value = reg;
+                        break;
+                    case ChoiceKind::Reg:
+                        op.type = ZYDIS_OPERAND_TYPE_REGISTER;
+                        op.reg.value = regs[index];
+                        break;
+                    case ChoiceKind::Imm:
+                        op.type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
+                        op.imm.s = imms[index];
+                        break;
+                    case ChoiceKind::Mem:
+                        // Base varies fastest, then index, displacement and scale.
+                        op.type = ZYDIS_OPERAND_TYPE_MEMORY;
+                        op.mem.base = regs[index % regs.size()];
+                        index /= regs.size();
+                        op.mem.index = regs[index % regs.size()];
+                        index /= regs.size();
+                        op.mem.displacement = Detail::MemDispValues::kTable[index % std::size(Detail::MemDispValues::kTable)];
+                        index /= std::size(Detail::MemDispValues::kTable);
+                        op.mem.scale = Detail::MemScaleValues::kTable[index];
+                        op.mem.size = memSize;
+                        break;
+                    case ChoiceKind::DataMem:
+                        op.type = ZYDIS_OPERAND_TYPE_MEMORY;
+                        op.mem.base = memForms[index].base;
+                        op.mem.index = memForms[index].index;
+                        op.mem.scale = memForms[index].scale;
+                        op.mem.displacement = memForms[index].disp;
+                        op.mem.size = memSize;
+                        break;
+                }
+                return op;
             }
         };
 
-        class Rel32 : public OperandBase
+        inline constexpr Choice kGp8{ .kind = ChoiceKind::Reg, .regs = Detail::Gp8Regs::kTable };
+        inline constexpr Choice kGp16{ .kind = ChoiceKind::Reg, .regs = Detail::Gp16Regs::kTable };
+        inline constexpr Choice kGp32{ .kind = ChoiceKind::Reg, .regs = Detail::Gp32Regs::kTable };
+        inline constexpr Choice kGp64{ .kind = ChoiceKind::Reg, .regs = Detail::Gp64Regs::kTable };
+        inline constexpr Choice kSt{ .kind = ChoiceKind::Reg, .regs = Detail::StRegs::kTable };
+        inline constexpr Choice kMmx{ .kind = ChoiceKind::Reg, .regs = Detail::MmRegs::kTable };
+        inline constexpr Choice kXmm{ .kind = ChoiceKind::Reg, .regs = Detail::XmmRegs::kTable };
+        inline constexpr Choice kYmm{ .kind = ChoiceKind::Reg, .regs = Detail::YmmRegs::kTable };
+        inline constexpr Choice kZmm{ .kind = ChoiceKind::Reg, .regs = Detail::ZmmRegs::kTable };
+        inline constexpr Choice kTmm{ .kind = ChoiceKind::Reg, .regs = Detail::TmmRegs::kTable };
+        inline constexpr Choice kImm{ .kind = ChoiceKind::Imm, .imms = Detail::ImmValues::kTable };
+        inline constexpr Choice kRel8{ .kind = ChoiceKind::Imm, .imms = Detail::Rel8Values::kTable };
+        inline constexpr Choice kRel32{ .kind = ChoiceKind::Imm, .imms = Detail::Rel32Values::kTable };
+        inline constexpr Choice kMem8{ .kind = ChoiceKind::Mem, .regs = Detail::Gp8MemRegs::kTable, .memSize = 1 };
+        inline constexpr Choice kMem16{ .kind = ChoiceKind::Mem, .regs = Detail::Gp16MemRegs::kTable, .memSize = 2 };
+        inline constexpr Choice kMem32{ .kind = ChoiceKind::Mem, .regs = Detail::Gp32MemRegs::kTable, .memSize = 4 };
+        inline constexpr Choice kMem64{ .kind = ChoiceKind::Mem, .regs = Detail::Gp64MemRegs::kTable, .memSize = 8 };
+
+        static_assert(kMem64.size() == 6 * 6 * 3 * 3);
+
+        // Explicit memory operand of the given size in bytes.
+        constexpr Choice getDataMem(uint16_t size)
         {
-            static constexpr int64_t kValues[] = {
-                1024, 0x7FFFFFFF, 0x7FFFFFFF, -1024, -0x7FFFFFFF, -0x7FFFFFFF,
-            };
+            return { .kind = ChoiceKind::DataMem, .memForms = Detail::DataMemForms::kTable, .memSize = size };
+        }
 
-            BaseGenerator<int64_t> _gen{ std::span(kValues) };
+        // Choice space of one operand, the alternatives are enumerated one after the other.
+        class Operand
+        {
+            sfl::static_vector<Choice, 4> _choices;
+            std::size_t _size{};
 
         public:
-            ZydisEncoderOperand current() override
+            void add(const Choice& choice)
             {
-                ZydisEncoderOperand op{};
-                op.type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
-                op.imm.s = _gen.current();
-                return op;
+                _choices.push_back(choice);
+                _size += choice.size();
             }
 
-            bool advance() override
+            std::size_t size() const
             {
-                return _gen.advance();
+                return _size;
             }
-        };
 
-        template<typename TRegClass, uint16_t TMemSize> class MemT : public OperandBase
-        {
-            static constexpr uint8_t kScaleValues[] = { 1, 4, 8 };
-            static constexpr int64_t kImmValues[] = {
-                0,
-                0x89FFFFF,
-                -0x89FFFFF,
-            };
-
-            BaseGenerator<ZydisRegister> _seg{ std::span(Detail::SegRegs::kTable) };
-            BaseGenerator<ZydisRegister> _base{ std::span(TRegClass::kTable) };
-            BaseGenerator<ZydisRegister> _index{ std::span(TRegClass::kTable) };
-            BaseGenerator<int64_t> _disp{ std::span(kImmValues) };
-            BaseGenerator<uint8_t> _scale{ std::span(kScaleValues) };
-
-        public:
-            ZydisEncoderOperand current() override
+            bool empty() const
             {
-                ZydisEncoderOperand op{};
-                op.type = ZYDIS_OPERAND_TYPE_MEMORY;
-                op.mem.base = _base.current();
-                op.mem.index = _index.current();
-                op.mem.displacement = _disp.current();
-                op.mem.scale = _scale.current();
-                op.mem.size = TMemSize;
-                return op;
+                return _choices.empty();
             }
 
-            bool advance() override
+            ZydisEncoderOperand get(std::size_t index) const
             {
-                if (_base.advance())
-                    return true;
-                if (_index.advance())
-                    return true;
-                if (_disp.advance())
-                    return true;
-                if (_scale.advance())
-                    return true;
+                for (const auto& choice : _choices)
+                {
+                    if (index < choice.size())
+                        return choice.get(index);
+                    index -= choice.size();
+                }
 
-                return false;
+                assert(false);
+                return {};
             }
         };
 
-        using Mem8 = MemT<Detail::Gp8MemRegs, 1>;
-        using Mem16 = MemT<Detail::Gp16MemRegs, 2>;
-        using Mem32 = MemT<Detail::Gp32MemRegs, 4>;
-        using Mem64 = MemT<Detail::Gp64MemRegs, 8>;
-
-        class Operand
+        // The operands form a mixed radix number with the first operand as the lowest digit, every index
+        // below size() is a distinct combination so any range of them can be enumerated independently.
+        class Instr
         {
-            size_t _index{};
-            std::vector<std::unique_ptr<OperandBase>> _gens;
+            ZydisMnemonic _mnemonic;
+            sfl::static_vector<Operand, ZYDIS_ENCODER_MAX_OPERANDS> _operands;
+            std::size_t _size = 1;
 
         public:
-            template<typename T, typename... Args> void add(Args&&... args)
+            Instr(ZydisMnemonic mnemonic)
+                : _mnemonic(mnemonic)
             {
-                _gens.push_back(std::make_unique<T>(std::forward<Args>(args)...));
             }
 
-            ZydisEncoderOperand current()
+            void addOperand(Operand&& op)
             {
-                assert(_index < _gens.size());
-
-                return _gens[_index]->current();
+                _size *= op.size();
+                _operands.push_back(std::move(op));
             }
 
-            bool advance()
+            std::size_t size() const
             {
-                if (_gens[_index]->advance())
-                    return true;
+                return _size;
+            }
 
-                _index++;
-                if (_index < _gens.size())
-                    return true;
+            std::size_t getOperandCount() const
+            {
+                return _operands.size();
+            }
 
-                _index = 0;
-                return false;
+            const Operand& getOperand(std::size_t index) const
+            {
+                return _operands[index];
             }
 
-            bool empty() const
+            ZydisEncoderRequest get(std::size_t index) const
             {
-                return _gens.empty();
+                assert(index < _size);
+
+                ZydisEncoderRequest req{};
+                req.mnemonic = _mnemonic;
+                req.operand_count = static_cast<ZyanU8>(_operands.size());
+                for (size_t i = 0; i < _operands.size(); ++i)
+                {
+                    req.operands[i] = _operands[i].get(index % _operands[i].size());
+                    index /= _operands[i].size();
+                }
+                return req;
             }
         };
 
-        class Instr
+        // Walks consecutive combinations, only the operands whose digit changed are rebuilt.
+        class Cursor
         {
-            ZydisMnemonic _mnemonic;
-            std::vector<Operand> _opGens;
+            const Instr& _instr;
+            std::size_t _digits[ZYDIS_ENCODER_MAX_OPERANDS]{};
+            ZydisEncoderRequest _req{};
 
         public:
-            Instr(ZydisMnemonic mnemonic)
-                : _mnemonic(mnemonic)
+            Cursor(const Instr& instr, std::size_t index)
+                : _instr(instr)
+                , _req(instr.get(index))
             {
+                for (std::size_t i = 0; i < instr.getOperandCount(); ++i)
+                {
+                    const auto radix = instr.getOperand(i).size();
+                    _digits[i] = index % radix;
+                    index /= radix;
+                }
             }
 
-            void addOpGen(Operand&& gen)
+            const ZydisEncoderRequest& current() const
             {
-                _opGens.push_back(std::move(gen));
+                return _req;
             }
 
-            ZydisEncoderRequest current()
+            void advance()
             {
-                ZydisEncoderRequest req{};
-                req.mnemonic = _mnemonic;
-                req.operand_count = _opGens.size();
-                for (size_t i = 0; i < _opGens.size(); ++i)
+                for (std::size_t i = 0; i < _instr.getOperandCount(); ++i)
                 {
-                    req.operands[i] = _opGens[i].current();
-                }
-                return req;
-            }
+                    const auto& op = _instr.getOperand(i);
+                    if (++_digits[i] < op.size())
+                    {
+                        _req.operands[i] = op.get(_digits[i]);
+                        return;
+                    }
 
-            bool advance()
-            {
-                for (size_t i = 0; i < _opGens.size(); ++i)
-                {
-                    if (_opGens[i].advance())
-                        return true;
+                    _digits[i] = 0;
+                    _req.operands[i] = op.get(0);
                 }
-                return false;
             }
         };
 
     } // namespace Generators
 
+    // Matches the data window of the executor.
+    static constexpr std::size_t kMaxDataMemSize = 64;
+
     static Generators::Operand buildOpGenerators(ZydisMnemonic mnemonic, const ZydisOperandDefinition& opDef)
     {
         Generators::Operand gens;
@@ -435,7 +481,25 @@ namespace x86Tester::Generator
         auto handleImplicitReg = [&]() {
             if (opDef.op.reg.type == ZYDIS_IMPLREG_TYPE_STATIC)
             {
-                gens.add<Generators::RegImplicit>(static_cast<ZydisRegister>(opDef.op.reg.reg.reg));
+                gens.add({
+                    .kind = Generators::ChoiceKind::FixedReg,
+                    .reg = static_cast<ZydisRegister>(opDef.op.reg.reg.reg),
+                });
+            }
+        };
+
+        // One choice per operand size, sizes that depend on the vector length are not known here and
+        // operands larger than the data window can't be executed.
+        auto handleDataMem = [&]() {
+            for (std::size_t i = 0; i < std::size(opDef.size); ++i)
+            {
+                const auto size = opDef.size[i];
+                const auto seen = std::find(std::begin(opDef.size), std::begin(opDef.size) + i, size)
+                    != std::begin(opDef.size) + i;
+                if (size == 0 || size > kMaxDataMemSize || seen)
+                    continue;
+
+                gens.add(Generators::getDataMem(size));
             }
         };
 
@@ -445,62 +509,65 @@ namespace x86Tester::Generator
                 handleImplicitReg();
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_GPR8:
-                gens.add<Generators::Gp8>();
+                gens.add(Generators::kGp8);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_GPR16:
-                gens.add<Generators::Gp16>();
+                gens.add(Generators::kGp16);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_GPR32:
-                gens.add<Generators::Gp32>();
+                gens.add(Generators::kGp32);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_GPR64:
-                gens.add<Generators::Gp64>();
+                gens.add(Generators::kGp64);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_GPR16_32_64:
-                gens.add<Generators::Gp16>();
-                gens.add<Generators::Gp32>();
-                gens.add<Generators::Gp64>();
+                gens.add(Generators::kGp16);
+                gens.add(Generators::kGp32);
+                gens.add(Generators::kGp64);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_GPR32_32_64:
-                gens.add<Generators::Gp32>();
-                gens.add<Generators::Gp64>();
+                gens.add(Generators::kGp32);
+                gens.add(Generators::kGp64);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_GPR16_32_32:
-                gens.add<Generators::Gp16>();
-                gens.add<Generators::Gp32>();
+                gens.add(Generators::kGp16);
+                gens.add(Generators::kGp32);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_GPR_ASZ:
-                gens.add<Generators::Gp16>();
-                gens.add<Generators::Gp32>();
-                gens.add<Generators::Gp64>();
+                gens.add(Generators::kGp16);
+                gens.add(Generators::kGp32);
+                gens.add(Generators::kGp64);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_IMM:
-                gens.add<Generators::Imm>();
+                gens.add(Generators::kImm);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_FPR:
-                gens.add<Generators::St>();
+                gens.add(Generators::kSt);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_MMX:
-                gens.add<Generators::Mmx>();
+                gens.add(Generators::kMmx);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_XMM:
-                gens.add<Generators::Xmm>();
+                gens.add(Generators::kXmm);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_YMM:
-                gens.add<Generators::Ymm>();
+                gens.add(Generators::kYmm);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_ZMM:
-                gens.add<Generators::Zmm>();
+                gens.add(Generators::kZmm);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_REL:
-                gens.add<Generators::Rel8>();
-                gens.add<Generators::Rel32>();
+                gens.add(Generators::kRel8);
+                gens.add(Generators::kRel32);
                 break;
             case ZYDIS_SEMANTIC_OPTYPE_AGEN:
-                gens.add<Generators::Mem8>();
-                gens.add<Generators::Mem16>();
-                gens.add<Generators::Mem32>();
-                gens.add<Generators::Mem64>();
+                gens.add(Generators::kMem8);
+                gens.add(Generators::kMem16);
+                gens.add(Generators::kMem32);
+                gens.add(Generators::kMem64);
+                break;
+            case ZYDIS_SEMANTIC_OPTYPE_MEM:
+                handleDataMem();
                 break;
             default:
                 break;
@@ -540,6 +607,9 @@ namespace x86Tester::Generator
 
                 Generators::Instr instr((ZydisMnemonic)mnemonic);
 
+                if (base_definition->operand_count_visible > ZYDIS_ENCODER_MAX_OPERANDS)
+                    continue;
+
                 bool badCombination = false;
                 for (uint8_t j = 0; j < base_definition->operand_count_visible; ++j)
                 {
@@ -552,7 +622,7 @@ namespace x86Tester::Generator
                         break;
                     }
 
-                    instr.addOpGen(std::move(opGen));
+                    instr.addOperand(std::move(opGen));
                 }
 
                 if (badCombination)
@@ -625,37 +695,259 @@ namespace x86Tester::Generator
         return res;
     }
 
-    template<bool TEnabled> struct CondLockGuard
+    // Shape of an encoder request, two requests with the same signature only differ in displacements and
+    // immediates of the same width. Those differences don't change whether an encoding exists so a failure
+    // for one of them can be assumed for all. Registers are kept as they are, whether a form exists can
+    // depend on the specific register, RSP can't be an index and some forms only take CL or the accumulator.
+    struct EncodeSignature
     {
-        std::mutex& mtx;
-        bool enabled;
+        ZydisMnemonic mnemonic{};
+        uint64_t operands[ZYDIS_ENCODER_MAX_OPERANDS]{};
+
+        bool operator==(const EncodeSignature&) const = default;
+    };
+
+    struct EncodeSignatureHash
+    {
+        std::size_t operator()(const EncodeSignature& sig) const
+        {
+            // FNV-1a over the fields.
+            std::size_t hash = 0xCBF29CE484222325ULL;
+            const auto mix = [&](uint64_t value) {
+                hash ^= value;
+                hash *= 0x100000001B3ULL;
+            };
+            mix(static_cast<uint64_t>(sig.mnemonic));
+            for (const auto op : sig.operands)
+                mix(op);
+            return hash;
+        }
+    };
 
-        CondLockGuard(std::mutex& mtx)
-            : mtx{ mtx }
+    // Registers of a class that need different prefixes, they don't necessarily encode in the same forms.
+    static uint64_t getRegGroup(ZydisRegister reg)
+    {
+        switch (reg)
         {
-            if constexpr (TEnabled)
+            case ZYDIS_REGISTER_AH:
+            case ZYDIS_REGISTER_CH:
+            case ZYDIS_REGISTER_DH:
+            case ZYDIS_REGISTER_BH:
+                // Can't be used with REX.
+                return 1;
+            case ZYDIS_REGISTER_SPL:
+            case ZYDIS_REGISTER_BPL:
+            case ZYDIS_REGISTER_SIL:
+            case ZYDIS_REGISTER_DIL:
+                // Requires REX.
+                return 2;
+            default:
+                break;
+        }
+
+        const auto id = ZydisRegisterGetId(reg);
+        if (id < 8)
+            return 0;
+        if (id < 16)
+            return 2;
+        // EVEX only.
+        return 3;
+    }
+
+    // Smallest width of the signed and of the unsigned interpretation, 3 bits each.
+    static uint64_t getValueWidth(int64_t value)
+    {
+        const auto signedWidth = [&]() -> uint64_t {
+            if (value == 0)
+                return 0;
+            if (value >= INT8_MIN && value <= INT8_MAX)
+                return 1;
+            if (value >= INT16_MIN && value <= INT16_MAX)
+                return 2;
+            if (value >= INT32_MIN && value <= INT32_MAX)
+                return 3;
+            return 4;
+        }();
+
+        const auto unsignedValue = static_cast<uint64_t>(value);
+        const auto unsignedWidth = [&]() -> uint64_t {
+            if (unsignedValue == 0)
+                return 0;
+            if (unsignedValue <= UINT8_MAX)
+                return 1;
+            if (unsignedValue <= UINT16_MAX)
+                return 2;
+            if (unsignedValue <= UINT32_MAX)
+                return 3;
+            return 4;
+        }();
+
+        return signedWidth | (unsignedWidth << 3);
+    }
+
+    // 18 bits, zero for no register.
+    static uint64_t getRegSignature(ZydisMachineMode mode, ZydisRegister reg)
+    {
+        if (reg == ZYDIS_REGISTER_NONE)
+            return 0;
+
+        // The width tells IP/EIP/RIP apart which share a class, the group AH from SPL which share an id.
+        const auto regWidth = std::bit_width(static_cast<uint32_t>(ZydisRegisterGetWidth(mode, reg)));
+        const auto regClass = static_cast<uint64_t>(ZydisRegisterGetClass(reg));
+        const auto regId = static_cast<uint64_t>(ZydisRegisterGetId(reg));
+        assert(regClass < 64 && regWidth < 16 && regId < 32);
+
+        return 1 | (regClass << 1) | (getRegGroup(reg) << 7) | (static_cast<uint64_t>(regWidth) << 9)
+               | (regId << 13);
+    }
+
+    static EncodeSignature getEncodeSignature(const ZydisEncoderRequest& req, ZydisMachineMode mode)
+    {
+        EncodeSignature sig{};
+        sig.mnemonic = req.mnemonic;
+
+        for (std::size_t i = 0; i < req.operand_count; ++i)
+        {
+            const auto& op = req.operands[i];
+            uint64_t opSig = static_cast<uint64_t>(op.type);
+            switch (op.type)
             {
-                mtx.lock();
+                case ZYDIS_OPERAND_TYPE_REGISTER:
+                    opSig |= getRegSignature(mode, op.reg.value) << 3;
+                    break;
+                case ZYDIS_OPERAND_TYPE_IMMEDIATE:
+                    opSig |= getValueWidth(op.imm.s) << 3;
+                    break;
+                case ZYDIS_OPERAND_TYPE_MEMORY:
+                    opSig |= getRegSignature(mode, op.mem.base) << 3;
+                    opSig |= getRegSignature(mode, op.mem.index) << 21;
+                    opSig |= getValueWidth(op.mem.displacement) << 39;
+                    opSig |= static_cast<uint64_t>(op.mem.scale) << 45;
+                    opSig |= static_cast<uint64_t>(op.mem.size) << 49;
+                    break;
+                default:
+                    break;
             }
+            sig.operands[i] = opSig;
         }
 
-        ~CondLockGuard()
+        return sig;
+    }
+
+    // Memoizes encode failures per signature, the encoder is only asked for shapes not known to fail.
+    class ValidityCache
+    {
+        std::unordered_set<EncodeSignature, EncodeSignatureHash> _invalid;
+
+    public:
+        std::size_t numHits{};
+        std::size_t numMisses{};
+
+        bool isKnownInvalid(const EncodeSignature& sig)
         {
-            if constexpr (TEnabled)
+            if (_invalid.contains(sig))
             {
-                mtx.unlock();
+                numHits++;
+                return true;
             }
+            numMisses++;
+            return false;
+        }
+
+        void addInvalid(const EncodeSignature& sig)
+        {
+            _invalid.insert(sig);
         }
     };
 
-    template<bool TBuildInParallel>
-    InstructionEntries buildInstructionsImpl(ZydisMachineMode mode, const Filter& filter, ProgressReportFn reporter)
+    // Append-only storage for the encodings of a single work item, uses the same layout as
+    // InstructionEntries::instrData. Chunks are never reallocated so appending never copies the
+    // previous encodings and every work item writes to its own buffer without any locking.
+    class EncodingBuffer
     {
-        InstructionEntries res;
+        static constexpr std::size_t kInitialChunkSize = 256;
+        static constexpr std::size_t kMaxChunkSize = 64 * 1024;
+
+        struct Chunk
+        {
+            std::unique_ptr<uint8_t[]> data;
+            std::size_t capacity{};
+            std::size_t size{};
+        };
+
+        std::vector<Chunk> _chunks;
+        std::size_t _size{};
+        std::size_t _count{};
 
-        std::mutex mtx;
+    public:
+        void append(const EncodeResult& encoded)
+        {
+            const std::size_t len = 1 + encoded.size;
+
+            if (_chunks.empty() || _chunks.back().capacity - _chunks.back().size < len)
+            {
+                // Most work items only produce a handful of encodings, start small.
+                const auto capacity = _chunks.empty() ? kInitialChunkSize
+                                                      : std::min(_chunks.back().capacity * 2, kMaxChunkSize);
+                _chunks.push_back({ std::make_unique_for_overwrite<uint8_t[]>(capacity), capacity, 0 });
+            }
+
+            auto& chunk = _chunks.back();
+            chunk.data[chunk.size] = encoded.size;
+            std::memcpy(chunk.data.get() + chunk.size + 1, encoded.buf, encoded.size);
+            chunk.size += len;
+
+            _size += len;
+            _count++;
+        }
+
+        std::size_t size() const
+        {
+            return _size;
+        }
+
+        std::size_t count() const
+        {
+            return _count;
+        }
+
+        // Copies the encodings to data and writes their offsets, data is at baseOffset of the final buffer.
+        void copyTo(uint8_t* data, uint32_t baseOffset, uint32_t* offsets) const
+        {
+            std::size_t pos = 0;
+            for (const auto& chunk : _chunks)
+            {
+                std::memcpy(data + pos, chunk.data.get(), chunk.size);
+
+                for (std::size_t i = 0; i < chunk.size; i += 1 + chunk.data[i])
+                {
+                    *offsets++ = static_cast<uint32_t>(baseOffset + pos + i);
+                }
+
+                pos += chunk.size;
+            }
+        }
+    };
+
+    // Range of combinations of a single instruction.
+    struct WorkItem
+    {
+        std::size_t instrIndex;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    static constexpr std::size_t kWorkItemSize = 4096;
+
+    template<bool TBuildInParallel>
+    InstructionEntries buildInstructionsImpl(
+        ZydisMachineMode mode, const Filter& filter, ProgressReportFn reporter, BuildStats* stats)
+    {
         std::atomic<size_t> progress{};
         std::atomic<size_t> countInvalid{};
+        std::atomic<size_t> countCacheHits{};
+        std::atomic<size_t> countCacheMisses{};
+        std::atomic<size_t> countCombinations{};
 
         static constexpr auto kExecutionPolicy = []() {
             if constexpr (TBuildInParallel)
@@ -664,55 +956,111 @@ namespace x86Tester::Generator
                 return std::execution::seq;
         }();
 
-        auto instrGenerators = createGenerators(filter);
-        std::for_each(kExecutionPolicy, instrGenerators.begin(), instrGenerators.end(), [&](auto& instr) {
-            for (;;)
+        const auto instrGenerators = createGenerators(filter);
+
+        // Split every instruction into ranges of combinations so a single huge instruction doesn't end up on
+        // one thread.
+        std::vector<WorkItem> workItems;
+        for (std::size_t i = 0; i < instrGenerators.size(); ++i)
+        {
+            const auto numCombinations = instrGenerators[i].size();
+            for (std::size_t begin = 0; begin < numCombinations; begin += kWorkItemSize)
             {
-                auto req = instr.current();
+                workItems.push_back({ i, begin, std::min(begin + kWorkItemSize, numCombinations) });
+            }
+        }
+
+        std::vector<EncodingBuffer> buffers(workItems.size());
+
+        std::for_each(kExecutionPolicy, workItems.begin(), workItems.end(), [&](const WorkItem& item) {
+            auto& buffer = buffers[&item - workItems.data()];
+
+            ValidityCache cache;
+            std::size_t numInvalid = 0;
+
+            Generators::Cursor cursor(instrGenerators[item.instrIndex], item.begin);
+            for (std::size_t i = item.begin; i < item.end; ++i, cursor.advance())
+            {
+                const auto& req = cursor.current();
+
+                const auto sig = getEncodeSignature(req, mode);
+                if (cache.isKnownInvalid(sig))
+                {
+                    numInvalid++;
+                    continue;
+                }
 
                 auto encodeRes = checkEncode(req, mode);
                 bool isValid = encodeRes.status == ZYAN_STATUS_SUCCESS;
 
                 if (isValid)
                 {
-                    CondLockGuard<TBuildInParallel> lock(mtx);
-
-                    const auto entryOffset = static_cast<uint32_t>(res.instrData.size());
-
-                    res.instrData.push_back(encodeRes.size);
-                    res.instrData.insert(res.instrData.end(), encodeRes.buf, encodeRes.buf + encodeRes.size);
-
-                    res.entryOffsets.push_back(entryOffset);
+                    buffer.append(encodeRes);
                 }
                 else
                 {
-                    countInvalid++;
+                    cache.addInvalid(sig);
+                    numInvalid++;
                 }
-
-                if (!instr.advance())
-                    break;
             }
 
-            progress++;
+            countInvalid += numInvalid;
+            countCacheHits += cache.numHits;
+            countCacheMisses += cache.numMisses;
+            countCombinations += item.end - item.begin;
+
+            const auto numDone = ++progress;
 
             if (reporter)
-                reporter(progress.load(), instrGenerators.size());
+                reporter(numDone, workItems.size());
+        });
+
+        // Merge in order so the result doesn't depend on scheduling.
+        std::vector<std::size_t> dataOffsets(buffers.size());
+        std::vector<std::size_t> entryIndices(buffers.size());
+        std::size_t totalSize = 0;
+        std::size_t totalCount = 0;
+        for (std::size_t i = 0; i < buffers.size(); ++i)
+        {
+            dataOffsets[i] = totalSize;
+            entryIndices[i] = totalCount;
+            totalSize += buffers[i].size();
+            totalCount += buffers[i].count();
+        }
+
+        InstructionEntries res;
+        res.instrData.resize(totalSize);
+        res.entryOffsets.resize(totalCount);
+
+        std::for_each(kExecutionPolicy, buffers.begin(), buffers.end(), [&](const auto& buffer) {
+            const auto index = &buffer - buffers.data();
+            buffer.copyTo(
+                res.instrData.data() + dataOffsets[index], static_cast<uint32_t>(dataOffsets[index]),
+                res.entryOffsets.data() + entryIndices[index]);
         });
 
+        if (stats != nullptr)
+        {
+            stats->numCombinations = countCombinations;
+            stats->numInvalid = countInvalid;
+            stats->numCacheHits = countCacheHits;
+            stats->numCacheMisses = countCacheMisses;
+        }
+
         return res;
     }
 
     InstructionEntries buildInstructions(
-        ZydisMachineMode mode, const Filter& filter, bool buildInParallel, ProgressReportFn reporter)
+        ZydisMachineMode mode, const Filter& filter, bool buildInParallel, ProgressReportFn reporter, BuildStats* stats)
     {
         auto entries = [&]() {
             if (buildInParallel)
             {
-                return buildInstructionsImpl<true>(mode, filter, reporter);
+                return buildInstructionsImpl<true>(mode, filter, reporter, stats);
             }
             else
             {
-                return buildInstructionsImpl<false>(mode, filter, reporter);
+                return buildInstructionsImpl<false>(mode, filter, reporter, stats);
             }
         }();
 
@@ -0,0 +1,873 @@
+#include <algorithm>
+#include <bit>
+#include <x86Tester/inputconstructor.hpp>
+
+namespace x86Tester::Generator
+{
+    // Targets that depend on more than the result are checked against a model of the instruction and
+    // retried with new random values.
+    static constexpr std::size_t kMaxTries = 64;
+
+    struct ModelResult
+    {
+        std::uint64_t value{};
+        std::uint32_t flags{};
+    };
+
+    struct RegLocation
+    {
+        ZydisRegister rootReg{};
+        // In bytes, AH starts at 1.
+        std::size_t offset{};
+        std::size_t size{};
+    };
+
+    static RegLocation getRegLocation(ZydisMachineMode mode, ZydisRegister reg)
+    {
+        std::size_t offset = 0;
+        switch (reg)
+        {
+            case ZYDIS_REGISTER_AH:
+            case ZYDIS_REGISTER_BH:
+            case ZYDIS_REGISTER_CH:
+            case ZYDIS_REGISTER_DH:
+                offset = 1;
+                break;
+        }
+        return { ZydisRegisterGetLargestEnclosing(mode, reg), offset, ZydisRegisterGetWidth(mode, reg) / 8u };
+    }
+
+    static bool regsOverlap(ZydisMachineMode mode, ZydisRegister a, ZydisRegister b)
+    {
+        const auto locA = getRegLocation(mode, a);
+        const auto locB = getRegLocation(mode, b);
+        return locA.rootReg == locB.rootReg && locA.offset < locB.offset + locB.size
+            && locB.offset < locA.offset + locA.size;
+    }
+
+    // Calls fn(fieldByte, valueByteIndex) for every byte of the fields that belongs to the register.
+    template<typename Fn>
+    static void forEachRegByte(std::span<const InputField> fields, ZydisMachineMode mode, ZydisRegister reg, Fn&& fn)
+    {
+        const auto dst = getRegLocation(mode, reg);
+        for (const auto& field : fields)
+        {
+            const auto src = getRegLocation(mode, field.reg);
+            if (src.rootReg != dst.rootReg)
+                continue;
+
+            for (std::size_t i = 0; i < field.data.size(); ++i)
+            {
+                const auto pos = src.offset + i;
+                if (pos < dst.offset || pos >= dst.offset + std::min<std::size_t>(dst.size, sizeof(std::uint64_t)))
+                    continue;
+
+                fn(field.data[i], pos - dst.offset);
+            }
+        }
+    }
+
+    static std::uint64_t readReg(std::span<const InputField> fields, ZydisMachineMode mode, ZydisRegister reg)
+    {
+        std::uint64_t value = 0;
+        forEachRegByte(fields, mode, reg, [&](std::uint8_t& data, std::size_t index) {
+            value |= std::uint64_t{ data } << (index * 8);
+        });
+        return value;
+    }
+
+    static void writeReg(std::span<const InputField> fields, ZydisMachineMode mode, ZydisRegister reg, std::uint64_t value)
+    {
+        forEachRegByte(fields, mode, reg, [&](std::uint8_t& data, std::size_t index) {
+            data = static_cast<std::uint8_t>(value >> (index * 8));
+        });
+    }
+
+    static std::uint64_t getMask(std::size_t width)
+    {
+        return width >= 64 ? ~std::uint64_t{} : (std::uint64_t{ 1 } << width) - 1;
+    }
+
+    static std::uint64_t setBit(std::uint64_t value, std::size_t bitIndex, bool set)
+    {
+        const auto bit = std::uint64_t{ 1 } << bitIndex;
+        return set ? value | bit : value & ~bit;
+    }
+
+    static bool isExpectedFlag(const InputTarget& target, std::uint32_t flag)
+    {
+        return target.reg == ZYDIS_REGISTER_FLAGS && target.bitPos == std::countr_zero(flag);
+    }
+
+    static std::uint32_t getResultFlags(std::uint64_t value, std::size_t width)
+    {
+        std::uint32_t flags = 0;
+        if ((value & getMask(width)) == 0)
+            flags |= ZYDIS_CPUFLAG_ZF;
+        if (((value >> (width - 1)) & 1) != 0)
+            flags |= ZYDIS_CPUFLAG_SF;
+        if (std::popcount(static_cast<std::uint8_t>(value)) % 2 == 0)
+            flags |= ZYDIS_CPUFLAG_PF;
+        return flags;
+    }
+
+    // Position of the target bit within the destination register, false if the target is elsewhere.
+    static bool getDestBit(
+        ZydisMachineMode mode, const InputTarget& target, ZydisRegister destReg, std::size_t width, std::size_t& bitIndex)
+    {
+        if (target.reg == ZYDIS_REGISTER_NONE || target.reg == ZYDIS_REGISTER_FLAGS)
+            return false;
+
+        const auto targetLoc = getRegLocation(mode, target.reg);
+        const auto destLoc = getRegLocation(mode, destReg);
+        if (targetLoc.rootReg != destLoc.rootReg)
+            return false;
+
+        const auto pos = targetLoc.offset * 8 + target.bitPos;
+        if (pos < destLoc.offset * 8 || pos >= destLoc.offset * 8 + width)
+            return false;
+
+        bitIndex = pos - destLoc.offset * 8;
+        return true;
+    }
+
+    static bool isTargetMet(
+        ZydisMachineMode mode, const InputTarget& target, ZydisRegister destReg, std::size_t width,
+        const ModelResult& res)
+    {
+        if (target.reg == ZYDIS_REGISTER_FLAGS)
+            return ((res.flags >> target.bitPos) & 1) == target.expectedBitValue;
+
+        std::size_t bitIndex{};
+        if (!getDestBit(mode, target, destReg, width, bitIndex))
+            return false;
+
+        return ((res.value >> bitIndex) & 1) == target.expectedBitValue;
+    }
+
+    // Random result that already has the target value if the target only depends on the result.
+    static std::uint64_t makeResult(
+        ZydisMachineMode mode, const InputTarget& target, ZydisRegister destReg, std::size_t width, Random::Prng& prng)
+    {
+        auto value = prng() & getMask(width);
+        const auto expected = target.expectedBitValue != 0;
+
+        std::size_t bitIndex{};
+        if (getDestBit(mode, target, destReg, width, bitIndex))
+            value = setBit(value, bitIndex, expected);
+        else if (isExpectedFlag(target, ZYDIS_CPUFLAG_ZF))
+            value = expected ? 0 : setBit(value, prng() % width, true);
+        else if (isExpectedFlag(target, ZYDIS_CPUFLAG_SF))
+            value = setBit(value, width - 1, expected);
+        else if (isExpectedFlag(target, ZYDIS_CPUFLAG_PF))
+        {
+            // Flipping a single bit flips the parity.
+            if (((getResultFlags(value, width) & ZYDIS_CPUFLAG_PF) != 0) != expected)
+                value ^= 1;
+        }
+
+        return value;
+    }
+
+    namespace Alu
+    {
+        enum class Op
+        {
+            Add,
+            Adc,
+            Sub,
+            Sbb,
+            Cmp,
+            And,
+            Or,
+            Xor,
+            Test,
+            Inc,
+            Dec,
+            Neg,
+            Not,
+        };
+
+        static ModelResult add(std::uint64_t a, std::uint64_t b, std::uint64_t carry, std::size_t width)
+        {
+            // Operate on the top bits so the carry out of the operand width is the carry out of 64 bits.
+            const auto shift = 64 - width;
+            const auto a1 = a << shift;
+            const auto b1 = b << shift;
+            const auto sum = a1 + b1;
+            const auto res = sum + (carry << shift);
+
+            ModelResult out{ res >> shift, getResultFlags(res >> shift, width) };
+            if (sum < a1 || res < sum)
+                out.flags |= ZYDIS_CPUFLAG_CF;
+            if ((((a1 ^ res) & (b1 ^ res)) >> 63) != 0)
+                out.flags |= ZYDIS_CPUFLAG_OF;
+            if ((((a ^ b ^ out.value) >> 4) & 1) != 0)
+                out.flags |= ZYDIS_CPUFLAG_AF;
+            return out;
+        }
+
+        static ModelResult sub(std::uint64_t a, std::uint64_t b, std::uint64_t borrow, std::size_t width)
+        {
+            const auto shift = 64 - width;
+            const auto a1 = a << shift;
+            const auto b1 = b << shift;
+            const auto diff = a1 - b1;
+            const auto res = diff - (borrow << shift);
+
+            ModelResult out{ res >> shift, getResultFlags(res >> shift, width) };
+            if (a1 < b1 || diff < (borrow << shift))
+                out.flags |= ZYDIS_CPUFLAG_CF;
+            if ((((a1 ^ b1) & (a1 ^ res)) >> 63) != 0)
+                out.flags |= ZYDIS_CPUFLAG_OF;
+            if ((((a ^ b ^ out.value) >> 4) & 1) != 0)
+                out.flags |= ZYDIS_CPUFLAG_AF;
+            return out;
+        }
+
+        static ModelResult model(Op op, std::uint64_t a, std::uint64_t b, std::uint32_t inFlags, std::size_t width)
+        {
+            const auto mask = getMask(width);
+            const std::uint64_t carry = (inFlags & ZYDIS_CPUFLAG_CF) != 0 ? 1 : 0;
+            const auto logic = [&](std::uint64_t value) { return ModelResult{ value & mask, getResultFlags(value, width) }; };
+            const auto keepCarry = [&](ModelResult res) {
+                res.flags = (res.flags & ~ZYDIS_CPUFLAG_CF) | (inFlags & ZYDIS_CPUFLAG_CF);
+                return res;
+            };
+
+            switch (op)
+            {
+                case Op::Add:
+                    return add(a, b, 0, width);
+                case Op::Adc:
+                    return add(a, b, carry, width);
+                case Op::Sub:
+                case Op::Cmp:
+                    return sub(a, b, 0, width);
+                case Op::Sbb:
+                    return sub(a, b, carry, width);
+                case Op::And:
+                case Op::Test:
+                    return logic(a & b);
+                case Op::Or:
+                    return logic(a | b);
+                case Op::Xor:
+                    return logic(a ^ b);
+                case Op::Inc:
+                    return keepCarry(add(a, 1, 0, width));
+                case Op::Dec:
+                    return keepCarry(sub(a, 1, 0, width));
+                case Op::Neg:
+                    return sub(0, a, 0, width);
+                case Op::Not:
+                    return { ~a & mask, inFlags };
+            }
+            return {};
+        }
+
+        template<Op TOp>
+        static bool construct(
+            const ZydisDisassembledInstruction& instr, const InputTarget& target, std::span<const InputField> fields,
+            std::uint32_t& flags, Random::Prng& prng)
+        {
+            const auto mode = instr.info.machine_mode;
+            const std::size_t width = instr.info.operand_width;
+            const auto& dst = instr.operands[0];
+            const auto& src = instr.operands[1];
+
+            if (target.exceptionType != TestData::ExceptionType::None)
+                return false;
+            if (dst.type != ZYDIS_OPERAND_TYPE_REGISTER || width < 8 || width > 64)
+                return false;
+
+            constexpr auto isUnary = TOp == Op::Inc || TOp == Op::Dec || TOp == Op::Neg || TOp == Op::Not;
+            constexpr auto usesCarry = TOp == Op::Adc || TOp == Op::Sbb;
+
+            const auto srcIsReg = !isUnary && src.type == ZYDIS_OPERAND_TYPE_REGISTER;
+            if (!isUnary && !srcIsReg && src.type != ZYDIS_OPERAND_TYPE_IMMEDIATE)
+                return false;
+            // Both operands would have to be the same value.
+            if (srcIsReg && regsOverlap(mode, dst.reg.value, src.reg.value))
+                return false;
+
+            const auto mask = getMask(width);
+            for (std::size_t i = 0; i < kMaxTries; ++i)
+            {
+                const auto result = makeResult(mode, target, dst.reg.value, width, prng);
+                const std::uint64_t carry = usesCarry ? prng() & 1 : 0;
+                const auto rnd = prng();
+
+                std::uint64_t a = 0;
+                std::uint64_t b = 0;
+                if constexpr (isUnary)
+                {
+                    if constexpr (TOp == Op::Inc)
+                        a = result - 1;
+                    else if constexpr (TOp == Op::Dec)
+                        a = result + 1;
+                    else if constexpr (TOp == Op::Neg)
+                        a = 0 - result;
+                    else
+                        a = ~result;
+                }
+                else if (!srcIsReg)
+                {
+                    b = src.imm.value.u & mask;
+                    if constexpr (TOp == Op::Add || TOp == Op::Adc)
+                        a = result - b - carry;
+                    else if constexpr (TOp == Op::Sub || TOp == Op::Sbb || TOp == Op::Cmp)
+                        a = result + b + carry;
+                    else if constexpr (TOp == Op::Xor)
+                        a = result ^ b;
+                    else if constexpr (TOp == Op::And || TOp == Op::Test)
+                        a = (result & b) | (rnd & ~b);
+                    else
+                        a = (result & ~b) | (rnd & b);
+                }
+                else
+                {
+                    // The first try keeps the generated destination value.
+                    a = i == 0 ? readReg(fields, mode, dst.reg.value) : prng();
+                    if constexpr (TOp == Op::Add || TOp == Op::Adc)
+                        b = result - a - carry;
+                    else if constexpr (TOp == Op::Sub || TOp == Op::Sbb || TOp == Op::Cmp)
+                        b = a - result - carry;
+                    else if constexpr (TOp == Op::Xor)
+                        b = a ^ result;
+                    else if constexpr (TOp == Op::And || TOp == Op::Test)
+                    {
+                        a = result | (a & rnd);
+                        b = result | (prng() & ~a);
+                    }
+                    else
+                    {
+                        a = result & rnd;
+                        b = (result & ~a) | (result & prng());
+                    }
+                }
+
+                a &= mask;
+                b &= mask;
+
+                auto inFlags = flags;
+                if constexpr (usesCarry)
+                    inFlags = (flags & ~ZYDIS_CPUFLAG_CF) | (carry != 0 ? ZYDIS_CPUFLAG_CF : 0);
+
+                if (!isTargetMet(mode, target, dst.reg.value, width, model(TOp, a, b, inFlags, width)))
+                    continue;
+
+                writeReg(fields, mode, dst.reg.value, a);
+                if (srcIsReg)
+                    writeReg(fields, mode, src.reg.value, b);
+                flags = inFlags;
+                return true;
+            }
+
+            return false;
+        }
+
+    } // namespace Alu
+
+    namespace Shift
+    {
+        enum class Op
+        {
+            Shl,
+            Shr,
+            Sar,
+            Rol,
+            Ror,
+        };
+
+        // Count is within [0, width), OF is modelled as for a count of 1.
+        static ModelResult model(Op op, std::uint64_t a, std::size_t count, std::uint32_t inFlags, std::size_t width)
+        {
+            const auto mask = getMask(width);
+            const auto msb = [&](std::uint64_t value) { return ((value >> (width - 1)) & 1) != 0; };
+            a &= mask;
+
+            // Nothing changes, not even the flags.
+            if (count == 0)
+                return { a, inFlags };
+
+            std::uint64_t value = 0;
+            bool cf = false;
+            bool of = false;
+            switch (op)
+            {
+                case Op::Shl:
+                    value = (a << count) & mask;
+                    cf = ((a >> (width - count)) & 1) != 0;
+                    of = msb(value) != cf;
+                    break;
+                case Op::Shr:
+                    value = a >> count;
+                    cf = ((a >> (count - 1)) & 1) != 0;
+                    of = msb(a);
+                    break;
+                case Op::Sar:
+                    value = static_cast<std::uint64_t>(static_cast<std::int64_t>(msb(a) ? a | ~mask : a) >> count) & mask;
+                    cf = ((a >> (count - 1)) & 1) != 0;
+                    break;
+                case Op::Rol:
+                    value = ((a << count) | (a >> (width - count))) & mask;
+                    cf = (value & 1) != 0;
+                    of = msb(value) != cf;
+                    break;
+                case Op::Ror:
+                    value = ((a >> count) | (a << (width - count))) & mask;
+                    cf = msb(value);
+                    of = msb(value) != (((value >> (width - 2)) & 1) != 0);
+                    break;
+            }
+
+            std::uint32_t flags = inFlags & ~(ZYDIS_CPUFLAG_CF | ZYDIS_CPUFLAG_OF);
+            // Rotates leave the result flags alone.
+            if (op != Op::Rol && op != Op::Ror)
+                flags = (flags & ~(ZYDIS_CPUFLAG_ZF | ZYDIS_CPUFLAG_SF | ZYDIS_CPUFLAG_PF)) | getResultFlags(value, width);
+            if (cf)
+                flags |= ZYDIS_CPUFLAG_CF;
+            if (of)
+                flags |= ZYDIS_CPUFLAG_OF;
+
+            return { value, flags };
+        }
+
+        template<Op TOp>
+        static bool construct(
+            const ZydisDisassembledInstruction& instr, const InputTarget& target, std::span<const InputField> fields,
+            std::uint32_t& flags, Random::Prng& prng)
+        {
+            const auto mode = instr.info.machine_mode;
+            const std::size_t width = instr.info.operand_width;
+            const auto& dst = instr.operands[0];
+            const auto& countOp = instr.operands[1];
+
+            if (target.exceptionType != TestData::ExceptionType::None)
+                return false;
+            if (dst.type != ZYDIS_OPERAND_TYPE_REGISTER || width < 8 || width > 64)
+                return false;
+
+            const auto countIsReg = countOp.type == ZYDIS_OPERAND_TYPE_REGISTER;
+            if (countIsReg && regsOverlap(mode, dst.reg.value, countOp.reg.value))
+                return false;
+
+            std::size_t fixedCount = 0;
+            if (!countIsReg)
+            {
+                if (countOp.type != ZYDIS_OPERAND_TYPE_IMMEDIATE)
+                    return false;
+
+                // Counts of zero leave everything alone, counts past the width are not modelled.
+                fixedCount = countOp.imm.value.u & (width == 64 ? 63 : 31);
+                if (fixedCount == 0 || fixedCount >= width)
+                    return false;
+            }
+
+            // A count of 0 leaves the flags alone and OF is only defined for a count of 1.
+            const auto targetsFlags = target.reg == ZYDIS_REGISTER_FLAGS;
+            const auto targetsOverflow = isExpectedFlag(target, ZYDIS_CPUFLAG_OF);
+
+            // Shifted in bits are zero, a set target bit has to come from the input.
+            std::size_t maxCount = width - 1;
+            std::size_t targetBit{};
+            if (target.expectedBitValue != 0 && getDestBit(mode, target, dst.reg.value, width, targetBit))
+            {
+                if (TOp == Op::Shl)
+                    maxCount = targetBit;
+                else if (TOp == Op::Shr)
+                    maxCount = width - 1 - targetBit;
+            }
+
+            const auto mask = getMask(width);
+            for (std::size_t i = 0; i < kMaxTries; ++i)
+            {
+                std::size_t count = fixedCount;
+                if (countIsReg)
+                {
+                    if (targetsOverflow)
+                        count = 1;
+                    else
+                        count = targetsFlags ? 1 + prng() % (width - 1) : prng() % (maxCount + 1);
+                }
+
+                auto result = makeResult(mode, target, dst.reg.value, width, prng);
+                const auto rnd = prng();
+                const auto shiftedOut = rnd & getMask(count);
+
+                std::uint64_t a = result;
+                if (count != 0)
+                {
+                    switch (TOp)
+                    {
+                        case Op::Shl:
+                            a = (result >> count) | (rnd << (width - count));
+                            break;
+                        case Op::Shr:
+                            a = (result << count) | shiftedOut;
+                            break;
+                        case Op::Sar:
+                        {
+                            // The top bits of the result are copies of the sign.
+                            const auto signBits = mask & ~getMask(width - count - 1);
+                            result = ((result >> (width - 1)) & 1) != 0 ? result | signBits : result & ~signBits;
+                            a = (result << count) | shiftedOut;
+                            break;
+                        }
+                        case Op::Rol:
+                            a = (result >> count) | (result << (width - count));
+                            break;
+                        case Op::Ror:
+                            a = (result << count) | (result >> (width - count));
+                            break;
+                    }
+                }
+                a &= mask;
+
+                if (!isTargetMet(mode, target, dst.reg.value, width, model(TOp, a, count, flags, width)))
+                    continue;
+
+                writeReg(fields, mode, dst.reg.value, a);
+                if (countIsReg)
+                    writeReg(fields, mode, countOp.reg.value, count);
+                return true;
+            }
+
+            return false;
+        }
+
+    } // namespace Shift
+
+    namespace BitTest
+    {
+        enum class Op
+        {
+            Test,
+            Set,
+            Reset,
+            Complement,
+        };
+
+        static ModelResult model(Op op, std::uint64_t base, std::size_t bitIndex, std::uint32_t inFlags)
+        {
+            const auto bit = std::uint64_t{ 1 } << bitIndex;
+
+            ModelResult res{};
+            res.value = base;
+            res.flags = inFlags & ~ZYDIS_CPUFLAG_CF;
+            if ((base & bit) != 0)
+                res.flags |= ZYDIS_CPUFLAG_CF;
+
+            switch (op)
+            {
+                case Op::Test:
+                    break;
+                case Op::Set:
+                    res.value |= bit;
+                    break;
+                case Op::Reset:
+                    res.value &= ~bit;
+                    break;
+                case Op::Complement:
+                    res.value ^= bit;
+                    break;
+            }
+            return res;
+        }
+
+        template<Op TOp>
+        static bool construct(
+            const ZydisDisassembledInstruction& instr, const InputTarget& target, std::span<const InputField> fields,
+            std::uint32_t& flags, Random::Prng& prng)
+        {
+            const auto mode = instr.info.machine_mode;
+            const std::size_t width = instr.info.operand_width;
+            const auto& base = instr.operands[0];
+            const auto& offsetOp = instr.operands[1];
+
+            if (target.exceptionType != TestData::ExceptionType::None)
+                return false;
+            // Memory operands address bits outside of the operand.
+            if (base.type != ZYDIS_OPERAND_TYPE_REGISTER || width < 16 || width > 64)
+                return false;
+
+            const auto offsetIsReg = offsetOp.type == ZYDIS_OPERAND_TYPE_REGISTER;
+            if (offsetIsReg && regsOverlap(mode, base.reg.value, offsetOp.reg.value))
+                return false;
+            if (!offsetIsReg && offsetOp.type != ZYDIS_OPERAND_TYPE_IMMEDIATE)
+                return false;
+
+            const auto mask = getMask(width);
+            for (std::size_t i = 0; i < kMaxTries; ++i)
+            {
+                const auto bitIndex = offsetIsReg ? prng() % width : offsetOp.imm.value.u & (width - 1);
+
+                auto value = (i == 0 ? readReg(fields, mode, base.reg.value) : prng()) & mask;
+
+                std::size_t destBit{};
+                if (isExpectedFlag(target, ZYDIS_CPUFLAG_CF))
+                    value = setBit(value, bitIndex, target.expectedBitValue != 0);
+                else if (getDestBit(mode, target, base.reg.value, width, destBit))
+                {
+                    // The tested bit itself is fixed by the operation, except for complement.
+                    const auto expected = target.expectedBitValue != 0;
+                    value = setBit(value, destBit, TOp == Op::Complement && destBit == bitIndex ? !expected : expected);
+                }
+
+                if (!isTargetMet(mode, target, base.reg.value, width, model(TOp, value, bitIndex, flags)))
+                    continue;
+
+                writeReg(fields, mode, base.reg.value, value);
+                if (offsetIsReg)
+                    writeReg(fields, mode, offsetOp.reg.value, bitIndex);
+                return true;
+            }
+
+            return false;
+        }
+
+    } // namespace BitTest
+
+    namespace Divide
+    {
+        struct UInt128
+        {
+            std::uint64_t lo{};
+            std::uint64_t hi{};
+        };
+
+        // a * b + c, can't overflow.
+        static UInt128 mulAdd(std::uint64_t a, std::uint64_t b, std::uint64_t c)
+        {
+            const auto aLo = a & 0xFFFFFFFFU;
+            const auto aHi = a >> 32;
+            const auto bLo = b & 0xFFFFFFFFU;
+            const auto bHi = b >> 32;
+
+            const auto p0 = aLo * bLo;
+            const auto p1 = aLo * bHi;
+            const auto p2 = aHi * bLo;
+            const auto p3 = aHi * bHi;
+            const auto mid = (p0 >> 32) + (p1 & 0xFFFFFFFFU) + (p2 & 0xFFFFFFFFU);
+
+            UInt128 res{ (p0 & 0xFFFFFFFFU) | (mid << 32), p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32) };
+            res.lo += c;
+            if (res.lo < c)
+                res.hi++;
+            return res;
+        }
+
+        static UInt128 negate(UInt128 value)
+        {
+            value.lo = ~value.lo + 1;
+            value.hi = ~value.hi + (value.lo == 0 ? 1 : 0);
+            return value;
+        }
+
+        static std::uint64_t getMagnitude(std::uint64_t value, std::size_t width, bool& negative)
+        {
+            const auto mask = getMask(width);
+            negative = ((value >> (width - 1)) & 1) != 0;
+            return negative ? (0 - value) & mask : value & mask;
+        }
+
+        template<bool TSigned>
+        static bool construct(
+            const ZydisDisassembledInstruction& instr, const InputTarget& target, std::span<const InputField> fields,
+            std::uint32_t&, Random::Prng& prng)
+        {
+            const auto mode = instr.info.machine_mode;
+            const std::size_t width = instr.info.operand_width;
+            const auto& divisorOp = instr.operands[0];
+
+            if (divisorOp.type != ZYDIS_OPERAND_TYPE_REGISTER)
+                return false;
+
+            // The dividend and the results are in AX for byte division and in rDX:rAX otherwise.
+            ZydisRegister lowReg{};
+            ZydisRegister highReg{};
+            switch (width)
+            {
+                case 8:
+                    lowReg = ZYDIS_REGISTER_AL;
+                    highReg = ZYDIS_REGISTER_AH;
+                    break;
+                case 16:
+                    lowReg = ZYDIS_REGISTER_AX;
+                    highReg = ZYDIS_REGISTER_DX;
+                    break;
+                case 32:
+                    lowReg = ZYDIS_REGISTER_EAX;
+                    highReg = ZYDIS_REGISTER_EDX;
+                    break;
+                case 64:
+                    lowReg = ZYDIS_REGISTER_RAX;
+                    highReg = ZYDIS_REGISTER_RDX;
+                    break;
+                default:
+                    return false;
+            }
+
+            const auto divisorReg = divisorOp.reg.value;
+            if (regsOverlap(mode, divisorReg, lowReg) || regsOverlap(mode, divisorReg, highReg))
+                return false;
+
+            const auto mask = getMask(width);
+            const auto signBit = std::uint64_t{ 1 } << (width - 1);
+
+            const auto assign = [&](std::uint64_t divisor, UInt128 dividend) {
+                writeReg(fields, mode, divisorReg, divisor & mask);
+                writeReg(fields, mode, lowReg, dividend.lo & mask);
+                writeReg(fields, mode, highReg, (width == 64 ? dividend.hi : dividend.lo >> width) & mask);
+                return true;
+            };
+
+            switch (target.exceptionType)
+            {
+                case TestData::ExceptionType::DivideError:
+                    return assign(0, { prng(), prng() });
+                case TestData::ExceptionType::IntegerOverflow:
+                {
+                    // Quotient that doesn't fit, a positive upper half at least as large as the divisor.
+                    const auto divisor = TSigned ? 1 + prng() % (signBit - 1) : 1 + prng() % mask;
+                    const auto limit = TSigned ? signBit : mask + 1;
+                    const auto high = divisor + prng() % (limit - divisor);
+                    const auto low = prng() & mask;
+                    return assign(divisor, { width == 64 ? low : low | (high << width), width == 64 ? high : 0 });
+                }
+                default:
+                    break;
+            }
+
+            std::size_t bitIndex{};
+            const auto isQuotient = getDestBit(mode, target, lowReg, width, bitIndex);
+            if (!isQuotient && !getDestBit(mode, target, highReg, width, bitIndex))
+                return false;
+
+            const auto expected = target.expectedBitValue != 0;
+            for (std::size_t i = 0; i < kMaxTries; ++i)
+            {
+                if constexpr (!TSigned)
+                {
+                    // dividend = quotient * divisor + remainder with remainder < divisor.
+                    if (isQuotient)
+                    {
+                        const auto divisor = 1 + prng() % mask;
+                        const auto quotient = setBit(prng() & mask, bitIndex, expected);
+                        return assign(divisor, mulAdd(quotient, divisor, prng() % divisor));
+                    }
+
+                    auto remainder = setBit(prng() & mask, bitIndex, expected);
+                    if (remainder == mask)
+                        remainder = setBit(remainder, (bitIndex + 1) % width, false);
+
+                    const auto divisor = remainder + 1 + prng() % (mask - remainder);
+                    return assign(divisor, mulAdd(prng() & mask, divisor, remainder));
+                }
+                else
+                {
+                    // Same with magnitudes, the remainder has the sign of the dividend.
+                    bool quotientNeg{};
+                    bool remainderNeg{};
+                    std::uint64_t quotientMag{};
+                    std::uint64_t remainderMag{};
+                    std::uint64_t divisorMag{};
+                    bool divisorNeg = (prng() & 1) != 0;
+                    // The most negative divisor has no positive counterpart.
+                    const auto fixDivisorSign = [&]() {
+                        if (divisorMag == signBit)
+                            divisorNeg = true;
+                    };
+
+                    if (isQuotient)
+                    {
+                        quotientMag = getMagnitude(setBit(prng() & mask, bitIndex, expected), width, quotientNeg);
+                        divisorMag = 1 + prng() % signBit;
+                        fixDivisorSign();
+                        remainderMag = prng() % divisorMag;
+                        remainderNeg = quotientMag != 0 ? quotientNeg != divisorNeg : (prng() & 1) != 0;
+                    }
+                    else
+                    {
+                        remainderMag = getMagnitude(setBit(prng() & mask, bitIndex, expected), width, remainderNeg);
+                        if (remainderMag >= signBit)
+                            continue;
+
+                        divisorMag = remainderMag + 1 + prng() % (signBit - remainderMag);
+                        fixDivisorSign();
+                        quotientMag = prng() % signBit;
+                        quotientNeg = remainderNeg != divisorNeg;
+                    }
+
+                    const auto dividendNeg = remainderMag != 0 ? remainderNeg : quotientNeg != divisorNeg;
+                    auto dividend = mulAdd(quotientMag, divisorMag, remainderMag);
+                    if (dividendNeg)
+                        dividend = negate(dividend);
+
+                    return assign(divisorNeg ? 0 - divisorMag : divisorMag, dividend);
+                }
+            }
+
+            return false;
+        }
+
+    } // namespace Divide
+
+    InputConstructorFn getInputConstructor(ZydisMnemonic mnemonic)
+    {
+        switch (mnemonic)
+        {
+            case ZYDIS_MNEMONIC_DIV:
+                return Divide::construct<false>;
+            case ZYDIS_MNEMONIC_IDIV:
+                return Divide::construct<true>;
+            case ZYDIS_MNEMONIC_SHL:
+            case ZYDIS_MNEMONIC_SAL:
+                return Shift::construct<Shift::Op::Shl>;
+            case ZYDIS_MNEMONIC_SHR:
+                return Shift::construct<Shift::Op::Shr>;
+            case ZYDIS_MNEMONIC_SAR:
+                return Shift::construct<Shift::Op::Sar>;
+            case ZYDIS_MNEMONIC_ROL:
+                return Shift::construct<Shift::Op::Rol>;
+            case ZYDIS_MNEMONIC_ROR:
+                return Shift::construct<Shift::Op::Ror>;
+            case ZYDIS_MNEMONIC_BT:
+                return BitTest::construct<BitTest::Op::Test>;
+            case ZYDIS_MNEMONIC_BTS:
+                return BitTest::construct<BitTest::Op::Set>;
+            case ZYDIS_MNEMONIC_BTR:
+                return BitTest::construct<BitTest::Op::Reset>;
+            case ZYDIS_MNEMONIC_BTC:
+                return BitTest::construct<BitTest::Op::Complement>;
+            case ZYDIS_MNEMONIC_ADD:
+                return Alu::construct<Alu::Op::Add>;
+            case ZYDIS_MNEMONIC_ADC:
+                return Alu::construct<Alu::Op::Adc>;
+            case ZYDIS_MNEMONIC_SUB:
+                return Alu::construct<Alu::Op::Sub>;
+            case ZYDIS_MNEMONIC_SBB:
+                return Alu::construct<Alu::Op::Sbb>;
+            case ZYDIS_MNEMONIC_CMP:
+                return Alu::construct<Alu::Op::Cmp>;
+            case ZYDIS_MNEMONIC_AND:
+                return Alu::construct<Alu::Op::And>;
+            case ZYDIS_MNEMONIC_OR:
+                return Alu::construct<Alu::Op::Or>;
+            case ZYDIS_MNEMONIC_XOR:
+                return Alu::construct<Alu::Op::Xor>;
+            case ZYDIS_MNEMONIC_TEST:
+                return Alu::construct<Alu::Op::Test>;
+            case ZYDIS_MNEMONIC_INC:
+                return Alu::construct<Alu::Op::Inc>;
+            case ZYDIS_MNEMONIC_DEC:
+                return Alu::construct<Alu::Op::Dec>;
+            case ZYDIS_MNEMONIC_NEG:
+                return Alu::construct<Alu::Op::Neg>;
+            case ZYDIS_MNEMONIC_NOT:
+                return Alu::construct<Alu::Op::Not>;
+        }
+        return nullptr;
+    }
+
+} // namespace x86Tester::Generator
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <x86Tester/bitmatch.hpp>
+
+namespace x86Tester::tests
+{
+    TEST(BitMatchTest, require_change)
+    {
+        BitMatch::Targets targets(8);
+        targets.add(0, 1);
+        targets.add(1, 0);
+        targets.add(2, 1);
+        targets.requireChange(2);
+        ASSERT_EQ(targets.getCount(), 3);
+
+        BitMatch::Image input;
+        BitMatch::Image output;
+        output.bytes[0] = 0b101;
+        // Bit 2 was already set, it doesn't count.
+        input.bytes[0] = 0b100;
+
+        BitMatch::Image matched0;
+        BitMatch::Image matched1;
+        ASSERT_TRUE(targets.match(input, output, matched0, matched1));
+        ASSERT_EQ(matched0.bytes[0], 0b010);
+        ASSERT_EQ(matched1.bytes[0], 0b001);
+
+        ASSERT_EQ(targets.remove(matched0, matched1), 2);
+        ASSERT_FALSE(targets.match(input, output, matched0, matched1));
+
+        input.bytes[0] = 0;
+        ASSERT_TRUE(targets.match(input, output, matched0, matched1));
+        ASSERT_EQ(targets.remove(matched0, matched1), 1);
+        ASSERT_TRUE(targets.empty());
+    }
+
+    TEST(BitMatchTest, coverage_reports_new_values)
+    {
+        BitMatch::Coverage coverage(4);
+
+        BitMatch::Image output;
+        ASSERT_TRUE(coverage.update(output));
+        ASSERT_FALSE(coverage.update(output));
+
+        output.bytes[3] = 0x80;
+        ASSERT_TRUE(coverage.update(output));
+        ASSERT_FALSE(coverage.update(output));
+
+        // Past the size, not tracked.
+        output.bytes[4] = 0xFF;
+        ASSERT_FALSE(coverage.update(output));
+    }
+
+    TEST(BitMatchTest, avx2_matches_scalar)
+    {
+        if (!BitMatch::isAvx2Supported())
+            GTEST_SKIP();
+
+        std::mt19937_64 prng(1);
+
+        BitMatch::Targets targets(BitMatch::kMaxImageSize);
+        for (std::size_t i = 0; i < BitMatch::kMaxImageSize * 8; ++i)
+        {
+            if (prng() % 3 == 0)
+                targets.add(i, prng() % 2);
+            if (prng() % 4 == 0)
+                targets.requireChange(i);
+        }
+
+        for (std::size_t run = 0; run < 64; ++run)
+        {
+            BitMatch::Image input;
+            BitMatch::Image output;
+            for (std::size_t i = 0; i < BitMatch::kMaxImageSize; ++i)
+            {
+                input.bytes[i] = static_cast<std::uint8_t>(prng());
+                output.bytes[i] = static_cast<std::uint8_t>(prng());
+            }
+
+            BitMatch::Image scalar0, scalar1, avx0, avx1;
+            ASSERT_EQ(
+                targets.matchScalar(input, output, scalar0, scalar1), targets.matchAvx2(input, output, avx0, avx1));
+            ASSERT_EQ(scalar0.bytes, avx0.bytes);
+            ASSERT_EQ(scalar1.bytes, avx1.bytes);
+        }
+    }
+
+    TEST(BitMatchTest, fixed_matches_scalar)
+    {
+        std::mt19937_64 prng(2);
+
+        // Flags behind a single GPR, the image of most ALU instructions.
+        constexpr std::size_t kSize = 12;
+        BitMatch::Targets targets(kSize);
+        for (std::size_t i = 0; i < kSize * 8; ++i)
+        {
+            if (prng() % 3 == 0)
+                targets.add(i, prng() % 2);
+            if (prng() % 4 == 0)
+                targets.requireChange(i);
+        }
+
+        for (std::size_t run = 0; run < 64; ++run)
+        {
+            BitMatch::Image input;
+            BitMatch::Image output;
+            for (std::size_t i = 0; i < kSize; ++i)
+            {
+                input.bytes[i] = static_cast<std::uint8_t>(prng());
+                output.bytes[i] = static_cast<std::uint8_t>(prng());
+            }
+
+            BitMatch::Image scalar0, scalar1, fixed0, fixed1;
+            ASSERT_EQ(
+                targets.matchScalar(input, output, scalar0, scalar1),
+                targets.matchFixed<kSize>(input, output, fixed0, fixed1));
+            ASSERT_EQ(scalar0.bytes, fixed0.bytes);
+            ASSERT_EQ(scalar1.bytes, fixed1.bytes);
+        }
+    }
+
+} // namespace x86Tester::tests
@@ -0,0 +1,176 @@
+#include "utils.hpp"
+
+#include <array>
+#include <bit>
+#include <gtest/gtest.h>
+#include <x86Tester/bitmodel.hpp>
+
+namespace x86Tester::tests
+{
+    using ExceptionType = TestData::ExceptionType;
+
+    static bool isRegBitPossible(const Generator::BitModel& model, ZydisRegister reg, std::uint16_t bitPos, std::uint8_t value)
+    {
+        return model.isPossible({ ExceptionType::None, reg, bitPos, value });
+    }
+
+    static bool isFlagPossible(const Generator::BitModel& model, std::uint32_t flag, std::uint8_t value)
+    {
+        return model.isPossible(
+            { ExceptionType::None, ZYDIS_REGISTER_FLAGS, static_cast<std::uint16_t>(std::countr_zero(flag)), value });
+    }
+
+    TEST(BitModelTest, same_regs)
+    {
+        // xor eax, eax
+        const Generator::BitModel xorModel(disassemble(std::array<std::uint8_t, 2>{ 0x31, 0xC0 }));
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            ASSERT_TRUE(isRegBitPossible(xorModel, ZYDIS_REGISTER_EAX, bitPos, 0));
+            ASSERT_FALSE(isRegBitPossible(xorModel, ZYDIS_REGISTER_EAX, bitPos, 1));
+        }
+        ASSERT_FALSE(isFlagPossible(xorModel, ZYDIS_CPUFLAG_ZF, 0));
+        ASSERT_FALSE(isFlagPossible(xorModel, ZYDIS_CPUFLAG_SF, 1));
+        ASSERT_FALSE(isFlagPossible(xorModel, ZYDIS_CPUFLAG_PF, 0));
+
+        // cmp ecx, ecx
+        const Generator::BitModel cmpModel(disassemble(std::array<std::uint8_t, 2>{ 0x39, 0xC9 }));
+        ASSERT_FALSE(isFlagPossible(cmpModel, ZYDIS_CPUFLAG_CF, 1));
+        ASSERT_FALSE(isFlagPossible(cmpModel, ZYDIS_CPUFLAG_OF, 1));
+        ASSERT_FALSE(isFlagPossible(cmpModel, ZYDIS_CPUFLAG_AF, 1));
+        ASSERT_TRUE(isFlagPossible(cmpModel, ZYDIS_CPUFLAG_ZF, 1));
+
+        // add eax, eax, the low bit is shifted out but the sum still overflows.
+        const Generator::BitModel addModel(disassemble(std::array<std::uint8_t, 2>{ 0x01, 0xC0 }));
+        ASSERT_FALSE(isRegBitPossible(addModel, ZYDIS_REGISTER_EAX, 0, 1));
+        ASSERT_TRUE(isRegBitPossible(addModel, ZYDIS_REGISTER_EAX, 1, 1));
+        ASSERT_TRUE(isFlagPossible(addModel, ZYDIS_CPUFLAG_OF, 1));
+        ASSERT_TRUE(isFlagPossible(addModel, ZYDIS_CPUFLAG_CF, 1));
+
+        // sbb eax, eax
+        const Generator::BitModel sbbModel(disassemble(std::array<std::uint8_t, 2>{ 0x19, 0xC0 }));
+        ASSERT_FALSE(isFlagPossible(sbbModel, ZYDIS_CPUFLAG_OF, 1));
+        ASSERT_FALSE(isFlagPossible(sbbModel, ZYDIS_CPUFLAG_PF, 0));
+        ASSERT_TRUE(isFlagPossible(sbbModel, ZYDIS_CPUFLAG_CF, 1));
+        ASSERT_TRUE(isRegBitPossible(sbbModel, ZYDIS_REGISTER_EAX, 31, 1));
+
+        // imul eax, eax
+        const Generator::BitModel imulModel(disassemble(std::array<std::uint8_t, 3>{ 0x0F, 0xAF, 0xC0 }));
+        ASSERT_TRUE(isRegBitPossible(imulModel, ZYDIS_REGISTER_EAX, 0, 1));
+        ASSERT_FALSE(isRegBitPossible(imulModel, ZYDIS_REGISTER_EAX, 1, 1));
+        ASSERT_TRUE(isRegBitPossible(imulModel, ZYDIS_REGISTER_EAX, 2, 1));
+    }
+
+    TEST(BitModelTest, immediates)
+    {
+        // and eax, 0xF0
+        const Generator::BitModel andModel(
+            disassemble(std::array<std::uint8_t, 5>{ 0x25, 0xF0, 0x00, 0x00, 0x00 }));
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            ASSERT_TRUE(isRegBitPossible(andModel, ZYDIS_REGISTER_EAX, bitPos, 0));
+            ASSERT_EQ(isRegBitPossible(andModel, ZYDIS_REGISTER_EAX, bitPos, 1), bitPos >= 4 && bitPos < 8);
+        }
+        ASSERT_FALSE(isFlagPossible(andModel, ZYDIS_CPUFLAG_SF, 1));
+
+        // or eax, 1
+        const Generator::BitModel orModel(disassemble(std::array<std::uint8_t, 3>{ 0x83, 0xC8, 0x01 }));
+        ASSERT_FALSE(isRegBitPossible(orModel, ZYDIS_REGISTER_EAX, 0, 0));
+        ASSERT_TRUE(isRegBitPossible(orModel, ZYDIS_REGISTER_EAX, 1, 0));
+        ASSERT_FALSE(isFlagPossible(orModel, ZYDIS_CPUFLAG_ZF, 1));
+
+        // mov ecx, 0x80000001
+        const Generator::BitModel movModel(
+            disassemble(std::array<std::uint8_t, 5>{ 0xB9, 0x01, 0x00, 0x00, 0x80 }));
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            const std::uint8_t value = bitPos == 0 || bitPos == 31 ? 1 : 0;
+            ASSERT_TRUE(isRegBitPossible(movModel, ZYDIS_REGISTER_ECX, bitPos, value));
+            ASSERT_FALSE(isRegBitPossible(movModel, ZYDIS_REGISTER_ECX, bitPos, value ^ 1));
+        }
+
+        // shl eax, 4 and shr eax, 4
+        const Generator::BitModel shlModel(disassemble(std::array<std::uint8_t, 3>{ 0xC1, 0xE0, 0x04 }));
+        const Generator::BitModel shrModel(disassemble(std::array<std::uint8_t, 3>{ 0xC1, 0xE8, 0x04 }));
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            ASSERT_EQ(isRegBitPossible(shlModel, ZYDIS_REGISTER_EAX, bitPos, 1), bitPos >= 4);
+            ASSERT_EQ(isRegBitPossible(shrModel, ZYDIS_REGISTER_EAX, bitPos, 1), bitPos < 28);
+        }
+
+        // btr eax, 35 uses the bit offset modulo the width.
+        const Generator::BitModel btrModel(disassemble(std::array<std::uint8_t, 4>{ 0x0F, 0xBA, 0xF0, 0x23 }));
+        ASSERT_FALSE(isRegBitPossible(btrModel, ZYDIS_REGISTER_EAX, 3, 1));
+        ASSERT_TRUE(isRegBitPossible(btrModel, ZYDIS_REGISTER_EAX, 4, 1));
+
+        // imul eax, ecx, 8
+        const Generator::BitModel imulModel(disassemble(std::array<std::uint8_t, 3>{ 0x6B, 0xC1, 0x08 }));
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            ASSERT_EQ(isRegBitPossible(imulModel, ZYDIS_REGISTER_EAX, bitPos, 1), bitPos >= 3);
+        }
+    }
+
+    TEST(BitModelTest, narrow_results)
+    {
+        // movzx eax, cl
+        const Generator::BitModel movzxModel(disassemble(std::array<std::uint8_t, 3>{ 0x0F, 0xB6, 0xC1 }));
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            ASSERT_EQ(isRegBitPossible(movzxModel, ZYDIS_REGISTER_EAX, bitPos, 1), bitPos < 8);
+        }
+
+        // popcnt eax, ecx counts up to 32.
+        const Generator::BitModel popcntModel(disassemble(std::array<std::uint8_t, 4>{ 0xF3, 0x0F, 0xB8, 0xC1 }));
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            ASSERT_EQ(isRegBitPossible(popcntModel, ZYDIS_REGISTER_EAX, bitPos, 1), bitPos < 6);
+        }
+
+        // setz al
+        const Generator::BitModel setzModel(disassemble(std::array<std::uint8_t, 3>{ 0x0F, 0x94, 0xC0 }));
+        for (std::uint16_t bitPos = 0; bitPos < 8; ++bitPos)
+        {
+            ASSERT_EQ(isRegBitPossible(setzModel, ZYDIS_REGISTER_AL, bitPos, 1), bitPos == 0);
+        }
+    }
+
+    TEST(BitModelTest, addresses)
+    {
+        // lea rax, [rcx*4]
+        const Generator::BitModel scaledModel(
+            disassemble(std::array<std::uint8_t, 8>{ 0x48, 0x8D, 0x04, 0x8D, 0x00, 0x00, 0x00, 0x00 }));
+        ASSERT_FALSE(isRegBitPossible(scaledModel, ZYDIS_REGISTER_RAX, 0, 1));
+        ASSERT_FALSE(isRegBitPossible(scaledModel, ZYDIS_REGISTER_RAX, 1, 1));
+        ASSERT_TRUE(isRegBitPossible(scaledModel, ZYDIS_REGISTER_RAX, 2, 1));
+
+        // lea rax, [rcx+rcx*1]
+        const Generator::BitModel doubleModel(disassemble(std::array<std::uint8_t, 4>{ 0x48, 0x8D, 0x04, 0x09 }));
+        ASSERT_FALSE(isRegBitPossible(doubleModel, ZYDIS_REGISTER_RAX, 0, 1));
+
+        // lea rax, [rcx+rcx*2] is a multiply by 3.
+        const Generator::BitModel tripleModel(disassemble(std::array<std::uint8_t, 4>{ 0x48, 0x8D, 0x04, 0x49 }));
+        ASSERT_TRUE(isRegBitPossible(tripleModel, ZYDIS_REGISTER_RAX, 0, 1));
+
+        // lea rax, [ecx], the address is zero extended.
+        const Generator::BitModel narrowModel(disassemble(std::array<std::uint8_t, 4>{ 0x67, 0x48, 0x8D, 0x01 }));
+        ASSERT_TRUE(isRegBitPossible(narrowModel, ZYDIS_REGISTER_RAX, 31, 1));
+        ASSERT_FALSE(isRegBitPossible(narrowModel, ZYDIS_REGISTER_RAX, 32, 1));
+    }
+
+    TEST(BitModelTest, unconstrained)
+    {
+        // div ecx
+        const Generator::BitModel model(disassemble(std::array<std::uint8_t, 2>{ 0xF7, 0xF1 }));
+        ASSERT_TRUE(model.isPossible({ ExceptionType::DivideError, ZYDIS_REGISTER_NONE, 0, 0 }));
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            for (std::uint8_t value = 0; value < 2; ++value)
+            {
+                ASSERT_TRUE(isRegBitPossible(model, ZYDIS_REGISTER_EAX, bitPos, value));
+                ASSERT_TRUE(isRegBitPossible(model, ZYDIS_REGISTER_EDX, bitPos, value));
+            }
+        }
+    }
+
+} // namespace x86Tester::tests
@@ -1,5 +1,6 @@
 #include <Zydis/Disassembler.h>
 #include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <gtest/gtest.h>
@@ -46,4 +47,461 @@ namespace x86Tester::tests
         ASSERT_TRUE(std::ranges::equal(xmm3Value, expectedXmm3Value));
     }
 
+    TEST(ExecutionTest, cvtdq2pd_xmm3_xmm0_debugger)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+        const auto instrBytes = std::array<std::uint8_t, 4>{ 0xF3, 0x0F, 0xE6, 0xD8 };
+
+        auto ctx = Execution::ScopedContext(mode, instrBytes, Execution::Backend::Debugger);
+        ASSERT_TRUE(ctx);
+        ASSERT_EQ(ctx.getBackend(), Execution::Backend::Debugger);
+
+        constexpr auto xmm0Value = std::to_array<std::uint8_t>(
+            { 0xFF, 0x00, 0x80, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 });
+
+        ctx.setRegBytes(ZYDIS_REGISTER_XMM0, xmm0Value);
+        ctx.setRegBytes(ZYDIS_REGISTER_XMM3, kCCBytes);
+
+        ASSERT_TRUE(ctx.execute());
+
+        const auto xmm3Value = ctx.getRegBytes(ZYDIS_REGISTER_XMM3);
+
+        const auto expectedXmm3Value = std::to_array<std::uint8_t>(
+            { 0x00, 0x00, 0x00, 0x40, 0xC0, 0xFF, 0x5F, 0xC1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0xBF });
+
+        ASSERT_TRUE(std::ranges::equal(xmm3Value, expectedXmm3Value));
+    }
+
+    TEST(ExecutionTest, div_rcx_inprocess)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+        const auto instrBytes = std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0xF1 };
+
+        auto ctx = Execution::ScopedContext(mode, instrBytes, Execution::Backend::InProcess);
+        ASSERT_TRUE(ctx);
+
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX, 7);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RDX, 0);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RCX, 0);
+
+        ASSERT_TRUE(ctx.execute());
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::ExceptionIntDivideError);
+
+        // Must recover from the fault.
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RCX, 2);
+
+        ASSERT_TRUE(ctx.execute());
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::Success);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX), 3);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RDX), 1);
+    }
+
+    static void testDivBatch(Execution::Backend backend)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+        const auto instrBytes = std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0xF1 };
+
+        auto ctx = Execution::ScopedContext(mode, instrBytes, backend);
+        ASSERT_TRUE(ctx);
+
+        // Every third entry divides by zero.
+        std::vector<Execution::InputState> inputs(9, ctx.getRegisterFile());
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RAX, 100 + i);
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RDX, 0);
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RCX, i % 3);
+        }
+
+        std::vector<Execution::OutputState> outputs(inputs.size());
+        ASSERT_TRUE(ctx.executeBatch(inputs, outputs));
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            const auto divisor = i % 3;
+            if (divisor == 0)
+            {
+                ASSERT_EQ(outputs[i].status, Execution::ExecutionStatus::ExceptionIntDivideError);
+                continue;
+            }
+
+            ASSERT_EQ(outputs[i].status, Execution::ExecutionStatus::Success);
+            ASSERT_EQ(Execution::getRegValue<std::uint64_t>(outputs[i].regs, ZYDIS_REGISTER_RAX), (100 + i) / divisor);
+            ASSERT_EQ(Execution::getRegValue<std::uint64_t>(outputs[i].regs, ZYDIS_REGISTER_RDX), (100 + i) % divisor);
+        }
+
+        // The context itself is left alone and still usable.
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX, 7);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RCX, 2);
+        ASSERT_TRUE(ctx.execute());
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::Success);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX), 3);
+    }
+
+    TEST(ExecutionTest, div_rcx_batch_inprocess)
+    {
+        testDivBatch(Execution::Backend::InProcess);
+    }
+
+    TEST(ExecutionTest, div_rcx_batch_debugger)
+    {
+        testDivBatch(Execution::Backend::Debugger);
+    }
+
+    static void testDivOverflow(Execution::Backend backend)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+        const auto instrBytes = std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0xF1 };
+
+        auto ctx = Execution::ScopedContext(mode, instrBytes, backend);
+        ASSERT_TRUE(ctx);
+
+        // Same #DE as a zero divisor, reported apart on every platform.
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX, 0);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RDX, 5);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RCX, 2);
+
+        ASSERT_TRUE(ctx.execute());
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::ExceptionIntOverflow);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RDX), 5);
+    }
+
+    TEST(ExecutionTest, div_overflow_inprocess)
+    {
+        testDivOverflow(Execution::Backend::InProcess);
+    }
+
+    TEST(ExecutionTest, div_overflow_debugger)
+    {
+        testDivOverflow(Execution::Backend::Debugger);
+    }
+
+    static void testUnusedStateKept(Execution::Backend backend)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+
+        // add rax, rcx
+        const auto instrBytes = std::array<std::uint8_t, 3>{ 0x48, 0x01, 0xC8 };
+
+        auto ctx = Execution::ScopedContext(mode, instrBytes, backend);
+        ASSERT_TRUE(ctx);
+
+        // XMM isn't part of the state mask, it must come back unchanged.
+        ctx.setRegBytes(ZYDIS_REGISTER_XMM0, kCCBytes);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX, 1);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RCX, 2);
+
+        ASSERT_TRUE(ctx.execute());
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::Success);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX), 3);
+        ASSERT_TRUE(std::ranges::equal(ctx.getRegBytes(ZYDIS_REGISTER_XMM0), kCCBytes));
+    }
+
+    TEST(ExecutionTest, unused_state_kept_inprocess)
+    {
+        testUnusedStateKept(Execution::Backend::InProcess);
+    }
+
+    TEST(ExecutionTest, unused_state_kept_debugger)
+    {
+        testUnusedStateKept(Execution::Backend::Debugger);
+    }
+
+    static std::array<std::uint8_t, 64> makeDwordLanes(std::uint32_t first)
+    {
+        std::array<std::uint8_t, 64> res{};
+        for (std::uint32_t i = 0; i < 16; ++i)
+        {
+            const auto value = first + i;
+            std::memcpy(res.data() + i * 4, &value, sizeof(value));
+        }
+        return res;
+    }
+
+    static void testVpadddYmm(Execution::Backend backend)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+
+        // vpaddd ymm3, ymm0, ymm1
+        const auto instrBytes = std::array<std::uint8_t, 4>{ 0xC5, 0xFD, 0xFE, 0xD9 };
+
+        auto ctx = Execution::ScopedContext(mode, instrBytes, backend);
+        ASSERT_TRUE(ctx);
+
+        const auto a = makeDwordLanes(1);
+        const auto b = makeDwordLanes(100);
+        ctx.setRegBytes(ZYDIS_REGISTER_YMM0, std::span(a).first(32));
+        ctx.setRegBytes(ZYDIS_REGISTER_YMM1, std::span(b).first(32));
+
+        ASSERT_TRUE(ctx.execute());
+        if (ctx.getExecutionStatus() == Execution::ExecutionStatus::IllegalInstruction)
+            GTEST_SKIP();
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::Success);
+
+        // Both halves of the result, XMM3 is the lower one.
+        const auto ymm3Value = ctx.getRegBytes(ZYDIS_REGISTER_YMM3);
+        ASSERT_EQ(ymm3Value.size(), 32);
+        for (std::uint32_t i = 0; i < 8; ++i)
+        {
+            std::uint32_t lane;
+            std::memcpy(&lane, ymm3Value.data() + i * 4, sizeof(lane));
+            ASSERT_EQ(lane, 101 + i * 2);
+        }
+        ASSERT_TRUE(std::ranges::equal(ctx.getRegBytes(ZYDIS_REGISTER_XMM3), ymm3Value.first(16)));
+    }
+
+    TEST(ExecutionTest, vpaddd_ymm_inprocess)
+    {
+        testVpadddYmm(Execution::Backend::InProcess);
+    }
+
+    TEST(ExecutionTest, vpaddd_ymm_debugger)
+    {
+        testVpadddYmm(Execution::Backend::Debugger);
+    }
+
+    TEST(ExecutionTest, vpaddd_zmm_masked)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+
+        // vpaddd zmm3 {k1}, zmm0, zmm1
+        const auto instrBytes = std::array<std::uint8_t, 6>{ 0x62, 0xF1, 0x7D, 0x49, 0xFE, 0xD9 };
+
+        auto ctx = Execution::ScopedContext(mode, instrBytes);
+        // The AVX-512 state can be enabled in a layout the register file doesn't cover.
+        if (!ctx)
+            GTEST_SKIP();
+
+        std::array<std::uint8_t, 64> zmm3Input{};
+        zmm3Input.fill(0xCC);
+        ctx.setRegBytes(ZYDIS_REGISTER_ZMM0, makeDwordLanes(1));
+        ctx.setRegBytes(ZYDIS_REGISTER_ZMM1, makeDwordLanes(100));
+        ctx.setRegBytes(ZYDIS_REGISTER_ZMM3, zmm3Input);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_K1, 0x00FF);
+
+        ASSERT_TRUE(ctx.execute());
+        if (ctx.getExecutionStatus() == Execution::ExecutionStatus::IllegalInstruction)
+            GTEST_SKIP();
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::Success);
+
+        // Lanes outside of the mask are merged.
+        const auto zmm3Value = ctx.getRegBytes(ZYDIS_REGISTER_ZMM3);
+        for (std::uint32_t i = 0; i < 16; ++i)
+        {
+            std::uint32_t lane;
+            std::memcpy(&lane, zmm3Value.data() + i * 4, sizeof(lane));
+            ASSERT_EQ(lane, i < 8 ? 101 + i * 2 : 0xCCCCCCCC);
+        }
+    }
+
+    TEST(ExecutionTest, debugger_sandbox_reuse)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+
+        // add rax, rcx
+        const auto addBytes = std::array<std::uint8_t, 3>{ 0x48, 0x01, 0xC8 };
+        // sub rax, rcx
+        const auto subBytes = std::array<std::uint8_t, 3>{ 0x48, 0x29, 0xC8 };
+
+        std::uint64_t firstBase = 0;
+        {
+            auto ctx = Execution::ScopedContext(mode, addBytes, Execution::Backend::Debugger);
+            ASSERT_TRUE(ctx);
+            firstBase = ctx.getBaseAddress();
+
+            // Two live contexts can't share a sandbox.
+            auto otherCtx = Execution::ScopedContext(mode, subBytes, Execution::Backend::Debugger);
+            ASSERT_TRUE(otherCtx);
+            ASSERT_NE(otherCtx.getBaseAddress(), firstBase);
+        }
+
+        // The released sandbox is reused with the new code and a clean register state.
+        auto ctx = Execution::ScopedContext(mode, subBytes, Execution::Backend::Debugger);
+        ASSERT_TRUE(ctx);
+        ASSERT_EQ(ctx.getBaseAddress(), firstBase);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX), 0);
+
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX, 5);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RCX, 3);
+        ASSERT_TRUE(ctx.execute());
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::Success);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX), 2);
+    }
+
+    TEST(ExecutionTest, backend_auto_selection)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+
+        // add rax, rcx
+        const auto addBytes = std::array<std::uint8_t, 3>{ 0x48, 0x01, 0xC8 };
+        auto addCtx = Execution::ScopedContext(mode, addBytes);
+        ASSERT_TRUE(addCtx);
+        ASSERT_EQ(addCtx.getBackend(), Execution::Backend::InProcess);
+
+        // mov rax, qword ptr [rcx]
+        const auto loadBytes = std::array<std::uint8_t, 3>{ 0x48, 0x8B, 0x01 };
+        auto loadCtx = Execution::ScopedContext(mode, loadBytes);
+        ASSERT_TRUE(loadCtx);
+        ASSERT_EQ(loadCtx.getBackend(), Execution::Backend::Debugger);
+    }
+
+    static void testCodeSlots(Execution::Backend backend)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+
+        // add rax, rcx
+        const auto addBytes = std::array<std::uint8_t, 3>{ 0x48, 0x01, 0xC8 };
+        // sub rax, rcx
+        const auto subBytes = std::array<std::uint8_t, 3>{ 0x48, 0x29, 0xC8 };
+        // div rcx
+        const auto divBytes = std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0xF1 };
+        const std::span<const std::uint8_t> codes[] = { addBytes, subBytes, divBytes };
+
+        auto ctx = Execution::ScopedContext(mode, codes, backend);
+        ASSERT_TRUE(ctx);
+        ASSERT_EQ(ctx.getSlotCount(), 3);
+        for (std::size_t i = 0; i < std::size(codes); ++i)
+        {
+            ASSERT_EQ(ctx.getCodeAddress(i), ctx.getBaseAddress() + i * Execution::kCodeSlotSize + 1);
+        }
+        ASSERT_EQ(ctx.getCodeAddress(), ctx.getCodeAddress(0));
+
+        // Every slot runs its own code on the registers left by the previous one.
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX, 10);
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RCX, 4);
+        ASSERT_TRUE(ctx.execute(0));
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::Success);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX), 14);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RIP), ctx.getCodeAddress(0) + addBytes.size());
+
+        ASSERT_TRUE(ctx.execute(1));
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::Success);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RAX), 10);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RIP), ctx.getCodeAddress(1) + subBytes.size());
+
+        // Faults are reported at the address of their own slot.
+        ctx.setRegValue<std::uint64_t>(ZYDIS_REGISTER_RCX, 0);
+        ASSERT_TRUE(ctx.execute(2));
+        ASSERT_EQ(ctx.getExecutionStatus(), Execution::ExecutionStatus::ExceptionIntDivideError);
+        ASSERT_EQ(ctx.getRegValue<std::uint64_t>(ZYDIS_REGISTER_RIP), ctx.getCodeAddress(2));
+
+        // Batches run the selected slot.
+        std::vector<Execution::InputState> inputs(4, ctx.getRegisterFile());
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RAX, 100);
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RCX, i);
+        }
+        std::vector<Execution::OutputState> outputs(inputs.size());
+        for (std::size_t slot = 0; slot < std::size(codes); ++slot)
+        {
+            ASSERT_TRUE(ctx.executeBatch(slot, inputs, outputs));
+            for (std::size_t i = 0; i < inputs.size(); ++i)
+            {
+                const auto rax = Execution::getRegValue<std::uint64_t>(outputs[i].regs, ZYDIS_REGISTER_RAX);
+                if (slot == 2 && i == 0)
+                {
+                    ASSERT_EQ(outputs[i].status, Execution::ExecutionStatus::ExceptionIntDivideError);
+                    continue;
+                }
+
+                ASSERT_EQ(outputs[i].status, Execution::ExecutionStatus::Success);
+                ASSERT_EQ(rax, slot == 0 ? 100 + i : slot == 1 ? 100 - i : 100 / i);
+            }
+        }
+    }
+
+    TEST(ExecutionTest, code_slots_inprocess)
+    {
+        testCodeSlots(Execution::Backend::InProcess);
+    }
+
+    TEST(ExecutionTest, code_slots_debugger)
+    {
+        testCodeSlots(Execution::Backend::Debugger);
+    }
+
+    static std::uint64_t getDataQword(const Execution::RegisterFile& regs, std::size_t index)
+    {
+        std::uint64_t value{};
+        std::memcpy(&value, regs.data + index * sizeof(value), sizeof(value));
+        return value;
+    }
+
+    static void setDataQword(Execution::RegisterFile& regs, std::size_t index, std::uint64_t value)
+    {
+        std::memcpy(regs.data + index * sizeof(value), &value, sizeof(value));
+    }
+
+    TEST(ExecutionTest, data_window_debugger)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+
+        // add qword ptr [rbx+rsi*8], rax
+        const auto addBytes = std::array<std::uint8_t, 4>{ 0x48, 0x01, 0x04, 0xF3 };
+        // div qword ptr [rbx]
+        const auto divBytes = std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0x33 };
+        // mov rax, qword ptr [rbx+0x40]
+        const auto loadBytes = std::array<std::uint8_t, 4>{ 0x48, 0x8B, 0x43, 0x40 };
+        const std::span<const std::uint8_t> codes[] = { addBytes, divBytes, loadBytes };
+
+        auto ctx = Execution::ScopedContext(mode, codes);
+        ASSERT_TRUE(ctx);
+        ASSERT_EQ(ctx.getBackend(), Execution::Backend::Debugger);
+
+        const auto dataAddr = ctx.getDataAddress();
+        ASSERT_NE(dataAddr, 0);
+
+        std::vector<Execution::InputState> inputs(4, ctx.getRegisterFile());
+        std::vector<Execution::OutputState> outputs(inputs.size());
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            for (std::size_t j = 0; j < Execution::kDataWindowSize / 8; ++j)
+            {
+                setDataQword(inputs[i], j, 1000 + j);
+            }
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RBX, dataAddr);
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RSI, i);
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RAX, 5);
+        }
+
+        // Every entry starts from its own memory, only the addressed qword changes.
+        ASSERT_TRUE(ctx.executeBatch(0, inputs, outputs));
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            ASSERT_EQ(outputs[i].status, Execution::ExecutionStatus::Success);
+            for (std::size_t j = 0; j < Execution::kDataWindowSize / 8; ++j)
+            {
+                ASSERT_EQ(getDataQword(outputs[i].regs, j), j == i ? 1005 + j : 1000 + j);
+            }
+            ASSERT_EQ(outputs[i].dataDirtyBegin, i * 8);
+            ASSERT_EQ(outputs[i].dataDirtyEnd, i * 8 + 1);
+        }
+
+        // Memory divisors tell #DE for a zero divisor apart from a quotient that doesn't fit.
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            setDataQword(inputs[i], 0, i);
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RAX, 100);
+            Execution::setRegValue<std::uint64_t>(inputs[i], ZYDIS_REGISTER_RDX, i == 1 ? 1 : 0);
+        }
+        ASSERT_TRUE(ctx.executeBatch(1, inputs, outputs));
+        ASSERT_EQ(outputs[0].status, Execution::ExecutionStatus::ExceptionIntDivideError);
+        ASSERT_EQ(outputs[1].status, Execution::ExecutionStatus::ExceptionIntOverflow);
+        for (std::size_t i = 2; i < inputs.size(); ++i)
+        {
+            ASSERT_EQ(outputs[i].status, Execution::ExecutionStatus::Success);
+            ASSERT_EQ(Execution::getRegValue<std::uint64_t>(outputs[i].regs, ZYDIS_REGISTER_RAX), 100 / i);
+            ASSERT_EQ(outputs[i].dataDirtyBegin, outputs[i].dataDirtyEnd);
+        }
+
+        // The window ends at a guard page.
+        ASSERT_TRUE(ctx.executeBatch(2, inputs, outputs));
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            ASSERT_EQ(outputs[i].status, Execution::ExecutionStatus::ExceptionAccessViolation);
+            ASSERT_EQ(Execution::getRegValue<std::uint64_t>(outputs[i].regs, ZYDIS_REGISTER_RIP), ctx.getCodeAddress(2));
+        }
+    }
+
 } // namespace x86Tester::tests
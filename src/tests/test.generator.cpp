@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <array>
+#include <gtest/gtest.h>
+#include <ranges>
+#include <vector>
+#include <x86Tester/generator.hpp>
+
+namespace x86Tester::tests
+{
+    static std::vector<std::vector<std::uint8_t>> collectEntries(const InstructionEntries& entries)
+    {
+        std::vector<std::vector<std::uint8_t>> res;
+        entries.forEach([&](auto data) { res.emplace_back(data.begin(), data.end()); });
+        return res;
+    }
+
+    TEST(GeneratorTest, parallel_matches_sequential)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+        const auto filter = Generator::Filter{}.addMnemonics(ZYDIS_MNEMONIC_ADD, ZYDIS_MNEMONIC_LEA);
+
+        const auto sequential = collectEntries(Generator::buildInstructions(mode, filter, false));
+        const auto parallel = collectEntries(Generator::buildInstructions(mode, filter, true));
+
+        ASSERT_FALSE(sequential.empty());
+        ASSERT_EQ(sequential, parallel);
+
+        // add rax, rcx
+        const auto addBytes = std::vector<std::uint8_t>{ 0x48, 0x01, 0xC8 };
+        ASSERT_NE(std::ranges::find(sequential, addBytes), sequential.end());
+    }
+
+    TEST(GeneratorTest, validity_cache_stats)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+        const auto filter = Generator::Filter{}.addMnemonics(ZYDIS_MNEMONIC_PSHUFD);
+
+        Generator::BuildStats stats{};
+        const auto entries = Generator::buildInstructions(mode, filter, true, {}, &stats);
+
+        ASSERT_GT(stats.numCombinations, 0);
+        ASSERT_EQ(stats.numCacheHits + stats.numCacheMisses, stats.numCombinations);
+        ASSERT_LE(stats.numCacheHits, stats.numInvalid);
+        // The legacy encoding has no XMM16 and up, those fail for every immediate of the same width.
+        ASSERT_GT(stats.numCacheHits, 0);
+        ASSERT_GE(stats.numCombinations - stats.numInvalid, entries.size());
+
+        // pshufd xmm15, xmm0, 1
+        const auto bytes = std::vector<std::uint8_t>{ 0x66, 0x44, 0x0F, 0x70, 0xF8, 0x01 };
+        const auto sequential = collectEntries(Generator::buildInstructions(mode, filter, false));
+        ASSERT_NE(std::ranges::find(sequential, bytes), sequential.end());
+    }
+
+    TEST(GeneratorTest, data_memory_forms)
+    {
+        const auto mode = ZydisMachineMode::ZYDIS_MACHINE_MODE_LONG_64;
+        const auto filter = Generator::Filter{}.addMnemonics(ZYDIS_MNEMONIC_ADD);
+
+        const auto entries = collectEntries(Generator::buildInstructions(mode, filter, false));
+
+        // add qword ptr [rbx], rax
+        const auto noSibBytes = std::vector<std::uint8_t>{ 0x48, 0x01, 0x03 };
+        ASSERT_NE(std::ranges::find(entries, noSibBytes), entries.end());
+
+        // add dword ptr [rbx+rsi*8-0x80], 1
+        const auto sibBytes = std::vector<std::uint8_t>{ 0x83, 0x44, 0xF3, 0x80, 0x01 };
+        ASSERT_NE(std::ranges::find(entries, sibBytes), entries.end());
+
+        // add al, byte ptr [r13+0x7F]
+        const auto disp8Bytes = std::vector<std::uint8_t>{ 0x41, 0x02, 0x45, 0x7F };
+        ASSERT_NE(std::ranges::find(entries, disp8Bytes), entries.end());
+    }
+
+} // namespace x86Tester::tests
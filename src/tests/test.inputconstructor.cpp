@@ -0,0 +1,235 @@
+#include "utils.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <x86Tester/inputconstructor.hpp>
+
+namespace x86Tester::tests
+{
+    using ExceptionType = TestData::ExceptionType;
+
+    // EAX, ECX and EDX as inputs, the same layout the input search passes.
+    struct Inputs
+    {
+        std::array<std::uint8_t, 4> eax{};
+        std::array<std::uint8_t, 4> ecx{};
+        std::array<std::uint8_t, 4> edx{};
+        std::uint32_t flags{};
+
+        bool construct(
+            const ZydisDisassembledInstruction& instr, const Generator::InputTarget& target, Random::Prng& prng)
+        {
+            const std::array<Generator::InputField, 3> fields{ {
+                { ZYDIS_REGISTER_EAX, eax },
+                { ZYDIS_REGISTER_ECX, ecx },
+                { ZYDIS_REGISTER_EDX, edx },
+            } };
+            flags = static_cast<std::uint32_t>(prng());
+
+            const auto constructor = Generator::getInputConstructor(instr.info.mnemonic);
+            return constructor != nullptr && constructor(instr, target, fields, flags, prng);
+        }
+
+        static std::uint32_t load(const std::array<std::uint8_t, 4>& data)
+        {
+            std::uint32_t value;
+            std::memcpy(&value, data.data(), sizeof(value));
+            return value;
+        }
+    };
+
+    static bool getBit(std::uint64_t value, std::size_t bitPos)
+    {
+        return ((value >> bitPos) & 1) != 0;
+    }
+
+    static Generator::InputTarget makeFlagTarget(std::uint32_t flag, std::uint8_t value)
+    {
+        return { ExceptionType::None, ZYDIS_REGISTER_FLAGS, static_cast<std::uint16_t>(std::countr_zero(flag)), value };
+    }
+
+    TEST(InputConstructorTest, divide)
+    {
+        Random::Prng prng(1);
+        Inputs inputs;
+
+        // div ecx
+        const auto div = disassemble(std::array<std::uint8_t, 2>{ 0xF7, 0xF1 });
+
+        ASSERT_TRUE(inputs.construct(div, { ExceptionType::DivideError, ZYDIS_REGISTER_NONE, 0, 0 }, prng));
+        ASSERT_EQ(Inputs::load(inputs.ecx), 0);
+
+        ASSERT_TRUE(inputs.construct(div, { ExceptionType::IntegerOverflow, ZYDIS_REGISTER_NONE, 0, 0 }, prng));
+        ASSERT_NE(Inputs::load(inputs.ecx), 0);
+        ASSERT_GE(Inputs::load(inputs.edx), Inputs::load(inputs.ecx));
+
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            for (std::uint8_t value = 0; value < 2; ++value)
+            {
+                for (const auto reg : { ZYDIS_REGISTER_EAX, ZYDIS_REGISTER_EDX })
+                {
+                    ASSERT_TRUE(inputs.construct(div, { ExceptionType::None, reg, bitPos, value }, prng));
+
+                    const auto divisor = std::uint64_t{ Inputs::load(inputs.ecx) };
+                    const auto dividend = (std::uint64_t{ Inputs::load(inputs.edx) } << 32) | Inputs::load(inputs.eax);
+                    ASSERT_NE(divisor, 0);
+                    ASSERT_LE(dividend / divisor, 0xFFFFFFFFU);
+
+                    const auto result = reg == ZYDIS_REGISTER_EAX ? dividend / divisor : dividend % divisor;
+                    ASSERT_EQ(getBit(result, bitPos), value != 0);
+                }
+            }
+        }
+
+        // idiv ecx
+        const auto idiv = disassemble(std::array<std::uint8_t, 2>{ 0xF7, 0xF9 });
+
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            for (std::uint8_t value = 0; value < 2; ++value)
+            {
+                for (const auto reg : { ZYDIS_REGISTER_EAX, ZYDIS_REGISTER_EDX })
+                {
+                    ASSERT_TRUE(inputs.construct(idiv, { ExceptionType::None, reg, bitPos, value }, prng));
+
+                    const auto divisor = std::int64_t{ static_cast<std::int32_t>(Inputs::load(inputs.ecx)) };
+                    const auto dividend = static_cast<std::int64_t>(
+                        (std::uint64_t{ Inputs::load(inputs.edx) } << 32) | Inputs::load(inputs.eax));
+                    ASSERT_NE(divisor, 0);
+
+                    const auto quotient = dividend / divisor;
+                    ASSERT_GE(quotient, INT32_MIN);
+                    ASSERT_LE(quotient, INT32_MAX);
+
+                    const auto result = reg == ZYDIS_REGISTER_EAX ? quotient : dividend % divisor;
+                    ASSERT_EQ(getBit(static_cast<std::uint64_t>(result), bitPos), value != 0);
+                }
+            }
+        }
+    }
+
+    TEST(InputConstructorTest, alu_flags)
+    {
+        Random::Prng prng(1);
+        Inputs inputs;
+
+        // add eax, ecx ; sbb eax, ecx
+        const auto add = disassemble(std::array<std::uint8_t, 2>{ 0x01, 0xC8 });
+        const auto sbb = disassemble(std::array<std::uint8_t, 2>{ 0x19, 0xC8 });
+
+        const std::uint32_t flags[] = {
+            ZYDIS_CPUFLAG_CF, ZYDIS_CPUFLAG_PF, ZYDIS_CPUFLAG_AF, ZYDIS_CPUFLAG_ZF, ZYDIS_CPUFLAG_SF, ZYDIS_CPUFLAG_OF,
+        };
+
+        for (const auto flag : flags)
+        {
+            for (std::uint8_t value = 0; value < 2; ++value)
+            {
+                for (const auto* instr : { &add, &sbb })
+                {
+                    ASSERT_TRUE(inputs.construct(*instr, makeFlagTarget(flag, value), prng));
+
+                    const auto a = Inputs::load(inputs.eax);
+                    const auto b = Inputs::load(inputs.ecx);
+                    const std::uint32_t carry = instr == &sbb ? inputs.flags & ZYDIS_CPUFLAG_CF : 0;
+
+                    const auto wide = instr == &add ? std::uint64_t{ a } + b : std::uint64_t{ a } - b - carry;
+                    const auto res = static_cast<std::uint32_t>(wide);
+                    const auto overflow = instr == &add ? (~(a ^ b) & (a ^ res)) >> 31 : ((a ^ b) & (a ^ res)) >> 31;
+
+                    bool isSet = false;
+                    switch (flag)
+                    {
+                        case ZYDIS_CPUFLAG_CF:
+                            isSet = (wide >> 32) != 0;
+                            break;
+                        case ZYDIS_CPUFLAG_PF:
+                            isSet = std::popcount(static_cast<std::uint8_t>(res)) % 2 == 0;
+                            break;
+                        case ZYDIS_CPUFLAG_AF:
+                            isSet = getBit(a ^ b ^ res, 4);
+                            break;
+                        case ZYDIS_CPUFLAG_ZF:
+                            isSet = res == 0;
+                            break;
+                        case ZYDIS_CPUFLAG_SF:
+                            isSet = getBit(res, 31);
+                            break;
+                        case ZYDIS_CPUFLAG_OF:
+                            isSet = overflow != 0;
+                            break;
+                    }
+                    ASSERT_EQ(isSet, value != 0);
+                }
+            }
+        }
+    }
+
+    TEST(InputConstructorTest, shifts_and_bit_tests)
+    {
+        Random::Prng prng(1);
+        Inputs inputs;
+
+        // shl eax, cl ; sar eax, cl ; ror eax, cl
+        const auto shl = disassemble(std::array<std::uint8_t, 2>{ 0xD3, 0xE0 });
+        const auto sar = disassemble(std::array<std::uint8_t, 2>{ 0xD3, 0xF8 });
+        const auto ror = disassemble(std::array<std::uint8_t, 2>{ 0xD3, 0xC8 });
+
+        for (std::uint16_t bitPos = 0; bitPos < 32; ++bitPos)
+        {
+            for (std::uint8_t value = 0; value < 2; ++value)
+            {
+                ASSERT_TRUE(inputs.construct(shl, { ExceptionType::None, ZYDIS_REGISTER_EAX, bitPos, value }, prng));
+                const auto shlCount = inputs.ecx[0] & 31;
+                ASSERT_EQ(getBit(Inputs::load(inputs.eax) << shlCount, bitPos), value != 0);
+
+                ASSERT_TRUE(inputs.construct(sar, { ExceptionType::None, ZYDIS_REGISTER_EAX, bitPos, value }, prng));
+                const auto sarCount = inputs.ecx[0] & 31;
+                const auto sarResult = static_cast<std::int32_t>(Inputs::load(inputs.eax)) >> sarCount;
+                ASSERT_EQ(getBit(static_cast<std::uint32_t>(sarResult), bitPos), value != 0);
+
+                ASSERT_TRUE(inputs.construct(ror, { ExceptionType::None, ZYDIS_REGISTER_EAX, bitPos, value }, prng));
+                const auto rorCount = inputs.ecx[0] & 31;
+                ASSERT_EQ(getBit(std::rotr(Inputs::load(inputs.eax), rorCount), bitPos), value != 0);
+            }
+        }
+
+        for (std::uint8_t value = 0; value < 2; ++value)
+        {
+            // Last bit shifted out.
+            ASSERT_TRUE(inputs.construct(shl, makeFlagTarget(ZYDIS_CPUFLAG_CF, value), prng));
+            const auto count = inputs.ecx[0] & 31;
+            ASSERT_NE(count, 0);
+            ASSERT_EQ(getBit(Inputs::load(inputs.eax), 32 - count), value != 0);
+        }
+
+        // bts eax, ecx
+        const auto bts = disassemble(std::array<std::uint8_t, 3>{ 0x0F, 0xAB, 0xC8 });
+
+        for (std::uint8_t value = 0; value < 2; ++value)
+        {
+            ASSERT_TRUE(inputs.construct(bts, makeFlagTarget(ZYDIS_CPUFLAG_CF, value), prng));
+            ASSERT_EQ(getBit(Inputs::load(inputs.eax), Inputs::load(inputs.ecx) % 32), value != 0);
+
+            ASSERT_TRUE(inputs.construct(bts, { ExceptionType::None, ZYDIS_REGISTER_EAX, 7, value }, prng));
+            const auto res = Inputs::load(inputs.eax) | (1U << (Inputs::load(inputs.ecx) % 32));
+            ASSERT_EQ(getBit(res, 7), value != 0);
+        }
+    }
+
+    TEST(InputConstructorTest, unsupported)
+    {
+        Random::Prng prng(1);
+        Inputs inputs;
+
+        // add eax, eax
+        const auto add = disassemble(std::array<std::uint8_t, 2>{ 0x01, 0xC0 });
+        ASSERT_FALSE(inputs.construct(add, makeFlagTarget(ZYDIS_CPUFLAG_ZF, 1), prng));
+
+        ASSERT_EQ(Generator::getInputConstructor(ZYDIS_MNEMONIC_CPUID), nullptr);
+    }
+
+} // namespace x86Tester::tests
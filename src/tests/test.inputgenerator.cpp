@@ -0,0 +1,186 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <new>
+#include <vector>
+#include <x86Tester/inputgenerator.hpp>
+
+// Counts the allocations of the current thread, replaces the global allocator of the test binary.
+static thread_local std::size_t numAllocations = 0;
+
+void* operator new(std::size_t size)
+{
+    numAllocations++;
+    if (void* ptr = std::malloc(size != 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace x86Tester::tests
+{
+    TEST(InputGeneratorTest, no_allocations)
+    {
+        Random::Prng prng(1);
+
+        std::vector<Generator::InputGenerator> generators;
+        generators.reserve(4);
+
+        const auto allocationsBefore = numAllocations;
+
+        // Same pattern as the input search, the generators are recreated for every matrix entry.
+        std::size_t checksum = 0;
+        for (std::size_t matrixEntry = 0; matrixEntry < 8; ++matrixEntry)
+        {
+            generators.clear();
+            generators.emplace_back(8, prng);
+            generators.emplace_back(32, prng);
+            generators.emplace_back(64, prng);
+            generators.emplace_back(128, prng);
+
+            for (std::size_t iteration = 0; iteration < 1000; ++iteration)
+            {
+                for (auto& generator : generators)
+                {
+                    generator.advance();
+                    checksum += generator.current()[0];
+                }
+            }
+        }
+
+        ASSERT_EQ(numAllocations, allocationsBefore);
+        ASSERT_EQ(generators[3].current().size(), 16);
+        ASSERT_NE(checksum, 0);
+    }
+
+    TEST(InputGeneratorTest, magic_numbers_from_pool)
+    {
+        // The pools are built at compile time.
+        constexpr auto& pool = Generator::Detail::kMagicNumbers64b;
+        static_assert(pool.size() > 0);
+
+        // Sorted and unique.
+        for (std::size_t i = 1; i < pool.size(); ++i)
+        {
+            std::int64_t prev;
+            std::int64_t next;
+            std::memcpy(&prev, pool[i - 1], sizeof(prev));
+            std::memcpy(&next, pool[i], sizeof(next));
+            ASSERT_LT(prev, next);
+        }
+
+        Random::Prng prng(1);
+        Generator::InputGenerator generator(64, prng);
+
+        // Magic numbers point into the pool instead of being copied.
+        const auto poolBegin = reinterpret_cast<std::uintptr_t>(pool.bytes.data());
+        const auto poolEnd = poolBegin + pool.bytes.size();
+
+        std::size_t numPooled = 0;
+        for (std::size_t i = 0; i < 2000; ++i)
+        {
+            generator.advance();
+
+            const auto address = reinterpret_cast<std::uintptr_t>(generator.current().data());
+            if (address >= poolBegin && address < poolEnd)
+            {
+                ASSERT_EQ((address - poolBegin) % sizeof(std::int64_t), 0);
+                numPooled++;
+            }
+        }
+
+        ASSERT_GE(numPooled, pool.size());
+    }
+
+    static void testWideStrategies(std::size_t maxBits, const std::uint8_t* poolBegin, std::size_t poolSize)
+    {
+        Random::Prng prng(1);
+        Generator::InputGenerator generator(maxBits, prng);
+        ASSERT_EQ(generator.current().size(), maxBits / 8);
+
+        const auto poolBytes = poolSize * (maxBits / 8);
+
+        // Random flips and every pool entry, then the strategies wrap around.
+        std::size_t numSteps = 0;
+        std::size_t numPooled = 0;
+        for (bool wrapped = false; !wrapped;)
+        {
+            ASSERT_LT(++numSteps, 100000);
+            wrapped = !generator.advance();
+
+            const auto* data = generator.current().data();
+            if (data >= poolBegin && data < poolBegin + poolBytes)
+                numPooled++;
+        }
+
+        ASSERT_EQ(numPooled, poolSize);
+        ASSERT_TRUE(generator.advance());
+    }
+
+    TEST(InputGeneratorTest, wide_inputs_cycle_strategies)
+    {
+        constexpr auto& xmm = Generator::Detail::kMagicNumbers128b;
+        constexpr auto& ymm = Generator::Detail::kMagicNumbers256b;
+        constexpr auto& zmm = Generator::Detail::kMagicNumbers512b;
+        static_assert(ymm.size() == xmm.size() && zmm.size() == xmm.size());
+
+        // Every lane holds the 128 bit value.
+        for (std::size_t i = 0; i < xmm.size(); ++i)
+        {
+            for (std::size_t lane = 0; lane < 4; ++lane)
+            {
+                ASSERT_EQ(std::memcmp(zmm[i] + lane * 16, xmm[i], 16), 0);
+            }
+        }
+
+        testWideStrategies(256, ymm.bytes.data(), ymm.size());
+        testWideStrategies(512, zmm.bytes.data(), zmm.size());
+    }
+
+    TEST(InputGeneratorTest, corpus_mutates_entries)
+    {
+        Random::Prng prng(1);
+
+        const std::size_t fieldSizes[] = { 8, 1, 16 };
+        Generator::InputCorpus corpus(fieldSizes, prng);
+        ASSERT_EQ(corpus.getEntrySize(), 25);
+        ASSERT_TRUE(corpus.empty());
+
+        std::vector<std::uint8_t> input(corpus.getEntrySize(), 0x11);
+        corpus.add(input);
+
+        std::vector<std::uint8_t> mutated(corpus.getEntrySize());
+
+        const auto allocationsBefore = numAllocations;
+
+        std::size_t numChanged = 0;
+        for (std::size_t i = 0; i < 1000; ++i)
+        {
+            corpus.mutate(mutated);
+            if (mutated != input)
+                numChanged++;
+        }
+
+        // A full corpus replaces the oldest entries.
+        for (std::size_t i = 0; i < Generator::InputCorpus::kMaxEntries; ++i)
+        {
+            corpus.add(mutated);
+        }
+
+        ASSERT_EQ(numAllocations, allocationsBefore);
+        ASSERT_EQ(corpus.size(), Generator::InputCorpus::kMaxEntries);
+        // Splicing from the only entry keeps the input as is, everything else changes it.
+        ASSERT_GT(numChanged, 800);
+    }
+
+} // namespace x86Tester::tests
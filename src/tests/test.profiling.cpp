@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <thread>
+#include <vector>
+#include <x86Tester/profiling.hpp>
+
+namespace x86Tester::tests
+{
+    TEST(ProfilingTest, totals_over_threads)
+    {
+        constexpr std::size_t kNumThreads = 4;
+        constexpr std::size_t kNumAdds = 1000;
+
+        const auto before = Profiling::getTotals();
+
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < kNumThreads; ++i)
+        {
+            threads.emplace_back([]() {
+                for (std::size_t j = 0; j < kNumAdds; ++j)
+                {
+                    Profiling::ScopedTimer timer(Profiling::Counter::MatchCycles);
+                    Profiling::add(Profiling::Counter::BitsSatisfied);
+                    Profiling::add(Profiling::Counter::IterationsToSatisfy, 3);
+                }
+            });
+        }
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        // The counters of finished threads are still part of the totals.
+        const auto after = Profiling::getTotals();
+        const auto getDelta = [&](Profiling::Counter counter) {
+            return after[static_cast<std::size_t>(counter)] - before[static_cast<std::size_t>(counter)];
+        };
+        ASSERT_EQ(getDelta(Profiling::Counter::BitsSatisfied), kNumThreads * kNumAdds);
+        ASSERT_EQ(getDelta(Profiling::Counter::IterationsToSatisfy), kNumThreads * kNumAdds * 3);
+        ASSERT_GT(getDelta(Profiling::Counter::MatchCycles), 0);
+        ASSERT_EQ(getDelta(Profiling::Counter::BitsAborted), 0);
+
+        ASSERT_GT(Profiling::getTscFrequency(), 0.0);
+        ASSERT_EQ(Profiling::getCounterName(Profiling::Counter::Executions), "executions");
+    }
+
+    TEST(ProfilingTest, registry_instance_per_thread)
+    {
+        struct Local
+        {
+            std::thread::id owner;
+        };
+
+        Profiling::ThreadRegistry<Local> registry;
+        registry.local().owner = std::this_thread::get_id();
+        ASSERT_EQ(&registry.local(), &registry.local());
+
+        std::thread thread([&]() { registry.local().owner = std::this_thread::get_id(); });
+        thread.join();
+
+        std::set<std::thread::id> owners;
+        registry.forEach([&](const Local& local) { owners.insert(local.owner); });
+        ASSERT_EQ(owners.size(), 2);
+        ASSERT_TRUE(owners.contains(std::this_thread::get_id()));
+    }
+
+} // namespace x86Tester::tests
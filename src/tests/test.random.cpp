@@ -0,0 +1,79 @@
+#include <array>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <x86Tester/random.hpp>
+
+namespace x86Tester::tests
+{
+    TEST(RandomTest, matches_reference)
+    {
+        // State expanded with SplitMix64 from seed 1, values from the reference implementation.
+        Random::Xoshiro256 prng(1);
+        ASSERT_EQ(prng(), 0xB3F2AF6D0FC710C5ULL);
+        ASSERT_EQ(prng(), 0x853B559647364CEAULL);
+        ASSERT_EQ(prng(), 0x92F89756082A4514ULL);
+
+        Random::Xoshiro256 jumped(1);
+        jumped.jump();
+        ASSERT_EQ(jumped(), 0x332802F81EAAE9D0ULL);
+        ASSERT_EQ(jumped(), 0x02D18D7749B84F96ULL);
+        ASSERT_EQ(jumped(), 0xC3729A527851F63DULL);
+
+        // Usable in constant expressions.
+        static_assert(Random::Xoshiro256(1)() == 0xB3F2AF6D0FC710C5ULL);
+    }
+
+    TEST(RandomTest, streams_are_deterministic)
+    {
+        // Creation order doesn't matter, a stream only depends on the seed and its index.
+        const auto a = Random::makeStream(42, 7);
+        const auto b = Random::makeStream(42, 3);
+        ASSERT_EQ(a, Random::makeStream(42, 7));
+        ASSERT_EQ(b, Random::makeStream(42, 3));
+
+        auto streamA = a;
+        auto streamB = b;
+        auto other = Random::makeStream(43, 7);
+        std::size_t numEqual = 0;
+        for (std::size_t i = 0; i < 1000; ++i)
+        {
+            const auto value = streamA();
+            if (value == streamB() || value == other())
+                numEqual++;
+        }
+        ASSERT_EQ(numEqual, 0);
+    }
+
+    TEST(RandomTest, bounded_draws)
+    {
+        Random::Prng prng(1);
+
+        std::array<std::size_t, 7> counts{};
+        for (std::size_t i = 0; i < 7000; ++i)
+        {
+            const auto value = prng.nextBelow(counts.size());
+            ASSERT_LT(value, counts.size());
+            counts[value]++;
+        }
+        for (const auto count : counts)
+        {
+            ASSERT_GT(count, 800);
+            ASSERT_LT(count, 1200);
+        }
+
+        // All bits of the mask take both values, nothing outside of it is set.
+        const std::uint64_t mask = 0x8D5;
+        std::uint64_t seenSet = 0;
+        std::uint64_t seenClear = 0;
+        for (std::size_t i = 0; i < 64; ++i)
+        {
+            const auto value = prng.nextBits(mask);
+            ASSERT_EQ(value & ~mask, 0);
+            seenSet |= value;
+            seenClear |= ~value & mask;
+        }
+        ASSERT_EQ(seenSet, mask);
+        ASSERT_EQ(seenClear, mask);
+    }
+
+} // namespace x86Tester::tests
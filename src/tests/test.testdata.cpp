@@ -0,0 +1,145 @@
+#include <array>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <ranges>
+#include <vector>
+#include <x86Tester/testdata.hpp>
+
+namespace x86Tester::tests
+{
+    static std::vector<std::uint8_t> buildSampleFile()
+    {
+        const auto instrBytes = std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0xF1 };
+        const auto rax = std::array<std::uint8_t, 8>{ 1, 2, 3, 4, 5, 6, 7, 8 };
+        const auto rcx = std::array<std::uint8_t, 8>{};
+        const auto xmm0 = std::array<std::uint8_t, 16>{ 0xAA, 0xBB, 0xCC };
+
+        TestData::Writer writer(ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_MNEMONIC_DIV);
+        EXPECT_TRUE(writer.beginInstruction(0x4000001, instrBytes));
+
+        const TestData::RegValue inputs[] = { { ZYDIS_REGISTER_RAX, rax }, { ZYDIS_REGISTER_RCX, rcx } };
+        EXPECT_TRUE(writer.addEntry(inputs, std::nullopt, {}, std::nullopt, TestData::ExceptionType::DivideError));
+
+        const TestData::RegValue outputs[] = { { ZYDIS_REGISTER_XMM0, xmm0 } };
+        EXPECT_TRUE(writer.addEntry(inputs, 0x202, outputs, 0x203, std::nullopt));
+
+        return writer.finish();
+    }
+
+    TEST(TestDataTest, round_trip)
+    {
+        const auto data = buildSampleFile();
+
+        TestData::FileView file;
+        ASSERT_TRUE(file.open(data));
+        ASSERT_EQ(file.getMachineMode(), ZYDIS_MACHINE_MODE_LONG_64);
+        ASSERT_EQ(file.getMnemonic(), ZYDIS_MNEMONIC_DIV);
+        ASSERT_EQ(file.getInstructionCount(), 1);
+
+        const auto instr = file.getInstruction(0);
+        ASSERT_EQ(instr.getAddress(), 0x4000001);
+        ASSERT_TRUE(std::ranges::equal(instr.getBytes(), std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0xF1 }));
+        ASSERT_EQ(instr.getEntryCount(), 2);
+
+        std::vector<TestData::EntryView> entries(instr.begin(), instr.end());
+        ASSERT_EQ(entries.size(), 2);
+
+        ASSERT_EQ(entries[0].getInputCount(), 2);
+        ASSERT_EQ(entries[0].getOutputCount(), 0);
+        ASSERT_EQ(entries[0].getInput(0).reg, ZYDIS_REGISTER_RAX);
+        ASSERT_TRUE(std::ranges::equal(entries[0].getInput(0).data, std::array<std::uint8_t, 8>{ 1, 2, 3, 4, 5, 6, 7, 8 }));
+        ASSERT_FALSE(entries[0].getInputFlags().has_value());
+        ASSERT_EQ(entries[0].getException(), TestData::ExceptionType::DivideError);
+
+        ASSERT_EQ(entries[1].getInputFlags(), 0x202);
+        ASSERT_EQ(entries[1].getOutputFlags(), 0x203);
+        ASSERT_FALSE(entries[1].getException().has_value());
+        const auto xmm0 = entries[1].getOutput(0);
+        ASSERT_EQ(xmm0.reg, ZYDIS_REGISTER_XMM0);
+        ASSERT_EQ(xmm0.data.size(), 16);
+        ASSERT_EQ(xmm0.data[1], 0xBB);
+
+        // Payloads are aligned to their size.
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(xmm0.data.data()) % 16, 0);
+    }
+
+    TEST(TestDataTest, rejects_truncated)
+    {
+        auto data = buildSampleFile();
+
+        TestData::FileView file;
+        ASSERT_FALSE(file.open(std::span(data).first(data.size() - 16)));
+        ASSERT_FALSE(file);
+
+        data[0] = 'Y';
+        ASSERT_FALSE(file.open(data));
+    }
+
+    TEST(TestDataTest, mapped_file)
+    {
+        const auto path = std::filesystem::temp_directory_path() / "x86tester_testdata.bin";
+        {
+            TestData::Writer writer(ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_MNEMONIC_DIV);
+            const auto instrBytes = std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0xF1 };
+            ASSERT_TRUE(writer.beginInstruction(0x4000001, instrBytes));
+            ASSERT_TRUE(writer.writeToFile(path));
+        }
+
+        {
+            TestData::MappedFile mapped;
+            ASSERT_TRUE(mapped.open(path));
+
+            TestData::FileView file;
+            ASSERT_TRUE(file.open(mapped.getData()));
+            ASSERT_EQ(file.getInstructionCount(), 1);
+            ASSERT_EQ(file.getInstruction(0).getEntryCount(), 0);
+        }
+
+        std::filesystem::remove(path);
+    }
+
+    TEST(TestDataTest, stream_writer)
+    {
+        const auto path = std::filesystem::temp_directory_path() / "x86tester_stream.bin";
+        const auto instrBytes = std::array<std::uint8_t, 3>{ 0x48, 0xF7, 0xF1 };
+        const auto rax = std::array<std::uint8_t, 8>{ 1, 2, 3, 4, 5, 6, 7, 8 };
+        const TestData::RegValue inputs[] = { { ZYDIS_REGISTER_RAX, rax } };
+        {
+            TestData::StreamWriter writer(ZYDIS_MACHINE_MODE_LONG_64, ZYDIS_MNEMONIC_DIV);
+            ASSERT_TRUE(writer.open(path));
+            ASSERT_TRUE(writer.beginInstruction(0x4000001, instrBytes));
+            ASSERT_TRUE(writer.addEntry(inputs, 0x202, {}, std::nullopt, TestData::ExceptionType::DivideError));
+            ASSERT_TRUE(writer.beginInstruction(0x4000002, instrBytes));
+            ASSERT_TRUE(writer.beginInstruction(0x4000003, instrBytes));
+            ASSERT_TRUE(writer.addEntry(inputs, std::nullopt, inputs, 0x203, std::nullopt));
+            ASSERT_TRUE(writer.addEntry({}, std::nullopt, inputs, std::nullopt, std::nullopt));
+            ASSERT_TRUE(writer.close());
+        }
+
+        {
+            TestData::MappedFile mapped;
+            ASSERT_TRUE(mapped.open(path));
+
+            TestData::FileView file;
+            ASSERT_TRUE(file.open(mapped.getData()));
+            ASSERT_EQ(file.getMnemonic(), ZYDIS_MNEMONIC_DIV);
+            ASSERT_EQ(file.getInstructionCount(), 3);
+            ASSERT_EQ(file.getInstruction(0).getEntryCount(), 1);
+            ASSERT_EQ(file.getInstruction(1).getEntryCount(), 0);
+            ASSERT_EQ(file.getInstruction(2).getAddress(), 0x4000003);
+
+            // The table follows the entries.
+            ASSERT_GT(file.getHeader().instrTableOffset, sizeof(TestData::FileHeader));
+
+            const auto instr = file.getInstruction(2);
+            std::vector<TestData::EntryView> entries(instr.begin(), instr.end());
+            ASSERT_EQ(entries.size(), 2);
+            ASSERT_EQ(entries[0].getOutputFlags(), 0x203);
+            ASSERT_EQ(entries[1].getInputCount(), 0);
+            ASSERT_TRUE(std::ranges::equal(entries[1].getOutput(0).data, rax));
+        }
+
+        std::filesystem::remove(path);
+    }
+
+} // namespace x86Tester::tests
@@ -0,0 +1,108 @@
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include <x86Tester/boundedqueue.hpp>
+#include <x86Tester/threadpool.hpp>
+
+namespace x86Tester::tests
+{
+    TEST(ThreadPoolTest, runs_all_tasks)
+    {
+        Threading::ThreadPool pool(4);
+        ASSERT_EQ(pool.getWorkerCount(), 4);
+
+        constexpr std::size_t kNumTasks = 1000;
+
+        std::vector<std::atomic<int>> counters(kNumTasks);
+        std::vector<Threading::ThreadPool::Task> tasks;
+        for (std::size_t i = 0; i < kNumTasks; ++i)
+        {
+            tasks.push_back([&counters, i](std::size_t) { counters[i]++; });
+        }
+
+        pool.run(std::move(tasks));
+
+        for (const auto& counter : counters)
+        {
+            ASSERT_EQ(counter.load(), 1);
+        }
+
+        // The pool is reusable.
+        std::atomic<std::size_t> secondRun{};
+        pool.run({ [&](std::size_t) { secondRun++; }, [&](std::size_t) { secondRun++; } });
+        ASSERT_EQ(secondRun.load(), 2);
+
+        const auto stats = pool.getStats();
+        const auto executed = std::accumulate(
+            stats.begin(), stats.end(), std::size_t{}, [](std::size_t acc, const auto& s) { return acc + s.tasksExecuted; });
+        ASSERT_EQ(executed, kNumTasks + 2);
+    }
+
+    TEST(ThreadPoolTest, idle_workers_steal)
+    {
+        Threading::ThreadPool pool(2);
+
+        // Round robin puts every slow task on the first worker, the second one runs out quickly.
+        std::vector<Threading::ThreadPool::Task> tasks;
+        for (std::size_t i = 0; i < 16; ++i)
+        {
+            if (i % 2 == 0)
+                tasks.push_back([](std::size_t) { std::this_thread::sleep_for(std::chrono::milliseconds(5)); });
+            else
+                tasks.push_back([](std::size_t) {});
+        }
+
+        pool.run(std::move(tasks));
+
+        const auto stats = pool.getStats();
+        ASSERT_EQ(stats[0].tasksExecuted + stats[1].tasksExecuted, 16);
+        ASSERT_GT(stats[1].tasksStolen, 0);
+    }
+
+    TEST(ThreadPoolTest, tasks_submit_tasks)
+    {
+        Threading::ThreadPool pool(3);
+
+        std::atomic<std::size_t> numLeafs{};
+        std::vector<Threading::ThreadPool::Task> tasks;
+        for (std::size_t i = 0; i < 8; ++i)
+        {
+            tasks.push_back([&](std::size_t) {
+                pool.submit({ [&](std::size_t) { numLeafs++; }, [&](std::size_t) { numLeafs++; } });
+            });
+        }
+
+        // wait() covers the tasks submitted while it was waiting.
+        pool.run(std::move(tasks));
+        ASSERT_EQ(numLeafs.load(), 16);
+    }
+
+    TEST(ThreadPoolTest, bounded_queue_close_drains)
+    {
+        Threading::BoundedQueue<int> queue(2);
+
+        std::thread producer([&]() {
+            for (int i = 0; i < 100; ++i)
+            {
+                EXPECT_TRUE(queue.push(i));
+            }
+            queue.close();
+        });
+
+        int expected = 0;
+        int value = 0;
+        while (queue.pop(value))
+        {
+            ASSERT_EQ(value, expected);
+            expected++;
+        }
+        producer.join();
+
+        ASSERT_EQ(expected, 100);
+        ASSERT_FALSE(queue.push(0));
+    }
+
+} // namespace x86Tester::tests
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <Zydis/Disassembler.h>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <span>
+
+namespace x86Tester::tests
+{
+    // 64 bit disassembly at address 0, fails the current test when the bytes don't decode.
+    inline ZydisDisassembledInstruction disassemble(std::span<const std::uint8_t> bytes)
+    {
+        ZydisDisassembledInstruction instr{};
+        EXPECT_TRUE(ZYAN_SUCCESS(
+            ZydisDisassembleIntel(ZYDIS_MACHINE_MODE_LONG_64, 0, bytes.data(), bytes.size(), &instr)));
+        return instr;
+    }
+
+} // namespace x86Tester::tests